@@ -0,0 +1,85 @@
+//===--- ConformanceHits.swift --------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks look up protocol conformances that are already in the
+// runtime's conformance cache from 1, 4 and 16 threads at once.  Casting a
+// metatype to an existential metatype asks the runtime for the conformance
+// on every cast.  Every thread does the same amount of work, so as long as
+// there are enough cores, lookups that hit scale linearly exactly when all
+// three take the same time.  Run them with SWIFT_CACHE_REPLICAS set to
+// compare against replicated caches.
+import TestsUtils
+
+protocol ConformanceHitsProto {}
+
+struct ConformanceHitsStruct : ConformanceHitsProto {}
+class ConformanceHitsClass : ConformanceHitsProto {}
+enum ConformanceHitsEnum : ConformanceHitsProto { case a }
+struct ConformanceHitsNonconforming {}
+
+extension Int : ConformanceHitsProto {}
+extension Double : ConformanceHitsProto {}
+extension String : ConformanceHitsProto {}
+extension Array : ConformanceHitsProto {}
+
+let conformanceHitsTypes: [Any.Type] = [
+  ConformanceHitsStruct.self,
+  ConformanceHitsClass.self,
+  ConformanceHitsEnum.self,
+  Int.self,
+  Double.self,
+  String.self,
+  [Int].self,
+  [String].self,
+  ConformanceHitsNonconforming.self,
+  Bool.self,
+]
+
+// All of the types but the last two conform.
+let conformanceHitsConforming = conformanceHitsTypes.count - 2
+
+@inline(never)
+func countConformingTypes(_ types: [Any.Type], _ count: Int) -> Int {
+  var found = 0
+  for _ in 0..<count {
+    for type in types {
+      if type is ConformanceHitsProto.Type {
+        found += 1
+      }
+    }
+  }
+  return found
+}
+
+func runConformanceHits(_ N: Int, threads: Int) {
+  let count = N * 10000
+  RunOnThreads(threads) { _ in
+    let found = countConformingTypes(conformanceHitsTypes, count)
+    CheckResults(found == count * conformanceHitsConforming,
+                 "Incorrect results in ConformanceHits")
+  }
+}
+
+@inline(never)
+public func run_ConformanceHits1(_ N: Int) {
+  runConformanceHits(N, threads: 1)
+}
+
+@inline(never)
+public func run_ConformanceHits4(_ N: Int) {
+  runConformanceHits(N, threads: 4)
+}
+
+@inline(never)
+public func run_ConformanceHits16(_ N: Int) {
+  runConformanceHits(N, threads: 16)
+}
@@ -0,0 +1,110 @@
+//===--- DynamicCast.swift ------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks repeat the same dynamic casts many times, as a decoder or
+// an event dispatcher would, to measure the cost of a cast between a pair of
+// types that has been seen before.
+import TestsUtils
+
+class CastBase {
+  var value: Int
+  init(_ value: Int) {
+    self.value = value
+  }
+}
+
+class CastDerived1 : CastBase {}
+class CastDerived2 : CastDerived1 {}
+class CastDerived3 : CastDerived2 {}
+class CastUnrelated {}
+
+protocol CastValueProtocol {
+  var value: Int { get }
+}
+
+struct CastValue : CastValueProtocol {
+  var value: Int
+}
+
+@inline(never)
+func castToDerived(_ object: AnyObject) -> CastDerived1? {
+  return object as? CastDerived1
+}
+
+@inline(never)
+func castToProtocol(_ value: Any) -> CastValueProtocol? {
+  return value as? CastValueProtocol
+}
+
+@inline(never)
+func castToInt(_ value: Any) -> Int? {
+  return value as? Int
+}
+
+@inline(never)
+func castToDerivedArray(_ array: [CastBase]) -> [CastDerived1]? {
+  return array as? [CastDerived1]
+}
+
+@inline(never)
+public func run_DynamicCastClass(_ N: Int) {
+  let objects: [AnyObject] = [CastDerived3(1), CastUnrelated(), CastDerived1(2)]
+  var sum = 0
+  for _ in 0..<(N * 100000) {
+    for object in objects {
+      if let derived = castToDerived(object) {
+        sum += derived.value
+      }
+    }
+  }
+  CheckResults(sum == N * 300000, "Incorrect results in DynamicCastClass")
+}
+
+@inline(never)
+public func run_DynamicCastProtocol(_ N: Int) {
+  let values: [Any] = [CastValue(value: 1), 2, CastValue(value: 3)]
+  var sum = 0
+  for _ in 0..<(N * 100000) {
+    for value in values {
+      if let p = castToProtocol(value) {
+        sum += p.value
+      }
+    }
+  }
+  CheckResults(sum == N * 400000, "Incorrect results in DynamicCastProtocol")
+}
+
+@inline(never)
+public func run_DynamicCastOptional(_ N: Int) {
+  let values: [Any] = [Optional<Int>.some(1), Optional<Int>.none, 2, "3"]
+  var sum = 0
+  for _ in 0..<(N * 100000) {
+    for value in values {
+      if let i = castToInt(value) {
+        sum += i
+      }
+    }
+  }
+  CheckResults(sum == N * 300000, "Incorrect results in DynamicCastOptional")
+}
+
+@inline(never)
+public func run_DynamicCastArray(_ N: Int) {
+  let array: [CastBase] = (0..<100).map { CastDerived3($0) }
+  var count = 0
+  for _ in 0..<(N * 1000) {
+    if let derived = castToDerivedArray(array) {
+      count += derived.count
+    }
+  }
+  CheckResults(count == N * 100000, "Incorrect results in DynamicCastArray")
+}
@@ -0,0 +1,72 @@
+//===--- FloatingPointPrinting.swift --------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks measure converting floating-point values to strings
+// through description and string interpolation, as serializing telemetry or
+// logging numbers would.  The values mix short decimals, which print with
+// few digits, and arbitrary bit patterns, which need the most digits.
+import TestsUtils
+
+let floatingPointValueCount = 1_000
+
+func makeDoubles() -> [Double] {
+  SRand()
+  var values: [Double] = []
+  for i in 0..<floatingPointValueCount {
+    if i % 2 == 0 {
+      values.append(Double(i) / 8.0 + 0.1)
+    } else {
+      let bits = UInt64(Random()) << 32 | UInt64(Random())
+      // Keep the exponent in a range of finite values.
+      values.append(Double(bitPattern: bits & 0xbfff_ffff_ffff_ffff))
+    }
+  }
+  return values
+}
+
+@inline(never)
+public func run_FloatingPointPrintingDouble(_ N: Int) {
+  let values = makeDoubles()
+  var length = 0
+  for _ in 1...N {
+    for value in values {
+      length = length &+ value.description.utf8.count
+    }
+  }
+  CheckResults(length > 0, "IncorrectResults in FloatingPointPrintingDouble")
+}
+
+@inline(never)
+public func run_FloatingPointPrintingFloat(_ N: Int) {
+  let values = makeDoubles().map { Float($0) }
+  var length = 0
+  for _ in 1...N {
+    for value in values {
+      length = length &+ value.description.utf8.count
+    }
+  }
+  CheckResults(length > 0, "IncorrectResults in FloatingPointPrintingFloat")
+}
+
+@inline(never)
+public func run_FloatingPointPrintingInterpolated(_ N: Int) {
+  let values = makeDoubles()
+  var length = 0
+  for _ in 1...N {
+    for i in stride(from: 0, to: values.count - 1, by: 2) {
+      let s = "x=\(values[i]) y=\(values[i + 1])"
+      length = length &+ s.utf8.count
+    }
+  }
+  CheckResults(length > 0,
+               "IncorrectResults in FloatingPointPrintingInterpolated")
+}
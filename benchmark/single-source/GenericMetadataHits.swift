@@ -0,0 +1,82 @@
+//===--- GenericMetadataHits.swift ----------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks look up generic metadata that is already in the runtime's
+// caches from 1, 4 and 16 threads at once.  Every thread does the same
+// amount of work, so as long as there are enough cores, lookups that hit
+// scale linearly exactly when all three take the same time.
+import TestsUtils
+
+protocol ArrayTypeMaker {
+  func arrayType() -> Any.Type
+}
+
+// The witness is generic over T, so each call asks the runtime for the
+// metadata of [T].
+struct GenericArrayTypeMaker<T> : ArrayTypeMaker {
+  func arrayType() -> Any.Type {
+    return [T].self
+  }
+}
+
+struct MetadataHitsElement {}
+class MetadataHitsClass {}
+
+let arrayTypeMakers: [ArrayTypeMaker] = [
+  GenericArrayTypeMaker<Int>(),
+  GenericArrayTypeMaker<Int8>(),
+  GenericArrayTypeMaker<UInt>(),
+  GenericArrayTypeMaker<Double>(),
+  GenericArrayTypeMaker<Float>(),
+  GenericArrayTypeMaker<Bool>(),
+  GenericArrayTypeMaker<String>(),
+  GenericArrayTypeMaker<MetadataHitsElement>(),
+  GenericArrayTypeMaker<MetadataHitsClass>(),
+  GenericArrayTypeMaker<[Int]>(),
+]
+
+@inline(never)
+func lookUpArrayTypes(_ makers: [ArrayTypeMaker], _ count: Int) -> Int {
+  var found = 0
+  for _ in 0..<count {
+    for maker in makers {
+      if ObjectIdentifier(maker.arrayType()) != ObjectIdentifier(Any.self) {
+        found += 1
+      }
+    }
+  }
+  return found
+}
+
+func runGenericMetadataHits(_ N: Int, threads: Int) {
+  let count = N * 10000
+  RunOnThreads(threads) { _ in
+    let found = lookUpArrayTypes(arrayTypeMakers, count)
+    CheckResults(found == count * arrayTypeMakers.count,
+                 "Incorrect results in GenericMetadataHits")
+  }
+}
+
+@inline(never)
+public func run_GenericMetadataHits1(_ N: Int) {
+  runGenericMetadataHits(N, threads: 1)
+}
+
+@inline(never)
+public func run_GenericMetadataHits4(_ N: Int) {
+  runGenericMetadataHits(N, threads: 4)
+}
+
+@inline(never)
+public func run_GenericMetadataHits16(_ N: Int) {
+  runGenericMetadataHits(N, threads: 16)
+}
@@ -0,0 +1,53 @@
+//===--- StrToFloat.swift -------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks check the throughput of String to Double and Float
+// conversion on the kind of numbers found in CSV and JSON columns.
+import TestsUtils
+
+let floatInputs = [
+  "-2373.92", "29.3715", "126809", "0.333779", "-362.824", "1.44198e5",
+  "-394973", "-16.3669", "-0.7236", "3769.65", "-4.00783e-3", "-118670",
+  "45.4728", "-38.915", "136285.0", "-4484.81", "-4.99684", "6829.8",
+  "3826.71", "105432", "-38385e-2", "39.422", "-2678.49", "-439886",
+  "0.00029269", "87017", "40469.2", "27692", "4.86408e10", "336.482",
+  "-67850", "5.6414", "-340902", "-3917.82", "414778", "-49.4338",
+  "-4130.17", "-377452", "-300.681", "170194", "4289.41", "-291665",
+  "89.331", "329496", "-36.4449", "2.72843e-7", "-10688", "142.542",
+  "-417439", "16733.7", "96.598", "-264104", "-186.029", "98480",
+  "-3167.27", "483808", "300.149", "-405877", "-98.938", "2836.85",
+  "-24.7856", "-46975", "346.060", "0.160085",
+]
+
+@inline(never)
+public func run_StrToDouble(_ N: Int) {
+  var total = 0.0
+  for _ in 1...100*N {
+    total = 0.0
+    for input in floatInputs {
+      total += Double(input)!
+    }
+  }
+  CheckResults(total != 0, "IncorrectResults in StrToDouble: \(total)")
+}
+
+@inline(never)
+public func run_StrToFloat(_ N: Int) {
+  var total: Float = 0.0
+  for _ in 1...100*N {
+    total = 0.0
+    for input in floatInputs {
+      total += Float(input)!
+    }
+  }
+  CheckResults(total != 0, "IncorrectResults in StrToFloat: \(total)")
+}
@@ -12,22 +12,24 @@
 
 // This test checks performance of String to Int conversion.
 // It is reported to be very slow: <rdar://problem/17255477>
+// The Int to String tests measure the conversion in the other direction.
 import TestsUtils
 
+// 64 numbers from -500_000 to 500_000 generated randomly
+let input = ["-237392", "293715", "126809", "333779", "-362824", "144198",
+             "-394973", "-163669", "-7236", "376965", "-400783", "-118670",
+             "454728", "-38915", "136285", "-448481", "-499684", "68298",
+             "382671", "105432", "-38385", "39422", "-267849", "-439886",
+             "292690", "87017", "404692", "27692", "486408", "336482",
+             "-67850", "56414", "-340902", "-391782", "414778", "-494338",
+             "-413017", "-377452", "-300681", "170194", "428941", "-291665",
+             "89331", "329496", "-364449", "272843", "-10688", "142542",
+             "-417439", "167337", "96598", "-264104", "-186029", "98480",
+             "-316727", "483808", "300149", "-405877", "-98938", "283685",
+             "-247856", "-46975", "346060", "160085",]
+
 @inline(never)
 public func run_StrToInt(_ N: Int) {
-  // 64 numbers from -500_000 to 500_000 generated randomly
-  let input = ["-237392", "293715", "126809", "333779", "-362824", "144198",
-               "-394973", "-163669", "-7236", "376965", "-400783", "-118670",
-               "454728", "-38915", "136285", "-448481", "-499684", "68298",
-               "382671", "105432", "-38385", "39422", "-267849", "-439886",
-               "292690", "87017", "404692", "27692", "486408", "336482",
-               "-67850", "56414", "-340902", "-391782", "414778", "-494338",
-               "-413017", "-377452", "-300681", "170194", "428941", "-291665",
-               "89331", "329496", "-364449", "272843", "-10688", "142542",
-               "-417439", "167337", "96598", "-264104", "-186029", "98480",
-               "-316727", "483808", "300149", "-405877", "-98938", "283685",
-               "-247856", "-46975", "346060", "160085",]
   let ref_result = 517492
   func DoOneIter(_ arr: [String]) -> Int {
     var r = 0
@@ -45,3 +47,34 @@ public func run_StrToInt(_ N: Int) {
   }
   CheckResults(res == ref_result, "IncorrectResults in StrToInt: \(res) != \(ref_result)")
 }
+
+@inline(never)
+func convertToStrings(_ arr: [Int], radix: Int) -> Int {
+  var r = 0
+  for n in arr {
+    r += String(n, radix: radix).utf8.count
+  }
+  return r
+}
+
+@inline(never)
+public func run_IntToStr(_ N: Int) {
+  let numbers = input.map { Int($0)! }
+  let ref_result = 399
+  var res = 0
+  for _ in 1...1000*N {
+    res = convertToStrings(numbers, radix: 10)
+  }
+  CheckResults(res == ref_result, "IncorrectResults in IntToStr: \(res) != \(ref_result)")
+}
+
+@inline(never)
+public func run_IntToHexStr(_ N: Int) {
+  let numbers = input.map { Int($0)! }
+  let ref_result = 343
+  var res = 0
+  for _ in 1...1000*N {
+    res = convertToStrings(numbers, radix: 16)
+  }
+  CheckResults(res == ref_result, "IncorrectResults in IntToHexStr: \(res) != \(ref_result)")
+}
@@ -40,3 +40,21 @@ public func run_StringInterpolation(_ N: Int) {
   }
 }
 
+
+@inline(never)
+public func run_StringInterpolationInts(_ N: Int) {
+  let reps = 100
+  let refResult = reps * 35
+  let aSmallInt = 42
+  let aNegativeInt = -1_000_000_007
+  let aLargeUInt: UInt64 = 0xFEDCBA9876543210
+
+  for _ in 1...100*N {
+    var result = 0
+    for _ in 1...reps {
+      let s = "\(aSmallInt) \(aNegativeInt) \(aLargeUInt)"
+      result = result &+ s.utf8.count
+    }
+    CheckResults(result == refResult, "IncorrectResults in StringInterpolationInts: \(result) != \(refResult)")
+  }
+}
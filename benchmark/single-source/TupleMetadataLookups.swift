@@ -0,0 +1,86 @@
+//===--- TupleMetadataLookups.swift ---------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks look up the metadata of 64 different tuple types from 1
+// and 32 threads at once.  The first run inserts them into the runtime's
+// tuple type cache concurrently; later runs measure lookups.  Every thread
+// does the same amount of work, so with enough cores both take the same
+// time when the cache scales.
+import TestsUtils
+
+protocol TupleTypeMaker {
+  func tupleType() -> Any.Type
+}
+
+// The witness is generic over T and U, so each call asks the runtime for
+// the metadata of (T, U).
+struct PairTypeMaker<T, U> : TupleTypeMaker {
+  func tupleType() -> Any.Type {
+    return (T, U).self
+  }
+}
+
+struct TupleLookupsElement {}
+class TupleLookupsClass {}
+
+func pairTypeMakers<T>(_: T.Type) -> [TupleTypeMaker] {
+  return [
+    PairTypeMaker<T, Int>(),
+    PairTypeMaker<T, Int8>(),
+    PairTypeMaker<T, Double>(),
+    PairTypeMaker<T, Bool>(),
+    PairTypeMaker<T, String>(),
+    PairTypeMaker<T, [Int]>(),
+    PairTypeMaker<T, TupleLookupsElement>(),
+    PairTypeMaker<T, TupleLookupsClass>(),
+  ]
+}
+
+let tupleTypeMakers: [TupleTypeMaker] =
+  pairTypeMakers(Int.self) + pairTypeMakers(Int8.self) +
+  pairTypeMakers(Double.self) + pairTypeMakers(Bool.self) +
+  pairTypeMakers(String.self) + pairTypeMakers([Int].self) +
+  pairTypeMakers(TupleLookupsElement.self) +
+  pairTypeMakers(TupleLookupsClass.self)
+
+@inline(never)
+func lookUpTupleTypes(_ makers: [TupleTypeMaker], _ count: Int,
+                      offset: Int) -> Int {
+  var found = 0
+  for i in 0..<count {
+    // Start each thread at a different type, so that they don't all ask for
+    // the same one at once.
+    let maker = makers[(i + offset) % makers.count]
+    if ObjectIdentifier(maker.tupleType()) != ObjectIdentifier(Any.self) {
+      found += 1
+    }
+  }
+  return found
+}
+
+func runTupleMetadataLookups(_ N: Int, threads: Int) {
+  let count = N * 100000
+  RunOnThreads(threads) { thread in
+    let found = lookUpTupleTypes(tupleTypeMakers, count, offset: thread * 7)
+    CheckResults(found == count, "Incorrect results in TupleMetadataLookups")
+  }
+}
+
+@inline(never)
+public func run_TupleMetadataLookups1(_ N: Int) {
+  runTupleMetadataLookups(N, threads: 1)
+}
+
+@inline(never)
+public func run_TupleMetadataLookups32(_ N: Int) {
+  runTupleMetadataLookups(N, threads: 32)
+}
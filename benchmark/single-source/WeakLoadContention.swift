@@ -0,0 +1,60 @@
+//===--- WeakLoadContention.swift -----------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// These benchmarks load the same weak reference from 1 and 8 threads at
+// once, as with a delegate shared between threads.  Every thread does the
+// same amount of work, so the loads don't contend when both take the same
+// time.
+import TestsUtils
+
+final class WeakLoadTarget {
+  var value = 1
+}
+
+final class WeakLoadHolder {
+  weak var target: WeakLoadTarget?
+}
+
+@inline(never)
+func loadWeakTarget(_ holder: WeakLoadHolder, _ count: Int) -> Int {
+  var sum = 0
+  for _ in 0..<count {
+    if let target = holder.target {
+      sum += target.value
+    }
+  }
+  return sum
+}
+
+func runWeakLoadContention(_ N: Int, threads: Int) {
+  let target = WeakLoadTarget()
+  let holder = WeakLoadHolder()
+  holder.target = target
+  let count = N * 100000
+  RunOnThreads(threads) { _ in
+    let sum = loadWeakTarget(holder, count)
+    CheckResults(sum == count, "Incorrect results in WeakLoadContention")
+  }
+  // Keep the target alive until every thread is done loading it.
+  CheckResults(holder.target === target,
+               "Incorrect results in WeakLoadContention")
+}
+
+@inline(never)
+public func run_WeakLoadContention1(_ N: Int) {
+  runWeakLoadContention(N, threads: 1)
+}
+
+@inline(never)
+public func run_WeakLoadContention8(_ N: Int) {
+  runWeakLoadContention(N, threads: 8)
+}
@@ -55,6 +55,34 @@ public func CheckResults(_ res: Bool, _ message: String = "") {
 
 public func False() -> Bool { return false }
 
+final class ThreadBody {
+  let body: () -> ()
+  init(_ body: @escaping () -> ()) { self.body = body }
+}
+
+func runThreadBody(_ context: UnsafeMutableRawPointer?)
+  -> UnsafeMutableRawPointer! {
+  // The body is passed in +1; we're responsible for releasing it.
+  Unmanaged<ThreadBody>.fromOpaque(context!).takeRetainedValue().body()
+  return nil
+}
+
+/// Run body on the given number of threads at once, passing each thread its
+/// index, and wait for all of them to finish.
+public func RunOnThreads(_ threadCount: Int, _ body: @escaping (Int) -> ()) {
+  var threads: [pthread_t] = []
+  for i in 0..<threadCount {
+    let context = Unmanaged.passRetained(ThreadBody({ body(i) })).toOpaque()
+    var thread: pthread_t? = nil
+    let result = pthread_create(&thread, nil, { runThreadBody($0) }, context)
+    CheckResults(result == 0, "Could not create a thread")
+    threads.append(thread!)
+  }
+  for thread in threads {
+    pthread_join(thread, nil)
+  }
+}
+
 /// This is a dummy protocol to test the speed of our protocol dispatch.
 public protocol SomeProtocol { func getValue() -> Int }
 struct MyStruct : SomeProtocol {
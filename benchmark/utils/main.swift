@@ -38,6 +38,7 @@ import Calculator
 import CaptureProp
 import Chars
 import ClassArrayGetter
+import ConformanceHits
 import DeadArray
 import DictTest
 import DictTest2
@@ -46,8 +47,11 @@ import DictionaryBridge
 import DictionaryLiteral
 import DictionaryRemove
 import DictionarySwap
+import DynamicCast
 import ErrorHandling
 import Fibonacci
+import FloatingPointPrinting
+import GenericMetadataHits
 import GlobalClass
 import Hanoi
 import Hash
@@ -88,16 +92,19 @@ import SortStrings
 import StackPromo
 import StaticArray
 import StrComplexWalk
+import StrToFloat
 import StrToInt
 import StringBuilder
 import StringInterpolation
 import StringTests
 import StringWalk
 import SuperChars
+import TupleMetadataLookups
 import TwoSum
 import TypeFlood
 import UTF8Decode
 import Walsh
+import WeakLoadContention
 import XorLoop
 
 precommitTests = [
@@ -123,6 +130,9 @@ precommitTests = [
   "CaptureProp": run_CaptureProp,
   "Chars": run_Chars,
   "ClassArrayGetter": run_ClassArrayGetter,
+  "ConformanceHits1": run_ConformanceHits1,
+  "ConformanceHits16": run_ConformanceHits16,
+  "ConformanceHits4": run_ConformanceHits4,
   "DeadArray": run_DeadArray,
   "Dictionary": run_Dictionary,
   "DictionaryOfObjects": run_DictionaryOfObjects,
@@ -136,11 +146,23 @@ precommitTests = [
   "DictionaryRemoveOfObjects": run_DictionaryRemoveOfObjects,
   "DictionarySwap": run_DictionarySwap,
   "DictionarySwapOfObjects": run_DictionarySwapOfObjects,
+  "DynamicCastArray": run_DynamicCastArray,
+  "DynamicCastClass": run_DynamicCastClass,
+  "DynamicCastOptional": run_DynamicCastOptional,
+  "DynamicCastProtocol": run_DynamicCastProtocol,
   "ErrorHandling": run_ErrorHandling,
+  "FloatingPointPrintingDouble": run_FloatingPointPrintingDouble,
+  "FloatingPointPrintingFloat": run_FloatingPointPrintingFloat,
+  "FloatingPointPrintingInterpolated": run_FloatingPointPrintingInterpolated,
+  "GenericMetadataHits1": run_GenericMetadataHits1,
+  "GenericMetadataHits16": run_GenericMetadataHits16,
+  "GenericMetadataHits4": run_GenericMetadataHits4,
   "GlobalClass": run_GlobalClass,
   "Hanoi": run_Hanoi,
   "HashTest": run_HashTest,
   "Histogram": run_Histogram,
+  "IntToHexStr": run_IntToHexStr,
+  "IntToStr": run_IntToStr,
   "Integrate": run_Integrate,
   "IterateData": run_IterateData,
   "Join": run_Join,
@@ -220,10 +242,13 @@ precommitTests = [
   "StackPromo": run_StackPromo,
   "StaticArray": run_StaticArray,
   "StrComplexWalk": run_StrComplexWalk,
+  "StrToDouble": run_StrToDouble,
+  "StrToFloat": run_StrToFloat,
   "StrToInt": run_StrToInt,
   "StringBuilder": run_StringBuilder,
   "StringEqualPointerComparison": run_StringEqualPointerComparison,
   "StringInterpolation": run_StringInterpolation,
+  "StringInterpolationInts": run_StringInterpolationInts,
   "StringHasPrefix": run_StringHasPrefix,
   "StringHasPrefixUnicode": run_StringHasPrefixUnicode,
   "StringHasSuffix": run_StringHasSuffix,
@@ -231,10 +256,14 @@ precommitTests = [
   "StringWalk": run_StringWalk,
   "StringWithCString": run_StringWithCString,
   "SuperChars": run_SuperChars,
+  "TupleMetadataLookups1": run_TupleMetadataLookups1,
+  "TupleMetadataLookups32": run_TupleMetadataLookups32,
   "TwoSum": run_TwoSum,
   "TypeFlood": run_TypeFlood,
   "UTF8Decode": run_UTF8Decode,
   "Walsh": run_Walsh,
+  "WeakLoadContention1": run_WeakLoadContention1,
+  "WeakLoadContention8": run_WeakLoadContention8,
   "XorLoop": run_XorLoop,
 ]
 
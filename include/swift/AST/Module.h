@@ -809,6 +809,13 @@ private:
   /// this source file so far.
   llvm::MD5 InterfaceHash;
 
+  /// A hash of the interface-contributing tokens of the top-level declaration
+  /// being parsed, if any.
+  Optional<llvm::MD5> DeclInterfaceHash;
+
+  /// The interface hash of each top-level declaration parsed so far.
+  llvm::DenseMap<const Decl *, std::string> DeclInterfaceHashes;
+
   /// \brief The ID for the memory buffer containing this file's source.
   ///
   /// May be -1, to indicate no association with a buffer.
@@ -1036,6 +1043,41 @@ public:
     // Add null byte to separate tokens.
     uint8_t a[1] = {0};
     InterfaceHash.update(a);
+
+    if (DeclInterfaceHash) {
+      DeclInterfaceHash->update(token);
+      DeclInterfaceHash->update(a);
+    }
+  }
+
+  /// Starts hashing the interface tokens of a top-level declaration on their
+  /// own, as well as as part of the whole file's interface hash.
+  void beginDeclInterfaceHash() {
+    assert(!DeclInterfaceHash && "top-level declarations don't nest");
+    DeclInterfaceHash.emplace();
+  }
+
+  /// Finishes hashing a top-level declaration's interface tokens, recording
+  /// the result for each of \p decls, which were parsed from them.
+  void endDeclInterfaceHash(ArrayRef<Decl *> decls) {
+    assert(DeclInterfaceHash && "not hashing a declaration");
+    llvm::MD5::MD5Result result;
+    DeclInterfaceHash->final(result);
+    DeclInterfaceHash.reset();
+
+    llvm::SmallString<32> str;
+    llvm::MD5::stringifyResult(result, str);
+    for (const Decl *D : decls)
+      DeclInterfaceHashes[D] = str.str();
+  }
+
+  /// Returns the hash of the interface tokens of the top-level declaration
+  /// \p D, or an empty string if it wasn't parsed from this file.
+  StringRef getDeclInterfaceHash(const Decl *D) const {
+    auto iter = DeclInterfaceHashes.find(D);
+    if (iter == DeclInterfaceHashes.end())
+      return StringRef();
+    return iter->second;
   }
 
   const llvm::MD5 &getInterfaceHashState() { return InterfaceHash; }
@@ -13,11 +13,12 @@
 #ifndef SWIFT_BASIC_DEMANGLE_H
 #define SWIFT_BASIC_DEMANGLE_H
 
-#include <memory>
 #include <string>
-#include <vector>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include "llvm/ADT/StringRef.h"
 #include "swift/Basic/Malloc.h"
 
@@ -69,7 +70,8 @@ struct DemangleOptions {
 };
 
 class Node;
-typedef std::shared_ptr<Node> NodePointer;
+typedef Node *NodePointer;
+class NodeFactory;
 
 enum class FunctionSigSpecializationParamKind : unsigned {
   // Option Flags use bits 0-5. This give us 6 bits implying 64 entries to
@@ -135,7 +137,11 @@ enum class Directness {
   Direct, Indirect
 };
 
-class Node : public std::enable_shared_from_this<Node> {
+/// A node in a demangling tree.
+///
+/// Nodes are allocated by a NodeFactory and live exactly as long as it does;
+/// they are never freed individually.
+class Node {
 public:
   enum class Kind : uint16_t {
 #define NODE(ID) ID,
@@ -145,6 +151,9 @@ public:
   typedef uint64_t IndexType;
 
 private:
+  /// The number of children that fit in the node itself.
+  static const unsigned NumInlineChildren = 2;
+
   Kind NodeKind;
 
   enum class PayloadKind : uint8_t {
@@ -152,40 +161,50 @@ private:
   };
   PayloadKind NodePayloadKind;
 
+  uint32_t NumChildren = 0;
+  uint32_t ReservedChildren = NumInlineChildren;
+
   union {
-    std::string TextPayload;
+    struct {
+      const char *Data;
+      size_t Length;
+    } TextPayload;
     IndexType IndexPayload;
   };
 
-  // FIXME: use allocator.
-  typedef std::vector<NodePointer> NodeVector;
-  NodeVector Children;
+  /// The children of this node.  This points to InlineChildren until there
+  /// are more children than fit there, and after that to an array allocated
+  /// by the factory.
+  NodePointer *Children;
+  NodePointer InlineChildren[NumInlineChildren];
 
   Node(Kind k)
-      : NodeKind(k), NodePayloadKind(PayloadKind::None) {
+      : NodeKind(k), NodePayloadKind(PayloadKind::None),
+        Children(InlineChildren) {
   }
-  Node(Kind k, std::string &&t)
-      : NodeKind(k), NodePayloadKind(PayloadKind::Text) {
-    new (&TextPayload) std::string(std::move(t));
+  Node(Kind k, llvm::StringRef t)
+      : NodeKind(k), NodePayloadKind(PayloadKind::Text),
+        Children(InlineChildren) {
+    TextPayload.Data = t.data();
+    TextPayload.Length = t.size();
   }
   Node(Kind k, IndexType index)
-      : NodeKind(k), NodePayloadKind(PayloadKind::Index) {
+      : NodeKind(k), NodePayloadKind(PayloadKind::Index),
+        Children(InlineChildren) {
     IndexPayload = index;
   }
   Node(const Node &) = delete;
   Node &operator=(const Node &) = delete;
 
-  friend struct NodeFactory;
+  friend class NodeFactory;
 
 public:
-  ~Node();
-
   Kind getKind() const { return NodeKind; }
 
   bool hasText() const { return NodePayloadKind == PayloadKind::Text; }
-  const std::string &getText() const {
+  llvm::StringRef getText() const {
     assert(hasText());
-    return TextPayload;
+    return llvm::StringRef(TextPayload.Data, TextPayload.Length);
   }
 
   bool hasIndex() const { return NodePayloadKind == PayloadKind::Index; }
@@ -194,46 +213,142 @@ public:
     return IndexPayload;
   }
   
-  typedef NodeVector::iterator iterator;
-  typedef NodeVector::const_iterator const_iterator;
-  typedef NodeVector::size_type size_type;
-
-  bool hasChildren() const { return !Children.empty(); }
-  size_t getNumChildren() const { return Children.size(); }
-  iterator begin() { return Children.begin(); }
-  iterator end() { return Children.end(); }
-  const_iterator begin() const { return Children.begin(); }
-  const_iterator end() const { return Children.end(); }
-
-  NodePointer getFirstChild() const { return Children.front(); }
-  NodePointer getChild(size_t index) const { return Children[index]; }
+  typedef NodePointer *iterator;
+  typedef const NodePointer *const_iterator;
+  typedef size_t size_type;
+
+  bool hasChildren() const { return NumChildren != 0; }
+  size_t getNumChildren() const { return NumChildren; }
+  iterator begin() { return Children; }
+  iterator end() { return Children + NumChildren; }
+  const_iterator begin() const { return Children; }
+  const_iterator end() const { return Children + NumChildren; }
+
+  NodePointer getFirstChild() const {
+    assert(NumChildren != 0);
+    return Children[0];
+  }
+  NodePointer getChild(size_t index) const {
+    assert(index < NumChildren);
+    return Children[index];
+  }
 
   /// Add a new node as a child of this one.
   ///
   /// \param child - should have no parent or siblings
+  /// \param factory - the factory that created this node; it allocates the
+  /// child array if the node outgrows its inline storage
   /// \returns child
-  NodePointer addChild(NodePointer child) {
-    assert(child && "adding null child!");
-    Children.push_back(child);
-    return child;
-  }
+  inline NodePointer addChild(NodePointer child, NodeFactory &factory);
 
   /// A convenience method for adding two children at once.
-  void addChildren(NodePointer child1, NodePointer child2) {
-    addChild(std::move(child1));
-    addChild(std::move(child2));
+  void addChildren(NodePointer child1, NodePointer child2,
+                   NodeFactory &factory) {
+    addChild(child1, factory);
+    addChild(child2, factory);
+  }
+};
+
+/// Allocates the nodes of demangling trees, along with their child arrays
+/// and text, from a bump-pointer arena.
+///
+/// Everything a factory allocates is freed at once when the factory is
+/// destroyed or cleared, so it must outlive every tree built from it.  A
+/// factory that is cleared and reused for a series of demanglings stops
+/// allocating memory once its slab is large enough.
+class NodeFactory {
+  /// The header of each slab of memory.  Slabs form a list from the most
+  /// recently allocated one.
+  struct Slab {
+    Slab *Previous;
+    size_t Size;
+  };
+
+  /// The smallest slab the factory allocates.
+  static const size_t MinSlabSize = 4096;
+
+  Slab *CurrentSlab = nullptr;
+  char *CurPtr = nullptr;
+  char *End = nullptr;
+
+  void *allocateInNewSlab(size_t size, size_t alignment);
+
+public:
+  NodeFactory() = default;
+  NodeFactory(const NodeFactory &) = delete;
+  NodeFactory &operator=(const NodeFactory &) = delete;
+  ~NodeFactory();
+
+  /// Free every node allocated so far, keeping the most recent slab to
+  /// allocate new nodes from.
+  void clear();
+
+  /// Return the number of slabs the factory currently holds.
+  size_t getNumSlabs() const;
+
+  /// Allocate uninitialized memory that lives as long as the factory.
+  void *allocate(size_t size, size_t alignment) {
+    uintptr_t start =
+      (reinterpret_cast<uintptr_t>(CurPtr) + alignment - 1) & ~(alignment - 1);
+    if (!CurPtr || start + size > reinterpret_cast<uintptr_t>(End))
+      return allocateInNewSlab(size, alignment);
+    CurPtr = reinterpret_cast<char *>(start + size);
+    return reinterpret_cast<void *>(start);
+  }
+
+  template <typename T>
+  T *allocate(size_t count = 1) {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  /// Copy a string into memory owned by the factory.
+  llvm::StringRef copyString(llvm::StringRef text) {
+    if (text.empty())
+      return llvm::StringRef();
+    char *copy = allocate<char>(text.size());
+    memcpy(copy, text.data(), text.size());
+    return llvm::StringRef(copy, text.size());
+  }
+
+  NodePointer createNode(Node::Kind K) {
+    return new (allocate<Node>()) Node(K);
+  }
+  NodePointer createNode(Node::Kind K, Node::IndexType Index) {
+    return new (allocate<Node>()) Node(K, Index);
+  }
+  /// Create a node with the given text, which is copied into the factory.
+  NodePointer createNode(Node::Kind K, llvm::StringRef Text) {
+    return new (allocate<Node>()) Node(K, copyString(Text));
+  }
+  NodePointer createNode(Node::Kind K, const char *Text) {
+    return createNode(K, llvm::StringRef(Text));
   }
 };
 
+NodePointer Node::addChild(NodePointer child, NodeFactory &factory) {
+  assert(child && "adding null child!");
+  if (NumChildren == ReservedChildren) {
+    ReservedChildren *= 2;
+    auto newChildren = factory.allocate<NodePointer>(ReservedChildren);
+    for (uint32_t i = 0; i != NumChildren; ++i)
+      newChildren[i] = Children[i];
+    Children = newChildren;
+  }
+  Children[NumChildren++] = child;
+  return child;
+}
+
 /// \brief Demangle the given string as a Swift symbol.
 ///
 /// Typical usage:
 /// \code
+///   NodeFactory Factory;
 ///   NodePointer aDemangledName =
-/// swift::Demangler::demangleSymbolAsNode("SomeSwiftMangledName")
+/// swift::Demangler::demangleSymbolAsNode("SomeSwiftMangledName", Factory)
 /// \endcode
 ///
 /// \param mangledName The mangled string.
+/// \param factory The factory that allocates the nodes of the tree.
 /// \param options An object encapsulating options to use to perform this demangling.
 ///
 ///
@@ -242,12 +357,14 @@ public:
 ///
 NodePointer
 demangleSymbolAsNode(const char *mangledName, size_t mangledNameLength,
+                     NodeFactory &factory,
                      const DemangleOptions &options = DemangleOptions());
 
 inline NodePointer
-demangleSymbolAsNode(const std::string &mangledName,
+demangleSymbolAsNode(llvm::StringRef mangledName, NodeFactory &factory,
                      const DemangleOptions &options = DemangleOptions()) {
-  return demangleSymbolAsNode(mangledName.data(), mangledName.size(), options);
+  return demangleSymbolAsNode(mangledName.data(), mangledName.size(), factory,
+                              options);
 }
 
 /// \brief Demangle the given string as a Swift symbol.
@@ -279,11 +396,13 @@ demangleSymbolAsString(const std::string &mangledName,
 ///
 /// Typical usage:
 /// \code
+///   NodeFactory Factory;
 ///   NodePointer aDemangledName =
-/// swift::Demangler::demangleTypeAsNode("SomeSwiftMangledName")
+/// swift::Demangler::demangleTypeAsNode("SomeSwiftMangledName", Factory)
 /// \endcode
 ///
 /// \param mangledName The mangled string.
+/// \param factory The factory that allocates the nodes of the tree.
 /// \param options An object encapsulating options to use to perform this demangling.
 ///
 ///
@@ -292,12 +411,14 @@ demangleSymbolAsString(const std::string &mangledName,
 ///
 NodePointer
 demangleTypeAsNode(const char *mangledName, size_t mangledNameLength,
+                   NodeFactory &factory,
                    const DemangleOptions &options = DemangleOptions());
 
 inline NodePointer
-demangleTypeAsNode(const std::string &mangledName,
+demangleTypeAsNode(llvm::StringRef mangledName, NodeFactory &factory,
                    const DemangleOptions &options = DemangleOptions()) {
-  return demangleTypeAsNode(mangledName.data(), mangledName.size(), options);
+  return demangleTypeAsNode(mangledName.data(), mangledName.size(), factory,
+                            options);
 }
 
 /// \brief Demangle the given string as a Swift type mangling.
@@ -332,7 +453,7 @@ void mangleIdentifier(const char *data, size_t length,
 /// \brief Remangle a demangled parse tree.
 ///
 /// This should always round-trip perfectly with demangleSymbolAsNode.
-std::string mangleNode(const NodePointer &root);
+std::string mangleNode(NodePointer root);
 
 /// \brief Transform the node structure to a string.
 ///
@@ -350,25 +471,6 @@ std::string mangleNode(const NodePointer &root);
 std::string nodeToString(NodePointer Root,
                          const DemangleOptions &Options = DemangleOptions());
 
-struct NodeFactory {
-  static NodePointer create(Node::Kind K) {
-    return NodePointer(new Node(K));
-  }
-  static NodePointer create(Node::Kind K, Node::IndexType Index) {
-    return NodePointer(new Node(K, Index));
-  }
-  static NodePointer create(Node::Kind K, llvm::StringRef Text) {
-    return NodePointer(new Node(K, Text));
-  }
-  static NodePointer create(Node::Kind K, std::string &&Text) {
-    return NodePointer(new Node(K, std::move(Text)));
-  }
-  template <size_t N>
-  static NodePointer create(Node::Kind K, const char (&Text)[N]) {
-    return NodePointer(new Node(K, llvm::StringRef(Text)));
-  }
-};
-
   /// A class for printing to a std::string.
 class DemanglerPrinter {
 public:
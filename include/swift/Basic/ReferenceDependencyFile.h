@@ -0,0 +1,226 @@
+//===--- ReferenceDependencyFile.h - Read and write .swiftdeps --*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file Declares the two formats of a Swift reference dependencies
+/// (".swiftdeps") file: the YAML format, which is easy to read and to write
+/// by hand, and a compact binary format, which the driver can use in place
+/// without parsing it.
+///
+/// A binary file consists of a header, the offsets of the distinct strings
+/// in the file, a table of entries that refer to strings by index, an
+/// optional table of entry fingerprints, and the string data itself. All
+/// integers are little-endian.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_BASIC_REFERENCEDEPENDENCYFILE_H
+#define SWIFT_BASIC_REFERENCEDEPENDENCYFILE_H
+
+#include "swift/Basic/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include <vector>
+
+namespace swift {
+
+/// The sections of a reference dependencies file, in the order in which they
+/// appear in the YAML format.
+enum class ReferenceDependencySection : uint8_t {
+  ProvidesTopLevel,
+  ProvidesNominal,
+  ProvidesMember,
+  ProvidesDynamicLookup,
+  DependsTopLevel,
+  DependsMember,
+  DependsNominal,
+  DependsDynamicLookup,
+  DependsExternal,
+};
+
+enum : unsigned { NumReferenceDependencySections = 9 };
+
+/// Returns the YAML key for \p section, such as "provides-top-level".
+StringRef getReferenceDependencySectionName(ReferenceDependencySection section);
+
+/// Returns true if the entries of \p section are (type, member) pairs.
+inline bool isMemberSection(ReferenceDependencySection section) {
+  return section == ReferenceDependencySection::ProvidesMember ||
+         section == ReferenceDependencySection::DependsMember;
+}
+
+/// One name in a reference dependencies file.
+///
+/// The name of an entry in a member section is the mangled name of the type
+/// and the name of the member, separated by a NUL character.
+///
+/// A provided name may have a fingerprint, which changes whenever the
+/// interface of one of the declarations providing it changes. Names without
+/// fingerprints are assumed to change whenever the file's interface hash does.
+struct ReferenceDependencyEntry {
+  ReferenceDependencySection Section;
+  bool IsCascading;
+  StringRef Name;
+  StringRef Fingerprint;
+};
+
+namespace binary_swiftdeps {
+  using llvm::support::ulittle16_t;
+  using llvm::support::ulittle32_t;
+
+  /// The first bytes of every binary file. YAML files are text, so they can
+  /// never start with a NUL.
+  const char Magic[4] = { '\0', 'S', 'W', 'D' };
+
+  /// Bumped on any change that an older reader can't handle.
+  const uint16_t MajorVersion = 2;
+
+  /// Bumped on changes that older readers can safely ignore.
+  const uint16_t MinorVersion = 0;
+
+  /// The string index used for a missing interface hash or fingerprint.
+  const uint32_t NoString = ~0U;
+
+  struct Header {
+    char Magic[4];
+    ulittle16_t MajorVersion;
+    ulittle16_t MinorVersion;
+    /// A bit for each ReferenceDependencySection that was written, even if
+    /// it has no entries.
+    ulittle32_t Sections;
+    ulittle32_t NumStrings;
+    ulittle32_t NumEntries;
+    ulittle32_t StringDataSize;
+    ulittle32_t InterfaceHash;
+    /// Either 0 or NumEntries.
+    ulittle32_t NumFingerprints;
+  };
+
+  /// The header is followed by NumStrings + 1 string offsets into the string
+  /// data. String i runs from offset i up to offset i + 1.
+  using StringOffset = ulittle32_t;
+
+  /// Then by NumEntries entries, each of which packs the index of its name,
+  /// whether it is private, and its section into 32 bits.
+  using EntryRecord = ulittle32_t;
+
+  enum : uint32_t {
+    EntryNameMask = (1U << 27) - 1,
+    EntryIsPrivateBit = 1U << 27,
+    EntrySectionShift = 28,
+  };
+
+  /// Then, if any entry has a fingerprint, by the string index of each
+  /// entry's fingerprint, or NoString.
+  using FingerprintRecord = ulittle32_t;
+} // end namespace binary_swiftdeps
+
+/// Collects the contents of a reference dependencies file and writes them
+/// in either format.
+///
+/// Within each section, entries keep the order in which they were added.
+class ReferenceDependencyFileWriter {
+  /// The distinct strings of the file, mapped to their indices.
+  llvm::StringMap<uint32_t> StringIndices;
+  std::vector<StringRef> Strings;
+
+  std::vector<std::pair<ReferenceDependencySection, uint32_t>> Entries;
+  std::vector<bool> EntryIsCascading;
+  std::vector<uint32_t> EntryFingerprints;
+  bool HasFingerprints = false;
+
+  unsigned Sections = 0;
+  uint32_t InterfaceHash = binary_swiftdeps::NoString;
+
+  uint32_t intern(StringRef string);
+  void addFingerprint(StringRef fingerprint);
+
+public:
+  /// Records that \p section is present, even if no entries are added to it.
+  void addSection(ReferenceDependencySection section) {
+    Sections |= 1U << unsigned(section);
+  }
+
+  void addEntry(ReferenceDependencySection section, StringRef name,
+                bool isCascading = true, StringRef fingerprint = StringRef());
+
+  void addMemberEntry(ReferenceDependencySection section, StringRef typeName,
+                      StringRef memberName, bool isCascading = true,
+                      StringRef fingerprint = StringRef());
+
+  void setInterfaceHash(StringRef hash) {
+    InterfaceHash = intern(hash);
+  }
+
+  void writeYAML(raw_ostream &out) const;
+  void writeBinary(raw_ostream &out) const;
+};
+
+/// A view of a binary reference dependencies file.
+///
+/// Nothing is copied out of the buffer, so it must outlive the reader.
+class BinaryReferenceDependencyFile {
+  const binary_swiftdeps::Header *Header = nullptr;
+  const binary_swiftdeps::StringOffset *StringOffsets = nullptr;
+  const binary_swiftdeps::EntryRecord *EntryRecords = nullptr;
+  const binary_swiftdeps::FingerprintRecord *FingerprintRecords = nullptr;
+  const char *StringData = nullptr;
+
+  StringRef getString(uint32_t index) const {
+    uint32_t start = StringOffsets[index];
+    return StringRef(StringData + start, StringOffsets[index + 1] - start);
+  }
+
+public:
+  /// Returns true if \p data starts like a binary file.
+  static bool isBinary(StringRef data);
+
+  /// Sets up the reader for \p data, checking that every table entry is in
+  /// bounds.
+  ///
+  /// \returns false if \p data is not a well-formed binary file of a
+  /// supported version.
+  bool init(StringRef data);
+
+  bool hasSection(ReferenceDependencySection section) const {
+    return Header->Sections & (1U << unsigned(section));
+  }
+
+  unsigned getNumEntries() const {
+    return Header->NumEntries;
+  }
+
+  ReferenceDependencyEntry getEntry(unsigned index) const {
+    using namespace binary_swiftdeps;
+    uint32_t record = EntryRecords[index];
+    StringRef fingerprint;
+    if (FingerprintRecords && FingerprintRecords[index] != NoString)
+      fingerprint = getString(FingerprintRecords[index]);
+    return { ReferenceDependencySection(record >> EntrySectionShift),
+             !(record & EntryIsPrivateBit),
+             getString(record & EntryNameMask),
+             fingerprint };
+  }
+
+  bool hasInterfaceHash() const {
+    return Header->InterfaceHash != binary_swiftdeps::NoString;
+  }
+
+  StringRef getInterfaceHash() const {
+    assert(hasInterfaceHash());
+    return getString(Header->InterfaceHash);
+  }
+};
+
+} // end namespace swift
+
+#endif // SWIFT_BASIC_REFERENCEDEPENDENCYFILE_H
@@ -38,6 +38,17 @@ enum class TaskFinishedResponse {
   StopExecution,
 };
 
+/// \brief Resources used by a task which finished execution.
+struct TaskResourceUsage {
+  /// The wall-clock time from starting the task to collecting its exit
+  /// status, in milliseconds.
+  uint64_t WallTimeMilliseconds = 0;
+
+  /// The task's peak resident set size in kilobytes, or 0 if this isn't
+  /// available on the current system.
+  uint64_t PeakRSSKilobytes = 0;
+};
+
 /// \brief A class encapsulating the execution of multiple tasks in parallel.
 class TaskQueue {
   /// Tasks which have not begun execution.
@@ -73,11 +84,13 @@ public:
   /// \param Output the output from the task which finished execution,
   /// if available. (This may not be available on all platforms.)
   /// \param Context the context which was passed when the task was added
+  /// \param Usage the resources used by the task which finished execution
   ///
   /// \returns true if further execution of tasks should stop,
   /// false if execution should continue
   typedef std::function<TaskFinishedResponse(ProcessId Pid, int ReturnCode,
-                                             StringRef Output, void *Context)>
+                                             StringRef Output, void *Context,
+                                             const TaskResourceUsage &Usage)>
     TaskFinishedCallback;
 
   /// \brief A callback which will be executed if a task exited abnormally due
@@ -14,6 +14,7 @@
 #define SWIFT_DRIVER_ACTION_H
 
 #include "swift/Basic/LLVM.h"
+#include "swift/Driver/ContentHash.h"
 #include "swift/Driver/Types.h"
 #include "swift/Driver/Util.h"
 #include "llvm/ADT/ArrayRef.h"
@@ -137,6 +138,11 @@ public:
     Status status = UpToDate;
     llvm::sys::TimeValue previousModTime;
 
+    /// The hash of the input's contents in the previous build, if
+    /// hasPreviousHash is set.
+    ContentHash previousHash = {};
+    bool hasPreviousHash = false;
+
     InputInfo() = default;
     InputInfo(Status stat, llvm::sys::TimeValue time)
         : status(stat), previousModTime(time) {}
@@ -17,11 +17,15 @@
 #ifndef SWIFT_DRIVER_COMPILATION_H
 #define SWIFT_DRIVER_COMPILATION_H
 
+#include "swift/Driver/ContentHash.h"
 #include "swift/Driver/Job.h"
 #include "swift/Driver/Util.h"
 #include "swift/Basic/ArrayRefView.h"
 #include "swift/Basic/LLVM.h"
+#include "swift/Basic/TaskQueue.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/TimeValue.h"
 
@@ -40,6 +44,7 @@ namespace swift {
 
 namespace driver {
   class Driver;
+  class OutputInfo;
   class ToolChain;
 
 /// An enum providing different levels of output which should be produced
@@ -55,6 +60,15 @@ enum class OutputLevel {
   Parseable,
 };
 
+/// The hash of an input's contents, and the modification time the input had
+/// before it was read to compute the hash.  The build record pairs the two,
+/// so the time must not be read again after hashing: a file modified in
+/// between would be recorded with the new time and the old hash.
+struct InputHash {
+  ContentHash Hash;
+  llvm::sys::TimeValue ModTime;
+};
+
 class Compilation {
 private:
   /// The DiagnosticEngine to which this Compilation should emit diagnostics.
@@ -106,6 +120,17 @@ private:
   /// If unknown, this will be some time in the past.
   llvm::sys::TimeValue LastBuildTime = llvm::sys::TimeValue::MinTime();
 
+  /// When true, the contents of inputs and external dependencies are hashed
+  /// and recorded, so that files which were touched without being modified
+  /// don't cause anything to be rebuilt.
+  bool EnableFileHashing = false;
+
+  /// The hash of each input's contents at the start of the build.
+  llvm::DenseMap<const llvm::opt::Arg *, InputHash> InputHashes;
+
+  /// The hash of each external dependency's contents in the previous build.
+  llvm::StringMap<ContentHash> PreviousExternalDependencyHashes;
+
   /// The number of commands which this compilation should attempt to run in
   /// parallel.
   unsigned NumberOfParallelCommands;
@@ -136,6 +161,26 @@ private:
   /// rebuilt.
   bool ShowIncrementalBuildDecisions = false;
 
+  /// When true, dumps the order in which jobs are started, how long they were
+  /// expected to take, and the resources they actually used.
+  bool ShowJobSchedule = false;
+
+  /// The resources used by each job in the previous build, keyed by the
+  /// job's entry in the build record.
+  ///
+  /// This is used to start the jobs on the longest chains first.
+  llvm::StringMap<sys::TaskResourceUsage> PreviousJobUsage;
+
+  /// When non-null, compile jobs that are ready to run at the same time are
+  /// combined into batches, each of which is run by one frontend invocation.
+  const ToolChain *BatchModeToolChain = nullptr;
+
+  /// The OutputInfo used to construct batch jobs.
+  std::unique_ptr<OutputInfo> BatchModeOutputInfo;
+
+  /// The number of batches the ready compile jobs are split into.
+  unsigned BatchCount = 1;
+
   static const Job *unwrap(const std::unique_ptr<const Job> &p) {
     return p.get();
   }
@@ -194,6 +239,14 @@ public:
     ShowIncrementalBuildDecisions = value;
   }
 
+  void setShowsJobSchedule(bool value = true) {
+    ShowJobSchedule = value;
+  }
+
+  void setPreviousJobUsage(llvm::StringMap<sys::TaskResourceUsage> usage) {
+    PreviousJobUsage = std::move(usage);
+  }
+
   void setCompilationRecordPath(StringRef path) {
     assert(CompilationRecordPath.empty() && "already set");
     CompilationRecordPath = path;
@@ -203,6 +256,43 @@ public:
     LastBuildTime = time;
   }
 
+  /// Requests that inputs and external dependencies whose modification times
+  /// changed since the last build only be treated as modified if their
+  /// contents changed too.
+  ///
+  /// \param inputHashes the hashes of the inputs' current contents
+  /// \param previousExternalDependencyHashes the hashes of the external
+  /// dependencies' contents in the last build
+  void enableFileHashing(
+      llvm::DenseMap<const llvm::opt::Arg *, InputHash> inputHashes,
+      llvm::StringMap<ContentHash> previousExternalDependencyHashes) {
+    EnableFileHashing = true;
+    InputHashes = std::move(inputHashes);
+    PreviousExternalDependencyHashes =
+        std::move(previousExternalDependencyHashes);
+  }
+
+  bool getFileHashingEnabled() const {
+    return EnableFileHashing;
+  }
+
+  Optional<InputHash> getInputHash(const llvm::opt::Arg *input) const {
+    auto iter = InputHashes.find(input);
+    if (iter == InputHashes.end())
+      return None;
+    return iter->second;
+  }
+
+  /// Requests that compile jobs which become ready to run at the same time be
+  /// split into \p BatchCount batches, each compiling several primary files
+  /// in one frontend invocation.
+  void enableBatchMode(const ToolChain &TC, const OutputInfo &OI,
+                       unsigned BatchCount);
+
+  bool getBatchModeEnabled() const {
+    return BatchModeToolChain != nullptr;
+  }
+
   /// Requests the path to a file containing all input source files. This can
   /// be shared across jobs.
   ///
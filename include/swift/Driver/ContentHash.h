@@ -0,0 +1,49 @@
+//===--- ContentHash.h - Hashes of file contents ----------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_DRIVER_CONTENTHASH_H
+#define SWIFT_DRIVER_CONTENTHASH_H
+
+#include "swift/Basic/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace swift {
+namespace driver {
+
+/// The MD5 hash of a file's contents.
+///
+/// Incremental builds can record these, so that a file whose modification
+/// time changed without its contents changing (after a checkout, a cache
+/// restore, or a touch) isn't treated as modified.
+using ContentHash = std::array<uint8_t, 16>;
+
+/// Computes the hash of the contents of each file in \p paths, reading several
+/// files in parallel. The hash of a file that can't be read is None.
+std::vector<Optional<ContentHash>> hashFileContents(ArrayRef<StringRef> paths);
+
+/// Writes \p hash as 32 lowercase hex digits.
+void writeContentHash(raw_ostream &out, const ContentHash &hash);
+
+/// Parses a hash written by writeContentHash, returning None if \p str isn't
+/// one.
+Optional<ContentHash> parseContentHash(StringRef str);
+
+} // end namespace driver
+} // end namespace swift
+
+#endif
@@ -90,6 +90,12 @@ private:
   struct ProvidesEntryTy {
     std::string name;
     DependencyMaskTy kindMask;
+    /// Identifies the interface of the declarations providing this name, or
+    /// empty if the dependencies file didn't say.
+    std::string fingerprint;
+    /// Whether the fingerprint changed, or was missing, when the node was
+    /// last loaded.
+    bool changed;
   };
   static_assert(std::is_move_constructible<ProvidesEntryTy>::value, "");
 
@@ -169,7 +175,8 @@ protected:
   }
 
   void markTransitive(SmallVectorImpl<const void *> &visited,
-                      const void *node, MarkTracerImpl *tracer = nullptr);
+                      const void *node, MarkTracerImpl *tracer = nullptr,
+                      bool onlyChangedProvides = false);
   bool markIntransitive(const void *node) {
     assert(Provides.count(node) && "node is not in the graph");
     return Marked.insert(node).second;
@@ -290,6 +297,23 @@ public:
     copyBack(visited, rawMarked);
   }
 
+  /// Like markTransitive, but only follows the names provided by \p node
+  /// whose fingerprints changed when it was last loaded.
+  ///
+  /// This is for a node that has just been rebuilt and reloaded: a name whose
+  /// declarations' interfaces didn't change can't affect the nodes that
+  /// depend on it. Names without fingerprints are always followed.
+  template <unsigned N>
+  void markTransitiveFromChangedProvides(SmallVector<T, N> &visited, T node,
+                                         MarkTracer *tracer = nullptr) {
+    SmallVector<const void *, N> rawMarked;
+    DependencyGraphImpl::markTransitive(rawMarked,
+                                        Traits::getAsVoidPointer(node),
+                                        tracer, /*onlyChangedProvides=*/true);
+    // FIXME: How can we avoid this copy?
+    copyBack(visited, rawMarked);
+  }
+
   template <unsigned N>
   void markExternal(SmallVector<T, N> &visited, StringRef externalDependency) {
     SmallVector<const void *, N> rawMarked;
@@ -60,6 +60,11 @@ protected:
     const CommandOutput &Output;
     const OutputInfo &OI;
 
+    /// When compiling several primary files in one frontend invocation, the
+    /// compile jobs being combined, in the order of their primary files.
+    /// Their outputs are passed to the frontend in the same order.
+    ArrayRef<const Job *> BatchedJobs;
+
     /// The arguments to the driver. Can also be used to create new strings with
     /// the same lifetime.
     ///
@@ -160,6 +165,15 @@ public:
                                     std::unique_ptr<CommandOutput> output,
                                     const OutputInfo &OI) const;
 
+  /// Construct a Job that compiles the primary files of all of \p jobs in
+  /// one frontend invocation, producing the outputs of each of them.
+  ///
+  /// Each of \p jobs must be a compile job in a standard compile with no
+  /// input jobs, and they must all produce the same kinds of output.
+  std::unique_ptr<Job> constructBatchJob(ArrayRef<const Job *> jobs,
+                                         Compilation &C,
+                                         const OutputInfo &OI) const;
+
   /// Return the default language type to use for the given extension.
   virtual types::ID lookupTypeForExtension(StringRef Ext) const;
 };
@@ -41,6 +41,7 @@
 #include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
 
+#include <algorithm>
 #include <memory>
 
 namespace swift {
@@ -307,7 +308,10 @@ class CompilerInstance {
   std::unique_ptr<SILModule> TheSILModule;
 
   DependencyTracker *DepTracker = nullptr;
-  ReferencedNameTracker *NameTracker = nullptr;
+
+  /// Records the names referenced by each primary source file. Either empty
+  /// or parallel to PrimaryBufferIDs.
+  SmallVector<ReferencedNameTracker *, 1> NameTrackers;
 
   Module *MainModule = nullptr;
   SerializedModuleLoader *SML = nullptr;
@@ -326,13 +330,27 @@ class CompilerInstance {
 
   enum : unsigned { NO_SUCH_BUFFER = ~0U };
   unsigned MainBufferID = NO_SUCH_BUFFER;
-  unsigned PrimaryBufferID = NO_SUCH_BUFFER;
 
-  SourceFile *PrimarySourceFile = nullptr;
+  /// The buffer IDs of the primary inputs, in the order they were given.
+  /// Empty if output is generated for the whole module.
+  SmallVector<unsigned, 1> PrimaryBufferIDs;
+
+  /// The source file of each primary input, parallel to PrimaryBufferIDs.
+  SmallVector<SourceFile *, 1> PrimarySourceFiles;
 
   void createSILModule(bool WholeModule = false);
   void setPrimarySourceFile(SourceFile *SF);
 
+  bool isPrimaryBuffer(unsigned BufferID) const {
+    return std::find(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                     BufferID) != PrimaryBufferIDs.end();
+  }
+
+  bool isPrimarySourceFile(const SourceFile *SF) const {
+    return std::find(PrimarySourceFiles.begin(), PrimarySourceFiles.end(),
+                     SF) != PrimarySourceFiles.end();
+  }
+
 public:
   SourceManager &getSourceMgr() { return SourceMgr; }
 
@@ -359,11 +377,17 @@ public:
   }
 
   void setReferencedNameTracker(ReferencedNameTracker *tracker) {
-    assert(!PrimarySourceFile && "must be called before performSema()");
-    NameTracker = tracker;
+    setReferencedNameTrackers(tracker);
   }
   ReferencedNameTracker *getReferencedNameTracker() {
-    return NameTracker;
+    return NameTrackers.empty() ? nullptr : NameTrackers.front();
+  }
+
+  /// Sets a separate tracker for each primary input, in the order the
+  /// primary inputs were given.
+  void setReferencedNameTrackers(ArrayRef<ReferencedNameTracker *> trackers) {
+    assert(PrimarySourceFiles.empty() && "must be called before performSema()");
+    NameTrackers.assign(trackers.begin(), trackers.end());
   }
 
   /// Set the SIL module for this compilation instance.
@@ -400,8 +424,15 @@ public:
   }
 
   /// Gets the SourceFile which is the primary input for this CompilerInstance.
+  /// In batch mode, this is the first of the primary inputs.
   /// \returns the primary SourceFile, or nullptr if there is no primary input
-  SourceFile *getPrimarySourceFile() { return PrimarySourceFile; }
+  SourceFile *getPrimarySourceFile() {
+    return PrimarySourceFiles.empty() ? nullptr : PrimarySourceFiles.front();
+  }
+
+  /// Gets the SourceFile of each primary input, in the order the primary
+  /// inputs were given.
+  ArrayRef<SourceFile *> getPrimarySourceFiles() { return PrimarySourceFiles; }
 
   /// \brief Returns true if there was an error during setup.
   bool setup(const CompilerInvocation &Invocation);
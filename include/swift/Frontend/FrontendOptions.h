@@ -52,6 +52,23 @@ public:
   bool isBuffer() const { return Kind == InputKind::Buffer; }
 };
 
+/// The outputs generated for one of the primary inputs of a batch-mode
+/// frontend invocation.
+struct BatchPrimaryInput {
+  SelectedInput Input;
+
+  /// Each path has the same meaning as the FrontendOptions field of the same
+  /// name, but applies only to this primary input.
+  std::string OutputFilename;
+  std::string ModuleOutputPath;
+  std::string ModuleDocOutputPath;
+  std::string SerializedDiagnosticsPath;
+  std::string DependenciesFilePath;
+  std::string ReferenceDependenciesFilePath;
+
+  BatchPrimaryInput(SelectedInput Input) : Input(Input) {}
+};
+
 enum class InputFileKind {
   IFK_None,
   IFK_Swift,
@@ -74,6 +91,13 @@ public:
   /// be generated for the whole module.
   Optional<SelectedInput> PrimaryInput;
 
+  /// In batch mode, each of the primary inputs together with its outputs, in
+  /// the order the primary inputs were given. PrimaryInput is the first of
+  /// them, and the top-level output paths below are those of the first.
+  ///
+  /// Empty unless more than one primary input was given.
+  std::vector<BatchPrimaryInput> BatchPrimaryInputs;
+
   /// The kind of input on which the frontend should operate.
   InputFileKind InputKind = InputFileKind::IFK_Swift;
 
@@ -112,6 +136,10 @@ public:
   /// The path to which we should output a Swift reference dependencies file.
   std::string ReferenceDependenciesFilePath;
 
+  /// Indicates whether the reference dependencies file should use the binary
+  /// format rather than YAML.
+  bool EmitBinaryReferenceDependencies = false;
+
   /// The path to which we should output fixits as source edits.
   std::string FixitsOutputPath;
 
@@ -258,6 +286,14 @@ public:
   bool actionIsImmediate() const;
 
   void forAllOutputPaths(std::function<void(const std::string &)> fn) const;
+
+  /// Indicates whether the frontend generates output for more than one
+  /// primary input.
+  bool isInBatchMode() const { return !BatchPrimaryInputs.empty(); }
+
+  /// Returns a copy of these options that selects only the primary input at
+  /// \p Index in BatchPrimaryInputs, along with its outputs.
+  FrontendOptions getOptionsForBatchPrimary(unsigned Index) const;
   
   /// Gets the name of the specified output filename.
   /// If multiple files are specified, the last one is returned.
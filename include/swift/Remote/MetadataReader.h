@@ -104,7 +104,7 @@ class TypeDecoder {
         if (repr->getKind() != NodeKind::MetatypeRepresentation ||
             !repr->hasText())
           return BuiltType();
-        auto &str = repr->getText();
+        auto str = repr->getText();
         if (str != "@thin")
           wasAbstract = true;
       }
@@ -137,16 +137,17 @@ class TypeDecoder {
         return Builder.createProtocolCompositionType(protocols);
     }
     case NodeKind::Protocol: {
-      auto moduleName = Node->getChild(0)->getText();
-      auto name = Node->getChild(1)->getText();
+      auto moduleName = Node->getChild(0)->getText().str();
+      auto name = Node->getChild(1)->getText().str();
 
       // Consistent handling of protocols and protocol compositions
-      auto protocolList = Demangle::NodeFactory::create(NodeKind::ProtocolList);
-      auto typeList = Demangle::NodeFactory::create(NodeKind::TypeList);
-      auto type = Demangle::NodeFactory::create(NodeKind::Type);
-      type->addChild(Node);
-      typeList->addChild(type);
-      protocolList->addChild(typeList);
+      Demangle::NodeFactory Factory;
+      auto protocolList = Factory.createNode(NodeKind::ProtocolList);
+      auto typeList = Factory.createNode(NodeKind::TypeList);
+      auto type = Factory.createNode(NodeKind::Type);
+      type->addChild(Node, Factory);
+      typeList->addChild(type, Factory);
+      protocolList->addChild(typeList, Factory);
 
       auto mangledName = Demangle::mangleNode(protocolList);
       return Builder.createProtocolType(mangledName, moduleName, name);
@@ -198,7 +199,7 @@ class TypeDecoder {
           if (!child->hasText())
             return BuiltType();
 
-          auto &text = child->getText();
+          auto text = child->getText();
 
           if (text == "@convention(thin)") {
             flags =
@@ -208,7 +209,7 @@ class TypeDecoder {
           if (!child->hasText())
             return BuiltType();
 
-          auto &text = child->getText();
+          auto text = child->getText();
           if (text == "@convention(c)") {
             flags =
               flags.withConvention(FunctionMetadataConvention::CFunctionPointer);
@@ -250,7 +251,7 @@ class TypeDecoder {
           if (labels.empty()) labels.append(elements.size(), ' ');
 
           // Add the label and its terminator.
-          labels += element->getChild(0)->getText();
+          labels += element->getChild(0)->getText().str();
           labels += ' ';
           typeChildIndex = 1;
 
@@ -281,7 +282,7 @@ class TypeDecoder {
       auto base = decodeMangledType(Node->getChild(0));
       if (!base)
         return BuiltType();
-      auto member = Node->getChild(1)->getText();
+      auto member = Node->getChild(1)->getText().str();
       auto protocol = decodeMangledType(Node->getChild(1));
       if (!protocol)
         return BuiltType();
@@ -691,6 +692,7 @@ public:
     case MetadataKind::Existential: {
       auto Exist = cast<TargetExistentialTypeMetadata<Runtime>>(Meta);
       std::vector<BuiltType> Protocols;
+      Demangle::NodeFactory Factory;
       for (size_t i = 0; i < Exist->Protocols.NumProtocols; ++i) {
         auto ProtocolAddress = Exist->Protocols[i];
         auto ProtocolDescriptor = readProtocolDescriptor(ProtocolAddress);
@@ -701,7 +703,8 @@ public:
         if (!Reader->readString(RemoteAddress(ProtocolDescriptor->Name),
                                 MangledName))
           return BuiltType();
-        auto Demangled = Demangle::demangleSymbolAsNode(MangledName);
+        Factory.clear();
+        auto Demangled = Demangle::demangleSymbolAsNode(MangledName, Factory);
         auto Protocol = decodeMangledType(Demangled);
         if (!Protocol)
           return BuiltType();
@@ -769,7 +772,9 @@ public:
 
   BuiltType readTypeFromMangledName(const char *MangledTypeName,
                                     size_t Length) {
-    auto Demangled = Demangle::demangleSymbolAsNode(MangledTypeName, Length);
+    Demangle::NodeFactory Factory;
+    auto Demangled = Demangle::demangleSymbolAsNode(MangledTypeName, Length,
+                                                    Factory);
     return decodeMangledType(Demangled);
   }
 
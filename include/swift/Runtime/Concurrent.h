@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 #ifndef SWIFT_RUNTIME_CONCURRENTUTILS_H
 #define SWIFT_RUNTIME_CONCURRENTUTILS_H
+#include <cassert>
 #include <iterator>
 #include <atomic>
 #include <stdint.h>
@@ -30,11 +31,11 @@ template <class ElemTy> struct ConcurrentListNode {
   /// The element.
   ElemTy Payload;
   /// Points to the next link in the chain.
-  ConcurrentListNode<ElemTy> *Next;
+  std::atomic<ConcurrentListNode<ElemTy> *> Next;
 };
 
 /// This is a concurrent linked list. It supports insertion at the beginning
-/// of the list and traversal using iterators.
+/// or end of the list and traversal using iterators.
 /// This is a very simple implementation of a concurrent linked list
 /// using atomic operations. The 'push_front' method allocates a new link
 /// and attempts to compare and swap the old head pointer with pointer to
@@ -44,7 +45,7 @@ template <class ElemTy> struct ConcurrentListNode {
 /// difficult feature of removing links is not supported.
 /// See 'push_front' for more details.
 template <class ElemTy> struct ConcurrentList {
-  ConcurrentList() : First(nullptr) {}
+  ConcurrentList() : First(nullptr), Last(nullptr) {}
   ~ConcurrentList() {
     clear();
   }
@@ -58,9 +59,10 @@ template <class ElemTy> struct ConcurrentList {
     // Iterate over the list and delete all the nodes.
     auto Ptr = First.load(std::memory_order_acquire);
     First.store(nullptr, std:: memory_order_release);
+    Last.store(nullptr, std::memory_order_relaxed);
 
     while (Ptr) {
-      auto N = Ptr->Next;
+      auto N = Ptr->Next.load(std::memory_order_relaxed);
       delete Ptr;
       Ptr = N;
     }
@@ -79,7 +81,7 @@ template <class ElemTy> struct ConcurrentList {
     ConcurrentListIterator(ConcurrentListNode<ElemTy> *P) : Ptr(P) {}
     /// Move to the next element.
     ConcurrentListIterator &operator++() {
-      Ptr = Ptr->Next;
+      Ptr = Ptr->Next.load(std::memory_order_acquire);
       return *this;
     }
     /// Access the element.
@@ -108,8 +110,8 @@ template <class ElemTy> struct ConcurrentList {
     /// Allocate a new node.
     ConcurrentListNode<ElemTy> *N = new ConcurrentListNode<ElemTy>(Elem);
     // Point to the first element in the list.
-    N->Next = First.load(std::memory_order_acquire);
-    auto OldFirst = N->Next;
+    auto OldFirst = First.load(std::memory_order_acquire);
+    N->Next.store(OldFirst, std::memory_order_relaxed);
     // Try to replace the current First with the new node.
     while (!std::atomic_compare_exchange_weak_explicit(&First, &OldFirst, N,
                                                std::memory_order_release,
@@ -117,12 +119,38 @@ template <class ElemTy> struct ConcurrentList {
       // If we fail, update the new node to point to the new head and try to
       // insert before the new
       // first element.
-      N->Next = OldFirst;
+      N->Next.store(OldFirst, std::memory_order_relaxed);
     }
   }
 
+  /// Add a new item to the end of the list, so that traversals see the items
+  /// added this way in the order they were added.
+  void push_back(ElemTy Elem) {
+    ConcurrentListNode<ElemTy> *N = new ConcurrentListNode<ElemTy>(Elem);
+    // Start from the last link we know of, which saves walking the whole
+    // list, and follow the chain to whichever link is really last.
+    ConcurrentListNode<ElemTy> *Tail = Last.load(std::memory_order_acquire);
+    std::atomic<ConcurrentListNode<ElemTy> *> *Link =
+      Tail ? &Tail->Next : &First;
+    ConcurrentListNode<ElemTy> *Next = nullptr;
+    while (!Link->compare_exchange_weak(Next, N, std::memory_order_release,
+                                        std::memory_order_acquire)) {
+      // If another link was added here first, try to add after it.
+      if (Next) {
+        Link = &Next->Next;
+        Next = nullptr;
+      }
+    }
+    // This is only a hint; a racing push_back may leave it at an earlier
+    // link, which is still in the list.
+    Last.store(N, std::memory_order_release);
+  }
+
   /// Points to the first link in the list.
   std::atomic<ConcurrentListNode<ElemTy> *> First;
+
+  /// Points to the last link added by push_back, or some link before it.
+  std::atomic<ConcurrentListNode<ElemTy> *> Last;
 };
 
 template <class T, bool Delete> class AtomicMaybeOwningPointer;
@@ -144,7 +172,7 @@ public:
     // This can use relaxed memory order because the client has to ensure
     // that all accesses are safely completed and their effects fully
     // visible before destruction occurs anyway.
-    ::delete Value.load(std::memory_order_relaxed);
+    delete Value.load(std::memory_order_relaxed);
   }
 };
 
@@ -210,13 +238,16 @@ class ConcurrentMap {
   /// The root of the tree.
   AtomicMaybeOwningPointer<Node, ProvideDestructor> Root;
 
-  /// This member stores the address of the last node that was found by the
-  /// search procedure. We cache the last search to accelerate code that
-  /// searches the same value in a loop.
-  std::atomic<Node*> LastSearch;
+  /// This member stores the address of the last node that was inserted.
+  /// Code commonly looks up the entry it just created, so we check it
+  /// before searching the tree.  It is deliberately never updated when a
+  /// search merely finds an existing node: with many threads hitting the
+  /// map, storing on every lookup would make this cache line bounce between
+  /// cores even though the map itself is only being read.
+  std::atomic<Node*> LastInsert;
 
 public:
-  constexpr ConcurrentMap() : Root(nullptr), LastSearch(nullptr) {}
+  constexpr ConcurrentMap() : Root(nullptr), LastInsert(nullptr) {}
 
   ConcurrentMap(const ConcurrentMap &) = delete;
   ConcurrentMap &operator=(const ConcurrentMap &) = delete;
@@ -244,19 +275,18 @@ public:
   /// \returns a pointer to the value or null if the value is not in the map.
   template <class KeyTy>
   EntryTy *find(const KeyTy &key) {
-    // Check if we are looking for the same key that we looked for in the last
-    // time we called this function.
-    if (Node *last = LastSearch.load(std::memory_order_acquire)) {
+    // Check if we are looking for the key that was inserted most recently.
+    if (Node *last = LastInsert.load(std::memory_order_acquire)) {
       if (last->Payload.compareWithKey(key) == 0)
         return &last->Payload;
     }
 
-    // Search the tree, starting from the root.
+    // Search the tree, starting from the root.  Nothing is written on
+    // this path.
     Node *node = Root.Value.load(std::memory_order_acquire);
     while (node) {
       int comparisonResult = node->Payload.compareWithKey(key);
       if (comparisonResult == 0) {
-        LastSearch.store(node, std::memory_order_release);
         return &node->Payload;
       } else if (comparisonResult < 0) {
         node = node->Left.load(std::memory_order_acquire);
@@ -274,10 +304,9 @@ public:
   ///   or already existed (false)
   template <class KeyTy, class... ArgTys>
   std::pair<EntryTy*, bool> getOrInsert(KeyTy key, ArgTys &&... args) {
-    // Check if we are looking for the same key that we looked for the
-    // last time we called this function.
-    if (Node *last = LastSearch.load(std::memory_order_acquire)) {
-      if (last && last->Payload.compareWithKey(key) == 0)
+    // Check if we are looking for the key that was inserted most recently.
+    if (Node *last = LastInsert.load(std::memory_order_acquire)) {
+      if (last->Payload.compareWithKey(key) == 0)
         return { &last->Payload, false };
     }
 
@@ -304,8 +333,7 @@ public:
           // Destroy the node we allocated before if we're carrying one around.
           ::delete newNode;
 
-          // Cache and report that we found an existing node.
-          LastSearch.store(node, std::memory_order_release);
+          // Report that we found an existing node.
           return { &node->Payload, false };
         }
 
@@ -327,7 +355,7 @@ public:
                                                   std::memory_order_acq_rel,
                                                   std::memory_order_acquire)) {
         // If that succeeded, cache and report that we created a new node.
-        LastSearch.store(newNode, std::memory_order_release);
+        LastInsert.store(newNode, std::memory_order_release);
         return { &newNode->Payload, true };
       }
 
@@ -340,6 +368,366 @@ public:
   }
 };
 
+/// A concurrent map that is implemented using an open-addressed hash table
+/// with linear probing.  It supports concurrent insertions and lock-free
+/// lookups, and it grows by migrating its entries into a table of twice the
+/// size.  It does not support removals.
+///
+/// The table itself only stores pointers to separately-allocated nodes, so
+/// entries never move once they have been inserted and the pointers returned
+/// by find and getOrInsert remain valid for the lifetime of the map.
+///
+/// Growing the table is cooperative: every thread that observes a table
+/// being migrated helps to finish the migration before it inserts into the
+/// new table.  This guarantees that a key is never inserted twice, which
+/// clients such as the metadata caches rely on for uniquing.
+///
+/// The entry type must provide the same operations as for ConcurrentMap,
+/// plus a hash function for keys:
+///
+///   /// Return a hash value for the given key.  Keys that compare equal
+///   /// must have equal hash values.
+///   static size_t getKeyHash(KeyTy key);
+template <class EntryTy, bool ProvideDestructor = true>
+class ConcurrentHashMap {
+  struct Node {
+    size_t Hash;
+    EntryTy Payload;
+
+    template <class... Args>
+    Node(size_t hash, Args &&... args)
+      : Hash(hash), Payload(std::forward<Args>(args)...) {}
+
+    Node(const Node &) = delete;
+    Node &operator=(const Node &) = delete;
+
+    /// Nodes are allocated with trailing space for the entry, so they must
+    /// not be deallocated with the size of the node type.
+    static void operator delete(void *ptr) { ::operator delete(ptr); }
+  };
+
+  /// The value stored into a slot once its node has been copied into the
+  /// next table.
+  static Node *getMovedMarker() {
+    return reinterpret_cast<Node *>(uintptr_t(1));
+  }
+
+  /// The value stored into a slot that was still empty when its table was
+  /// migrated.  Like an empty slot, it ends a probe sequence.
+  static Node *getMovedEmptyMarker() {
+    return reinterpret_cast<Node *>(uintptr_t(2));
+  }
+
+  /// Whether a slot has been migrated to the next table.
+  static bool isMoved(Node *node) {
+    return node == getMovedMarker() || node == getMovedEmptyMarker();
+  }
+
+  struct Table {
+    /// The number of slots minus one.  The number of slots is always a
+    /// power of two.
+    size_t Mask;
+
+    /// The number of nodes stored in this table.
+    std::atomic<size_t> Count;
+
+    /// The table that the entries of this table are being migrated to,
+    /// or null if this table is not being migrated.
+    std::atomic<Table *> Next;
+
+    /// The table that this table replaced.  Old tables are kept alive
+    /// because concurrent readers may still be probing them.
+    Table *Previous;
+
+    /// The slots; the actual number of slots is Mask + 1.
+    std::atomic<Node *> Slots[1];
+
+    Table(size_t capacity, Table *previous)
+      : Mask(capacity - 1), Count(0), Next(nullptr), Previous(previous) {
+      for (size_t i = 0; i != capacity; ++i)
+        ::new (&Slots[i]) std::atomic<Node *>(nullptr);
+    }
+
+    Table(const Table &) = delete;
+    Table &operator=(const Table &) = delete;
+
+    /// Tables are allocated with trailing slots, so they must not be
+    /// deallocated with the size of the table type.
+    static void operator delete(void *ptr) { ::operator delete(ptr); }
+
+    static Table *create(size_t capacity, Table *previous) {
+      size_t allocSize =
+        sizeof(Table) + (capacity - 1) * sizeof(std::atomic<Node *>);
+      void *memory = ::operator new(allocSize);
+      return ::new (memory) Table(capacity, previous);
+    }
+
+    size_t getCapacity() const { return Mask + 1; }
+
+    /// Whether inserting another node would put this table over its
+    /// maximum load factor of one half.
+    bool isFull() const {
+      return (Count.load(std::memory_order_relaxed) + 1) * 2 > getCapacity();
+    }
+
+    ~Table() {
+      // These can be relaxed accesses because there is no safe way for
+      // another thread to race an access to this table with our destruction
+      // of it.  Nodes are only owned by the newest table; older tables have
+      // had every slot replaced by a moved marker.
+      for (size_t i = 0; i != getCapacity(); ++i) {
+        Node *node = Slots[i].load(std::memory_order_relaxed);
+        if (node && !isMoved(node))
+          delete node;
+      }
+      delete Previous;
+    }
+  };
+
+  /// The initial number of slots in a table.
+  enum : size_t { InitialCapacity = 16 };
+
+  /// The newest completely-populated table.
+  AtomicMaybeOwningPointer<Table, ProvideDestructor> Current;
+
+  /// Return the table that \p table is being migrated to, allocating it
+  /// if necessary.
+  static Table *getOrCreateNextTable(Table *table) {
+    Table *next = table->Next.load(std::memory_order_acquire);
+    if (next)
+      return next;
+
+    Table *newTable = Table::create(table->getCapacity() * 2, table);
+    if (table->Next.compare_exchange_strong(next, newTable,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+      return newTable;
+
+    // Somebody else started the migration first.  Our table was never
+    // published, so it does not own anything.
+    newTable->Previous = nullptr;
+    delete newTable;
+    return next;
+  }
+
+  /// Copy an existing node into a table that is the target of a migration.
+  /// Since no new keys are inserted into a table until the migration into it
+  /// is complete, nodes only need to be compared by identity.
+  static void copyNodeInto(Table *table, Node *node) {
+    size_t i = node->Hash & table->Mask;
+    while (true) {
+      Node *slot = table->Slots[i].load(std::memory_order_acquire);
+      if (!slot) {
+        if (table->Slots[i].compare_exchange_strong(
+                slot, node, std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+          table->Count.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+      }
+
+      // Either another helper copied this node first, or the target table
+      // has itself started migrating, which can only happen after every
+      // node of the source table has been copied.
+      if (slot == node || isMoved(slot))
+        return;
+
+      // If the compare-exchange failed because another node landed in this
+      // slot, keep probing.
+      if (slot)
+        i = (i + 1) & table->Mask;
+    }
+  }
+
+  /// Move every node of \p table into its successor and return the
+  /// successor.  When this returns, every slot of \p table holds one of the
+  /// moved markers, so no further insertions into \p table can succeed.
+  Table *migrate(Table *table) {
+    Table *next = getOrCreateNextTable(table);
+
+    for (size_t i = 0; i != table->getCapacity(); ++i) {
+      auto &slot = table->Slots[i];
+      Node *node = slot.load(std::memory_order_acquire);
+      while (!isMoved(node)) {
+        if (node)
+          copyNodeInto(next, node);
+        Node *marker = node ? getMovedMarker() : getMovedEmptyMarker();
+        if (slot.compare_exchange_weak(node, marker,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire))
+          break;
+      }
+    }
+
+    // Publish the new table.  Tables only ever grow, so the capacity tells
+    // us whether somebody already published this table or a newer one.
+    Table *current = Current.Value.load(std::memory_order_acquire);
+    while (current->getCapacity() < next->getCapacity() &&
+           !Current.Value.compare_exchange_weak(current, next,
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+    }
+
+    return next;
+  }
+
+  /// Return the current table, allocating the initial table if necessary.
+  Table *getOrCreateCurrentTable() {
+    Table *table = Current.Value.load(std::memory_order_acquire);
+    if (table)
+      return table;
+
+    Table *newTable = Table::create(InitialCapacity, nullptr);
+    if (Current.Value.compare_exchange_strong(table, newTable,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire))
+      return newTable;
+
+    delete newTable;
+    return table;
+  }
+
+public:
+  constexpr ConcurrentHashMap() : Current(nullptr) {}
+
+  ConcurrentHashMap(const ConcurrentHashMap &) = delete;
+  ConcurrentHashMap &operator=(const ConcurrentHashMap &) = delete;
+
+  // ConcurrentHashMap<T, false> must have a trivial destructor.
+  ~ConcurrentHashMap() = default;
+
+  /// Search for a value by key \p Key.
+  /// \returns a pointer to the value or null if the value is not in the map.
+  template <class KeyTy>
+  EntryTy *find(const KeyTy &key) {
+    size_t hash = EntryTy::getKeyHash(key);
+    Table *table = Current.Value.load(std::memory_order_acquire);
+
+    while (table) {
+      size_t i = hash & table->Mask;
+      for (size_t probes = 0; probes <= table->Mask; ++probes) {
+        Node *node = table->Slots[i].load(std::memory_order_acquire);
+
+        // An empty slot ends the probe sequence.
+        if (!node || node == getMovedEmptyMarker())
+          break;
+
+        // A moved node has already been copied into the next table, but the
+        // rest of this probe sequence may not have been, so keep looking
+        // here first.
+        if (node == getMovedMarker()) {
+          i = (i + 1) & table->Mask;
+          continue;
+        }
+
+        if (node->Hash == hash && node->Payload.compareWithKey(key) == 0)
+          return &node->Payload;
+
+        i = (i + 1) & table->Mask;
+      }
+
+      // If the table is being migrated, the entry may be one that was moved
+      // into its successor, or one inserted there after the migration.
+      table = table->Next.load(std::memory_order_acquire);
+    }
+
+    return nullptr;
+  }
+
+  /// Get or create an entry in the map.
+  ///
+  /// \returns the entry in the map and whether a new node was added (true)
+  ///   or already existed (false)
+  template <class KeyTy, class... ArgTys>
+  std::pair<EntryTy*, bool> getOrInsert(KeyTy key, ArgTys &&... args) {
+    size_t hash = EntryTy::getKeyHash(key);
+
+    // The node we allocated.
+    Node *newNode = nullptr;
+
+    Table *table = getOrCreateCurrentTable();
+
+  searchTable:
+    size_t i = hash & table->Mask;
+    for (size_t probes = 0; probes <= table->Mask; ++probes) {
+      auto &slot = table->Slots[i];
+      Node *node = slot.load(std::memory_order_acquire);
+
+      if (!node) {
+        // Don't insert into a table that is over its load factor; grow it
+        // and insert into the new table instead.
+        if (table->isFull())
+          break;
+
+        // Create a new node.
+        if (!newNode) {
+          size_t allocSize =
+            sizeof(Node) + EntryTy::getExtraAllocationSize(key, args...);
+          void *memory = ::operator new(allocSize);
+          newNode = ::new (memory) Node(hash, key,
+                                        std::forward<ArgTys>(args)...);
+        }
+
+        // Try to claim the slot.
+        if (slot.compare_exchange_strong(node, newNode,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+          table->Count.fetch_add(1, std::memory_order_relaxed);
+          return { &newNode->Payload, true };
+        }
+
+        // Otherwise, we lost the race because some other thread filled
+        // the slot before us.  node will be set to the current value.
+        assert(node && "spurious failure from compare_exchange_strong?");
+      }
+
+      // The table is being migrated; finish the migration and search the
+      // new table.
+      if (isMoved(node))
+        break;
+
+      // If it's equal, we can use this node.
+      if (node->Hash == hash && node->Payload.compareWithKey(key) == 0) {
+        // Destroy the node we allocated before if we're carrying one around.
+        delete newNode;
+        return { &node->Payload, false };
+      }
+
+      i = (i + 1) & table->Mask;
+    }
+
+    table = migrate(table);
+    goto searchTable;
+  }
+
+  /// Return the longest probe sequence needed to find any entry in the
+  /// current table.  This is only meaningful while no other thread is
+  /// modifying the map, and is intended for testing and tuning.
+  size_t getMaxProbeDistance() const {
+    Table *table = Current.Value.load(std::memory_order_acquire);
+    if (!table)
+      return 0;
+
+    size_t maxDistance = 0;
+    for (size_t i = 0; i != table->getCapacity(); ++i) {
+      Node *node = table->Slots[i].load(std::memory_order_acquire);
+      if (!node || isMoved(node))
+        continue;
+      size_t distance = (i - (node->Hash & table->Mask)) & table->Mask;
+      if (distance > maxDistance)
+        maxDistance = distance;
+    }
+    return maxDistance;
+  }
+
+  /// Return the number of entries in the map.  This is only meaningful
+  /// while no other thread is modifying the map.
+  size_t size() const {
+    Table *table = Current.Value.load(std::memory_order_acquire);
+    return table ? table->Count.load(std::memory_order_relaxed) : 0;
+  }
+};
+
 } // end namespace swift
 
 #endif // SWIFT_RUNTIME_CONCURRENTUTILS_H
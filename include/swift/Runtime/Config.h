@@ -85,6 +85,20 @@
 # define SWIFT_ALLOWED_RUNTIME_GLOBAL_CTOR_END
 #endif
 
+// Small thread-local variables that the runtime reads on its fast paths use
+// the initial-exec TLS model, which addresses them at a fixed offset from the
+// thread pointer instead of calling __tls_get_addr.  That is still safe when
+// libswiftCore.so is dlopen'ed: glibc reserves spare static TLS for
+// initial-exec variables of libraries loaded after startup, and the few words
+// the runtime declares this way fit in it.  Larger thread-local state keeps
+// the default model so as not to use up that reserve.
+#if defined(__ELF__)
+# define SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC \
+    __attribute__((tls_model("initial-exec")))
+#else
+# define SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC
+#endif
+
 // Bring in visibility attribute macros
 #include "../../../stdlib/public/SwiftShims/Visibility.h"
 
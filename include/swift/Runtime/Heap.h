@@ -18,5 +18,17 @@
 #define SWIFT_RUNTIME_HEAP_H
 
 #include <llvm/Support/Compiler.h>
+#include <cstddef>
+
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+namespace swift {
+
+/// If \p ptr is a block from the runtime's size class allocator, return
+/// the size of the block; otherwise return zero.
+LLVM_LIBRARY_VISIBILITY
+size_t _swift_getSizeClassBlockSize(const void *ptr);
+
+} // end namespace swift
+#endif
 
 #endif /* SWIFT_RUNTIME_HEAP_H */
@@ -164,6 +164,13 @@ SWIFT_RUNTIME_EXPORT
 extern "C" BoxPair::Return (*_swift_allocBox)(Metadata const *type)
            SWIFT_CC(swift);
 
+/// Write the allocation profile collected so far to the given file, or to
+/// the file named by SWIFT_ALLOCATION_PROFILE if the path is null.  Does
+/// nothing unless SWIFT_ALLOCATION_PROFILE enabled allocation profiling, or
+/// on platforms that don't support it.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_dumpAllocationProfile(const char *path);
+
 
 // Allocate plain old memory. This is the generalized entry point
 // Never returns nil. The returned memory is uninitialized. 
@@ -635,6 +642,10 @@ static inline void swift_unownedTakeAssign(UnownedReference *dest,
 /*****************************************************************************/
 
 /// A weak reference value object.  This is ABI.
+///
+/// A native weak reference does not point at the object itself but at a side
+/// table that the runtime allocates for the object when the first weak
+/// reference to it is formed.
 struct WeakReference {
   uintptr_t Value;
 };
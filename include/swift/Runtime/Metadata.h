@@ -2673,6 +2673,25 @@ public:
     return this->DirectType;
   }
 
+  const TargetClassMetadata<Runtime> *getDirectClass() const {
+    switch (Flags.getTypeKind()) {
+    case TypeMetadataRecordKind::Universal:
+      return nullptr;
+
+    case TypeMetadataRecordKind::UniqueDirectClass:
+      break;
+
+    case TypeMetadataRecordKind::UniqueDirectType:
+    case TypeMetadataRecordKind::NonuniqueDirectType:
+    case TypeMetadataRecordKind::UniqueIndirectClass:
+    case TypeMetadataRecordKind::UniqueNominalTypeDescriptor:
+      assert(false && "not direct class object");
+    }
+
+    const TargetMetadata<Runtime> *metadata = this->DirectType;
+    return static_cast<const TargetClassMetadata<Runtime> *>(metadata);
+  }
+
   const TargetNominalTypeDescriptor<Runtime> *
   getNominalTypeDescriptor() const {
     switch (Flags.getTypeKind()) {
@@ -3453,6 +3472,41 @@ extern "C"
 void swift_registerTypeMetadataRecords(const TypeMetadataRecord *begin,
                                        const TypeMetadataRecord *end);
 
+/// Instantiate, on a background thread, the metadata and conformances listed
+/// in a metadata profile recorded by an earlier run of the same binaries
+/// with SWIFT_METADATA_PROFILE_OUTPUT set.  Setting SWIFT_METADATA_PROFILE
+/// has the same effect when the process first looks up generic metadata or
+/// a protocol conformance; call this at startup to begin earlier.  Does
+/// nothing if the profile can't be opened, and on platforms that don't
+/// support metadata profiles.
+SWIFT_RUNTIME_EXPORT
+extern "C"
+void swift_prewarmMetadata(const char *profilePath);
+
+/// Start recording a metadata profile to the given path, as setting
+/// SWIFT_METADATA_PROFILE_OUTPUT does, or stop recording if the path is null.
+/// Only metadata created after the call is recorded.
+SWIFT_RUNTIME_EXPORT
+extern "C"
+void swift_recordMetadataProfile(const char *profilePath);
+
+/// Like swift_prewarmMetadata, but replay the profile on the current thread,
+/// calling the callback with each piece of metadata it produces.
+SWIFT_RUNTIME_EXPORT
+extern "C"
+void swift_replayMetadataProfile(const char *profilePath,
+                                 void (*callback)(const void *metadata,
+                                                  void *context),
+                                 void *context);
+
+/// Keep the given number of replicas of the conformance and metadata caches,
+/// as setting SWIFT_CACHE_REPLICAS=<n> does, or stop replicating them if the
+/// number is zero.  Every thread switches on its next lookup.  Does nothing
+/// on platforms that don't support cache replicas.
+SWIFT_RUNTIME_EXPORT
+extern "C"
+void swift_setCacheReplicas(unsigned numReplicas);
+
 /// Return the type name for a given type metadata.
 std::string nameForMetadata(const Metadata *type,
                             bool qualified = true);
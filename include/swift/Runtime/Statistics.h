@@ -0,0 +1,132 @@
+//===--- Statistics.h - Swift Runtime call statistics -----------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Counters of calls to the hottest runtime entry points, and sampled latency
+// histograms for the slow paths of metadata instantiation and conformance
+// lookup, so that a process can tell how much of its time goes to the
+// runtime.
+//
+// Statistics are off by default.  Setting SWIFT_RUNTIME_STATISTICS=1 in the
+// environment turns the counters on at startup, and setting
+// SWIFT_RUNTIME_STATISTICS_LATENCY_SAMPLE=<n> also times one in every n
+// slow paths on each thread.  They can be turned on and off at any time with
+// swift_enableRuntimeStatistics and swift_disableRuntimeStatistics.  While
+// they are on, each generic type also keeps count of how much metadata it
+// instantiates and how long that takes.
+//
+// Statistics are only collected on Linux.  Elsewhere the functions below
+// are available but always report zero.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_STATISTICS_H
+#define SWIFT_RUNTIME_STATISTICS_H
+
+#include "swift/Runtime/Config.h"
+#include "swift/Runtime/Metadata.h"
+#include <cstdint>
+
+namespace swift {
+
+/// A histogram of the time taken by the sampled calls of a runtime slow
+/// path.  Bucket i counts the calls that took at least 2^i and less than
+/// 2^(i+1) nanoseconds; the first bucket also counts calls that took no
+/// measurable time, and the last one also counts anything longer.
+struct RuntimeLatencyHistogram {
+  enum : unsigned { NumBuckets = 40 };
+
+  uint64_t Buckets[NumBuckets];
+
+  /// The number of sampled calls, and their total duration.
+  uint64_t Samples;
+  uint64_t TotalNanoseconds;
+};
+
+/// A snapshot of the runtime statistics since they were last reset.  The
+/// counters count calls made while statistics were enabled.
+struct RuntimeStatistics {
+  /// Calls to swift_retain and swift_retain_n and their nonatomic variants.
+  uint64_t Retains;
+
+  /// Calls to swift_release and swift_release_n and their nonatomic
+  /// variants.
+  uint64_t Releases;
+
+  /// Calls to swift_allocObject, including those made by swift_allocBox.
+  uint64_t ObjectAllocations;
+
+  /// Calls to swift_deallocObject.
+  uint64_t ObjectDeallocations;
+
+  /// Calls to swift_dynamicCast.
+  uint64_t DynamicCasts;
+
+  /// Calls to swift_conformsToProtocol.
+  uint64_t ConformanceLookups;
+
+  /// Calls to swift_getGenericMetadata.
+  uint64_t GenericMetadataLookups;
+
+  /// Sampled times taken to instantiate generic metadata that wasn't
+  /// already cached.
+  RuntimeLatencyHistogram GenericMetadataInstantiation;
+
+  /// Sampled times taken by conformance lookups that missed the cache.
+  RuntimeLatencyHistogram ConformanceCacheMisses;
+};
+
+/// The instantiation statistics of one generic type, since the statistics
+/// were last reset.
+struct GenericMetadataStatistics {
+  /// The generic type's metadata pattern.
+  const GenericMetadata *Pattern;
+
+  /// The number of instantiations of the pattern made while statistics
+  /// were enabled, and the total time they took.
+  uint64_t Instantiations;
+  uint64_t TotalNanoseconds;
+
+  /// The number of times a thread had to wait for another thread to finish
+  /// instantiating metadata from the pattern.
+  uint64_t Waits;
+};
+
+/// Start counting runtime calls.  If latencySampleInterval is nonzero, also
+/// time one in every latencySampleInterval slow paths on each thread.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_enableRuntimeStatistics(unsigned latencySampleInterval);
+
+/// Stop counting runtime calls and timing slow paths.  The statistics
+/// collected so far are kept.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_disableRuntimeStatistics(void);
+
+/// Take a snapshot of the statistics collected since they were last reset.
+/// Counts from threads that are running concurrently may be slightly stale.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_getRuntimeStatistics(RuntimeStatistics *statistics);
+
+/// Reset all of the statistics to zero.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_resetRuntimeStatistics(void);
+
+/// Call the callback with the instantiation statistics of each generic type
+/// that has instantiated metadata since the statistics were last reset.
+SWIFT_RUNTIME_EXPORT
+extern "C" void swift_enumerateGenericMetadataStatistics(
+    void (*callback)(const GenericMetadataStatistics *statistics,
+                     void *context),
+    void *context);
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_STATISTICS_H
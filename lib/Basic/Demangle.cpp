@@ -50,9 +50,9 @@ DemanglerPrinter &DemanglerPrinter::operator<<(long long n) & {
 
 namespace {
 struct QuotedString {
-  std::string Value;
+  StringRef Value;
 
-  explicit QuotedString(std::string Value) : Value(Value) {}
+  explicit QuotedString(StringRef Value) : Value(Value) {}
 };
 } // end anonymous namespace.
 
@@ -87,25 +87,50 @@ static DemanglerPrinter &operator<<(DemanglerPrinter &printer,
   return printer;
 }
 
-Node::~Node() {
-  switch (NodePayloadKind) {
-  case PayloadKind::None: return;
-  case PayloadKind::Index: return;
-  case PayloadKind::Text: TextPayload.~basic_string(); return;
+NodeFactory::~NodeFactory() {
+  while (CurrentSlab) {
+    Slab *previous = CurrentSlab->Previous;
+    free(CurrentSlab);
+    CurrentSlab = previous;
   }
-  unreachable("bad payload kind");
 }
 
-namespace {
-  struct FindPtr {
-    FindPtr(Node *v) : Target(v) {}
-    bool operator()(NodePointer sp) const {
-      return sp.get() == Target;
-    }
-  private:
-    Node *Target;
-  };
-} // end anonymous namespace
+void NodeFactory::clear() {
+  if (!CurrentSlab)
+    return;
+
+  // Free every slab but the most recent one, which is the largest.
+  while (Slab *previous = CurrentSlab->Previous) {
+    CurrentSlab->Previous = previous->Previous;
+    free(previous);
+  }
+  CurPtr = reinterpret_cast<char *>(CurrentSlab + 1);
+}
+
+size_t NodeFactory::getNumSlabs() const {
+  size_t numSlabs = 0;
+  for (Slab *slab = CurrentSlab; slab; slab = slab->Previous)
+    ++numSlabs;
+  return numSlabs;
+}
+
+void *NodeFactory::allocateInNewSlab(size_t size, size_t alignment) {
+  // Grow the slabs geometrically so that a factory that is reused settles on
+  // a single slab that is large enough for its typical tree.
+  size_t slabSize = CurrentSlab ? CurrentSlab->Size * 2 : MinSlabSize;
+  while (slabSize < sizeof(Slab) + size + alignment)
+    slabSize *= 2;
+
+  auto newSlab = static_cast<Slab *>(malloc(slabSize));
+  if (!newSlab)
+    unreachable("out of memory allocating demangling tree");
+  newSlab->Previous = CurrentSlab;
+  newSlab->Size = slabSize;
+  CurrentSlab = newSlab;
+  CurPtr = reinterpret_cast<char *>(newSlab + 1);
+  End = reinterpret_cast<char *>(newSlab) + slabSize;
+  return allocate(size, alignment);
+}
 
 static bool isStartOfIdentifier(char c) {
   if (c >= '0' && c <= '9')
@@ -290,17 +315,24 @@ static StringRef toString(ValueWitnessKind k) {
 
 /// The main class for parsing a demangling tree out of a mangled string.
 class Demangler {
-  std::vector<NodePointer> Substitutions;
+  NodeFactory &Factory;
+
+  /// The substitutions, in an array allocated by the factory.
+  NodePointer *Substitutions = nullptr;
+  size_t NumSubstitutions = 0;
+  size_t ReservedSubstitutions = 0;
+
   NameSource Mangled;
 public:  
-  Demangler(llvm::StringRef mangled) : Mangled(mangled) {}
+  Demangler(llvm::StringRef mangled, NodeFactory &factory)
+    : Factory(factory), Mangled(mangled) {}
 
 /// Try to demangle a child node of the given kind.  If that fails,
 /// return; otherwise add it to the parent.
 #define DEMANGLE_CHILD_OR_RETURN(PARENT, CHILD_KIND) do { \
     auto _node = demangle##CHILD_KIND();                  \
     if (!_node) return nullptr;                           \
-    (PARENT)->addChild(std::move(_node));                 \
+    (PARENT)->addChild(std::move(_node), Factory);        \
   } while (false)
 
 /// Try to demangle a child node of the given kind.  If that fails,
@@ -308,8 +340,9 @@ public:
 #define DEMANGLE_CHILD_AS_NODE_OR_RETURN(PARENT, CHILD_KIND) do {  \
     auto _kind = demangle##CHILD_KIND();                           \
     if (!_kind.hasValue()) return nullptr;                         \
-    (PARENT)->addChild(NodeFactory::create(Node::Kind::CHILD_KIND, \
-                                           unsigned(*_kind)));     \
+    (PARENT)->addChild(Factory.createNode(Node::Kind::CHILD_KIND,  \
+                                          unsigned(*_kind)),       \
+                       Factory);                                   \
   } while (false)
 
   /// Attempt to demangle the source string.  The root node will
@@ -322,7 +355,7 @@ public:
     if (!Mangled.nextIf("_T"))
       return nullptr;
 
-    NodePointer topLevel = NodeFactory::create(Node::Kind::Global);
+    NodePointer topLevel = Factory.createNode(Node::Kind::Global);
 
     // First demangle any specialization prefixes.
     if (Mangled.nextIf("TS")) {
@@ -331,7 +364,7 @@ public:
 
         // The Substitution header does not share state with the rest
         // of the mangling.
-        Substitutions.clear();
+        NumSubstitutions = 0;
       } while (Mangled.nextIf("_TTS"));
 
       // Then check that we have a global.
@@ -339,24 +372,29 @@ public:
         return nullptr;
 
     } else if (Mangled.nextIf("To")) {
-      topLevel->addChild(NodeFactory::create(Node::Kind::ObjCAttribute));
+      topLevel->addChild(Factory.createNode(Node::Kind::ObjCAttribute),
+                         Factory);
     } else if (Mangled.nextIf("TO")) {
-      topLevel->addChild(NodeFactory::create(Node::Kind::NonObjCAttribute));
+      topLevel->addChild(Factory.createNode(Node::Kind::NonObjCAttribute),
+                         Factory);
     } else if (Mangled.nextIf("TD")) {
-      topLevel->addChild(NodeFactory::create(Node::Kind::DynamicAttribute));
+      topLevel->addChild(Factory.createNode(Node::Kind::DynamicAttribute),
+                         Factory);
     } else if (Mangled.nextIf("Td")) {
-      topLevel->addChild(NodeFactory::create(
-                                   Node::Kind::DirectMethodReferenceAttribute));
+      topLevel->addChild(Factory.createNode(
+                                   Node::Kind::DirectMethodReferenceAttribute),
+                         Factory);
     } else if (Mangled.nextIf("TV")) {
-      topLevel->addChild(NodeFactory::create(Node::Kind::VTableAttribute));
+      topLevel->addChild(Factory.createNode(Node::Kind::VTableAttribute),
+                         Factory);
     }
 
     DEMANGLE_CHILD_OR_RETURN(topLevel, Global);
 
     // Add a suffix node if there's anything left unmangled.
     if (!Mangled.isEmpty()) {
-      topLevel->addChild(NodeFactory::create(Node::Kind::Suffix,
-                                             Mangled.getString()));
+      topLevel->addChild(Factory.createNode(Node::Kind::Suffix,
+                                            Mangled.getString()), Factory);
     }
 
     return topLevel;
@@ -468,43 +506,43 @@ private:
     if (Mangled.nextIf('M')) {
       if (Mangled.nextIf('P')) {
         auto pattern =
-            NodeFactory::create(Node::Kind::GenericTypeMetadataPattern);
+            Factory.createNode(Node::Kind::GenericTypeMetadataPattern);
         DEMANGLE_CHILD_OR_RETURN(pattern, Type);
         return pattern;
       }
       if (Mangled.nextIf('a')) {
         auto accessor =
-          NodeFactory::create(Node::Kind::TypeMetadataAccessFunction);
+          Factory.createNode(Node::Kind::TypeMetadataAccessFunction);
         DEMANGLE_CHILD_OR_RETURN(accessor, Type);
         return accessor;
       }
       if (Mangled.nextIf('L')) {
-        auto cache = NodeFactory::create(Node::Kind::TypeMetadataLazyCache);
+        auto cache = Factory.createNode(Node::Kind::TypeMetadataLazyCache);
         DEMANGLE_CHILD_OR_RETURN(cache, Type);
         return cache;
       }
       if (Mangled.nextIf('m')) {
-        auto metaclass = NodeFactory::create(Node::Kind::Metaclass);
+        auto metaclass = Factory.createNode(Node::Kind::Metaclass);
         DEMANGLE_CHILD_OR_RETURN(metaclass, Type);
         return metaclass;
       }
       if (Mangled.nextIf('n')) {
         auto nominalType =
-            NodeFactory::create(Node::Kind::NominalTypeDescriptor);
+            Factory.createNode(Node::Kind::NominalTypeDescriptor);
         DEMANGLE_CHILD_OR_RETURN(nominalType, Type);
         return nominalType;
       }
       if (Mangled.nextIf('f')) {
-        auto metadata = NodeFactory::create(Node::Kind::FullTypeMetadata);
+        auto metadata = Factory.createNode(Node::Kind::FullTypeMetadata);
         DEMANGLE_CHILD_OR_RETURN(metadata, Type);
         return metadata;
       }
       if (Mangled.nextIf('p')) {
-        auto metadata = NodeFactory::create(Node::Kind::ProtocolDescriptor);
+        auto metadata = Factory.createNode(Node::Kind::ProtocolDescriptor);
         DEMANGLE_CHILD_OR_RETURN(metadata, ProtocolName);
         return metadata;
       }
-      auto metadata = NodeFactory::create(Node::Kind::TypeMetadata);
+      auto metadata = Factory.createNode(Node::Kind::TypeMetadata);
       DEMANGLE_CHILD_OR_RETURN(metadata, Type);
       return metadata;
     }
@@ -515,7 +553,7 @@ private:
       Node::Kind kind = Node::Kind::PartialApplyForwarder;
       if (Mangled.nextIf('o'))
         kind = Node::Kind::PartialApplyObjCForwarder;
-      auto forwarder = NodeFactory::create(kind);
+      auto forwarder = Factory.createNode(kind);
       if (Mangled.nextIf("__T"))
         DEMANGLE_CHILD_OR_RETURN(forwarder, Global);
       return forwarder;
@@ -523,7 +561,7 @@ private:
 
     // Top-level types, for various consumers.
     if (Mangled.nextIf('t')) {
-      auto type = NodeFactory::create(Node::Kind::TypeMangling);
+      auto type = Factory.createNode(Node::Kind::TypeMangling);
       DEMANGLE_CHILD_OR_RETURN(type, Type);
       return type;
     }
@@ -534,7 +572,7 @@ private:
       if (!w.hasValue())
         return nullptr;
       auto witness =
-        NodeFactory::create(Node::Kind::ValueWitness, unsigned(w.getValue()));
+        Factory.createNode(Node::Kind::ValueWitness, unsigned(w.getValue()));
       DEMANGLE_CHILD_OR_RETURN(witness, Type);
       return witness;
     }
@@ -542,69 +580,69 @@ private:
     // Offsets, value witness tables, and protocol witnesses.
     if (Mangled.nextIf('W')) {
       if (Mangled.nextIf('V')) {
-        auto witnessTable = NodeFactory::create(Node::Kind::ValueWitnessTable);
+        auto witnessTable = Factory.createNode(Node::Kind::ValueWitnessTable);
         DEMANGLE_CHILD_OR_RETURN(witnessTable, Type);
         return witnessTable;
       }
       if (Mangled.nextIf('o')) {
         auto witnessTableOffset =
-            NodeFactory::create(Node::Kind::WitnessTableOffset);
+            Factory.createNode(Node::Kind::WitnessTableOffset);
         DEMANGLE_CHILD_OR_RETURN(witnessTableOffset, Entity);
         return witnessTableOffset;
       }
       if (Mangled.nextIf('v')) {
-        auto fieldOffset = NodeFactory::create(Node::Kind::FieldOffset);
+        auto fieldOffset = Factory.createNode(Node::Kind::FieldOffset);
         DEMANGLE_CHILD_AS_NODE_OR_RETURN(fieldOffset, Directness);
         DEMANGLE_CHILD_OR_RETURN(fieldOffset, Entity);
         return fieldOffset;
       }
       if (Mangled.nextIf('P')) {
         auto witnessTable =
-            NodeFactory::create(Node::Kind::ProtocolWitnessTable);
+            Factory.createNode(Node::Kind::ProtocolWitnessTable);
         DEMANGLE_CHILD_OR_RETURN(witnessTable, ProtocolConformance);
         return witnessTable;
       }
       if (Mangled.nextIf('G')) {
         auto witnessTable =
-            NodeFactory::create(Node::Kind::GenericProtocolWitnessTable);
+            Factory.createNode(Node::Kind::GenericProtocolWitnessTable);
         DEMANGLE_CHILD_OR_RETURN(witnessTable, ProtocolConformance);
         return witnessTable;
       }
       if (Mangled.nextIf('I')) {
-        auto witnessTable = NodeFactory::create(
+        auto witnessTable = Factory.createNode(
             Node::Kind::GenericProtocolWitnessTableInstantiationFunction);
         DEMANGLE_CHILD_OR_RETURN(witnessTable, ProtocolConformance);
         return witnessTable;
       }
       if (Mangled.nextIf('l')) {
         auto accessor =
-          NodeFactory::create(Node::Kind::LazyProtocolWitnessTableAccessor);
+          Factory.createNode(Node::Kind::LazyProtocolWitnessTableAccessor);
         DEMANGLE_CHILD_OR_RETURN(accessor, Type);
         DEMANGLE_CHILD_OR_RETURN(accessor, ProtocolConformance);
         return accessor;
       }
       if (Mangled.nextIf('L')) {
         auto accessor =
-          NodeFactory::create(Node::Kind::LazyProtocolWitnessTableCacheVariable);
+          Factory.createNode(Node::Kind::LazyProtocolWitnessTableCacheVariable);
         DEMANGLE_CHILD_OR_RETURN(accessor, Type);
         DEMANGLE_CHILD_OR_RETURN(accessor, ProtocolConformance);
         return accessor;
       }
       if (Mangled.nextIf('a')) {
         auto tableTemplate =
-          NodeFactory::create(Node::Kind::ProtocolWitnessTableAccessor);
+          Factory.createNode(Node::Kind::ProtocolWitnessTableAccessor);
         DEMANGLE_CHILD_OR_RETURN(tableTemplate, ProtocolConformance);
         return tableTemplate;
       }
       if (Mangled.nextIf('t')) {
-        auto accessor = NodeFactory::create(
+        auto accessor = Factory.createNode(
             Node::Kind::AssociatedTypeMetadataAccessor);
         DEMANGLE_CHILD_OR_RETURN(accessor, ProtocolConformance);
         DEMANGLE_CHILD_OR_RETURN(accessor, DeclName);
         return accessor;
       }
       if (Mangled.nextIf('T')) {
-        auto accessor = NodeFactory::create(
+        auto accessor = Factory.createNode(
             Node::Kind::AssociatedTypeWitnessTableAccessor);
         DEMANGLE_CHILD_OR_RETURN(accessor, ProtocolConformance);
         DEMANGLE_CHILD_OR_RETURN(accessor, DeclName);
@@ -617,19 +655,19 @@ private:
     // Other thunks.
     if (Mangled.nextIf('T')) {
       if (Mangled.nextIf('R')) {
-        auto thunk = NodeFactory::create(Node::Kind::ReabstractionThunkHelper);
+        auto thunk = Factory.createNode(Node::Kind::ReabstractionThunkHelper);
         if (!demangleReabstractSignature(thunk))
           return nullptr;
         return thunk;
       }
       if (Mangled.nextIf('r')) {
-        auto thunk = NodeFactory::create(Node::Kind::ReabstractionThunk);
+        auto thunk = Factory.createNode(Node::Kind::ReabstractionThunk);
         if (!demangleReabstractSignature(thunk))
           return nullptr;
         return thunk;
       }
       if (Mangled.nextIf('W')) {
-        NodePointer thunk = NodeFactory::create(Node::Kind::ProtocolWitness);
+        NodePointer thunk = Factory.createNode(Node::Kind::ProtocolWitness);
         DEMANGLE_CHILD_OR_RETURN(thunk, ProtocolConformance);
         // The entity is mangled in its own generic context.
         DEMANGLE_CHILD_OR_RETURN(thunk, Entity);
@@ -645,7 +683,8 @@ private:
   NodePointer demangleGenericSpecialization(NodePointer specialization) {
     while (!Mangled.nextIf('_')) {
       // Otherwise, we have another parameter. Demangle the type.
-      NodePointer param = NodeFactory::create(Node::Kind::GenericSpecializationParam);
+      NodePointer param =
+        Factory.createNode(Node::Kind::GenericSpecializationParam);
       DEMANGLE_CHILD_OR_RETURN(param, Type);
 
       // Then parse any conformances until we find an underscore. Pop off the
@@ -655,7 +694,7 @@ private:
       }
 
       // Add the parameter to our specialization list.
-      specialization->addChild(param);
+      specialization->addChild(param, Factory);
     }
 
     return specialization;
@@ -663,11 +702,11 @@ private:
 
 /// TODO: This is an atrocity. Come up with a shorter name.
 #define FUNCSIGSPEC_CREATE_PARAM_KIND(kind)                                    \
-  NodeFactory::create(Node::Kind::FunctionSignatureSpecializationParamKind,    \
-                      unsigned(FunctionSigSpecializationParamKind::kind))
+  Factory.createNode(Node::Kind::FunctionSignatureSpecializationParamKind,     \
+                     unsigned(FunctionSigSpecializationParamKind::kind))
 #define FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(payload)                              \
-  NodeFactory::create(Node::Kind::FunctionSignatureSpecializationParamPayload, \
-                      payload)
+  Factory.createNode(Node::Kind::FunctionSignatureSpecializationParamPayload,  \
+                     payload)
 
   bool demangleFuncSigSpecializationConstantProp(NodePointer parent) {
     // Then figure out what was actually constant propagated. First check if
@@ -677,8 +716,10 @@ private:
       NodePointer name = demangleIdentifier();
       if (!name || !Mangled.nextIf('_'))
         return false;
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropFunction));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()));
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropFunction),
+                       Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()),
+                       Factory);
       return true;
     }
 
@@ -686,8 +727,10 @@ private:
       NodePointer name = demangleIdentifier();
       if (!name || !Mangled.nextIf('_'))
         return false;
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropGlobal));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()));
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropGlobal),
+                       Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()),
+                       Factory);
       return true;
     }
 
@@ -695,8 +738,9 @@ private:
       std::string Str;
       if (!Mangled.readUntil('_', Str) || !Mangled.nextIf('_'))
         return false;
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropInteger));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(Str));
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropInteger),
+                       Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(Str), Factory);
       return true;
     }
 
@@ -704,8 +748,9 @@ private:
       std::string Str;
       if (!Mangled.readUntil('_', Str) || !Mangled.nextIf('_'))
         return false;
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropFloat));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(Str));
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropFloat),
+                       Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(Str), Factory);
       return true;
     }
 
@@ -731,9 +776,11 @@ private:
       if (!str || !Mangled.nextIf('_'))
         return false;
 
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropString));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(encodingStr));
-      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(str->getText()));
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ConstantPropString),
+                       Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(encodingStr), Factory);
+      parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(str->getText()),
+                       Factory);
       return true;
     }
 
@@ -749,13 +796,14 @@ private:
       return false;
     }
 
-    parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ClosureProp));
-    parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()));
+    parent->addChild(FUNCSIGSPEC_CREATE_PARAM_KIND(ClosureProp), Factory);
+    parent->addChild(FUNCSIGSPEC_CREATE_PARAM_PAYLOAD(name->getText()),
+                     Factory);
 
     // Then demangle types until we fail.
-    NodePointer type;
+    NodePointer type = nullptr;
     while (Mangled.peek() != '_' && (type = demangleType())) {
-      parent->addChild(type);
+      parent->addChild(type, Factory);
     }
 
     // Eat last '_'
@@ -773,8 +821,8 @@ private:
     while (!Mangled.nextIf('_')) {
       // Create the parameter.
       NodePointer param =
-        NodeFactory::create(Node::Kind::FunctionSignatureSpecializationParam,
-                            paramCount);
+        Factory.createNode(Node::Kind::FunctionSignatureSpecializationParam,
+                           paramCount);
 
       // First handle options.
       if (Mangled.nextIf("n_")) {
@@ -789,12 +837,12 @@ private:
         auto result = FUNCSIGSPEC_CREATE_PARAM_KIND(BoxToValue);
         if (!result)
           return nullptr;
-        param->addChild(result);
+        param->addChild(result, Factory);
       } else if (Mangled.nextIf("k_")) {
         auto result = FUNCSIGSPEC_CREATE_PARAM_KIND(BoxToStack);
         if (!result)
           return nullptr;
-        param->addChild(result);
+        param->addChild(result, Factory);
       } else {
         // Otherwise handle option sets.
         unsigned Value = 0;
@@ -818,14 +866,14 @@ private:
         if (!Value)
           return nullptr;
 
-        auto result = NodeFactory::create(
+        auto result = Factory.createNode(
             Node::Kind::FunctionSignatureSpecializationParamKind, Value);
         if (!result)
           return nullptr;
-        param->addChild(result);
+        param->addChild(result, Factory);
       }
 
-      specialization->addChild(param);
+      specialization->addChild(param, Factory);
       paramCount++;
     }
 
@@ -838,36 +886,38 @@ private:
   NodePointer demangleSpecializedAttribute() {
     bool isNotReAbstracted = false;
     if (Mangled.nextIf("g") || (isNotReAbstracted = Mangled.nextIf("r"))) {
-      auto spec = NodeFactory::create(isNotReAbstracted ?
+      auto spec = Factory.createNode(isNotReAbstracted ?
                               Node::Kind::GenericSpecializationNotReAbstracted :
                               Node::Kind::GenericSpecialization);
 
       // Create a node if the specialization is externally inlineable.
       if (Mangled.nextIf("q")) {
         auto kind = Node::Kind::SpecializationIsFragile;
-        spec->addChild(NodeFactory::create(kind));
+        spec->addChild(Factory.createNode(kind), Factory);
       }
 
       // Create a node for the pass id.
-      spec->addChild(NodeFactory::create(Node::Kind::SpecializationPassID,
-                                         unsigned(Mangled.next() - 48)));
+      spec->addChild(Factory.createNode(Node::Kind::SpecializationPassID,
+                                        unsigned(Mangled.next() - 48)),
+                     Factory);
 
       // And then mangle the generic specialization.
       return demangleGenericSpecialization(spec);
     }
     if (Mangled.nextIf("f")) {
       auto spec =
-          NodeFactory::create(Node::Kind::FunctionSignatureSpecialization);
+          Factory.createNode(Node::Kind::FunctionSignatureSpecialization);
 
       // Create a node if the specialization is externally inlineable.
       if (Mangled.nextIf("q")) {
         auto kind = Node::Kind::SpecializationIsFragile;
-        spec->addChild(NodeFactory::create(kind));
+        spec->addChild(Factory.createNode(kind), Factory);
       }
 
       // Add the pass id.
-      spec->addChild(NodeFactory::create(Node::Kind::SpecializationPassID,
-                                         unsigned(Mangled.next() - 48)));
+      spec->addChild(Factory.createNode(Node::Kind::SpecializationPassID,
+                                        unsigned(Mangled.next() - 48)),
+                     Factory);
 
       // Then perform the function signature specialization.
       return demangleFunctionSignatureSpecialization(spec);
@@ -887,9 +937,9 @@ private:
       NodePointer name = demangleIdentifier();
       if (!name) return nullptr;
 
-      NodePointer localName = NodeFactory::create(Node::Kind::LocalDeclName);
-      localName->addChild(std::move(discriminator));
-      localName->addChild(std::move(name));
+      NodePointer localName = Factory.createNode(Node::Kind::LocalDeclName);
+      localName->addChild(std::move(discriminator), Factory);
+      localName->addChild(std::move(name), Factory);
       return localName;
 
     } else if (Mangled.nextIf('P')) {
@@ -899,8 +949,9 @@ private:
       NodePointer name = demangleIdentifier();
       if (!name) return nullptr;
 
-      auto privateName = NodeFactory::create(Node::Kind::PrivateDeclName);
-      privateName->addChildren(std::move(discriminator), std::move(name));
+      auto privateName = Factory.createNode(Node::Kind::PrivateDeclName);
+      privateName->addChildren(std::move(discriminator), std::move(name),
+                               Factory);
       return privateName;
     }
 
@@ -985,7 +1036,7 @@ private:
       identifier = opDecodeBuffer;
     }
     
-    return NodeFactory::create(*kind, identifier);
+    return Factory.createNode(*kind, identifier);
   }
 
   bool demangleIndex(Node::IndexType &natural) {
@@ -1007,24 +1058,38 @@ private:
     Node::IndexType index;
     if (!demangleIndex(index))
       return nullptr;
-    return NodeFactory::create(kind, index);
+    return Factory.createNode(kind, index);
   }
 
   NodePointer createSwiftType(Node::Kind typeKind, StringRef name) {
-    NodePointer type = NodeFactory::create(typeKind);
-    type->addChild(NodeFactory::create(Node::Kind::Module, STDLIB_NAME));
-    type->addChild(NodeFactory::create(Node::Kind::Identifier, name));
+    NodePointer type = Factory.createNode(typeKind);
+    type->addChild(Factory.createNode(Node::Kind::Module, STDLIB_NAME),
+                   Factory);
+    type->addChild(Factory.createNode(Node::Kind::Identifier, name), Factory);
     return type;
   }
 
+  void addSubstitution(NodePointer node) {
+    if (NumSubstitutions == ReservedSubstitutions) {
+      ReservedSubstitutions = ReservedSubstitutions ? ReservedSubstitutions * 2
+                                                    : 16;
+      auto newSubstitutions =
+        Factory.allocate<NodePointer>(ReservedSubstitutions);
+      for (size_t i = 0; i != NumSubstitutions; ++i)
+        newSubstitutions[i] = Substitutions[i];
+      Substitutions = newSubstitutions;
+    }
+    Substitutions[NumSubstitutions++] = node;
+  }
+
   /// Demangle a <substitution>, given that we've already consumed the 'S'.
   NodePointer demangleSubstitutionIndex() {
     if (!Mangled)
       return nullptr;
     if (Mangled.nextIf('o'))
-      return NodeFactory::create(Node::Kind::Module, MANGLING_MODULE_OBJC);
+      return Factory.createNode(Node::Kind::Module, MANGLING_MODULE_OBJC);
     if (Mangled.nextIf('C'))
-      return NodeFactory::create(Node::Kind::Module, MANGLING_MODULE_C);
+      return Factory.createNode(Node::Kind::Module, MANGLING_MODULE_C);
     if (Mangled.nextIf('a'))
       return createSwiftType(Node::Kind::Structure, "Array");
     if (Mangled.nextIf('b'))
@@ -1060,14 +1125,14 @@ private:
     Node::IndexType index_sub;
     if (!demangleIndex(index_sub))
       return nullptr;
-    if (index_sub >= Substitutions.size())
+    if (index_sub >= NumSubstitutions)
       return nullptr;
     return Substitutions[index_sub];
   }
 
   NodePointer demangleModule() {
     if (Mangled.nextIf('s')) {
-      return NodeFactory::create(Node::Kind::Module, STDLIB_NAME);
+      return Factory.createNode(Node::Kind::Module, STDLIB_NAME);
     }
     if (Mangled.nextIf('S')) {
       NodePointer module = demangleSubstitutionIndex();
@@ -1080,7 +1145,7 @@ private:
 
     NodePointer module = demangleIdentifier(Node::Kind::Module);
     if (!module) return nullptr;
-    Substitutions.push_back(module);
+    addSubstitution(module);
     return module;
   }
 
@@ -1091,10 +1156,10 @@ private:
     auto name = demangleDeclName();
     if (!name) return nullptr;
 
-    auto decl = NodeFactory::create(kind);
-    decl->addChild(context);
-    decl->addChild(name);
-    Substitutions.push_back(decl);
+    auto decl = Factory.createNode(kind);
+    decl->addChild(context, Factory);
+    decl->addChild(name, Factory);
+    addSubstitution(decl);
     return decl;
   }
 
@@ -1102,8 +1167,8 @@ private:
     NodePointer proto = demangleProtocolNameImpl();
     if (!proto) return nullptr;
 
-    NodePointer type = NodeFactory::create(Node::Kind::Type);
-    type->addChild(proto);
+    NodePointer type = Factory.createNode(Node::Kind::Type);
+    type->addChild(proto, Factory);
     return type;
   }
 
@@ -1111,10 +1176,10 @@ private:
     NodePointer name = demangleDeclName();
     if (!name) return nullptr;
 
-    auto proto = NodeFactory::create(Node::Kind::Protocol);
-    proto->addChild(std::move(context));
-    proto->addChild(std::move(name));
-    Substitutions.push_back(proto);
+    auto proto = Factory.createNode(Node::Kind::Protocol);
+    proto->addChild(std::move(context), Factory);
+    proto->addChild(std::move(name), Factory);
+    addSubstitution(proto);
     return proto;
   }
 
@@ -1136,7 +1201,7 @@ private:
     }
 
     if (Mangled.nextIf('s')) {
-      NodePointer stdlib = NodeFactory::create(Node::Kind::Module, STDLIB_NAME);
+      NodePointer stdlib = Factory.createNode(Node::Kind::Module, STDLIB_NAME);
 
       return demangleProtocolNameGivenContext(stdlib);
     }
@@ -1169,19 +1234,19 @@ private:
 
       // Rebuild this type with the new parent type, which may have
       // had its generic arguments applied.
-      NodePointer result = NodeFactory::create(nominalType->getKind());
-      result->addChild(parentOrModule);
-      result->addChild(nominalType->getChild(1));
+      NodePointer result = Factory.createNode(nominalType->getKind());
+      result->addChild(parentOrModule, Factory);
+      result->addChild(nominalType->getChild(1), Factory);
 
       nominalType = result;
     }
 
-    NodePointer args = NodeFactory::create(Node::Kind::TypeList);
+    NodePointer args = Factory.createNode(Node::Kind::TypeList);
     while (!Mangled.nextIf('_')) {
       NodePointer type = demangleType();
       if (!type)
         return nullptr;
-      args->addChild(type);
+      args->addChild(type, Factory);
       if (Mangled.isEmpty())
         return nullptr;
     }
@@ -1193,8 +1258,8 @@ private:
 
     // Otherwise, build a bound generic type node from the unbound
     // type and arguments.
-    NodePointer unboundType = NodeFactory::create(Node::Kind::Type);
-    unboundType->addChild(nominalType);
+    NodePointer unboundType = Factory.createNode(Node::Kind::Type);
+    unboundType->addChild(nominalType, Factory);
 
     Node::Kind kind;
     switch (nominalType->getKind()) { // look through Type node
@@ -1210,9 +1275,9 @@ private:
       default:
         return nullptr;
     }
-    NodePointer result = NodeFactory::create(kind);
-    result->addChild(unboundType);
-    result->addChild(args);
+    NodePointer result = Factory.createNode(kind);
+    result->addChild(unboundType, Factory);
+    result->addChild(args, Factory);
     return result;
   }
 
@@ -1235,17 +1300,17 @@ private:
     // context ::= 'e' module context generic-signature (constrained extension)
     if (!Mangled) return nullptr;
     if (Mangled.nextIf('E')) {
-      NodePointer ext = NodeFactory::create(Node::Kind::Extension);
+      NodePointer ext = Factory.createNode(Node::Kind::Extension);
       NodePointer def_module = demangleModule();
       if (!def_module) return nullptr;
       NodePointer type = demangleContext();
       if (!type) return nullptr;
-      ext->addChild(def_module);
-      ext->addChild(type);
+      ext->addChild(def_module, Factory);
+      ext->addChild(type, Factory);
       return ext;
     }
     if (Mangled.nextIf('e')) {
-      NodePointer ext = NodeFactory::create(Node::Kind::Extension);
+      NodePointer ext = Factory.createNode(Node::Kind::Extension);
       NodePointer def_module = demangleModule();
       if (!def_module) return nullptr;
       NodePointer sig = demangleGenericSignature();
@@ -1256,15 +1321,15 @@ private:
       NodePointer type = demangleContext();
       if (!type) return nullptr;
 
-      ext->addChild(def_module);
-      ext->addChild(type);
-      ext->addChild(sig);
+      ext->addChild(def_module, Factory);
+      ext->addChild(type, Factory);
+      ext->addChild(sig, Factory);
       return ext;
     }
     if (Mangled.nextIf('S'))
       return demangleSubstitutionIndex();
     if (Mangled.nextIf('s'))
-      return NodeFactory::create(Node::Kind::Module, STDLIB_NAME);
+      return Factory.createNode(Node::Kind::Module, STDLIB_NAME);
     if (Mangled.nextIf('G'))
       return demangleBoundGenericType();
     if (isStartOfEntity(Mangled.peek()))
@@ -1273,14 +1338,14 @@ private:
   }
   
   NodePointer demangleProtocolList() {
-    NodePointer proto_list = NodeFactory::create(Node::Kind::ProtocolList);
-    NodePointer type_list = NodeFactory::create(Node::Kind::TypeList);
-    proto_list->addChild(type_list);
+    NodePointer proto_list = Factory.createNode(Node::Kind::ProtocolList);
+    NodePointer type_list = Factory.createNode(Node::Kind::TypeList);
+    proto_list->addChild(type_list, Factory);
     while (!Mangled.nextIf('_')) {
       NodePointer proto = demangleProtocolName();
       if (!proto)
         return nullptr;
-      type_list->addChild(std::move(proto));
+      type_list->addChild(std::move(proto), Factory);
     }
     return proto_list;
   }
@@ -1296,10 +1361,10 @@ private:
     if (!context)
       return nullptr;
     NodePointer proto_conformance =
-        NodeFactory::create(Node::Kind::ProtocolConformance);
-    proto_conformance->addChild(type);
-    proto_conformance->addChild(protocol);
-    proto_conformance->addChild(context);
+        Factory.createNode(Node::Kind::ProtocolConformance);
+    proto_conformance->addChild(type, Factory);
+    proto_conformance->addChild(protocol, Factory);
+    proto_conformance->addChild(context, Factory);
     return proto_conformance;
   }
 
@@ -1329,7 +1394,7 @@ private:
     // entity-name
     Node::Kind entityKind;
     bool hasType = true;
-    NodePointer name;
+    NodePointer name = nullptr;
     if (Mangled.nextIf('D')) {
       entityKind = Node::Kind::Deallocator;
       hasType = false;
@@ -1425,20 +1490,20 @@ private:
       if (!name) return nullptr;
     }
 
-    NodePointer entity = NodeFactory::create(entityKind);
-    entity->addChild(context);
+    NodePointer entity = Factory.createNode(entityKind);
+    entity->addChild(context, Factory);
 
-    if (name) entity->addChild(name);
+    if (name) entity->addChild(name, Factory);
 
     if (hasType) {
       auto type = demangleType();
       if (!type) return nullptr;
-      entity->addChild(type);
+      entity->addChild(type, Factory);
     }
     
     if (isStatic) {
-      auto staticNode = NodeFactory::create(Node::Kind::Static);
-      staticNode->addChild(entity);
+      auto staticNode = Factory.createNode(Node::Kind::Static);
+      staticNode->addChild(entity, Factory);
       return staticNode;
     }
 
@@ -1447,10 +1512,10 @@ private:
 
   NodePointer demangleArchetypeRef(Node::IndexType depth, Node::IndexType i) {
     // FIXME: Name won't match demangled context generic signatures correctly.
-    auto ref = NodeFactory::create(Node::Kind::ArchetypeRef,
-                                   archetypeName(i, depth));
-    ref->addChild(NodeFactory::create(Node::Kind::Index, depth));
-    ref->addChild(NodeFactory::create(Node::Kind::Index, i));
+    auto ref = Factory.createNode(Node::Kind::ArchetypeRef,
+                                  archetypeName(i, depth));
+    ref->addChild(Factory.createNode(Node::Kind::Index, depth), Factory);
+    ref->addChild(Factory.createNode(Node::Kind::Index, i), Factory);
     return ref;
   }
 
@@ -1458,10 +1523,10 @@ private:
     DemanglerPrinter PrintName;
     PrintName << archetypeName(index, depth);
 
-    auto paramTy = NodeFactory::create(Node::Kind::DependentGenericParamType,
-                                       std::move(PrintName).str());
-    paramTy->addChild(NodeFactory::create(Node::Kind::Index, depth));
-    paramTy->addChild(NodeFactory::create(Node::Kind::Index, index));
+    auto paramTy = Factory.createNode(Node::Kind::DependentGenericParamType,
+                                      std::move(PrintName).str());
+    paramTy->addChild(Factory.createNode(Node::Kind::Index, depth), Factory);
+    paramTy->addChild(Factory.createNode(Node::Kind::Index, index), Factory);
 
     return paramTy;
   }
@@ -1490,7 +1555,7 @@ private:
   NodePointer demangleDependentMemberTypeName(NodePointer base) {
     assert(base->getKind() == Node::Kind::Type
            && "base should be a type");
-    NodePointer assocTy;
+    NodePointer assocTy = nullptr;
 
     if (Mangled.nextIf('S')) {
       assocTy = demangleSubstitutionIndex();
@@ -1509,14 +1574,14 @@ private:
       assocTy = demangleIdentifier(Node::Kind::DependentAssociatedTypeRef);
       if (!assocTy) return nullptr;
       if (protocol)
-        assocTy->addChild(protocol);
+        assocTy->addChild(protocol, Factory);
 
-      Substitutions.push_back(assocTy);
+      addSubstitution(assocTy);
     }
 
-    NodePointer depTy = NodeFactory::create(Node::Kind::DependentMemberType);
-    depTy->addChild(base);
-    depTy->addChild(assocTy);
+    NodePointer depTy = Factory.createNode(Node::Kind::DependentMemberType);
+    depTy->addChild(base, Factory);
+    depTy->addChild(assocTy, Factory);
     return depTy;
   }
 
@@ -1526,8 +1591,8 @@ private:
     if (!base)
       return nullptr;
 
-    NodePointer nodeType = NodeFactory::create(Node::Kind::Type);
-    nodeType->addChild(base);
+    NodePointer nodeType = Factory.createNode(Node::Kind::Type);
+    nodeType->addChild(base, Factory);
 
     // Demangle the associated type name.
     return demangleDependentMemberTypeName(nodeType);
@@ -1541,8 +1606,8 @@ private:
 
     // Demangle the associated type chain.
     while (!Mangled.nextIf('_')) {
-      NodePointer nodeType = NodeFactory::create(Node::Kind::Type);
-      nodeType->addChild(base);
+      NodePointer nodeType = Factory.createNode(Node::Kind::Type);
+      nodeType->addChild(base, Factory);
       
       base = demangleDependentMemberTypeName(nodeType);
       if (!base)
@@ -1585,14 +1650,14 @@ private:
     if (!type)
       return nullptr;
 
-    NodePointer nodeType = NodeFactory::create(Node::Kind::Type);
-    nodeType->addChild(type);
+    NodePointer nodeType = Factory.createNode(Node::Kind::Type);
+    nodeType->addChild(type, Factory);
     return nodeType;
   }
 
   NodePointer demangleGenericSignature(bool isPseudogeneric = false) {
     auto sig =
-      NodeFactory::create(isPseudogeneric
+      Factory.createNode(isPseudogeneric
                             ? Node::Kind::DependentPseudogenericSignature
                             : Node::Kind::DependentGenericSignature);
     // First read in the parameter counts at each depth.
@@ -1600,8 +1665,8 @@ private:
     
     auto addCount = [&]{
       auto countNode =
-        NodeFactory::create(Node::Kind::DependentGenericParamCount, count);
-      sig->addChild(countNode);
+        Factory.createNode(Node::Kind::DependentGenericParamCount, count);
+      sig->addChild(countNode, Factory);
     };
     
     while (Mangled.peek() != 'R' && Mangled.peek() != 'r') {
@@ -1631,7 +1696,7 @@ private:
     while (!Mangled.nextIf('r')) {
       NodePointer reqt = demangleGenericRequirement();
       if (!reqt) return nullptr;
-      sig->addChild(reqt);
+      sig->addChild(reqt, Factory);
     }
     
     return sig;
@@ -1639,14 +1704,14 @@ private:
 
   NodePointer demangleMetatypeRepresentation() {
     if (Mangled.nextIf('t'))
-      return NodeFactory::create(Node::Kind::MetatypeRepresentation, "@thin");
+      return Factory.createNode(Node::Kind::MetatypeRepresentation, "@thin");
 
     if (Mangled.nextIf('T'))
-      return NodeFactory::create(Node::Kind::MetatypeRepresentation, "@thick");
+      return Factory.createNode(Node::Kind::MetatypeRepresentation, "@thick");
 
     if (Mangled.nextIf('o'))
-      return NodeFactory::create(Node::Kind::MetatypeRepresentation,
-                                 "@objc_metatype");
+      return Factory.createNode(Node::Kind::MetatypeRepresentation,
+                                "@objc_metatype");
 
     unreachable("Unhandled metatype representation");
   }
@@ -1658,10 +1723,10 @@ private:
     if (Mangled.nextIf('z')) {
       NodePointer second = demangleType();
       if (!second) return nullptr;
-      auto reqt = NodeFactory::create(
+      auto reqt = Factory.createNode(
           Node::Kind::DependentGenericSameTypeRequirement);
-      reqt->addChild(constrainedType);
-      reqt->addChild(second);
+      reqt->addChild(constrainedType, Factory);
+      reqt->addChild(second, Factory);
       return reqt;
     }
 
@@ -1669,7 +1734,7 @@ private:
     // will begin with either 'C' or 'S'.
     if (!Mangled)
       return nullptr;
-    NodePointer constraint;
+    NodePointer constraint = nullptr;
 
     auto next = Mangled.peek();
 
@@ -1679,7 +1744,7 @@ private:
     } else if (next == 'S') {
       // A substitution may be either the module name of a protocol or a full
       // type name.
-      NodePointer typeName;
+      NodePointer typeName = nullptr;
       Mangled.next();
       NodePointer sub = demangleSubstitutionIndex();
       if (!sub) return nullptr;
@@ -1693,35 +1758,35 @@ private:
       } else {
         return nullptr;
       }
-      constraint = NodeFactory::create(Node::Kind::Type);
-      constraint->addChild(typeName);
+      constraint = Factory.createNode(Node::Kind::Type);
+      constraint->addChild(typeName, Factory);
     } else {
       constraint = demangleProtocolName();
       if (!constraint)
         return nullptr;
     }
-    auto reqt = NodeFactory::create(
+    auto reqt = Factory.createNode(
                           Node::Kind::DependentGenericConformanceRequirement);
-    reqt->addChild(constrainedType);
-    reqt->addChild(constraint);
+    reqt->addChild(constrainedType, Factory);
+    reqt->addChild(constraint, Factory);
     return reqt;
   }
   
   NodePointer demangleArchetypeType() {
     auto makeSelfType = [&](NodePointer proto) -> NodePointer {
-      auto selfType = NodeFactory::create(Node::Kind::SelfTypeRef);
-      selfType->addChild(proto);
-      Substitutions.push_back(selfType);
+      auto selfType = Factory.createNode(Node::Kind::SelfTypeRef);
+      selfType->addChild(proto, Factory);
+      addSubstitution(selfType);
       return selfType;
     };
     
     auto makeAssociatedType = [&](NodePointer root) -> NodePointer {
       NodePointer name = demangleIdentifier();
       if (!name) return nullptr;
-      auto assocType = NodeFactory::create(Node::Kind::AssociatedTypeRef);
-      assocType->addChild(root);
-      assocType->addChild(name);
-      Substitutions.push_back(assocType);
+      auto assocType = Factory.createNode(Node::Kind::AssociatedTypeRef);
+      assocType->addChild(root, Factory);
+      assocType->addChild(name, Factory);
+      addSubstitution(assocType);
       return assocType;
     };
     
@@ -1745,7 +1810,7 @@ private:
         return makeAssociatedType(sub);
     }
     if (Mangled.nextIf('s')) {
-      NodePointer stdlib = NodeFactory::create(Node::Kind::Module, STDLIB_NAME);
+      NodePointer stdlib = Factory.createNode(Node::Kind::Module, STDLIB_NAME);
       return makeAssociatedType(stdlib);
     }
     if (Mangled.nextIf('d')) {
@@ -1760,14 +1825,14 @@ private:
       NodePointer index = demangleIndexAsNode();
       if (!index)
         return nullptr;
-      NodePointer decl_ctx = NodeFactory::create(Node::Kind::DeclContext);
+      NodePointer decl_ctx = Factory.createNode(Node::Kind::DeclContext);
       NodePointer ctx = demangleContext();
       if (!ctx)
         return nullptr;
-      decl_ctx->addChild(ctx);
-      auto qual_atype = NodeFactory::create(Node::Kind::QualifiedArchetype);
-      qual_atype->addChild(index);
-      qual_atype->addChild(decl_ctx);
+      decl_ctx->addChild(ctx, Factory);
+      auto qual_atype = Factory.createNode(Node::Kind::QualifiedArchetype);
+      qual_atype->addChild(index, Factory);
+      qual_atype->addChild(decl_ctx, Factory);
       return qual_atype;
     }
     Node::IndexType index;
@@ -1777,34 +1842,34 @@ private:
   }
 
   NodePointer demangleTuple(IsVariadic isV) {
-    NodePointer tuple = NodeFactory::create(
+    NodePointer tuple = Factory.createNode(
         isV == IsVariadic::yes ? Node::Kind::VariadicTuple
                                : Node::Kind::NonVariadicTuple);
     while (!Mangled.nextIf('_')) {
       if (!Mangled)
         return nullptr;
-      NodePointer elt = NodeFactory::create(Node::Kind::TupleElement);
+      NodePointer elt = Factory.createNode(Node::Kind::TupleElement);
 
       if (isStartOfIdentifier(Mangled.peek())) {
         NodePointer label = demangleIdentifier(Node::Kind::TupleElementName);
         if (!label)
           return nullptr;
-        elt->addChild(label);
+        elt->addChild(label, Factory);
       }
 
       NodePointer type = demangleType();
       if (!type)
         return nullptr;
-      elt->addChild(type);
+      elt->addChild(type, Factory);
 
-      tuple->addChild(elt);
+      tuple->addChild(elt, Factory);
     }
     return tuple;
   }
   
   NodePointer postProcessReturnTypeNode (NodePointer out_args) {
-    NodePointer out_node = NodeFactory::create(Node::Kind::ReturnType);
-    out_node->addChild(out_args);
+    NodePointer out_node = Factory.createNode(Node::Kind::ReturnType);
+    out_node->addChild(out_args, Factory);
     return out_node;
   }
 
@@ -1812,8 +1877,8 @@ private:
     NodePointer type = demangleTypeImpl();
     if (!type)
       return nullptr;
-    NodePointer nodeType = NodeFactory::create(Node::Kind::Type);
-    nodeType->addChild(type);
+    NodePointer nodeType = Factory.createNode(Node::Kind::Type);
+    nodeType->addChild(type, Factory);
     return nodeType;
   }
   
@@ -1829,16 +1894,17 @@ private:
     NodePointer out_args = demangleType();
     if (!out_args)
       return nullptr;
-    NodePointer block = NodeFactory::create(kind);
+    NodePointer block = Factory.createNode(kind);
     
     if (throws) {
-      block->addChild(NodeFactory::create(Node::Kind::ThrowsAnnotation));
+      block->addChild(Factory.createNode(Node::Kind::ThrowsAnnotation),
+                      Factory);
     }
     
-    NodePointer in_node = NodeFactory::create(Node::Kind::ArgumentTuple);
-    block->addChild(in_node);
-    in_node->addChild(in_args);
-    block->addChild(postProcessReturnTypeNode(out_args));
+    NodePointer in_node = Factory.createNode(Node::Kind::ArgumentTuple);
+    block->addChild(in_node, Factory);
+    in_node->addChild(in_args, Factory);
+    block->addChild(postProcessReturnTypeNode(out_args), Factory);
     return block;
   }
   
@@ -1851,15 +1917,15 @@ private:
         return nullptr;
       c = Mangled.next();
       if (c == 'b')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.BridgeObject");
       if (c == 'B')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.UnsafeValueBuffer");
       if (c == 'f') {
         Node::IndexType size;
         if (demangleBuiltinSize(size)) {
-          return NodeFactory::create(
+          return Factory.createNode(
               Node::Kind::BuiltinTypeName,
               std::move(DemanglerPrinter() << "Builtin.Float" << size).str());
         }
@@ -1867,7 +1933,7 @@ private:
       if (c == 'i') {
         Node::IndexType size;
         if (demangleBuiltinSize(size)) {
-          return NodeFactory::create(
+          return Factory.createNode(
               Node::Kind::BuiltinTypeName,
               (DemanglerPrinter() << "Builtin.Int" << size).str());
         }
@@ -1881,7 +1947,7 @@ private:
             Node::IndexType size;
             if (!demangleBuiltinSize(size))
               return nullptr;
-            return NodeFactory::create(
+            return Factory.createNode(
                 Node::Kind::BuiltinTypeName,
                 (DemanglerPrinter() << "Builtin.Vec" << elts << "xInt" << size)
                     .str());
@@ -1890,29 +1956,29 @@ private:
             Node::IndexType size;
             if (!demangleBuiltinSize(size))
               return nullptr;
-            return NodeFactory::create(
+            return Factory.createNode(
                 Node::Kind::BuiltinTypeName,
                 (DemanglerPrinter() << "Builtin.Vec" << elts << "xFloat"
                                     << size).str());
           }
           if (Mangled.nextIf('p'))
-            return NodeFactory::create(
+            return Factory.createNode(
                 Node::Kind::BuiltinTypeName,
                 (DemanglerPrinter() << "Builtin.Vec" << elts << "xRawPointer")
                     .str());
         }
       }
       if (c == 'O')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.UnknownObject");
       if (c == 'o')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.NativeObject");
       if (c == 'p')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.RawPointer");
       if (c == 'w')
-        return NodeFactory::create(Node::Kind::BuiltinTypeName,
+        return Factory.createNode(Node::Kind::BuiltinTypeName,
                                      "Builtin.Word");
       return nullptr;
     }
@@ -1930,8 +1996,8 @@ private:
       if (!type)
         return nullptr;
 
-      NodePointer dynamicSelf = NodeFactory::create(Node::Kind::DynamicSelf);
-      dynamicSelf->addChild(type);
+      NodePointer dynamicSelf = Factory.createNode(Node::Kind::DynamicSelf);
+      dynamicSelf->addChild(type, Factory);
       return dynamicSelf;
     }
     if (c == 'E') {
@@ -1939,7 +2005,7 @@ private:
         return nullptr;
       if (!Mangled.nextIf('R'))
         return nullptr;
-      return NodeFactory::create(Node::Kind::ErrorType, std::string());
+      return Factory.createNode(Node::Kind::ErrorType, std::string());
     }
     if (c == 'F') {
       return demangleFunctionType(Node::Kind::FunctionType);
@@ -1955,8 +2021,8 @@ private:
         NodePointer type = demangleType();
         if (!type)
           return nullptr;
-        NodePointer boxType = NodeFactory::create(Node::Kind::SILBoxType);
-        boxType->addChild(type);
+        NodePointer boxType = Factory.createNode(Node::Kind::SILBoxType);
+        boxType->addChild(type, Factory);
         return boxType;
       }
     }
@@ -1967,8 +2033,8 @@ private:
       NodePointer type = demangleType();
       if (!type)
         return nullptr;
-      NodePointer metatype = NodeFactory::create(Node::Kind::Metatype);
-      metatype->addChild(type);
+      NodePointer metatype = Factory.createNode(Node::Kind::Metatype);
+      metatype->addChild(type, Factory);
       return metatype;
     }
     if (c == 'X') {
@@ -1979,9 +2045,9 @@ private:
         NodePointer type = demangleType();
         if (!type)
           return nullptr;
-        NodePointer metatype = NodeFactory::create(Node::Kind::Metatype);
-        metatype->addChild(metatypeRepr);
-        metatype->addChild(type);
+        NodePointer metatype = Factory.createNode(Node::Kind::Metatype);
+        metatype->addChild(metatypeRepr, Factory);
+        metatype->addChild(type, Factory);
         return metatype;
       }
     }
@@ -1989,8 +2055,8 @@ private:
       if (Mangled.nextIf('M')) {
         NodePointer type = demangleType();
         if (!type) return nullptr;
-        auto metatype = NodeFactory::create(Node::Kind::ExistentialMetatype);
-        metatype->addChild(type);
+        auto metatype = Factory.createNode(Node::Kind::ExistentialMetatype);
+        metatype->addChild(type, Factory);
         return metatype;
       }
 
@@ -2006,9 +2072,9 @@ private:
           NodePointer type = demangleType();
           if (!type) return nullptr;
 
-          auto metatype = NodeFactory::create(Node::Kind::ExistentialMetatype);
-          metatype->addChild(metatypeRepr);
-          metatype->addChild(type);
+          auto metatype = Factory.createNode(Node::Kind::ExistentialMetatype);
+          metatype->addChild(metatypeRepr, Factory);
+          metatype->addChild(type, Factory);
           return metatype;
         }
 
@@ -2032,11 +2098,11 @@ private:
       return demangleAssociatedTypeCompound();
     }
     if (c == 'R') {
-      NodePointer inout = NodeFactory::create(Node::Kind::InOut);
+      NodePointer inout = Factory.createNode(Node::Kind::InOut);
       NodePointer type = demangleTypeImpl();
       if (!type)
         return nullptr;
-      inout->addChild(type);
+      inout->addChild(type, Factory);
       return inout;
     }
     if (c == 'S') {
@@ -2054,9 +2120,9 @@ private:
       NodePointer sub = demangleType();
       if (!sub) return nullptr;
       NodePointer dependentGenericType
-        = NodeFactory::create(Node::Kind::DependentGenericType);
-      dependentGenericType->addChild(sig);
-      dependentGenericType->addChild(sub);
+        = Factory.createNode(Node::Kind::DependentGenericType);
+      dependentGenericType->addChild(sig, Factory);
+      dependentGenericType->addChild(sub, Factory);
       return dependentGenericType;
     }
     if (c == 'X') {
@@ -2067,24 +2133,24 @@ private:
         NodePointer type = demangleType();
         if (!type)
           return nullptr;
-        NodePointer unowned = NodeFactory::create(Node::Kind::Unowned);
-        unowned->addChild(type);
+        NodePointer unowned = Factory.createNode(Node::Kind::Unowned);
+        unowned->addChild(type, Factory);
         return unowned;
       }
       if (Mangled.nextIf('u')) {
         NodePointer type = demangleType();
         if (!type)
           return nullptr;
-        NodePointer unowned = NodeFactory::create(Node::Kind::Unmanaged);
-        unowned->addChild(type);
+        NodePointer unowned = Factory.createNode(Node::Kind::Unmanaged);
+        unowned->addChild(type, Factory);
         return unowned;
       }
       if (Mangled.nextIf('w')) {
         NodePointer type = demangleType();
         if (!type)
           return nullptr;
-        NodePointer weak = NodeFactory::create(Node::Kind::Weak);
-        weak->addChild(type);
+        NodePointer weak = Factory.createNode(Node::Kind::Weak);
+        weak->addChild(type, Factory);
         return weak;
       }
 
@@ -2104,16 +2170,16 @@ private:
     if (Mangled.nextIf('G')) {
       NodePointer generics = demangleGenericSignature();
       if (!generics) return false;
-      signature->addChild(std::move(generics));
+      signature->addChild(std::move(generics), Factory);
     }
 
     NodePointer srcType = demangleType();
     if (!srcType) return false;
-    signature->addChild(std::move(srcType));
+    signature->addChild(std::move(srcType), Factory);
 
     NodePointer destType = demangleType();
     if (!destType) return false;
-    signature->addChild(std::move(destType));
+    signature->addChild(std::move(destType), Factory);
 
     return true;
   }
@@ -2127,7 +2193,7 @@ private:
   // impl-function-attribute ::= 'Cw'            // compatible with protocol witness
   // impl-function-attribute ::= 'G'             // generic
   NodePointer demangleImplFunctionType() {
-    NodePointer type = NodeFactory::create(Node::Kind::ImplFunctionType);
+    NodePointer type = Factory.createNode(Node::Kind::ImplFunctionType);
 
     if (!demangleImplCalleeConvention(type))
       return nullptr;
@@ -2155,7 +2221,7 @@ private:
       NodePointer generics = demangleGenericSignature(isPseudogeneric);
       if (!generics)
         return nullptr;
-      type->addChild(generics);
+      type->addChild(generics, Factory);
     }
 
     // Expect the attribute terminator.
@@ -2221,13 +2287,14 @@ private:
     if (attr.empty()) {
       return false;
     }
-    type->addChild(NodeFactory::create(Node::Kind::ImplConvention, attr));
+    type->addChild(Factory.createNode(Node::Kind::ImplConvention, attr),
+                   Factory);
     return true;
   }
 
   void addImplFunctionAttribute(NodePointer parent, StringRef attr,
                          Node::Kind kind = Node::Kind::ImplFunctionAttribute) {
-    parent->addChild(NodeFactory::create(kind, attr));
+    parent->addChild(Factory.createNode(kind, attr), Factory);
   }
 
   // impl-parameter ::= impl-convention type
@@ -2235,7 +2302,7 @@ private:
     while (!Mangled.nextIf('_')) {
       auto input = demangleImplParameterOrResult(Node::Kind::ImplParameter);
       if (!input) return false;
-      parent->addChild(input);
+      parent->addChild(input, Factory);
     }
     return true;
   }
@@ -2245,7 +2312,7 @@ private:
     while (!Mangled.nextIf('_')) {
       auto res = demangleImplParameterOrResult(Node::Kind::ImplResult);
       if (!res) return false;
-      parent->addChild(res);
+      parent->addChild(res, Factory);
     }
     return true;
   }
@@ -2273,10 +2340,10 @@ private:
     auto type = demangleType();
     if (!type) return nullptr;
 
-    NodePointer node = NodeFactory::create(kind);
-    node->addChild(NodeFactory::create(Node::Kind::ImplConvention,
-                                       convention));
-    node->addChild(type);
+    NodePointer node = Factory.createNode(kind);
+    node->addChild(Factory.createNode(Node::Kind::ImplConvention,
+                                      convention), Factory);
+    node->addChild(type, Factory);
     
     return node;
   }
@@ -2286,16 +2353,18 @@ private:
 NodePointer
 swift::Demangle::demangleSymbolAsNode(const char *MangledName,
                                       size_t MangledNameLength,
+                                      NodeFactory &Factory,
                                       const DemangleOptions &Options) {
-  Demangler demangler(StringRef(MangledName, MangledNameLength));
+  Demangler demangler(StringRef(MangledName, MangledNameLength), Factory);
   return demangler.demangleTopLevel();
 }
 
 NodePointer
 swift::Demangle::demangleTypeAsNode(const char *MangledName,
                                     size_t MangledNameLength,
+                                    NodeFactory &Factory,
                                     const DemangleOptions &Options) {
-  Demangler demangler(StringRef(MangledName, MangledNameLength));
+  Demangler demangler(StringRef(MangledName, MangledNameLength), Factory);
   return demangler.demangleTypeName();
 }
 
@@ -2724,8 +2793,9 @@ unsigned NodePrinter::printFunctionSigSpecializationParam(NodePointer pointer,
     Printer << "[";
     print(pointer->getChild(Idx++));
     Printer << " : ";
-    const auto &text = pointer->getChild(Idx++)->getText();
-    std::string demangledName = demangleSymbolAsString(text);
+    StringRef text = pointer->getChild(Idx++)->getText();
+    std::string demangledName = demangleSymbolAsString(text.data(),
+                                                       text.size());
     if (demangledName.empty()) {
       Printer << text;
     } else {
@@ -2864,7 +2934,7 @@ void NodePrinter::printSimplifiedEntityType(NodePointer context,
   assert(type->getKind() == Node::Kind::Type);
   type = type->getChild(0);
 
-  NodePointer generics;
+  NodePointer generics = nullptr;
   if (type->getKind() == Node::Kind::DependentGenericType) {
     generics = type->getChild(0);
     type = type->getChild(1)->getChild(0);
@@ -3164,7 +3234,9 @@ void NodePrinter::print(NodePointer pointer, bool asContext, bool suppressType)
     return;
   }
   case Node::Kind::FunctionSignatureSpecializationParamPayload: {
-    std::string demangledName = demangleSymbolAsString(pointer->getText());
+    StringRef text = pointer->getText();
+    std::string demangledName = demangleSymbolAsString(text.data(),
+                                                       text.size());
     if (demangledName.empty()) {
       Printer << pointer->getText();
     } else {
@@ -3702,10 +3774,12 @@ std::string Demangle::demangleSymbolAsString(const char *MangledName,
                                              size_t MangledNameLength,
                                              const DemangleOptions &Options) {
   auto mangled = StringRef(MangledName, MangledNameLength);
-  auto root = demangleSymbolAsNode(MangledName, MangledNameLength, Options);
+  NodeFactory Factory;
+  auto root = demangleSymbolAsNode(MangledName, MangledNameLength, Factory,
+                                   Options);
   if (!root) return mangled.str();
 
-  std::string demangling = nodeToString(std::move(root), Options);
+  std::string demangling = nodeToString(root, Options);
   if (demangling.empty())
     return mangled.str();
   return demangling;
@@ -3715,10 +3789,12 @@ std::string Demangle::demangleTypeAsString(const char *MangledName,
                                            size_t MangledNameLength,
                                            const DemangleOptions &Options) {
   auto mangled = StringRef(MangledName, MangledNameLength);
-  auto root = demangleTypeAsNode(MangledName, MangledNameLength, Options);
+  NodeFactory Factory;
+  auto root = demangleTypeAsNode(MangledName, MangledNameLength, Factory,
+                                 Options);
   if (!root) return mangled.str();
   
-  std::string demangling = nodeToString(std::move(root), Options);
+  std::string demangling = nodeToString(root, Options);
   if (demangling.empty())
     return mangled.str();
   return demangling;
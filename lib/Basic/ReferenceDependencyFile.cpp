@@ -0,0 +1,246 @@
+//===--- ReferenceDependencyFile.cpp - Read and write .swiftdeps ----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Basic/ReferenceDependencyFile.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+
+using namespace swift;
+using namespace swift::binary_swiftdeps;
+
+StringRef
+swift::getReferenceDependencySectionName(ReferenceDependencySection section) {
+  switch (section) {
+  case ReferenceDependencySection::ProvidesTopLevel:
+    return "provides-top-level";
+  case ReferenceDependencySection::ProvidesNominal:
+    return "provides-nominal";
+  case ReferenceDependencySection::ProvidesMember:
+    return "provides-member";
+  case ReferenceDependencySection::ProvidesDynamicLookup:
+    return "provides-dynamic-lookup";
+  case ReferenceDependencySection::DependsTopLevel:
+    return "depends-top-level";
+  case ReferenceDependencySection::DependsMember:
+    return "depends-member";
+  case ReferenceDependencySection::DependsNominal:
+    return "depends-nominal";
+  case ReferenceDependencySection::DependsDynamicLookup:
+    return "depends-dynamic-lookup";
+  case ReferenceDependencySection::DependsExternal:
+    return "depends-external";
+  }
+  llvm_unreachable("unhandled section");
+}
+
+uint32_t ReferenceDependencyFileWriter::intern(StringRef string) {
+  auto insertResult = StringIndices.insert({string, uint32_t(Strings.size())});
+  if (insertResult.second)
+    Strings.push_back(insertResult.first->getKey());
+  return insertResult.first->getValue();
+}
+
+void ReferenceDependencyFileWriter::addEntry(ReferenceDependencySection section,
+                                             StringRef name,
+                                             bool isCascading,
+                                             StringRef fingerprint) {
+  assert(!isMemberSection(section) && "use addMemberEntry");
+  addSection(section);
+  Entries.push_back({section, intern(name)});
+  EntryIsCascading.push_back(isCascading);
+  addFingerprint(fingerprint);
+}
+
+void
+ReferenceDependencyFileWriter::addMemberEntry(ReferenceDependencySection section,
+                                              StringRef typeName,
+                                              StringRef memberName,
+                                              bool isCascading,
+                                              StringRef fingerprint) {
+  assert(isMemberSection(section) && "use addEntry");
+  addSection(section);
+
+  // Store the pair the way the driver's dependency graph keys it.
+  SmallString<64> name;
+  name += typeName;
+  name.push_back('\0');
+  name += memberName;
+  Entries.push_back({section, intern(name)});
+  EntryIsCascading.push_back(isCascading);
+  addFingerprint(fingerprint);
+}
+
+void ReferenceDependencyFileWriter::addFingerprint(StringRef fingerprint) {
+  if (fingerprint.empty()) {
+    EntryFingerprints.push_back(NoString);
+    return;
+  }
+  EntryFingerprints.push_back(intern(fingerprint));
+  HasFingerprints = true;
+}
+
+void ReferenceDependencyFileWriter::writeYAML(raw_ostream &out) const {
+  out << "### Swift dependencies file v0 ###\n";
+
+  for (unsigned i = 0; i != NumReferenceDependencySections; ++i) {
+    auto section = ReferenceDependencySection(i);
+    if (!(Sections & (1U << i)))
+      continue;
+
+    out << getReferenceDependencySectionName(section) << ":\n";
+    for (size_t j = 0, e = Entries.size(); j != e; ++j) {
+      if (Entries[j].first != section)
+        continue;
+      StringRef name = Strings[Entries[j].second];
+      out << "- ";
+      if (!EntryIsCascading[j])
+        out << "!private ";
+
+      // An entry with a fingerprint is written as a sequence, with the
+      // fingerprint last.
+      bool hasFingerprint = EntryFingerprints[j] != NoString;
+      if (isMemberSection(section)) {
+        auto split = name.split('\0');
+        out << "[\"" << llvm::yaml::escape(split.first) << "\", \""
+            << llvm::yaml::escape(split.second) << "\"";
+      } else {
+        if (hasFingerprint)
+          out << "[";
+        out << "\"" << llvm::yaml::escape(name) << "\"";
+      }
+      if (hasFingerprint)
+        out << ", \"" << Strings[EntryFingerprints[j]] << "\"";
+      if (isMemberSection(section) || hasFingerprint)
+        out << "]";
+      out << "\n";
+    }
+  }
+
+  if (InterfaceHash != NoString)
+    out << "interface-hash: \"" << Strings[InterfaceHash] << "\"\n";
+}
+
+void ReferenceDependencyFileWriter::writeBinary(raw_ostream &out) const {
+  uint32_t stringDataSize = 0;
+  for (StringRef string : Strings)
+    stringDataSize += string.size();
+
+  binary_swiftdeps::Header header;
+  memcpy(header.Magic, Magic, sizeof(Magic));
+  header.MajorVersion = binary_swiftdeps::MajorVersion;
+  header.MinorVersion = binary_swiftdeps::MinorVersion;
+  header.Sections = Sections;
+  header.NumStrings = Strings.size();
+  header.NumEntries = Entries.size();
+  header.StringDataSize = stringDataSize;
+  header.InterfaceHash = InterfaceHash;
+  header.NumFingerprints = HasFingerprints ? Entries.size() : 0;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  StringOffset offset;
+  offset = 0;
+  out.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  for (StringRef string : Strings) {
+    offset = offset + string.size();
+    out.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  }
+
+  for (size_t i = 0, e = Entries.size(); i != e; ++i) {
+    assert(Entries[i].second <= EntryNameMask && "too many strings");
+    EntryRecord record;
+    record = (uint32_t(Entries[i].first) << EntrySectionShift) |
+             (EntryIsCascading[i] ? 0 : EntryIsPrivateBit) |
+             Entries[i].second;
+    out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  }
+
+  if (HasFingerprints) {
+    for (uint32_t fingerprint : EntryFingerprints) {
+      FingerprintRecord record;
+      record = fingerprint;
+      out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+  }
+
+  for (StringRef string : Strings)
+    out << string;
+}
+
+bool BinaryReferenceDependencyFile::isBinary(StringRef data) {
+  return data.size() >= sizeof(Magic) &&
+         memcmp(data.data(), Magic, sizeof(Magic)) == 0;
+}
+
+bool BinaryReferenceDependencyFile::init(StringRef data) {
+  if (data.size() < sizeof(binary_swiftdeps::Header) || !isBinary(data))
+    return false;
+  auto header = reinterpret_cast<const binary_swiftdeps::Header *>(data.data());
+  if (header->MajorVersion != binary_swiftdeps::MajorVersion)
+    return false;
+
+  // Compute the table sizes in 64 bits so that a corrupt header can't make
+  // them wrap around.
+  uint64_t numStrings = header->NumStrings;
+  uint64_t numEntries = header->NumEntries;
+  uint64_t numFingerprints = header->NumFingerprints;
+  uint64_t stringDataSize = header->StringDataSize;
+  uint64_t stringOffsetsOffset = sizeof(binary_swiftdeps::Header);
+  uint64_t entryRecordsOffset =
+    stringOffsetsOffset + (numStrings + 1) * sizeof(StringOffset);
+  uint64_t fingerprintRecordsOffset =
+    entryRecordsOffset + numEntries * sizeof(EntryRecord);
+  uint64_t stringDataOffset =
+    fingerprintRecordsOffset + numFingerprints * sizeof(FingerprintRecord);
+  if (numFingerprints != 0 && numFingerprints != numEntries)
+    return false;
+  if (stringDataOffset + stringDataSize > data.size())
+    return false;
+
+  auto stringOffsets = reinterpret_cast<const StringOffset *>(
+    data.data() + stringOffsetsOffset);
+  if (stringOffsets[0] != 0 || stringOffsets[numStrings] != stringDataSize)
+    return false;
+  for (uint64_t i = 0; i != numStrings; ++i) {
+    if (stringOffsets[i] > stringOffsets[i + 1])
+      return false;
+  }
+
+  auto entryRecords = reinterpret_cast<const EntryRecord *>(
+    data.data() + entryRecordsOffset);
+  for (uint64_t i = 0; i != numEntries; ++i) {
+    uint32_t record = entryRecords[i];
+    if ((record >> EntrySectionShift) >= NumReferenceDependencySections ||
+        (record & EntryNameMask) >= numStrings)
+      return false;
+  }
+
+  auto fingerprintRecords = reinterpret_cast<const FingerprintRecord *>(
+    data.data() + fingerprintRecordsOffset);
+  for (uint64_t i = 0; i != numFingerprints; ++i) {
+    uint32_t fingerprint = fingerprintRecords[i];
+    if (fingerprint != NoString && fingerprint >= numStrings)
+      return false;
+  }
+
+  if (header->InterfaceHash != NoString && header->InterfaceHash >= numStrings)
+    return false;
+
+  Header = header;
+  StringOffsets = stringOffsets;
+  EntryRecords = entryRecords;
+  FingerprintRecords = numFingerprints ? fingerprintRecords : nullptr;
+  StringData = data.data() + stringDataOffset;
+  return true;
+}
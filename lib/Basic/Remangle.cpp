@@ -26,7 +26,6 @@
 #include <vector>
 #include <cstdio>
 #include <cstdlib>
-#include <unordered_map>
 
 using namespace swift;
 using namespace Demangle;
@@ -147,7 +146,7 @@ namespace {
         }
       }
       for (const auto &child : *node) {
-        hash(child.get());
+        hash(child);
       }
     }
   };
@@ -181,7 +180,7 @@ static bool deepEquals(Node *lhs, Node *rhs) {
 
   for (auto li = lhs->begin(), ri = lhs->begin(), le = lhs->end();
        li != le; ++li, ++ri) {
-    if (!deepEquals(li->get(), ri->get()))
+    if (!deepEquals(*li, *ri))
       return false;
   }
 
@@ -195,11 +194,6 @@ namespace {
 
     // Note that the constructor leaves this uninitialized.
 
-    struct Hasher {
-      size_t operator()(const SubstitutionEntry &entry) const {
-        return entry.StoredHash;
-      }
-    };
     friend bool operator==(const SubstitutionEntry &lhs,
                            const SubstitutionEntry &rhs) {
       return (lhs.StoredHash == rhs.StoredHash &&
@@ -211,11 +205,23 @@ namespace {
     DemanglerPrinter &Out;
 
     // We have to cons up temporary nodes sometimes when remangling
-    // nested generics. This vector owns them.
-    std::vector<NodePointer> TemporaryNodes;
+    // nested generics. This factory owns them.
+    NodeFactory Factory;
+
+    /// A slot in the substitution table.  Empty slots have a null node.
+    struct SubstitutionSlot {
+      SubstitutionEntry Entry;
+      unsigned Index;
+    };
 
-    std::unordered_map<SubstitutionEntry, unsigned,
-                       SubstitutionEntry::Hasher> Substitutions;
+    /// The substitutions made so far, in an open-addressing hash table
+    /// allocated by the factory.  The number of slots is a power of two.
+    SubstitutionSlot *Substitutions = nullptr;
+    size_t NumSubstitutionSlots = 0;
+    unsigned NumSubstitutions = 0;
+
+    SubstitutionSlot *findSubstitutionSlot(const SubstitutionEntry &entry);
+    void growSubstitutions();
   public:
     Remangler(DemanglerPrinter &out) : Out(out) {}
 
@@ -266,16 +272,16 @@ namespace {
     void mangleChildNodes(Node *node) { mangleNodes(node->begin(), node->end()); }
     void mangleNodes(Node::iterator i, Node::iterator e) {
       for (; i != e; ++i) {
-        mangle(i->get());
+        mangle(*i);
       }
     }
     void mangleSingleChildNode(Node *node) {
       assert(node->getNumChildren() == 1);
-      mangle(node->begin()->get());
+      mangle(*node->begin());
     }
     void mangleChildNode(Node *node, unsigned index) {
       assert(index < node->getNumChildren());
-      mangle(node->begin()[index].get());
+      mangle(node->begin()[index]);
     }
 
     void mangleSimpleEntity(Node *node, char basicKind, StringRef entityKind,
@@ -317,12 +323,40 @@ void Remangler::mangle##ID(Node *node) {        \
 /// when part of the mangling is done independently, e.g. when an
 /// optimization pass modifies a pass.
 void Remangler::resetSubstitutions() {
-  Substitutions.clear();
+  for (size_t i = 0; i != NumSubstitutionSlots; ++i)
+    Substitutions[i].Entry.TheNode = nullptr;
+  NumSubstitutions = 0;
+}
+
+/// Find the slot holding the given entry, or the empty slot where it
+/// belongs.
+Remangler::SubstitutionSlot *
+Remangler::findSubstitutionSlot(const SubstitutionEntry &entry) {
+  size_t mask = NumSubstitutionSlots - 1;
+  for (size_t i = entry.StoredHash & mask;; i = (i + 1) & mask) {
+    SubstitutionSlot &slot = Substitutions[i];
+    if (!slot.Entry.TheNode || slot.Entry == entry)
+      return &slot;
+  }
+}
+
+void Remangler::growSubstitutions() {
+  SubstitutionSlot *oldSlots = Substitutions;
+  size_t oldNumSlots = NumSubstitutionSlots;
+
+  NumSubstitutionSlots = oldNumSlots ? oldNumSlots * 2 : 16;
+  Substitutions = Factory.allocate<SubstitutionSlot>(NumSubstitutionSlots);
+  for (size_t i = 0; i != NumSubstitutionSlots; ++i)
+    Substitutions[i].Entry.TheNode = nullptr;
+
+  for (size_t i = 0; i != oldNumSlots; ++i)
+    if (oldSlots[i].Entry.TheNode)
+      *findSubstitutionSlot(oldSlots[i].Entry) = oldSlots[i];
 }
 
 bool Remangler::trySubstitution(Node *node, SubstitutionEntry &entry) {
   auto isInSwiftModule = [](Node *node) -> bool {
-    auto context = node->begin()->get();
+    auto context = *node->begin();
     return (context->getKind() == Node::Kind::Module &&
             context->getText() == STDLIB_NAME);
   };
@@ -383,19 +417,26 @@ bool Remangler::trySubstitution(Node *node, SubstitutionEntry &entry) {
   entry.TheNode = node;
   entry.StoredHash = deepHash(node);
 
-  auto it = Substitutions.find(entry);
-  if (it == Substitutions.end())
+  if (NumSubstitutions == 0)
+    return false;
+  SubstitutionSlot *slot = findSubstitutionSlot(entry);
+  if (!slot->Entry.TheNode)
     return false;
 
   Out << 'S';
-  mangleIndex(it->second);
+  mangleIndex(slot->Index);
   return true;
 }
 
 void Remangler::addSubstitution(const SubstitutionEntry &entry) {
-  auto result = Substitutions.insert({entry, Substitutions.size()});
-  assert(result.second);
-  (void) result;
+  // Keep the table at most three quarters full.
+  if ((NumSubstitutions + 1) * 4 > NumSubstitutionSlots * 3)
+    growSubstitutions();
+
+  SubstitutionSlot *slot = findSubstitutionSlot(entry);
+  assert(!slot->Entry.TheNode && "substitution was already added");
+  slot->Entry = entry;
+  slot->Index = NumSubstitutions++;
 }
 
 void Remangler::mangleIdentifier(Node *node) {
@@ -495,12 +536,12 @@ void Remangler::mangleFunctionSignatureSpecializationParam(Node *node) {
   switch (kind) {
   case FunctionSigSpecializationParamKind::ConstantPropFunction:
     Out << "cpfr";
-    mangleIdentifier(node->getChild(1).get());
+    mangleIdentifier(node->getChild(1));
     Out << '_';
     return;
   case FunctionSigSpecializationParamKind::ConstantPropGlobal:
     Out << "cpg";
-    mangleIdentifier(node->getChild(1).get());
+    mangleIdentifier(node->getChild(1));
     Out << '_';
     return;
   case FunctionSigSpecializationParamKind::ConstantPropInteger:
@@ -519,15 +560,15 @@ void Remangler::mangleFunctionSignatureSpecializationParam(Node *node) {
     else
       unreachable("Unknown encoding");
     Out << 'v';
-    mangleIdentifier(node->getChild(2).get());
+    mangleIdentifier(node->getChild(2));
     Out << '_';
     return;
   }
   case FunctionSigSpecializationParamKind::ClosureProp:
     Out << "cl";
-    mangleIdentifier(node->getChild(1).get());
+    mangleIdentifier(node->getChild(1));
     for (unsigned i = 2, e = node->getNumChildren(); i != e; ++i) {
-      mangleType(node->getChild(i).get());
+      mangleType(node->getChild(i));
     }
     Out << '_';
     return;
@@ -567,7 +608,7 @@ void Remangler::mangleProtocolConformance(Node *node) {
   // type, protocol name, context
   assert(node->getNumChildren() == 3);
   mangleChildNode(node, 0);
-  mangleProtocolWithoutPrefix(node->begin()[1].get());
+  mangleProtocolWithoutPrefix(node->begin()[1]);
   mangleChildNode(node, 2);
 }
 
@@ -628,7 +669,7 @@ void Remangler::mangleFullTypeMetadata(Node *node) {
 
 void Remangler::mangleProtocolDescriptor(Node *node) {
   Out << "Mp";
-  mangleProtocolWithoutPrefix(node->begin()[0].get());
+  mangleProtocolWithoutPrefix(node->begin()[0]);
 }
 
 void Remangler::manglePartialApplyForwarder(Node *node) {
@@ -743,7 +784,7 @@ void Remangler::mangleAssociatedTypeWitnessTableAccessor(Node *node) {
   assert(node->getNumChildren() == 3);
   mangleChildNode(node, 0); // protocol conformance
   mangleChildNode(node, 1); // identifier
-  mangleProtocolWithoutPrefix(node->begin()[2].get()); // type
+  mangleProtocolWithoutPrefix(node->begin()[2]); // type
 }
 
 void Remangler::mangleReabstractionThunkHelper(Node *node) {
@@ -876,7 +917,7 @@ void Remangler::mangleImplicitClosure(Node *node, EntityContext &ctx) {
 
 void Remangler::mangleStatic(Node *node, EntityContext &ctx) {
   Out << 'Z';
-  mangleEntityContext(node->getChild(0).get(), ctx);
+  mangleEntityContext(node->getChild(0), ctx);
 }
 
 void Remangler::mangleSimpleEntity(Node *node, char basicKind,
@@ -884,7 +925,7 @@ void Remangler::mangleSimpleEntity(Node *node, char basicKind,
                                    EntityContext &ctx) {
   assert(node->getNumChildren() == 1);
   Out << basicKind;
-  mangleEntityContext(node->begin()[0].get(), ctx);
+  mangleEntityContext(node->begin()[0], ctx);
   Out << entityKind;
 }
 
@@ -893,7 +934,7 @@ void Remangler::mangleNamedEntity(Node *node, char basicKind,
                                   EntityContext &ctx) {
   assert(node->getNumChildren() == 2);
   if (basicKind != '\0') Out << basicKind;
-  mangleEntityContext(node->begin()[0].get(), ctx);
+  mangleEntityContext(node->begin()[0], ctx);
   Out << entityKind;
   mangleChildNode(node, 1); // decl name / index
 }
@@ -903,9 +944,9 @@ void Remangler::mangleTypedEntity(Node *node, char basicKind,
                                   EntityContext &ctx) {
   assert(node->getNumChildren() == 2);
   Out << basicKind;
-  mangleEntityContext(node->begin()[0].get(), ctx);
+  mangleEntityContext(node->begin()[0], ctx);
   Out << entityKind;
-  mangleEntityType(node->begin()[1].get(), ctx);
+  mangleEntityType(node->begin()[1], ctx);
 }
 
 void Remangler::mangleNamedAndTypedEntity(Node *node, char basicKind,
@@ -913,10 +954,10 @@ void Remangler::mangleNamedAndTypedEntity(Node *node, char basicKind,
                                           EntityContext &ctx) {
   assert(node->getNumChildren() == 3);
   Out << basicKind;
-  mangleEntityContext(node->begin()[0].get(), ctx);
+  mangleEntityContext(node->begin()[0], ctx);
   Out << entityKind;
   mangleChildNode(node, 1); // decl name / index
-  mangleEntityType(node->begin()[2].get(), ctx);
+  mangleEntityType(node->begin()[2], ctx);
 }
 
 void Remangler::mangleEntityContext(Node *node, EntityContext &ctx) {
@@ -942,7 +983,7 @@ void Remangler::mangleEntityContext(Node *node, EntityContext &ctx) {
 void Remangler::mangleEntityType(Node *node, EntityContext &ctx) {
   assert(node->getKind() == Node::Kind::Type);
   assert(node->getNumChildren() == 1);
-  node = node->begin()[0].get();
+  node = node->begin()[0];
 
   // Expand certain kinds of type within the entity context.
   switch (node->getKind()) {
@@ -952,11 +993,11 @@ void Remangler::mangleEntityType(Node *node, EntityContext &ctx) {
     unsigned inputIndex = node->getNumChildren() - 2;
     assert(inputIndex <= 1);
     for (unsigned i = 0; i <= inputIndex; ++i)
-      mangle(node->begin()[i].get());
-    auto returnType = node->begin()[inputIndex+1].get();
+      mangle(node->begin()[i]);
+    auto returnType = node->begin()[inputIndex+1];
     assert(returnType->getKind() == Node::Kind::ReturnType);
     assert(returnType->getNumChildren() == 1);
-    mangleEntityType(returnType->begin()[0].get(), ctx);
+    mangleEntityType(returnType->begin()[0], ctx);
     return;
   }
   default:
@@ -1079,8 +1120,8 @@ void Remangler::mangleReturnType(Node *node) {
 void Remangler::mangleImplFunctionType(Node *node) {
   Out << "XF";
   auto i = node->begin(), e = node->end();
-  if (i != e && i->get()->getKind() == Node::Kind::ImplConvention) {
-    StringRef text = (i++)->get()->getText();
+  if (i != e && (*i)->getKind() == Node::Kind::ImplConvention) {
+    StringRef text = (*i++)->getText();
     if (text == "@callee_unowned") {
       Out << 'd';
     } else if (text == "@callee_guaranteed") {
@@ -1094,19 +1135,19 @@ void Remangler::mangleImplFunctionType(Node *node) {
     Out << 't';
   }
   for (; i != e &&
-         i->get()->getKind() == Node::Kind::ImplFunctionAttribute; ++i) {
-    mangle(i->get()); // impl function attribute
+         (*i)->getKind() == Node::Kind::ImplFunctionAttribute; ++i) {
+    mangle(*i); // impl function attribute
   }
   if (i != e &&
-      (i->get()->getKind() == Node::Kind::DependentGenericSignature ||
-       i->get()->getKind() == Node::Kind::DependentPseudogenericSignature)) {
-    Out << (i->get()->getKind() == Node::Kind::DependentGenericSignature
+      ((*i)->getKind() == Node::Kind::DependentGenericSignature ||
+       (*i)->getKind() == Node::Kind::DependentPseudogenericSignature)) {
+    Out << ((*i)->getKind() == Node::Kind::DependentGenericSignature
               ? 'G' : 'g');
-    mangleDependentGenericSignature((i++)->get());
+    mangleDependentGenericSignature(*i++);
   }
   Out << '_';
-  for (; i != e && i->get()->getKind() == Node::Kind::ImplParameter; ++i) {
-    mangleImplParameter(i->get());
+  for (; i != e && (*i)->getKind() == Node::Kind::ImplParameter; ++i) {
+    mangleImplParameter(*i);
   }
   Out << '_';
   mangleNodes(i, e); // impl results
@@ -1230,10 +1271,10 @@ void Remangler::mangleProtocolList(Node *node) {
 void Remangler::mangleProtocolListWithoutPrefix(Node *node) {
   assert(node->getKind() == Node::Kind::ProtocolList);
   assert(node->getNumChildren() == 1);
-  auto typeList = node->begin()[0].get();
+  auto typeList = node->begin()[0];
   assert(typeList->getKind() == Node::Kind::TypeList);
   for (auto &child : *typeList) {
-    mangleProtocolWithoutPrefix(child.get());
+    mangleProtocolWithoutPrefix(child);
   }
   Out << '_';
 }
@@ -1303,8 +1344,8 @@ void Remangler::mangleDependentGenericSignature(Node *node) {
   
   // Remangle generic params.
   for (; i != e &&
-         i->get()->getKind() == Node::Kind::DependentGenericParamCount; ++i) {
-    auto count = i->get();
+         (*i)->getKind() == Node::Kind::DependentGenericParamCount; ++i) {
+    auto count = *i;
     if (count->getIndex() > 0)
       mangleIndex(count->getIndex() - 1);
     else
@@ -1327,30 +1368,30 @@ void Remangler::mangleDependentGenericParamCount(Node *node) {
 }
 
 void Remangler::mangleDependentGenericConformanceRequirement(Node *node) {
-  mangleConstrainedType(node->getChild(0).get());
+  mangleConstrainedType(node->getChild(0));
   // If the constraint represents a protocol, use the shorter mangling.
   if (node->getNumChildren() == 2
       && node->getChild(1)->getKind() == Node::Kind::Type
       && node->getChild(1)->getNumChildren() == 1
       && node->getChild(1)->getChild(0)->getKind() == Node::Kind::Protocol) {
-    mangleProtocolWithoutPrefix(node->getChild(1)->getChild(0).get());
+    mangleProtocolWithoutPrefix(node->getChild(1)->getChild(0));
     return;
   }
 
-  mangle(node->getChild(1).get());
+  mangle(node->getChild(1));
 }
 
 void Remangler::mangleDependentGenericSameTypeRequirement(Node *node) {
-  mangleConstrainedType(node->getChild(0).get());
+  mangleConstrainedType(node->getChild(0));
   Out << 'z';
-  mangle(node->getChild(1).get());
+  mangle(node->getChild(1));
 }
 
 void Remangler::mangleConstrainedType(Node *node) {
   if (node->getFirstChild()->getKind()
         == Node::Kind::DependentGenericParamType) {
     // Can be mangled without an introducer.
-    mangleDependentGenericParamIndex(node->getFirstChild().get());
+    mangleDependentGenericParamIndex(node->getFirstChild());
   } else {
     mangle(node);
   }
@@ -1359,7 +1400,7 @@ void Remangler::mangleConstrainedType(Node *node) {
 void Remangler::mangleArchetype(Node *node) {
   if (node->hasChildren()) {
     assert(node->getNumChildren() == 1);
-    mangleProtocolListWithoutPrefix(node->begin()->get());
+    mangleProtocolListWithoutPrefix(*node->begin());
   } else {
     Out << '_';
   }
@@ -1368,7 +1409,7 @@ void Remangler::mangleArchetype(Node *node) {
 void Remangler::mangleAssociatedType(Node *node) {
   if (node->hasChildren()) {
     assert(node->getNumChildren() == 1);
-    mangleProtocolListWithoutPrefix(node->begin()->get());
+    mangleProtocolListWithoutPrefix(*node->begin());
   } else {
     Out << '_';
   }
@@ -1379,7 +1420,7 @@ void Remangler::mangleSelfTypeRef(Node *node) {
   if (trySubstitution(node, entry)) return;
   Out << "QP";
   assert(node->getNumChildren() == 1);
-  mangleProtocolWithoutPrefix(node->begin()[0].get());
+  mangleProtocolWithoutPrefix(node->begin()[0]);
   addSubstitution(entry);
 }
 
@@ -1411,11 +1452,11 @@ void Remangler::mangleExtension(Node *node, EntityContext &ctx) {
   } else {
     Out << 'E';
   }
-  mangleEntityContext(node->begin()[0].get(), ctx); // module
+  mangleEntityContext(node->begin()[0], ctx); // module
   if (node->getNumChildren() == 3) {
-    mangleDependentGenericSignature(node->begin()[2].get()); // generic sig
+    mangleDependentGenericSignature(node->begin()[2]); // generic sig
   }
-  mangleEntityContext(node->begin()[1].get(), ctx); // context
+  mangleEntityContext(node->begin()[1], ctx); // context
 }
 
 void Remangler::mangleModule(Node *node, EntityContext &ctx) {
@@ -1441,7 +1482,7 @@ void Remangler::mangleDependentMemberType(Node *node) {
   Node *base = node;
   do {
     members.push_back(base);
-    base = base->getFirstChild()->getFirstChild().get();
+    base = base->getFirstChild()->getFirstChild();
   } while (base->getKind() == Node::Kind::DependentMemberType);
 
   assert(base->getKind() == Node::Kind::DependentGenericParamType
@@ -1451,13 +1492,13 @@ void Remangler::mangleDependentMemberType(Node *node) {
   if (members.size() == 1) {
     Out << 'w';
     mangleDependentGenericParamIndex(base);
-    mangle(members[0]->getChild(1).get());
+    mangle(members[0]->getChild(1));
   } else {
     Out << 'W';
     mangleDependentGenericParamIndex(base);
 
     for (auto *member : reversed(members)) {
-      mangle(member->getChild(1).get());
+      mangle(member->getChild(1));
     }
     Out << '_';
   }
@@ -1469,7 +1510,7 @@ void Remangler::mangleDependentAssociatedTypeRef(Node *node) {
 
   if (node->getNumChildren() > 0) {
     Out << 'P';
-    mangleProtocolWithoutPrefix(node->getFirstChild().get());
+    mangleProtocolWithoutPrefix(node->getFirstChild());
   }
   mangleIdentifier(node);
 
@@ -1517,7 +1558,7 @@ void Remangler::mangleProtocol(Node *node, EntityContext &ctx) {
 void Remangler::mangleProtocolWithoutPrefix(Node *node) {
   if (node->getKind() == Node::Kind::Type) {
     assert(node->getNumChildren() == 1);
-    node = node->begin()[0].get();
+    node = node->begin()[0];
   }
 
   assert(node->getKind() == Node::Kind::Protocol);
@@ -1535,7 +1576,7 @@ static bool isSpecialized(Node *node) {
   case Node::Kind::Structure:
   case Node::Kind::Enum:
   case Node::Kind::Class: {
-    Node *parentOrModule = node->getChild(0).get();
+    Node *parentOrModule = node->getChild(0);
     if (isSpecialized(parentOrModule))
       return true;
 
@@ -1552,13 +1593,13 @@ NodePointer Remangler::getUnspecialized(Node *node) {
   case Node::Kind::Structure:
   case Node::Kind::Enum:
   case Node::Kind::Class: {
-    NodePointer result = NodeFactory::create(node->getKind());
+    NodePointer result = Factory.createNode(node->getKind());
     NodePointer parentOrModule = node->getChild(0);
-    if (isSpecialized(parentOrModule.get()))
-      result->addChild(getUnspecialized(parentOrModule.get()));
+    if (isSpecialized(parentOrModule))
+      result->addChild(getUnspecialized(parentOrModule), Factory);
     else
-      result->addChild(parentOrModule);
-    result->addChild(node->getChild(1));
+      result->addChild(parentOrModule, Factory);
+    result->addChild(node->getChild(1), Factory);
     return result;
   }
 
@@ -1568,8 +1609,8 @@ NodePointer Remangler::getUnspecialized(Node *node) {
     NodePointer unboundType = node->getChild(0);
     assert(unboundType->getKind() == Node::Kind::Type);
     NodePointer nominalType = unboundType->getChild(0);
-    if (isSpecialized(nominalType.get()))
-      return getUnspecialized(nominalType.get());
+    if (isSpecialized(nominalType))
+      return getUnspecialized(nominalType);
     else
       return nominalType;
   }
@@ -1585,7 +1626,7 @@ void Remangler::mangleGenericArgs(Node *node, EntityContext &ctx) {
   case Node::Kind::Enum:
   case Node::Kind::Class: {
     NodePointer parentOrModule = node->getChild(0);
-    mangleGenericArgs(parentOrModule.get(), ctx);
+    mangleGenericArgs(parentOrModule, ctx);
 
     // No generic arguments at this level
     Out << '_';
@@ -1599,9 +1640,9 @@ void Remangler::mangleGenericArgs(Node *node, EntityContext &ctx) {
     assert(unboundType->getKind() == Node::Kind::Type);
     NodePointer nominalType = unboundType->getChild(0);
     NodePointer parentOrModule = nominalType->getChild(0);
-    mangleGenericArgs(parentOrModule.get(), ctx);
+    mangleGenericArgs(parentOrModule, ctx);
 
-    mangleTypeList(node->getChild(1).get());
+    mangleTypeList(node->getChild(1));
     break;
   }
 
@@ -1615,9 +1656,7 @@ void Remangler::mangleAnyNominalType(Node *node, EntityContext &ctx) {
     Out << 'G';
 
     NodePointer unboundType = getUnspecialized(node);
-    TemporaryNodes.push_back(unboundType);
-
-    mangleAnyNominalType(unboundType.get(), ctx);
+    mangleAnyNominalType(unboundType, ctx);
     mangleGenericArgs(node, ctx);
     return;
   }
@@ -1677,10 +1716,10 @@ void Remangler::mangleTypeList(Node *node) {
 }
 
 /// The top-level interface to the remangler.
-std::string Demangle::mangleNode(const NodePointer &node) {
+std::string Demangle::mangleNode(NodePointer node) {
   if (!node) return "";
 
   DemanglerPrinter printer;
-  Remangler(printer).mangle(node.get());
+  Remangler(printer).mangle(node);
   return std::move(printer).str();
 }
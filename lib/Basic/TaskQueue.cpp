@@ -80,7 +80,8 @@ bool DummyTaskQueue::execute(TaskQueue::TaskBeganCallback Began,
 
     if (Finished) {
       std::string Output = "Output placeholder\n";
-        if (Finished(P.first, 0, Output, P.second->Context) ==
+        if (Finished(P.first, 0, Output, P.second->Context,
+                     TaskResourceUsage()) ==
             TaskFinishedResponse::StopExecution)
           SubtaskFailed = true;
     }
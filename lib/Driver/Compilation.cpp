@@ -24,6 +24,7 @@
 #include "swift/Driver/Driver.h"
 #include "swift/Driver/Job.h"
 #include "swift/Driver/ParseableOutput.h"
+#include "swift/Driver/ToolChain.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringExtras.h"
@@ -62,6 +63,13 @@ Compilation::Compilation(DiagnosticEngine &Diags, OutputLevel Level,
     ShowDriverTimeCompilation(ShowDriverTimeCompilation) {
 };
 
+void Compilation::enableBatchMode(const ToolChain &TC, const OutputInfo &OI,
+                                  unsigned BatchCount) {
+  BatchModeToolChain = &TC;
+  BatchModeOutputInfo.reset(new OutputInfo(OI));
+  this->BatchCount = std::max(BatchCount, 1U);
+}
+
 using CommandSet = llvm::SmallPtrSet<const Job *, 16>;
 
 namespace {
@@ -86,6 +94,24 @@ namespace {
     ///
     /// Only intended for source files.
     llvm::SmallDenseMap<const Job *, bool, 16> UnfinishedCommands;
+
+    /// Jobs that are ready to run but have not yet been given to the
+    /// TaskQueue, so that they can be ordered and, in batch mode, combined.
+    SmallVector<const Job *, 16> ReadyCommands;
+
+    /// In batch mode, the jobs created to run batches...
+    SmallVector<std::unique_ptr<const Job>, 4> BatchJobs;
+
+    /// ...and the compile jobs each of them runs, in order.
+    llvm::SmallDenseMap<const Job *, SmallVector<const Job *, 4>, 4>
+        BatchedCommands;
+
+    /// The resources used by each job which finished execution.
+    llvm::SmallDenseMap<const Job *, TaskResourceUsage, 16> JobUsage;
+
+    /// The hashes of the external dependencies that were hashed to check
+    /// whether they changed, when file hashing is enabled.
+    llvm::StringMap<ContentHash> ExternalDependencyHashes;
   };
 }
 
@@ -106,6 +132,104 @@ static const Job *findUnfinishedJob(ArrayRef<const Job *> JL,
   return nullptr;
 }
 
+/// Returns true if \p Cmd can be run in the same frontend invocation as
+/// other compile jobs.
+static bool isBatchable(const Job *Cmd) {
+  const CommandOutput &Output = Cmd->getOutput();
+  return isa<CompileJobAction>(Cmd->getSource()) &&
+         Cmd->getSource().size() == 1 &&
+         Cmd->getInputs().empty() &&
+         Cmd->getExtraEnvironment().empty() &&
+         Output.getPrimaryOutputFilenames().size() <= 1 &&
+         Output.getAdditionalOutputForType(types::TY_Remapping).empty();
+}
+
+static const Arg &getPrimaryInputArg(const Job *Cmd) {
+  return cast<InputAction>(*Cmd->getSource().begin())->getInputArg();
+}
+
+/// Returns true if \p LHS and \p RHS produce the same kinds of output, so
+/// that the frontend can be given one path of each kind per primary file.
+static bool haveSameOutputTypes(const Job *LHS, const Job *RHS) {
+  const CommandOutput &LHSOutput = LHS->getOutput();
+  const CommandOutput &RHSOutput = RHS->getOutput();
+  if (LHSOutput.getPrimaryOutputType() != RHSOutput.getPrimaryOutputType())
+    return false;
+  for (types::ID type : { types::TY_SwiftModuleFile,
+                          types::TY_SwiftModuleDocFile,
+                          types::TY_SerializedDiagnostics,
+                          types::TY_Dependencies,
+                          types::TY_SwiftDeps,
+                          types::TY_ObjCHeader }) {
+    if (LHSOutput.getAdditionalOutputForType(type).empty() !=
+        RHSOutput.getAdditionalOutputForType(type).empty())
+      return false;
+  }
+  return true;
+}
+
+/// Returns the name under which the resources used by \p Cmd are kept in the
+/// build record: its input file for a compile job of a single file, or else
+/// the kind of job.
+static StringRef getJobUsageKey(const Job *Cmd) {
+  const JobAction &Source = Cmd->getSource();
+  if (isa<CompileJobAction>(Source) && Source.size() == 1)
+    if (auto *IA = dyn_cast<InputAction>(*Source.begin()))
+      return IA->getInputArg().getValue();
+  return Source.getClassName();
+}
+
+/// Estimates how long each job will take from how long it took in the
+/// previous build. Compile jobs without a previous time are assumed to take
+/// as long as the average compile job that has one.
+///
+/// Also computes each job's critical path: its own time plus that of the
+/// longest chain of jobs which depend on it, such as merge-module and link.
+static void
+estimateJobTimes(const Compilation &C,
+                 const llvm::StringMap<TaskResourceUsage> &previousUsage,
+                 llvm::DenseMap<const Job *, uint64_t> &expectedTime,
+                 llvm::DenseMap<const Job *, uint64_t> &criticalPathTime) {
+  auto jobs = C.getJobs();
+
+  uint64_t totalCompileTime = 0;
+  unsigned numTimedCompiles = 0;
+  SmallVector<const Job *, 16> untimedCompiles;
+  for (const Job *cmd : jobs) {
+    bool isCompile = isa<CompileJobAction>(cmd->getSource());
+    auto previous = previousUsage.find(getJobUsageKey(cmd));
+    if (previous == previousUsage.end()) {
+      if (isCompile)
+        untimedCompiles.push_back(cmd);
+      continue;
+    }
+
+    uint64_t time = previous->getValue().WallTimeMilliseconds;
+    expectedTime[cmd] = time;
+    if (isCompile) {
+      totalCompileTime += time;
+      ++numTimedCompiles;
+    }
+  }
+  if (numTimedCompiles != 0) {
+    for (const Job *cmd : untimedCompiles)
+      expectedTime[cmd] = totalCompileTime / numTimedCompiles;
+  }
+
+  // Jobs are added after their inputs, so walking backwards visits each job
+  // after all of the jobs that depend on it.
+  llvm::DenseMap<const Job *, uint64_t> downstreamTime;
+  for (size_t i = jobs.size(); i != 0; --i) {
+    const Job *cmd = jobs[i - 1];
+    uint64_t time = expectedTime.lookup(cmd) + downstreamTime.lookup(cmd);
+    criticalPathTime[cmd] = time;
+    for (const Job *input : cmd->getInputs()) {
+      uint64_t &inputDownstreamTime = downstreamTime[input];
+      inputDownstreamTime = std::max(inputDownstreamTime, time);
+    }
+  }
+}
+
 using InputInfoMap =
   llvm::SmallMapVector<const llvm::opt::Arg *, CompileJobAction::InputInfo, 16>;
 
@@ -175,9 +299,15 @@ static void checkForOutOfDateInputs(DiagnosticEngine &diags,
   }
 }
 
+using JobUsageMap = llvm::MapVector<StringRef, TaskResourceUsage>;
+using ContentHashMap = llvm::MapVector<StringRef, ContentHash>;
+
 static void writeCompilationRecord(StringRef path, StringRef argsHash,
                                    llvm::sys::TimeValue buildTime,
-                                   const InputInfoMap &inputs) {
+                                   const InputInfoMap &inputs,
+                                   const JobUsageMap &jobUsage,
+                                   const ContentHashMap &inputHashes,
+                                   const ContentHashMap &externalHashes) {
   std::error_code error;
   llvm::raw_fd_ostream out(path, error, llvm::sys::fs::F_None);
   if (out.has_error()) {
@@ -216,6 +346,29 @@ static void writeCompilationRecord(StringRef path, StringRef argsHash,
     writeTimeValue(out, entry.second.previousModTime);
     out << "\n";
   }
+
+  if (!jobUsage.empty()) {
+    // Each job's wall time in milliseconds and peak RSS in kilobytes.
+    out << "job_usage:\n";
+    for (auto &entry : jobUsage) {
+      out << "  \"" << llvm::yaml::escape(entry.first) << "\": ["
+          << entry.second.WallTimeMilliseconds << ", "
+          << entry.second.PeakRSSKilobytes << "]\n";
+    }
+  }
+
+  auto writeHashes = [&out](StringRef name, const ContentHashMap &hashes) {
+    if (hashes.empty())
+      return;
+    out << name << ":\n";
+    for (auto &entry : hashes) {
+      out << "  \"" << llvm::yaml::escape(entry.first) << "\": \"";
+      writeContentHash(out, entry.second);
+      out << "\"\n";
+    }
+  };
+  writeHashes("input_hashes", inputHashes);
+  writeHashes("external_dependency_hashes", externalHashes);
 }
 
 static bool writeFilelistIfNecessary(const Job *job, DiagnosticEngine &diags) {
@@ -270,6 +423,10 @@ int Compilation::performJobsImpl() {
   SmallPtrSet<const Job *, 16> DeferredCommands;
   SmallVector<const Job *, 16> InitialOutOfDateCommands;
 
+  llvm::DenseMap<const Job *, uint64_t> ExpectedTime;
+  llvm::DenseMap<const Job *, uint64_t> CriticalPathTime;
+  estimateJobTimes(*this, PreviousJobUsage, ExpectedTime, CriticalPathTime);
+
   DependencyGraph::MarkTracer ActualIncrementalTracer;
   DependencyGraph::MarkTracer *IncrementalTracer = nullptr;
   if (ShowIncrementalBuildDecisions)
@@ -289,6 +446,55 @@ int Compilation::performJobsImpl() {
     });
   };
 
+  // Returns the jobs run by the task for \p Cmd: the jobs in its batch, if
+  // it is a batch, or else just \p Cmd itself.
+  auto getCommandsRunBy =
+      [&] (const Job * const &Cmd) -> ArrayRef<const Job *> {
+    auto Batched = State.BatchedCommands.find(Cmd);
+    if (Batched == State.BatchedCommands.end())
+      return Cmd;
+    return Batched->second;
+  };
+
+  // Describes the task for \p Cmd for -driver-show-schedule, by its input
+  // files or, if it has none of its own, its output.
+  auto describeTask = [&] (raw_ostream &out, const Job *Cmd) {
+    out << Cmd->getSource().getClassName();
+    bool HasInputFiles = false;
+    for (const Job *RunCmd : getCommandsRunBy(Cmd)) {
+      for (const Action *A : RunCmd->getSource().getInputs()) {
+        if (const InputAction *IA = dyn_cast<InputAction>(A)) {
+          out << " " << llvm::sys::path::filename(IA->getInputArg().getValue());
+          HasInputFiles = true;
+        }
+      }
+    }
+    ArrayRef<std::string> Outputs =
+      Cmd->getOutput().getPrimaryOutputFilenames();
+    if (!HasInputFiles && !Outputs.empty())
+      out << " " << llvm::sys::path::filename(Outputs.front());
+  };
+
+  auto addTask = [&] (const Job *Cmd) {
+    // FIXME: Failing here should not take down the whole process.
+    bool success = writeFilelistIfNecessary(Cmd, Diags);
+    assert(success && "failed to write filelist");
+    (void)success;
+
+    if (ShowJobSchedule) {
+      llvm::outs() << "Scheduling ";
+      describeTask(llvm::outs(), Cmd);
+      llvm::outs() << " (expected " << ExpectedTime.lookup(Cmd)
+                   << " ms, critical path " << CriticalPathTime.lookup(Cmd)
+                   << " ms)\n";
+    }
+
+    assert(Cmd->getExtraEnvironment().empty() &&
+           "not implemented for compilations with multiple jobs");
+    TQ->addTask(Cmd->getExecutable(), Cmd->getArguments(), llvm::None,
+                (void *)Cmd);
+  };
+
   // Set up scheduleCommandIfNecessaryAndPossible.
   // This will only schedule the given command if it has not been scheduled
   // and if all of its inputs are in FinishedCommands.
@@ -302,16 +508,97 @@ int Compilation::performJobsImpl() {
       return;
     }
 
-    // FIXME: Failing here should not take down the whole process.
-    bool success = writeFilelistIfNecessary(Cmd, Diags);
-    assert(success && "failed to write filelist");
-    (void)success;
-
-    assert(Cmd->getExtraEnvironment().empty() &&
-           "not implemented for compilations with multiple jobs");
     State.ScheduledCommands.insert(Cmd);
-    TQ->addTask(Cmd->getExecutable(), Cmd->getArguments(), llvm::None,
-                (void *)Cmd);
+    State.ReadyCommands.push_back(Cmd);
+  };
+
+  // Add a task for each of the jobs that have become ready to run.
+  //
+  // In batch mode, the compile jobs among them are first split into batches,
+  // each run by one task. Jobs are only batched with jobs that produce the
+  // same kinds of output.
+  //
+  // When tasks run in parallel, the ones with the longest critical paths are
+  // started first.
+  auto flushReadyCommands = [&] {
+    if (State.ReadyCommands.empty())
+      return;
+    auto Ready = std::move(State.ReadyCommands);
+    State.ReadyCommands.clear();
+
+    SmallVector<const Job *, 16> Tasks;
+    SmallVector<SmallVector<const Job *, 16>, 1> Groups;
+    for (const Job *Cmd : Ready) {
+      if (!getBatchModeEnabled() || !isBatchable(Cmd)) {
+        Tasks.push_back(Cmd);
+        continue;
+      }
+
+      auto Group = std::find_if(Groups.begin(), Groups.end(),
+                                [&](ArrayRef<const Job *> Existing) {
+        return haveSameOutputTypes(Existing.front(), Cmd);
+      });
+      if (Group == Groups.end()) {
+        Groups.emplace_back();
+        Group = Groups.end() - 1;
+      }
+      Group->push_back(Cmd);
+    }
+
+    for (auto &Group : Groups) {
+      // The frontend matches outputs to primary files by position, and it
+      // sees the primary files in command-line order.
+      std::stable_sort(Group.begin(), Group.end(),
+                       [](const Job *LHS, const Job *RHS) {
+        return getPrimaryInputArg(LHS).getIndex() <
+               getPrimaryInputArg(RHS).getIndex();
+      });
+
+      size_t NumBatches = std::min<size_t>(BatchCount, Group.size());
+      for (size_t i = 0; i != NumBatches; ++i) {
+        size_t Begin = Group.size() * i / NumBatches;
+        size_t End = Group.size() * (i + 1) / NumBatches;
+        auto Batch = llvm::makeArrayRef(Group).slice(Begin, End - Begin);
+        if (Batch.size() == 1) {
+          Tasks.push_back(Batch.front());
+          continue;
+        }
+
+        std::unique_ptr<Job> BatchJob =
+          BatchModeToolChain->constructBatchJob(Batch, *this,
+                                                *BatchModeOutputInfo);
+        State.BatchedCommands[BatchJob.get()].append(Batch.begin(),
+                                                     Batch.end());
+
+        // The jobs in a batch run one after another.
+        uint64_t BatchTime = 0;
+        uint64_t BatchDownstreamTime = 0;
+        for (const Job *Cmd : Batch) {
+          uint64_t Time = ExpectedTime.lookup(Cmd);
+          BatchTime += Time;
+          BatchDownstreamTime = std::max(BatchDownstreamTime,
+                                         CriticalPathTime.lookup(Cmd) - Time);
+        }
+        ExpectedTime[BatchJob.get()] = BatchTime;
+        CriticalPathTime[BatchJob.get()] = BatchTime + BatchDownstreamTime;
+
+        Tasks.push_back(BatchJob.get());
+        State.BatchJobs.push_back(std::move(BatchJob));
+      }
+    }
+
+    if (TQ->getNumberOfParallelTasks() > 1) {
+      // Differences of less than a second are mostly noise from one build to
+      // the next, so tasks within a second of each other keep their order.
+      std::stable_sort(Tasks.begin(), Tasks.end(),
+                       [&](const Job *LHS, const Job *RHS) {
+        return CriticalPathTime.lookup(LHS) / 1000 >
+               CriticalPathTime.lookup(RHS) / 1000;
+      });
+    }
+
+    for (const Job *Cmd : Tasks)
+      addTask(Cmd);
   };
 
   // When a task finishes, we need to reevaluate the other commands that
@@ -398,18 +685,40 @@ int Compilation::performJobsImpl() {
     size_t firstSize = AdditionalOutOfDateCommands.size();
 
     // Check all cross-module dependencies as well.
+    SmallVector<StringRef, 16> ChangedExternalDependencies;
     for (StringRef dependency : DepGraph.getExternalDependencies()) {
       llvm::sys::fs::file_status depStatus;
       if (!llvm::sys::fs::status(dependency, depStatus))
         if (depStatus.getLastModificationTime() < LastBuildTime)
           continue;
+      ChangedExternalDependencies.push_back(dependency);
+    }
 
-      // If the dependency has been modified since the oldest built file,
-      // or if we can't stat it for some reason (perhaps it's been deleted?),
-      // trigger rebuilds through the dependency graph.
-      DepGraph.markExternal(AdditionalOutOfDateCommands, dependency);
+    // A dependency that was touched without changing can be skipped, if we
+    // know what it looked like last time.
+    if (getFileHashingEnabled() && !ChangedExternalDependencies.empty()) {
+      auto Hashes = hashFileContents(ChangedExternalDependencies);
+      SmallVector<StringRef, 16> StillChanged;
+      for (size_t i = 0, e = Hashes.size(); i != e; ++i) {
+        StringRef dependency = ChangedExternalDependencies[i];
+        if (Hashes[i]) {
+          State.ExternalDependencyHashes[dependency] = *Hashes[i];
+          auto Previous = PreviousExternalDependencyHashes.find(dependency);
+          if (Previous != PreviousExternalDependencyHashes.end() &&
+              Previous->getValue() == *Hashes[i])
+            continue;
+        }
+        StillChanged.push_back(dependency);
+      }
+      ChangedExternalDependencies = std::move(StillChanged);
     }
 
+    // If the dependency has been modified since the oldest built file,
+    // or if we can't stat it for some reason (perhaps it's been deleted?),
+    // trigger rebuilds through the dependency graph.
+    for (StringRef dependency : ChangedExternalDependencies)
+      DepGraph.markExternal(AdditionalOutOfDateCommands, dependency);
+
     for (auto *externalCmd :
             llvm::makeArrayRef(AdditionalOutOfDateCommands).slice(firstSize)) {
       noteBuilding(externalCmd, "because of external dependencies");
@@ -440,9 +749,11 @@ int Compilation::performJobsImpl() {
       llvm::raw_svector_ostream OS(TimerName);
 
       OS << BeganCmd->getSource().getClassName();
-      for (auto A : BeganCmd->getSource().getInputs()) {
-        if (const InputAction *IA = dyn_cast<InputAction>(A)) {
-          OS << " " << IA->getInputArg().getValue();
+      for (const Job *Cmd : getCommandsRunBy(BeganCmd)) {
+        for (auto A : Cmd->getSource().getInputs()) {
+          if (const InputAction *IA = dyn_cast<InputAction>(A)) {
+            OS << " " << IA->getInputArg().getValue();
+          }
         }
       }
       for (auto J : BeganCmd->getInputs()) {
@@ -462,10 +773,97 @@ int Compilation::performJobsImpl() {
     }
 
     // For verbose output, print out each command as it begins execution.
-    if (Level == OutputLevel::Verbose)
+    // Parseable output describes each job of a batch separately, since
+    // consumers track their inputs and outputs by job.
+    if (Level == OutputLevel::Verbose) {
       BeganCmd->printCommandLine(llvm::errs());
-    else if (Level == OutputLevel::Parseable)
-      parseable_output::emitBeganMessage(llvm::errs(), *BeganCmd, Pid);
+    } else if (Level == OutputLevel::Parseable) {
+      for (const Job *Cmd : getCommandsRunBy(BeganCmd))
+        parseable_output::emitBeganMessage(llvm::errs(), *Cmd, Pid);
+    }
+  };
+
+  // Reloads the dependencies of \p FinishedCmd after it has run, collecting
+  // the jobs that now need to run because of it in \p Dependents.
+  auto reloadDependencies = [&] (const Job *FinishedCmd, int ReturnCode,
+                                 SmallVector<const Job *, 16> &Dependents) {
+    const CommandOutput &Output = FinishedCmd->getOutput();
+    StringRef DependenciesFile =
+      Output.getAdditionalOutputForType(types::TY_SwiftDeps);
+
+    if (DependenciesFile.empty()) {
+      // If this job doesn't track dependencies, it must always be run.
+      // Note: In theory CheckDependencies makes sense as well (for a leaf
+      // node in the dependency graph), and maybe even NewlyAdded (for very
+      // coarse dependencies that always affect downstream nodes), but we're
+      // not using either of those right now, and this logic should probably
+      // be revisited when we are.
+      assert(FinishedCmd->getCondition() == Job::Condition::Always);
+    } else {
+      // If we have a dependency file /and/ the frontend task exited normally,
+      // we can be discerning about what downstream files to rebuild.
+      if (ReturnCode == EXIT_SUCCESS || ReturnCode == EXIT_FAILURE) {
+        bool wasCascading = DepGraph.isMarked(FinishedCmd);
+
+        switch (DepGraph.loadFromPath(FinishedCmd, DependenciesFile)) {
+        case DependencyGraphImpl::LoadResult::HadError:
+          if (ReturnCode == EXIT_SUCCESS) {
+            disableIncrementalBuild();
+            for (const Job *Cmd : DeferredCommands)
+              scheduleCommandIfNecessaryAndPossible(Cmd);
+            DeferredCommands.clear();
+            Dependents.clear();
+          } // else, let the next build handle it.
+          break;
+        case DependencyGraphImpl::LoadResult::UpToDate:
+          if (wasCascading)
+            DepGraph.markTransitive(Dependents, FinishedCmd);
+          break;
+        case DependencyGraphImpl::LoadResult::AffectsDownstream:
+          if (wasCascading) {
+            DepGraph.markTransitive(Dependents, FinishedCmd);
+            break;
+          }
+          // Only the files that use declarations whose interfaces changed
+          // need to be rebuilt.
+          DepGraph.markTransitiveFromChangedProvides(Dependents, FinishedCmd);
+          break;
+        }
+      } else {
+        // If there's an abnormal exit (a crash), assume the worst.
+        switch (FinishedCmd->getCondition()) {
+        case Job::Condition::NewlyAdded:
+          // The job won't be treated as newly added next time. Conservatively
+          // mark it as affecting other jobs, because some of them may have
+          // completed already.
+          DepGraph.markTransitive(Dependents, FinishedCmd);
+          break;
+        case Job::Condition::Always:
+          // Any incremental task that shows up here has already been marked;
+          // we didn't need to wait for it to finish to start downstream
+          // tasks.
+          assert(DepGraph.isMarked(FinishedCmd));
+          break;
+        case Job::Condition::RunWithoutCascading:
+          // If this file changed, it might have been a non-cascading change
+          // and it might not. Unfortunately, the interface hash has been
+          // updated or compromised, so we don't actually know anymore; we
+          // have to conservatively assume the changes could affect other
+          // files.
+          DepGraph.markTransitive(Dependents, FinishedCmd);
+          break;
+        case Job::Condition::CheckDependencies:
+          // If the only reason we're running this is because something else
+          // changed, then we can trust the dependency graph as to whether
+          // it's a cascading or non-cascading change. That is, if whatever
+          // /caused/ the error isn't supposed to affect other files, and
+          // whatever /fixes/ the error isn't supposed to affect other files,
+          // then there's no need to recompile any other inputs. If either of
+          // those are false, we /do/ need to recompile other inputs.
+          break;
+        }
+      }
+    }
   };
 
   // Set up a callback which will be called immediately after a task has
@@ -474,17 +872,40 @@ int Compilation::performJobsImpl() {
   // it should also schedule any additional commands which we now know need
   // to run.
   auto taskFinished = [&] (ProcessId Pid, int ReturnCode, StringRef Output,
-                           void *Context) -> TaskFinishedResponse {
+                           void *Context,
+                           const TaskResourceUsage &Usage)
+      -> TaskFinishedResponse {
     const Job *FinishedCmd = (const Job *)Context;
+    ArrayRef<const Job *> FinishedCmds = getCommandsRunBy(FinishedCmd);
 
     if (ShowDriverTimeCompilation) {
       DriverTimers[FinishedCmd]->stopTimer();
     }
 
+    // Record the resources used for scheduling the next build. The jobs in a
+    // batch are assumed to take equal shares of its time.
+    for (const Job *Cmd : FinishedCmds) {
+      TaskResourceUsage &CmdUsage = State.JobUsage[Cmd];
+      CmdUsage.WallTimeMilliseconds =
+        Usage.WallTimeMilliseconds / FinishedCmds.size();
+      CmdUsage.PeakRSSKilobytes = Usage.PeakRSSKilobytes;
+    }
+
+    if (ShowJobSchedule) {
+      llvm::outs() << "Finished ";
+      describeTask(llvm::outs(), FinishedCmd);
+      llvm::outs() << " in " << Usage.WallTimeMilliseconds << " ms, peak RSS "
+                   << Usage.PeakRSSKilobytes << " KB\n";
+    }
+
     if (Level == OutputLevel::Parseable) {
-      // Parseable output was requested.
-      parseable_output::emitFinishedMessage(llvm::errs(), *FinishedCmd, Pid,
-                                            ReturnCode, Output);
+      // Parseable output was requested. The output of a batch can't be split
+      // by job, so it all goes with the first one.
+      for (size_t i = 0, e = FinishedCmds.size(); i != e; ++i) {
+        parseable_output::emitFinishedMessage(llvm::errs(), *FinishedCmds[i],
+                                              Pid, ReturnCode,
+                                              i == 0 ? Output : "");
+      }
     } else {
       // Otherwise, send the buffered output to stderr, though only if we
       // support getting buffered output.
@@ -496,78 +917,9 @@ int Compilation::performJobsImpl() {
     // dependencies that have arisen, we need to reload the dependency file.
     // Do this whether or not the build succeeded.
     SmallVector<const Job *, 16> Dependents;
-    if (getIncrementalBuildEnabled()) {
-      const CommandOutput &Output = FinishedCmd->getOutput();
-      StringRef DependenciesFile =
-        Output.getAdditionalOutputForType(types::TY_SwiftDeps);
-
-      if (DependenciesFile.empty()) {
-        // If this job doesn't track dependencies, it must always be run.
-        // Note: In theory CheckDependencies makes sense as well (for a leaf
-        // node in the dependency graph), and maybe even NewlyAdded (for very
-        // coarse dependencies that always affect downstream nodes), but we're
-        // not using either of those right now, and this logic should probably
-        // be revisited when we are.
-        assert(FinishedCmd->getCondition() == Job::Condition::Always);
-      } else {
-        // If we have a dependency file /and/ the frontend task exited normally,
-        // we can be discerning about what downstream files to rebuild.
-        if (ReturnCode == EXIT_SUCCESS || ReturnCode == EXIT_FAILURE) {
-          bool wasCascading = DepGraph.isMarked(FinishedCmd);
-
-          switch (DepGraph.loadFromPath(FinishedCmd, DependenciesFile)) {
-          case DependencyGraphImpl::LoadResult::HadError:
-            if (ReturnCode == EXIT_SUCCESS) {
-              disableIncrementalBuild();
-              for (const Job *Cmd : DeferredCommands)
-                scheduleCommandIfNecessaryAndPossible(Cmd);
-              DeferredCommands.clear();
-              Dependents.clear();
-            } // else, let the next build handle it.
-            break;
-          case DependencyGraphImpl::LoadResult::UpToDate:
-            if (!wasCascading)
-              break;
-            SWIFT_FALLTHROUGH;
-          case DependencyGraphImpl::LoadResult::AffectsDownstream:
-            DepGraph.markTransitive(Dependents, FinishedCmd);
-            break;
-          }
-        } else {
-          // If there's an abnormal exit (a crash), assume the worst.
-          switch (FinishedCmd->getCondition()) {
-          case Job::Condition::NewlyAdded:
-            // The job won't be treated as newly added next time. Conservatively
-            // mark it as affecting other jobs, because some of them may have
-            // completed already.
-            DepGraph.markTransitive(Dependents, FinishedCmd);
-            break;
-          case Job::Condition::Always:
-            // Any incremental task that shows up here has already been marked;
-            // we didn't need to wait for it to finish to start downstream
-            // tasks.
-            assert(DepGraph.isMarked(FinishedCmd));
-            break;
-          case Job::Condition::RunWithoutCascading:
-            // If this file changed, it might have been a non-cascading change
-            // and it might not. Unfortunately, the interface hash has been
-            // updated or compromised, so we don't actually know anymore; we
-            // have to conservatively assume the changes could affect other
-            // files.
-            DepGraph.markTransitive(Dependents, FinishedCmd);
-            break;
-          case Job::Condition::CheckDependencies:
-            // If the only reason we're running this is because something else
-            // changed, then we can trust the dependency graph as to whether
-            // it's a cascading or non-cascading change. That is, if whatever
-            // /caused/ the error isn't supposed to affect other files, and
-            // whatever /fixes/ the error isn't supposed to affect other files,
-            // then there's no need to recompile any other inputs. If either of
-            // those are false, we /do/ need to recompile other inputs.
-            break;
-          }
-        }
-      }
+    for (const Job *Cmd : FinishedCmds) {
+      if (getIncrementalBuildEnabled())
+        reloadDependencies(Cmd, ReturnCode, Dependents);
     }
 
     if (ReturnCode != EXIT_SUCCESS) {
@@ -586,14 +938,16 @@ int Compilation::performJobsImpl() {
                        ReturnCode);
       }
 
-      return ContinueBuildingAfterErrors ?
-          TaskFinishedResponse::ContinueExecution :
-          TaskFinishedResponse::StopExecution;
+      if (!ContinueBuildingAfterErrors)
+        return TaskFinishedResponse::StopExecution;
+      flushReadyCommands();
+      return TaskFinishedResponse::ContinueExecution;
     }
 
     // When a task finishes, we need to reevaluate the other commands that
     // might have been blocked.
-    markFinished(FinishedCmd);
+    for (const Job *Cmd : FinishedCmds)
+      markFinished(Cmd);
 
     for (const Job *Cmd : Dependents) {
       DeferredCommands.erase(Cmd);
@@ -601,6 +955,7 @@ int Compilation::performJobsImpl() {
       scheduleCommandIfNecessaryAndPossible(Cmd);
     }
 
+    flushReadyCommands();
     return TaskFinishedResponse::ContinueExecution;
   };
 
@@ -614,8 +969,12 @@ int Compilation::performJobsImpl() {
 
     if (Level == OutputLevel::Parseable) {
       // Parseable output was requested.
-      parseable_output::emitSignalledMessage(llvm::errs(), *SignalledCmd, Pid,
-                                             ErrorMsg, Output);
+      ArrayRef<const Job *> SignalledCmds = getCommandsRunBy(SignalledCmd);
+      for (size_t i = 0, e = SignalledCmds.size(); i != e; ++i) {
+        parseable_output::emitSignalledMessage(llvm::errs(), *SignalledCmds[i],
+                                               Pid, ErrorMsg,
+                                               i == 0 ? Output : "");
+      }
     } else {
       // Otherwise, send the buffered output to stderr, though only if we
       // support getting buffered output.
@@ -636,6 +995,8 @@ int Compilation::performJobsImpl() {
     return TaskFinishedResponse::StopExecution;
   };
 
+  flushReadyCommands();
+
   do {
     // Ask the TaskQueue to execute.
     TQ->execute(taskBegan, taskFinished, taskSignalled);
@@ -653,6 +1014,7 @@ int Compilation::performJobsImpl() {
     }
 
     // ...which may allow us to go on and do later tasks.
+    flushReadyCommands();
   } while (Result == 0 && TQ->hasRemainingTasks());
 
   if (Result == 0) {
@@ -684,8 +1046,64 @@ int Compilation::performJobsImpl() {
     InputInfoMap InputInfo;
     populateInputInfoMap(InputInfo, State);
     checkForOutOfDateInputs(Diags, InputInfo);
+
+    // Jobs that didn't run this time keep their times from the last build.
+    JobUsageMap JobUsage;
+    for (const Job *Cmd : getJobs()) {
+      StringRef Key = getJobUsageKey(Cmd);
+      auto Measured = State.JobUsage.find(Cmd);
+      if (Measured != State.JobUsage.end()) {
+        JobUsage[Key] = Measured->second;
+        continue;
+      }
+      auto Previous = PreviousJobUsage.find(Key);
+      if (Previous != PreviousJobUsage.end())
+        JobUsage.insert({Key, Previous->getValue()});
+    }
+
+    ContentHashMap InputHashMap;
+    ContentHashMap ExternalHashMap;
+    if (getFileHashingEnabled()) {
+      for (auto &entry : InputInfo) {
+        if (auto Hash = getInputHash(entry.first))
+          InputHashMap[entry.first->getValue()] = Hash->Hash;
+      }
+
+      // External dependencies that weren't hashed at the start of the build
+      // keep their hashes from the last one, unless they were just found.
+      // A new dependency's hash is only recorded if the file hasn't changed
+      // since the build started, since this build's jobs may have read an
+      // older version of it.
+      SmallVector<StringRef, 16> Unhashed;
+      for (StringRef Dep : DepGraph.getExternalDependencies()) {
+        auto Current = State.ExternalDependencyHashes.find(Dep);
+        if (Current != State.ExternalDependencyHashes.end()) {
+          ExternalHashMap[Dep] = Current->getValue();
+          continue;
+        }
+        auto Previous = PreviousExternalDependencyHashes.find(Dep);
+        if (Previous != PreviousExternalDependencyHashes.end()) {
+          ExternalHashMap[Dep] = Previous->getValue();
+          continue;
+        }
+        Unhashed.push_back(Dep);
+      }
+      auto NewHashes = hashFileContents(Unhashed);
+      for (size_t i = 0, e = Unhashed.size(); i != e; ++i) {
+        if (!NewHashes[i])
+          continue;
+        // Check the time after hashing, so that a write during hashing is
+        // caught too.
+        llvm::sys::fs::file_status DepStatus;
+        if (llvm::sys::fs::status(Unhashed[i], DepStatus) ||
+            !(DepStatus.getLastModificationTime() < BuildStartTime))
+          continue;
+        ExternalHashMap[Unhashed[i]] = *NewHashes[i];
+      }
+    }
+
     writeCompilationRecord(CompilationRecordPath, ArgsHash, BuildStartTime,
-                           InputInfo);
+                           InputInfo, JobUsage, InputHashMap, ExternalHashMap);
   }
 
   if (Result == 0)
@@ -0,0 +1,89 @@
+//===--- ContentHash.cpp - Hashes of file contents ------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Driver/ContentHash.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+using namespace swift;
+using namespace swift::driver;
+
+static Optional<ContentHash> hashFile(StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*FileSize=*/-1,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return None;
+
+  llvm::MD5 hash;
+  hash.update(buffer.get()->getBuffer());
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+
+  ContentHash contentHash;
+  static_assert(sizeof(result) == sizeof(contentHash), "not an MD5 hash");
+  memcpy(contentHash.data(), &result, sizeof(contentHash));
+  return contentHash;
+}
+
+std::vector<Optional<ContentHash>>
+swift::driver::hashFileContents(ArrayRef<StringRef> paths) {
+  std::vector<Optional<ContentHash>> hashes(paths.size());
+
+  // Each thread takes the next file that hasn't been hashed until there are
+  // none left, so one large file doesn't hold up the rest.
+  std::atomic<size_t> nextIndex(0);
+  auto hashFiles = [&] {
+    for (size_t i = nextIndex++; i < paths.size(); i = nextIndex++)
+      hashes[i] = hashFile(paths[i]);
+  };
+
+  size_t numThreads = std::min<size_t>(std::thread::hardware_concurrency(),
+                                       paths.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < numThreads; ++i)
+    threads.emplace_back(hashFiles);
+  hashFiles();
+  for (std::thread &thread : threads)
+    thread.join();
+
+  return hashes;
+}
+
+void swift::driver::writeContentHash(raw_ostream &out,
+                                     const ContentHash &hash) {
+  for (uint8_t byte : hash) {
+    out << llvm::hexdigit(byte >> 4, /*LowerCase=*/true)
+        << llvm::hexdigit(byte & 0xF, /*LowerCase=*/true);
+  }
+}
+
+Optional<ContentHash> swift::driver::parseContentHash(StringRef str) {
+  ContentHash hash;
+  if (str.size() != 2 * hash.size())
+    return None;
+
+  for (size_t i = 0, e = hash.size(); i != e; ++i) {
+    unsigned high = llvm::hexDigitValue(str[2 * i]);
+    unsigned low = llvm::hexDigitValue(str[2 * i + 1]);
+    if (high >= 16 || low >= 16)
+      return None;
+    hash[i] = (high << 4) | low;
+  }
+  return hash;
+}
@@ -12,8 +12,11 @@
 
 #include "swift/Driver/DependencyGraph.h"
 #include "swift/Basic/DemangleWrappers.h"
+#include "swift/Basic/ReferenceDependencyFile.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/raw_ostream.h"
@@ -46,17 +49,60 @@ DependencyGraphImpl::MarkTracerImpl::~MarkTracerImpl() = default;
 
 using LoadResult = DependencyGraphImpl::LoadResult;
 using DependencyKind = DependencyGraphImpl::DependencyKind;
-using DependencyCallbackTy = LoadResult(StringRef, DependencyKind, bool);
+using DependencyCallbackTy = LoadResult(StringRef, DependencyKind, bool,
+                                        StringRef);
 using InterfaceHashCallbackTy = LoadResult(StringRef);
 
+enum class DependencyDirection : bool {
+  Depends,
+  Provides
+};
+using KindAndDirection = std::pair<DependencyKind, DependencyDirection>;
+
+static KindAndDirection getKindAndDirection(ReferenceDependencySection section) {
+  switch (section) {
+  case ReferenceDependencySection::ProvidesTopLevel:
+    return {DependencyKind::TopLevelName, DependencyDirection::Provides};
+  case ReferenceDependencySection::ProvidesNominal:
+    return {DependencyKind::NominalType, DependencyDirection::Provides};
+  case ReferenceDependencySection::ProvidesMember:
+    return {DependencyKind::NominalTypeMember, DependencyDirection::Provides};
+  case ReferenceDependencySection::ProvidesDynamicLookup:
+    return {DependencyKind::DynamicLookupName, DependencyDirection::Provides};
+  case ReferenceDependencySection::DependsTopLevel:
+    return {DependencyKind::TopLevelName, DependencyDirection::Depends};
+  case ReferenceDependencySection::DependsMember:
+    return {DependencyKind::NominalTypeMember, DependencyDirection::Depends};
+  case ReferenceDependencySection::DependsNominal:
+    return {DependencyKind::NominalType, DependencyDirection::Depends};
+  case ReferenceDependencySection::DependsDynamicLookup:
+    return {DependencyKind::DynamicLookupName, DependencyDirection::Depends};
+  case ReferenceDependencySection::DependsExternal:
+    return {DependencyKind::ExternalFile, DependencyDirection::Depends};
+  }
+  llvm_unreachable("unhandled section");
+}
+
+// After an entry, we know more about the node as a whole.
+// Update the "result" variable in the caller.
+// This is a macro rather than a lambda because it contains a return.
+#define UPDATE_RESULT(update) switch (update) {\
+    case LoadResult::HadError: \
+      return LoadResult::HadError; \
+    case LoadResult::UpToDate: \
+      break; \
+    case LoadResult::AffectsDownstream: \
+      result = LoadResult::AffectsDownstream; \
+      break; \
+    } \
+
 static LoadResult
-parseDependencyFile(llvm::MemoryBuffer &buffer,
-                    llvm::function_ref<DependencyCallbackTy> providesCallback,
-                    llvm::function_ref<DependencyCallbackTy> dependsCallback,
-                    llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
+parseYAMLDependencyFile(llvm::MemoryBuffer &buffer,
+                        llvm::function_ref<DependencyCallbackTy> providesCallback,
+                        llvm::function_ref<DependencyCallbackTy> dependsCallback,
+                        llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
   namespace yaml = llvm::yaml;
 
-  // FIXME: Switch to a format other than YAML.
   llvm::SourceMgr SM;
   yaml::Stream stream(buffer.getMemBufferRef(), SM);
   auto I = stream.begin();
@@ -73,19 +119,6 @@ parseDependencyFile(llvm::MemoryBuffer &buffer,
   LoadResult result = LoadResult::UpToDate;
   SmallString<64> scratch;
 
-  // After an entry, we know more about the node as a whole.
-  // Update the "result" variable above.
-  // This is a macro rather than a lambda because it contains a return.
-#define UPDATE_RESULT(update) switch (update) {\
-    case LoadResult::HadError: \
-      return LoadResult::HadError; \
-    case LoadResult::UpToDate: \
-      break; \
-    case LoadResult::AffectsDownstream: \
-      result = LoadResult::AffectsDownstream; \
-      break; \
-    } \
-
   // FIXME: LLVM's YAML support does incremental parsing in such a way that
   // for-range loops break.
   for (auto i = topLevelMap->begin(), e = topLevelMap->end(); i != e; ++i) {
@@ -106,108 +139,131 @@ parseDependencyFile(llvm::MemoryBuffer &buffer,
       UPDATE_RESULT(interfaceHashCallback(valueString));
 
     } else {
-      enum class DependencyDirection : bool {
-        Depends,
-        Provides
-      };
-      using KindPair = std::pair<DependencyKind, DependencyDirection>;
-
-      KindPair dirAndKind = llvm::StringSwitch<KindPair>(key->getValue(scratch))
-        .Case("depends-top-level",
-              std::make_pair(DependencyKind::TopLevelName,
-                             DependencyDirection::Depends))
-        .Case("depends-nominal",
-              std::make_pair(DependencyKind::NominalType,
-                             DependencyDirection::Depends))
-        .Case("depends-member",
-              std::make_pair(DependencyKind::NominalTypeMember,
-                             DependencyDirection::Depends))
+      using SectionTy = Optional<ReferenceDependencySection>;
+      SectionTy section = llvm::StringSwitch<SectionTy>(keyString)
+        .Case("depends-top-level", ReferenceDependencySection::DependsTopLevel)
+        .Case("depends-nominal", ReferenceDependencySection::DependsNominal)
+        .Case("depends-member", ReferenceDependencySection::DependsMember)
         .Case("depends-dynamic-lookup",
-              std::make_pair(DependencyKind::DynamicLookupName,
-                             DependencyDirection::Depends))
-        .Case("depends-external",
-              std::make_pair(DependencyKind::ExternalFile,
-                             DependencyDirection::Depends))
+              ReferenceDependencySection::DependsDynamicLookup)
+        .Case("depends-external", ReferenceDependencySection::DependsExternal)
         .Case("provides-top-level",
-              std::make_pair(DependencyKind::TopLevelName,
-                             DependencyDirection::Provides))
-        .Case("provides-nominal",
-              std::make_pair(DependencyKind::NominalType,
-                             DependencyDirection::Provides))
-        .Case("provides-member",
-              std::make_pair(DependencyKind::NominalTypeMember,
-                             DependencyDirection::Provides))
+              ReferenceDependencySection::ProvidesTopLevel)
+        .Case("provides-nominal", ReferenceDependencySection::ProvidesNominal)
+        .Case("provides-member", ReferenceDependencySection::ProvidesMember)
         .Case("provides-dynamic-lookup",
-              std::make_pair(DependencyKind::DynamicLookupName,
-                             DependencyDirection::Provides))
-        .Default(std::make_pair(DependencyKind(),
-                                DependencyDirection::Depends));
-      if (dirAndKind.first == DependencyKind())
+              ReferenceDependencySection::ProvidesDynamicLookup)
+        .Default(None);
+      if (!section)
         return LoadResult::HadError;
+      KindAndDirection dirAndKind = getKindAndDirection(*section);
 
       auto *entries = dyn_cast<yaml::SequenceNode>(i->getValue());
       if (!entries)
         return LoadResult::HadError;
 
-      if (dirAndKind.first == DependencyKind::NominalTypeMember) {
-        // Handle member dependencies specially. Rather than being a single
-        // string, they come in the form ["{MangledBaseName}", "memberName"].
-        for (yaml::Node &rawEntry : *entries) {
-          bool isCascading = rawEntry.getRawTag() != "!private";
+      bool isDepends = dirAndKind.second == DependencyDirection::Depends;
+      auto &callback = isDepends ? dependsCallback : providesCallback;
 
-          auto *entry = dyn_cast<yaml::SequenceNode>(&rawEntry);
-          if (!entry)
-            return LoadResult::HadError;
+      bool isMember = dirAndKind.first == DependencyKind::NominalTypeMember;
+      for (yaml::Node &rawEntry : *entries) {
+        bool isCascading = rawEntry.getRawTag() != "!private";
 
-          auto iter = entry->begin();
-          auto *base = dyn_cast<yaml::ScalarNode>(&*iter);
-          if (!base)
+        // A plain name is a single string; anything else is a sequence.
+        if (auto *entry = dyn_cast<yaml::ScalarNode>(&rawEntry)) {
+          if (isMember)
             return LoadResult::HadError;
-          ++iter;
+          UPDATE_RESULT(callback(entry->getValue(scratch), dirAndKind.first,
+                                 isCascading, StringRef()));
+          continue;
+        }
 
-          auto *member = dyn_cast<yaml::ScalarNode>(&*iter);
-          if (!member)
+        // Member dependencies come in the form
+        // ["{MangledBaseName}", "memberName"]. Provided names may also be
+        // followed by a fingerprint.
+        auto *entry = dyn_cast<yaml::SequenceNode>(&rawEntry);
+        if (!entry)
+          return LoadResult::HadError;
+
+        SmallVector<std::string, 3> parts;
+        for (yaml::Node &rawPart : *entry) {
+          auto *part = dyn_cast<yaml::ScalarNode>(&rawPart);
+          if (!part)
             return LoadResult::HadError;
-          ++iter;
+          parts.push_back(part->getValue(scratch));
+        }
 
-          // FIXME: LLVM's YAML support doesn't implement == correctly for end
-          // iterators.
-          assert(!(iter != entry->end()));
+        size_t numNameParts = isMember ? 2 : 1;
+        bool hasFingerprint = parts.size() == numNameParts + 1 && !isDepends;
+        if (parts.size() != numNameParts && !hasFingerprint)
+          return LoadResult::HadError;
+
+        // Smash the type and member names together so we can continue using
+        // StringMap.
+        SmallString<64> name;
+        name += parts[0];
+        if (isMember) {
+          name.push_back('\0');
+          name += parts[1];
+        }
+        StringRef fingerprint;
+        if (hasFingerprint)
+          fingerprint = parts.back();
 
-          bool isDepends = dirAndKind.second == DependencyDirection::Depends;
-          auto &callback = isDepends ? dependsCallback : providesCallback;
+        UPDATE_RESULT(callback(name.str(), dirAndKind.first, isCascading,
+                               fingerprint));
+      }
+    }
+  }
 
-          // Smash the type and member names together so we can continue using
-          // StringMap.
-          SmallString<64> appended;
-          appended += base->getValue(scratch);
-          appended.push_back('\0');
-          appended += member->getValue(scratch);
+  return result;
+}
 
-          UPDATE_RESULT(callback(appended.str(), dirAndKind.first,
-                                 isCascading));
-        }
-      } else {
-        for (const yaml::Node &rawEntry : *entries) {
-          auto *entry = dyn_cast<yaml::ScalarNode>(&rawEntry);
-          if (!entry)
-            return LoadResult::HadError;
+static LoadResult
+parseBinaryDependencyFile(llvm::MemoryBuffer &buffer,
+                          llvm::function_ref<DependencyCallbackTy> providesCallback,
+                          llvm::function_ref<DependencyCallbackTy> dependsCallback,
+                          llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
+  BinaryReferenceDependencyFile file;
+  if (!file.init(buffer.getBuffer()))
+    return LoadResult::HadError;
 
-          bool isDepends = dirAndKind.second == DependencyDirection::Depends;
-          auto &callback = isDepends ? dependsCallback : providesCallback;
+  LoadResult result = LoadResult::UpToDate;
 
-          UPDATE_RESULT(callback(entry->getValue(scratch), dirAndKind.first,
-                                 entry->getRawTag() != "!private"));
-        }
-      }
-    }
+  // Member names are already stored in the form the callbacks expect, so
+  // every name is passed straight out of the buffer.
+  for (unsigned i = 0, e = file.getNumEntries(); i != e; ++i) {
+    ReferenceDependencyEntry entry = file.getEntry(i);
+    KindAndDirection dirAndKind = getKindAndDirection(entry.Section);
+    bool isDepends = dirAndKind.second == DependencyDirection::Depends;
+    auto &callback = isDepends ? dependsCallback : providesCallback;
+    UPDATE_RESULT(callback(entry.Name, dirAndKind.first, entry.IsCascading,
+                           entry.Fingerprint));
   }
 
+  if (file.hasInterfaceHash())
+    UPDATE_RESULT(interfaceHashCallback(file.getInterfaceHash()));
+
   return result;
 }
 
+static LoadResult
+parseDependencyFile(llvm::MemoryBuffer &buffer,
+                    llvm::function_ref<DependencyCallbackTy> providesCallback,
+                    llvm::function_ref<DependencyCallbackTy> dependsCallback,
+                    llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
+  if (BinaryReferenceDependencyFile::isBinary(buffer.getBuffer()))
+    return parseBinaryDependencyFile(buffer, providesCallback, dependsCallback,
+                                     interfaceHashCallback);
+  return parseYAMLDependencyFile(buffer, providesCallback, dependsCallback,
+                                 interfaceHashCallback);
+}
+
 LoadResult DependencyGraphImpl::loadFromPath(const void *node, StringRef path) {
-  auto buffer = llvm::MemoryBuffer::getFile(path);
+  // Neither parser needs a null terminator, and without one the file can be
+  // mapped rather than read. A binary file is then used in place.
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*FileSize=*/-1,
+                                            /*RequiresNullTerminator=*/false);
   if (!buffer)
     return LoadResult::HadError;
   return loadFromBuffer(node, *buffer.get());
@@ -223,10 +279,22 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
                                                llvm::MemoryBuffer &buffer) {
   auto &provides = Provides[node];
 
-  auto dependsCallback = [this, node](StringRef name, DependencyKind kind,
-                                      bool isCascading) -> LoadResult {
+  // Provided names start out as changed, so that anything this file no
+  // longer provides is treated as changed too.
+  size_t numPreviousProvides = provides.size();
+  SmallVector<bool, 16> seenPreviousProvides(numPreviousProvides, false);
+  bool dependsAffectDownstream = false;
+
+  // The names this file uses, with member names reduced to their type.
+  llvm::StringSet<> usedNames;
+
+  auto dependsCallback = [&](StringRef name, DependencyKind kind,
+                             bool isCascading,
+                             StringRef fingerprint) -> LoadResult {
     if (kind == DependencyKind::ExternalFile)
       ExternalDependencies.insert(name);
+    else
+      usedNames.insert(name.split('\0').first);
 
     auto &entries = Dependencies[name];
     auto iter = std::find_if(entries.first.begin(), entries.first.end(),
@@ -245,24 +313,40 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
       iter->flags |= flags;
     }
 
-    if (isCascading && (entries.second & kind))
+    if (isCascading && (entries.second & kind)) {
+      dependsAffectDownstream = true;
       return LoadResult::AffectsDownstream;
+    }
     return LoadResult::UpToDate;
   };
 
   auto providesCallback =
-      [this, node, &provides](StringRef name, DependencyKind kind,
-                              bool isCascading) -> LoadResult {
+      [&](StringRef name, DependencyKind kind, bool isCascading,
+          StringRef fingerprint) -> LoadResult {
     assert(isCascading);
     auto iter = std::find_if(provides.begin(), provides.end(),
                              [name](const ProvidesEntryTy &entry) -> bool {
       return name == entry.name;
     });
 
-    if (iter == provides.end())
-      provides.push_back({name, kind});
-    else
-      iter->kindMask |= kind;
+    if (iter == provides.end()) {
+      provides.push_back({name, kind, fingerprint, /*changed=*/true});
+      return LoadResult::UpToDate;
+    }
+
+    iter->kindMask |= kind;
+
+    // A name without a fingerprint always counts as changed. If a name is
+    // provided with several kinds, all of them have to match.
+    bool changed = fingerprint.empty() || fingerprint != iter->fingerprint;
+    size_t index = iter - provides.begin();
+    if (index < numPreviousProvides && !seenPreviousProvides[index]) {
+      seenPreviousProvides[index] = true;
+      iter->changed = changed;
+    } else {
+      iter->changed |= changed;
+    }
+    iter->fingerprint = fingerprint;
 
     return LoadResult::UpToDate;
   };
@@ -285,8 +369,32 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
     return LoadResult::UpToDate;
   };
 
-  return parseDependencyFile(buffer, providesCallback, dependsCallback,
-                             interfaceHashCallback);
+  LoadResult result = parseDependencyFile(buffer, providesCallback,
+                                          dependsCallback,
+                                          interfaceHashCallback);
+
+  for (size_t i = 0; i != numPreviousProvides; ++i) {
+    if (!seenPreviousProvides[i])
+      provides[i].changed = true;
+  }
+
+  // If this node is affected by something it depends on, the fingerprints
+  // can't be trusted: they only cover the tokens of each declaration, not
+  // anything inferred from other files.  The same goes for a changed name
+  // that this file uses itself, as in "let x = foo()" when foo's result
+  // type changes.
+  bool usesChangedName =
+    std::any_of(provides.begin(), provides.end(),
+                [&](const ProvidesEntryTy &entry) -> bool {
+      return entry.changed &&
+             usedNames.count(StringRef(entry.name).split('\0').first);
+    });
+  if (dependsAffectDownstream || usesChangedName) {
+    for (auto &entry : provides)
+      entry.changed = true;
+  }
+
+  return result;
 }
 
 void DependencyGraphImpl::markExternal(SmallVectorImpl<const void *> &visited,
@@ -308,7 +416,8 @@ void DependencyGraphImpl::markExternal(SmallVectorImpl<const void *> &visited,
 
 void
 DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
-                                    const void *node, MarkTracerImpl *tracer) {
+                                    const void *node, MarkTracerImpl *tracer,
+                                    bool onlyChangedProvides) {
   assert(Provides.count(node) && "node is not in the graph");
   llvm::SpecificBumpPtrAllocator<MarkTracerImpl::Entry> scratchAlloc;
 
@@ -322,12 +431,16 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
   SmallPtrSet<const void *, 16> visitedSet;
 
   auto addDependentsToWorklist = [&](const void *next,
-                                     ArrayRef<MarkTracerImpl::Entry> reason) {
+                                     ArrayRef<MarkTracerImpl::Entry> reason,
+                                     bool onlyChanged) {
     auto allProvided = Provides.find(next);
     if (allProvided == Provides.end())
       return;
 
     for (const auto &provided : allProvided->second) {
+      if (onlyChanged && !provided.changed)
+        continue;
+
       auto allDependents = Dependencies.find(provided.name);
       if (allDependents == Dependencies.end())
         continue;
@@ -374,7 +487,7 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
 
   // Always mark through the starting node, even if it's already marked.
   markIntransitive(node);
-  addDependentsToWorklist(node, {});
+  addDependentsToWorklist(node, {}, onlyChangedProvides);
 
   while (!worklist.empty()) {
     auto next = worklist.pop_back_val();
@@ -386,7 +499,7 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
       continue;
     }
 
-    addDependentsToWorklist(next.Node, next.Reason);
+    addDependentsToWorklist(next.Node, next.Reason, /*onlyChanged=*/false);
     if (!markIntransitive(next.Node))
       continue;
     record(next);
@@ -192,7 +192,10 @@ class Driver::InputInfoMap
 };
 using InputInfoMap = Driver::InputInfoMap;
 
-static bool populateOutOfDateMap(InputInfoMap &map, StringRef argsHashStr,
+static bool populateOutOfDateMap(InputInfoMap &map,
+                                 llvm::StringMap<sys::TaskResourceUsage> &usage,
+                                 llvm::StringMap<ContentHash> &externalHashes,
+                                 StringRef argsHashStr,
                                  const InputFileList &inputs,
                                  StringRef buildRecordPath) {
   // Treat a missing file as "no previous build".
@@ -216,9 +219,36 @@ static bool populateOutOfDateMap(InputInfoMap &map, StringRef argsHashStr,
   SmallString<64> scratch;
 
   llvm::StringMap<InputInfo> previousInputs;
+  llvm::StringMap<ContentHash> previousInputHashes;
   bool versionValid = false;
   bool optionsMatch = true;
 
+  // Reads a mapping from file names to content hashes.
+  auto readHashes = [&scratch](yaml::Node *node,
+                               llvm::StringMap<ContentHash> &hashes) -> bool {
+    auto *hashMap = dyn_cast<yaml::MappingNode>(node);
+    if (!hashMap)
+      return true;
+
+    // FIXME: LLVM's YAML support does incremental parsing in such a way that
+    // for-range loops break.
+    for (auto i = hashMap->begin(), e = hashMap->end(); i != e; ++i) {
+      auto *key = dyn_cast<yaml::ScalarNode>(i->getKey());
+      if (!key)
+        return true;
+
+      auto *value = dyn_cast<yaml::ScalarNode>(i->getValue());
+      if (!value)
+        return true;
+      auto hash = parseContentHash(value->getValue(scratch));
+      if (!hash)
+        return true;
+
+      hashes[key->getValue(scratch)] = *hash;
+    }
+    return false;
+  };
+
   auto readTimeValue = [&scratch](yaml::Node *node,
                                   llvm::sys::TimeValue &timeValue) -> bool {
     auto *seq = dyn_cast<yaml::SequenceNode>(node);
@@ -317,6 +347,50 @@ static bool populateOutOfDateMap(InputInfoMap &map, StringRef argsHashStr,
         auto inputName = key->getValue(scratch);
         previousInputs[inputName] = { *previousBuildState, timeValue };
       }
+
+    } else if (keyStr == "input_hashes") {
+      if (readHashes(i->getValue(), previousInputHashes))
+        return true;
+
+    } else if (keyStr == "external_dependency_hashes") {
+      if (readHashes(i->getValue(), externalHashes))
+        return true;
+
+    } else if (keyStr == "job_usage") {
+      auto *usageMap = dyn_cast<yaml::MappingNode>(i->getValue());
+      if (!usageMap)
+        return true;
+
+      // Each entry is a job's wall time in milliseconds and its peak RSS in
+      // kilobytes. These are only used for scheduling, so they're kept even
+      // if the rest of the record turns out to be stale.
+      for (auto i = usageMap->begin(), e = usageMap->end(); i != e; ++i) {
+        auto *key = dyn_cast<yaml::ScalarNode>(i->getKey());
+        if (!key)
+          return true;
+
+        auto *value = dyn_cast<yaml::SequenceNode>(i->getValue());
+        if (!value)
+          return true;
+
+        SmallVector<uint64_t, 2> fields;
+        for (auto fieldI = value->begin(), fieldE = value->end();
+             fieldI != fieldE; ++fieldI) {
+          auto *field = dyn_cast<yaml::ScalarNode>(&*fieldI);
+          if (!field)
+            return true;
+          fields.emplace_back();
+          if (field->getValue(scratch).getAsInteger(10, fields.back()))
+            return true;
+        }
+        if (fields.size() != 2)
+          return true;
+
+        auto jobName = key->getValue(scratch);
+        sys::TaskResourceUsage &jobUsage = usage[jobName];
+        jobUsage.WallTimeMilliseconds = fields[0];
+        jobUsage.PeakRSSKilobytes = fields[1];
+      }
     }
   }
 
@@ -331,7 +405,14 @@ static bool populateOutOfDateMap(InputInfoMap &map, StringRef argsHashStr,
       continue;
     }
     ++numInputsFromPrevious;
-    map[inputPair.second] = iter->getValue();
+    InputInfo &info = map[inputPair.second];
+    info = iter->getValue();
+
+    auto hashIter = previousInputHashes.find(inputPair.second->getValue());
+    if (hashIter != previousInputHashes.end()) {
+      info.previousHash = hashIter->getValue();
+      info.hasPreviousHash = true;
+    }
   }
 
   // If a file was removed, we've lost its dependency info. Rebuild everything.
@@ -339,6 +420,48 @@ static bool populateOutOfDateMap(InputInfoMap &map, StringRef argsHashStr,
   return numInputsFromPrevious != previousInputs.size();
 }
 
+/// Hashes the contents of the source inputs for the build record.
+///
+/// Each input's modification time is read before its contents, and recorded
+/// with the hash.  Inputs whose modification times match the build record
+/// keep their recorded hashes; the rest are read and hashed in parallel.
+static llvm::DenseMap<const Arg *, InputHash>
+hashInputs(ArrayRef<InputPair> inputs, const InputInfoMap &previousInputs) {
+  llvm::DenseMap<const Arg *, InputHash> hashes;
+  SmallVector<const Arg *, 16> inputsToHash;
+  SmallVector<StringRef, 16> pathsToHash;
+  SmallVector<llvm::sys::TimeValue, 16> modTimesToHash;
+
+  for (auto &inputPair : inputs) {
+    if (!types::isPartOfSwiftCompilation(inputPair.first))
+      continue;
+    const Arg *input = inputPair.second;
+
+    llvm::sys::fs::file_status inputStatus;
+    if (llvm::sys::fs::status(input->getValue(), inputStatus))
+      continue;
+    llvm::sys::TimeValue modTime = inputStatus.getLastModificationTime();
+
+    auto previous = previousInputs.find(input);
+    if (previous != previousInputs.end() && previous->second.hasPreviousHash &&
+        modTime == previous->second.previousModTime) {
+      hashes[input] = {previous->second.previousHash, modTime};
+      continue;
+    }
+
+    inputsToHash.push_back(input);
+    pathsToHash.push_back(input->getValue());
+    modTimesToHash.push_back(modTime);
+  }
+
+  auto newHashes = hashFileContents(pathsToHash);
+  for (size_t i = 0, e = inputsToHash.size(); i != e; ++i) {
+    if (newHashes[i])
+      hashes[inputsToHash[i]] = {*newHashes[i], modTimesToHash[i]};
+  }
+  return hashes;
+}
+
 std::unique_ptr<Compilation> Driver::buildCompilation(
     ArrayRef<const char *> Args) {
   llvm::PrettyStackTraceString CrashInfo("Compilation construction");
@@ -361,10 +484,14 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
     ArgList->hasArg(options::OPT_driver_skip_execution);
   bool ShowIncrementalBuildDecisions =
     ArgList->hasArg(options::OPT_driver_show_incremental);
+  bool ShowJobSchedule = ArgList->hasArg(options::OPT_driver_show_schedule);
 
   bool Incremental = ArgList->hasArg(options::OPT_incremental) &&
     !ArgList->hasArg(options::OPT_whole_module_optimization) &&
     !ArgList->hasArg(options::OPT_embed_bitcode);
+  bool FileHashing = Incremental &&
+    ArgList->hasFlag(options::OPT_enable_incremental_file_hashing,
+                     options::OPT_disable_incremental_file_hashing, false);
 
   bool SaveTemps = ArgList->hasArg(options::OPT_save_temps);
   bool ContinueBuildingAfterErrors =
@@ -432,6 +559,9 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
   computeArgsHash(ArgsHash, *TranslatedArgList);
 
   InputInfoMap outOfDateMap;
+  llvm::StringMap<sys::TaskResourceUsage> previousJobUsage;
+  llvm::StringMap<ContentHash> previousExternalHashes;
+  StringRef buildRecordPath;
   bool rebuildEverything = true;
   if (Incremental) {
     if (!OFM) {
@@ -440,7 +570,6 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
       Diags.diagnose(SourceLoc(), diag::incremental_requires_output_file_map);
 
     } else {
-      StringRef buildRecordPath;
       if (auto *masterOutputMap = OFM->getOutputMapForSingleOutput()) {
         auto iter = masterOutputMap->find(types::TY_SwiftDeps);
         if (iter != masterOutputMap->end())
@@ -454,7 +583,8 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
         rebuildEverything = true;
 
       } else {
-        if (populateOutOfDateMap(outOfDateMap, ArgsHash, Inputs,
+        if (populateOutOfDateMap(outOfDateMap, previousJobUsage,
+                                 previousExternalHashes, ArgsHash, Inputs,
                                  buildRecordPath)) {
           // FIXME: Distinguish errors from "file removed", which is benign.
         } else {
@@ -486,6 +616,23 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
     }
   }
 
+  // Batch mode combines the compile jobs of a standard compile. Jobs that
+  // emit fix-its or use multiple threads keep their own invocations.
+  bool BatchMode =
+    ArgList->hasFlag(options::OPT_enable_batch_mode,
+                     options::OPT_disable_batch_mode, false) &&
+    OI.CompilerMode == OutputInfo::Mode::StandardCompile &&
+    !OI.ShouldGenerateFixitEdits && !OI.isMultiThreading();
+  unsigned BatchCount = NumberOfParallelCommands;
+  if (const Arg *A = ArgList->getLastArg(options::OPT_driver_batch_count)) {
+    if (StringRef(A->getValue()).getAsInteger(10, BatchCount) ||
+        BatchCount == 0) {
+      Diags.diagnose(SourceLoc(), diag::error_invalid_arg_value,
+                     A->getAsString(*ArgList), A->getValue());
+      return nullptr;
+    }
+  }
+
   OutputLevel Level = OutputLevel::Normal;
   if (const Arg *A = ArgList->getLastArg(options::OPT_v,
                                          options::OPT_parseable_output)) {
@@ -508,8 +655,18 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
                                                  SaveTemps,
                                                  ShowDriverTimeCompilation));
 
+  // Input hashes are needed to decide which jobs to run, so this has to
+  // happen before building jobs.
+  if (FileHashing && !buildRecordPath.empty()) {
+    C->enableFileHashing(hashInputs(C->getInputFiles(), outOfDateMap),
+                         std::move(previousExternalHashes));
+  }
+
   buildJobs(Actions, OI, OFM.get(), *TC, *C);
 
+  if (BatchMode)
+    C->enableBatchMode(*TC, OI, BatchCount);
+
   // For updating code we need to go through all the files and pick up changes,
   // even if they have compiler errors. Also for getting bulk fixits, or for when
   // users explicitly request to continue building despite errors.
@@ -521,6 +678,10 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
   if (ShowIncrementalBuildDecisions)
     C->setShowsIncrementalBuildDecisions();
 
+  if (ShowJobSchedule)
+    C->setShowsJobSchedule();
+  C->setPreviousJobUsage(std::move(previousJobUsage));
+
   // This has to happen after building jobs, because otherwise we won't even
   // emit .swiftdeps files for the next build.
   if (rebuildEverything)
@@ -1077,7 +1238,9 @@ void Driver::buildOutputInfo(const ToolChain &TC, const DerivedArgList &Args,
                         [&OI](sys::ProcessId PID,
                               int returnCode,
                               StringRef output,
-                              void *unused) -> sys::TaskFinishedResponse {
+                              void *unused,
+                              const sys::TaskResourceUsage &) ->
+                          sys::TaskFinishedResponse {
             if (returnCode == 0) {
               output = output.rtrim();
               auto lastLineStart = output.find_last_of("\n\r");
@@ -1606,21 +1769,35 @@ static void addAuxiliaryOutput(Compilation &C, CommandOutput &output,
 /// mtime has not changed), adjust the Job's condition accordingly.
 static void
 handleCompileJobCondition(Job *J, CompileJobAction::InputInfo inputInfo,
-                          StringRef input, bool alwaysRebuildDependents) {
+                          StringRef input, Optional<InputHash> inputHash,
+                          bool alwaysRebuildDependents) {
   if (inputInfo.status == CompileJobAction::InputInfo::NewlyAdded) {
     J->setCondition(Job::Condition::NewlyAdded);
     return;
   }
 
+  // If the input was hashed, use the modification time it had then, which is
+  // the one its hash goes with.
   bool hasValidModTime = false;
   llvm::sys::fs::file_status inputStatus;
-  if (!llvm::sys::fs::status(input, inputStatus)) {
+  if (inputHash) {
+    J->setInputModTime(inputHash->ModTime);
+    hasValidModTime = true;
+  } else if (!llvm::sys::fs::status(input, inputStatus)) {
     J->setInputModTime(inputStatus.getLastModificationTime());
     hasValidModTime = true;
   }
 
+  // A file that was touched without being modified can be treated as if it
+  // hadn't been touched at all.
+  bool isUnmodified =
+      hasValidModTime && J->getInputModTime() == inputInfo.previousModTime;
+  if (!isUnmodified && inputHash && inputInfo.hasPreviousHash) {
+    isUnmodified = (inputHash->Hash == inputInfo.previousHash);
+  }
+
   Job::Condition condition;
-  if (hasValidModTime && J->getInputModTime() == inputInfo.previousModTime) {
+  if (isUnmodified) {
     switch (inputInfo.status) {
     case CompileJobAction::InputInfo::UpToDate:
       if (llvm::sys::fs::exists(J->getOutput().getPrimaryOutputFilename()))
@@ -1895,7 +2072,10 @@ Job *Driver::buildJobsForAction(Compilation &C, const JobAction *JA,
       auto compileJob = cast<CompileJobAction>(JA);
       bool alwaysRebuildDependents =
           C.getArgs().hasArg(options::OPT_driver_always_rebuild_dependents);
+      const Arg &InputArg =
+          cast<InputAction>(InputActions.front())->getInputArg();
       handleCompileJobCondition(J, compileJob->getInputInfo(), BaseInput,
+                                C.getInputHash(&InputArg),
                                 alwaysRebuildDependents);
     }
   }
@@ -121,6 +121,43 @@ ToolChain::constructJob(const JobAction &JA,
                                 std::move(invocationInfo.FilelistInfo));
 }
 
+std::unique_ptr<Job>
+ToolChain::constructBatchJob(ArrayRef<const Job *> jobs,
+                             Compilation &C,
+                             const OutputInfo &OI) const {
+  assert(jobs.size() > 1 && "a batch of one job is just that job");
+  assert(OI.CompilerMode == OutputInfo::Mode::StandardCompile &&
+         "only standard compiles can be batched");
+  const Job *firstJob = jobs.front();
+
+  auto output = llvm::make_unique<CommandOutput>(
+      firstJob->getOutput().getPrimaryOutputType());
+  ActionList inputActions;
+  for (const Job *job : jobs) {
+    assert(isa<CompileJobAction>(job->getSource()) && job->getInputs().empty());
+    const CommandOutput &jobOutput = job->getOutput();
+    ArrayRef<std::string> outputFilenames =
+        jobOutput.getPrimaryOutputFilenames();
+    for (unsigned i = 0, e = outputFilenames.size(); i != e; ++i)
+      output->addPrimaryOutput(outputFilenames[i], jobOutput.getBaseInput(i));
+    inputActions.append(job->getSource().begin(), job->getSource().end());
+  }
+
+  JobContext context{C, {}, inputActions, *output, OI};
+  context.BatchedJobs = jobs;
+  InvocationInfo invocationInfo =
+      constructInvocation(cast<CompileJobAction>(firstJob->getSource()),
+                          context);
+
+  SmallVector<const Job *, 4> noInputs;
+  return llvm::make_unique<Job>(firstJob->getSource(), std::move(noInputs),
+                                std::move(output),
+                                firstJob->getExecutable(),
+                                std::move(invocationInfo.Arguments),
+                                std::move(invocationInfo.ExtraEnvironment),
+                                std::move(invocationInfo.FilelistInfo));
+}
+
 std::string
 ToolChain::findProgramRelativeToSwift(StringRef executableName) const {
   auto insertionResult =
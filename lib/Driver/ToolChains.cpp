@@ -25,6 +25,7 @@
 #include "swift/Config.h"
 #include "clang/Basic/Version.h"
 #include "clang/Driver/Util.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Option/Arg.h"
 #include "llvm/Option/ArgList.h"
@@ -247,30 +248,32 @@ ToolChain::constructInvocation(const CompileJobAction &job,
   switch (context.OI.CompilerMode) {
   case OutputInfo::Mode::StandardCompile:
   case OutputInfo::Mode::UpdateCode: {
-    assert(context.InputActions.size() == 1 &&
-           "The Swift frontend expects exactly one input (the primary file)!");
-
-    auto *IA = cast<InputAction>(context.InputActions[0]);
-    const Arg &PrimaryInputArg = IA->getInputArg();
+    assert((context.BatchedJobs.empty() ?
+              context.InputActions.size() == 1 :
+              context.InputActions.size() == context.BatchedJobs.size()) &&
+           "The Swift frontend expects exactly one input per primary file!");
 
     if (context.Args.hasArg(options::OPT_driver_use_filelists) ||
         context.getTopLevelInputFiles().size() > TOO_MANY_FILES) {
       Arguments.push_back("-filelist");
       Arguments.push_back(context.getAllSourcesPath());
-      Arguments.push_back("-primary-file");
-      PrimaryInputArg.render(context.Args, Arguments);
+      for (const Action *A : context.InputActions) {
+        Arguments.push_back("-primary-file");
+        cast<InputAction>(A)->getInputArg().render(context.Args, Arguments);
+      }
     } else {
-      bool FoundPrimaryInput = false;
+      llvm::SmallDenseSet<unsigned, 4> PrimaryInputIndices;
+      for (const Action *A : context.InputActions)
+        PrimaryInputIndices.insert(
+            cast<InputAction>(A)->getInputArg().getIndex());
+
       for (auto inputPair : context.getTopLevelInputFiles()) {
         if (!types::isPartOfSwiftCompilation(inputPair.first))
           continue;
 
         // See if this input should be passed with -primary-file.
-        if (!FoundPrimaryInput &&
-            PrimaryInputArg.getIndex() == inputPair.second->getIndex()) {
+        if (PrimaryInputIndices.erase(inputPair.second->getIndex()))
           Arguments.push_back("-primary-file");
-          FoundPrimaryInput = true;
-        }
         Arguments.push_back(inputPair.second->getValue());
       }
     }
@@ -312,12 +315,32 @@ ToolChain::constructInvocation(const CompileJobAction &job,
   Arguments.push_back("-module-name");
   Arguments.push_back(context.Args.MakeArgString(context.OI.ModuleName));
 
-  const std::string &ModuleOutputPath =
-    context.Output.getAdditionalOutputForType(types::ID::TY_SwiftModuleFile);
-  if (!ModuleOutputPath.empty()) {
-    Arguments.push_back("-emit-module-path");
-    Arguments.push_back(ModuleOutputPath.c_str());
-  }
+  // Adds the path of the output of the given type, if there is one. When
+  // compiling several primary files at once, there is one for each of them.
+  auto addOutputsOfType = [&](types::ID type, const char *optName) -> bool {
+    bool addedAny = false;
+    auto addOutput = [&](const CommandOutput &output) {
+      const std::string &path = output.getAdditionalOutputForType(type);
+      if (path.empty())
+        return;
+      Arguments.push_back(optName);
+      Arguments.push_back(path.c_str());
+      addedAny = true;
+    };
+    if (context.BatchedJobs.empty()) {
+      addOutput(context.Output);
+    } else {
+      for (const Job *batchedJob : context.BatchedJobs)
+        addOutput(batchedJob->getOutput());
+    }
+    return addedAny;
+  };
+
+  addOutputsOfType(types::TY_SwiftModuleFile, "-emit-module-path");
+
+  // addCommonFrontendArgs only knows about a single module doc output.
+  if (!context.BatchedJobs.empty())
+    addOutputsOfType(types::TY_SwiftModuleDocFile, "-emit-module-doc-path");
 
   const std::string &ObjCHeaderOutputPath =
     context.Output.getAdditionalOutputForType(types::ID::TY_ObjCHeader);
@@ -330,26 +353,12 @@ ToolChain::constructInvocation(const CompileJobAction &job,
     Arguments.push_back(ObjCHeaderOutputPath.c_str());
   }
 
-  const std::string &SerializedDiagnosticsPath =
-    context.Output.getAdditionalOutputForType(types::TY_SerializedDiagnostics);
-  if (!SerializedDiagnosticsPath.empty()) {
-    Arguments.push_back("-serialize-diagnostics-path");
-    Arguments.push_back(SerializedDiagnosticsPath.c_str());
-  }
-
-  const std::string &DependenciesPath =
-    context.Output.getAdditionalOutputForType(types::TY_Dependencies);
-  if (!DependenciesPath.empty()) {
-    Arguments.push_back("-emit-dependencies-path");
-    Arguments.push_back(DependenciesPath.c_str());
-  }
-
-  const std::string &ReferenceDependenciesPath =
-    context.Output.getAdditionalOutputForType(types::TY_SwiftDeps);
-  if (!ReferenceDependenciesPath.empty()) {
-    Arguments.push_back("-emit-reference-dependencies-path");
-    Arguments.push_back(ReferenceDependenciesPath.c_str());
-  }
+  addOutputsOfType(types::TY_SerializedDiagnostics,
+                   "-serialize-diagnostics-path");
+  addOutputsOfType(types::TY_Dependencies, "-emit-dependencies-path");
+  if (addOutputsOfType(types::TY_SwiftDeps,
+                       "-emit-reference-dependencies-path"))
+    Arguments.push_back("-binary-reference-dependencies");
 
   const std::string &FixitsPath =
     context.Output.getAdditionalOutputForType(types::TY_Remapping);
@@ -774,7 +783,9 @@ static bool findXcodeClangPath(llvm::SmallVectorImpl<char> &path) {
                   [&path](sys::ProcessId PID,
                           int returnCode,
                           StringRef output,
-                          void *unused) -> sys::TaskFinishedResponse {
+                          void *unused,
+                          const sys::TaskResourceUsage &) ->
+                    sys::TaskFinishedResponse {
       if (returnCode == 0) {
         output = output.rtrim();
         path.append(output.begin(), output.end());
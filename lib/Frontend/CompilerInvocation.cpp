@@ -98,10 +98,10 @@ static void debugFailWithCrash() {
 static bool readFileList(DiagnosticEngine &diags,
                          std::vector<std::string> &inputFiles,
                          const llvm::opt::Arg *filelistPath,
-                         const llvm::opt::Arg *primaryFileArg = nullptr,
-                         unsigned *primaryFileIndex = nullptr) {
-  assert((primaryFileArg == nullptr) || (primaryFileIndex != nullptr) &&
-         "did not provide argument for primary file index");
+                         ArrayRef<const llvm::opt::Arg *> primaryFileArgs = {},
+                         std::vector<unsigned> *primaryFileIndices = nullptr) {
+  assert((primaryFileArgs.empty() || primaryFileIndices != nullptr) &&
+         "did not provide argument for primary file indices");
 
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
       llvm::MemoryBuffer::getFile(filelistPath->getValue());
@@ -111,29 +111,103 @@ static bool readFileList(DiagnosticEngine &diags,
     return false;
   }
 
-  bool foundPrimaryFile = false;
-  if (primaryFileIndex) *primaryFileIndex = 0;
+  // Map each primary file to its position among the -primary-file arguments.
+  llvm::StringMap<unsigned> primaryFilePositions;
+  for (unsigned i = 0, e = primaryFileArgs.size(); i != e; ++i)
+    primaryFilePositions.insert({primaryFileArgs[i]->getValue(), i});
+
+  const unsigned notFound = ~0U;
+  if (primaryFileIndices)
+    primaryFileIndices->assign(primaryFileArgs.size(), notFound);
 
   for (StringRef line : make_range(llvm::line_iterator(*buffer.get()), {})) {
     inputFiles.push_back(line);
 
-    if (foundPrimaryFile || primaryFileArg == nullptr)
+    if (primaryFilePositions.empty())
       continue;
-    if (line == primaryFileArg->getValue())
-      foundPrimaryFile = true;
-    else
-      ++*primaryFileIndex;
+    auto found = primaryFilePositions.find(line);
+    if (found == primaryFilePositions.end())
+      continue;
+    unsigned &index = (*primaryFileIndices)[found->getValue()];
+    if (index == notFound)
+      index = inputFiles.size() - 1;
   }
 
-  if (primaryFileArg && !foundPrimaryFile) {
-    diags.diagnose(SourceLoc(), diag::error_primary_file_not_found,
-                   primaryFileArg->getValue(), filelistPath->getValue());
-    return false;
+  for (unsigned i = 0, e = primaryFileArgs.size(); i != e; ++i) {
+    if ((*primaryFileIndices)[i] == notFound) {
+      diags.diagnose(SourceLoc(), diag::error_primary_file_not_found,
+                     primaryFileArgs[i]->getValue(), filelistPath->getValue());
+      return false;
+    }
   }
 
   return true;
 }
 
+/// In batch mode, reads the outputs of each primary input, which are given
+/// once per primary input and in the same order.
+///
+/// \returns true on error.
+static bool parseBatchPrimaryInputs(FrontendOptions &Opts, ArgList &Args,
+                                    DiagnosticEngine &Diags,
+                                    ArrayRef<SelectedInput> PrimaryInputs) {
+  using namespace options;
+
+  for (SelectedInput Input : PrimaryInputs)
+    Opts.BatchPrimaryInputs.push_back(Input);
+
+  if (Opts.actionHasOutput() &&
+      Opts.OutputFilenames.size() != PrimaryInputs.size()) {
+    Diags.diagnose(SourceLoc(), diag::error_batch_mode_output_count, "-o",
+                   PrimaryInputs.size());
+    return true;
+  }
+  for (unsigned i = 0, e = Opts.OutputFilenames.size(); i != e; ++i)
+    Opts.BatchPrimaryInputs[i].OutputFilename = Opts.OutputFilenames[i];
+
+  // Outputs requested without a path would all get the same name, so they
+  // must be given by path.
+  auto readPaths = [&](OptSpecifier pathOpt, OptSpecifier flagOpt,
+                       StringRef pathOptName,
+                       std::string BatchPrimaryInput::*path) -> bool {
+    std::vector<std::string> values = Args.getAllArgValues(pathOpt);
+    if (values.empty() && !Args.hasArg(flagOpt))
+      return false;
+    if (values.size() != PrimaryInputs.size()) {
+      Diags.diagnose(SourceLoc(), diag::error_batch_mode_output_count,
+                     pathOptName, PrimaryInputs.size());
+      return true;
+    }
+    for (unsigned i = 0, e = values.size(); i != e; ++i)
+      Opts.BatchPrimaryInputs[i].*path = values[i];
+    return false;
+  };
+
+  if (readPaths(OPT_emit_module_path, OPT_emit_module, "-emit-module-path",
+                &BatchPrimaryInput::ModuleOutputPath) ||
+      readPaths(OPT_emit_module_doc_path, OPT_emit_module_doc,
+                "-emit-module-doc-path",
+                &BatchPrimaryInput::ModuleDocOutputPath) ||
+      readPaths(OPT_serialize_diagnostics_path, OPT_serialize_diagnostics,
+                "-serialize-diagnostics-path",
+                &BatchPrimaryInput::SerializedDiagnosticsPath) ||
+      readPaths(OPT_emit_dependencies_path, OPT_emit_dependencies,
+                "-emit-dependencies-path",
+                &BatchPrimaryInput::DependenciesFilePath) ||
+      readPaths(OPT_emit_reference_dependencies_path,
+                OPT_emit_reference_dependencies,
+                "-emit-reference-dependencies-path",
+                &BatchPrimaryInput::ReferenceDependenciesFilePath))
+    return true;
+
+  // Make the top-level options describe the first primary input, as they
+  // would if it were the only one.
+  FrontendOptions FirstPrimaryOpts = Opts.getOptionsForBatchPrimary(0);
+  FirstPrimaryOpts.BatchPrimaryInputs = std::move(Opts.BatchPrimaryInputs);
+  Opts = std::move(FirstPrimaryOpts);
+  return false;
+}
+
 static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
                               DiagnosticEngine &Diags) {
   using namespace options;
@@ -201,13 +275,16 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
     }
   }
 
+  // More than one primary input puts the frontend in batch mode.
+  SmallVector<SelectedInput, 1> PrimaryInputs;
   if (const Arg *A = Args.getLastArg(OPT_filelist)) {
-    const Arg *primaryFileArg = Args.getLastArg(OPT_primary_file);
-    unsigned primaryFileIndex = 0;
+    SmallVector<const Arg *, 1> primaryFileArgs(
+      Args.filtered_begin(OPT_primary_file), Args.filtered_end());
+    std::vector<unsigned> primaryFileIndices;
     if (readFileList(Diags, Opts.InputFilenames, A,
-                     primaryFileArg, &primaryFileIndex)) {
-      if (primaryFileArg)
-        Opts.PrimaryInput = SelectedInput(primaryFileIndex);
+                     primaryFileArgs, &primaryFileIndices)) {
+      for (unsigned primaryFileIndex : primaryFileIndices)
+        PrimaryInputs.push_back(SelectedInput(primaryFileIndex));
       assert(!Args.hasArg(OPT_INPUT) && "mixing -filelist with inputs");
     }
   } else {
@@ -217,13 +294,15 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
       if (A->getOption().matches(OPT_INPUT)) {
         Opts.InputFilenames.push_back(A->getValue());
       } else if (A->getOption().matches(OPT_primary_file)) {
-        Opts.PrimaryInput = SelectedInput(Opts.InputFilenames.size());
+        PrimaryInputs.push_back(SelectedInput(Opts.InputFilenames.size()));
         Opts.InputFilenames.push_back(A->getValue());
       } else {
         llvm_unreachable("Unknown input-related argument!");
       }
     }
   }
+  if (!PrimaryInputs.empty())
+    Opts.PrimaryInput = PrimaryInputs.front();
 
   Opts.ParseStdlib |= Args.hasArg(OPT_parse_stdlib);
 
@@ -582,6 +661,8 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
                           OPT_emit_reference_dependencies,
                           OPT_emit_reference_dependencies_path,
                           "swiftdeps", false);
+  Opts.EmitBinaryReferenceDependencies |=
+    Args.hasArg(OPT_binary_reference_dependencies);
   determineOutputFilename(Opts.SerializedDiagnosticsPath,
                           OPT_serialize_diagnostics,
                           OPT_serialize_diagnostics_path,
@@ -615,6 +696,10 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
                           SERIALIZED_MODULE_DOC_EXTENSION,
                           false);
 
+  if (PrimaryInputs.size() > 1 &&
+      parseBatchPrimaryInputs(Opts, Args, Diags, PrimaryInputs))
+    return true;
+
   if (!Opts.DependenciesFilePath.empty()) {
     switch (Opts.RequestedAction) {
     case FrontendOptions::NoneAction:
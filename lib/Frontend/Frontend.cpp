@@ -45,11 +45,22 @@ void CompilerInstance::createSILModule(bool WholeModule) {
 void CompilerInstance::setPrimarySourceFile(SourceFile *SF) {
   assert(SF);
   assert(MainModule && "main module not created yet");
-  assert(!PrimarySourceFile && "already has a primary source file");
-  assert(PrimaryBufferID == NO_SUCH_BUFFER || !SF->getBufferID().hasValue() ||
-         SF->getBufferID().getValue() == PrimaryBufferID);
-  PrimarySourceFile = SF;
-  PrimarySourceFile->setReferencedNameTracker(NameTracker);
+
+  // Keep the source files in the order the primary inputs were given.
+  unsigned Position = 0;
+  if (SF->getBufferID().hasValue() && !PrimaryBufferIDs.empty()) {
+    auto Found = std::find(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                           SF->getBufferID().getValue());
+    assert(Found != PrimaryBufferIDs.end() && "not a primary input");
+    Position = Found - PrimaryBufferIDs.begin();
+  }
+  if (PrimarySourceFiles.size() <= Position)
+    PrimarySourceFiles.resize(Position + 1, nullptr);
+  assert(!PrimarySourceFiles[Position] && "already has a primary source file");
+  PrimarySourceFiles[Position] = SF;
+
+  if (Position < NameTrackers.size())
+    SF->setReferencedNameTracker(NameTrackers[Position]);
 }
 
 bool CompilerInstance::setup(const CompilerInvocation &Invok) {
@@ -130,8 +141,24 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
   if (SILMode)
     Invocation.getLangOptions().EnableAccessControl = false;
 
-  const Optional<SelectedInput> &PrimaryInput =
-    Invocation.getFrontendOptions().PrimaryInput;
+  // Collect the primary inputs, in the order they were given.
+  const FrontendOptions &FrontendOpts = Invocation.getFrontendOptions();
+  SmallVector<SelectedInput, 1> PrimaryInputs;
+  if (FrontendOpts.isInBatchMode()) {
+    for (auto &Primary : FrontendOpts.BatchPrimaryInputs)
+      PrimaryInputs.push_back(Primary.Input);
+  } else if (FrontendOpts.PrimaryInput) {
+    PrimaryInputs.push_back(*FrontendOpts.PrimaryInput);
+  }
+  PrimaryBufferIDs.assign(PrimaryInputs.size(), NO_SUCH_BUFFER);
+
+  auto recordIfPrimary = [&](SelectedInput::InputKind Kind, unsigned Index,
+                             unsigned BufferID) {
+    for (unsigned i = 0, e = PrimaryInputs.size(); i != e; ++i) {
+      if (PrimaryInputs[i].Kind == Kind && PrimaryInputs[i].Index == Index)
+        PrimaryBufferIDs[i] = BufferID;
+    }
+  };
 
   // Add the memory buffers first, these will be associated with a filename
   // and they can replace the contents of an input filename.
@@ -150,8 +177,7 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
       if (SILMode)
         MainBufferID = BufferID;
 
-      if (PrimaryInput && PrimaryInput->isBuffer() && PrimaryInput->Index == i)
-        PrimaryBufferID = BufferID;
+      recordIfPrimary(SelectedInput::InputKind::Buffer, i, BufferID);
     }
   }
 
@@ -166,9 +192,8 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
       if (SILMode || (MainMode && filename(File) == "main.swift"))
         MainBufferID = ExistingBufferID.getValue();
 
-      if (PrimaryInput && PrimaryInput->isFilename() &&
-          PrimaryInput->Index == i)
-        PrimaryBufferID = ExistingBufferID.getValue();
+      recordIfPrimary(SelectedInput::InputKind::Filename, i,
+                      ExistingBufferID.getValue());
 
       continue; // replaced by a memory buffer.
     }
@@ -209,13 +234,17 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
     if (SILMode || (MainMode && filename(File) == "main.swift"))
       MainBufferID = BufferID;
 
-    if (PrimaryInput && PrimaryInput->isFilename() && PrimaryInput->Index == i)
-      PrimaryBufferID = BufferID;
+    recordIfPrimary(SelectedInput::InputKind::Filename, i, BufferID);
   }
 
+  // A primary input that isn't a source file doesn't limit what is compiled.
+  if (std::all_of(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                  [](unsigned ID) { return ID == NO_SUCH_BUFFER; }))
+    PrimaryBufferIDs.clear();
+
   // Set the primary file to the code-completion point if one exists.
   if (CodeCompletionBufferID.hasValue())
-    PrimaryBufferID = *CodeCompletionBufferID;
+    PrimaryBufferIDs.assign(1, *CodeCompletionBufferID);
 
   if (MainMode && MainBufferID == NO_SUCH_BUFFER && BufferIDs.size() == 1)
     MainBufferID = BufferIDs.front();
@@ -401,7 +430,7 @@ void CompilerInstance::performSema() {
     MainModule->addFile(*MainFile);
     addAdditionalInitialImports(MainFile);
 
-    if (MainBufferID == PrimaryBufferID)
+    if (isPrimaryBuffer(MainBufferID))
       setPrimarySourceFile(MainFile);
   }
 
@@ -427,13 +456,12 @@ void CompilerInstance::performSema() {
     MainModule->addFile(*NextInput);
     addAdditionalInitialImports(NextInput);
 
-    if (BufferID == PrimaryBufferID)
+    if (isPrimaryBuffer(BufferID))
       setPrimarySourceFile(NextInput);
 
     auto &Diags = NextInput->getASTContext().Diags;
     auto DidSuppressWarnings = Diags.getSuppressWarnings();
-    auto IsPrimary
-      = PrimaryBufferID == NO_SUCH_BUFFER || BufferID == PrimaryBufferID;
+    auto IsPrimary = PrimaryBufferIDs.empty() || isPrimaryBuffer(BufferID);
     Diags.setSuppressWarnings(DidSuppressWarnings || !IsPrimary);
 
     bool Done;
@@ -462,7 +490,7 @@ void CompilerInstance::performSema() {
 
   // Compute the options we want to use for type checking.
   OptionSet<TypeCheckingFlags> TypeCheckOptions;
-  if (PrimaryBufferID == NO_SUCH_BUFFER) {
+  if (PrimaryBufferIDs.empty()) {
     TypeCheckOptions |= TypeCheckingFlags::DelayWholeModuleChecking;
   }
   if (options.DebugTimeFunctionBodies) {
@@ -475,7 +503,7 @@ void CompilerInstance::performSema() {
   // Parse the main file last.
   if (MainBufferID != NO_SUCH_BUFFER) {
     bool mainIsPrimary =
-      (PrimaryBufferID == NO_SUCH_BUFFER || MainBufferID == PrimaryBufferID);
+      (PrimaryBufferIDs.empty() || isPrimaryBuffer(MainBufferID));
 
     SourceFile &MainFile =
       MainModule->getMainSourceFile(Invocation.getSourceFileKind());
@@ -515,7 +543,7 @@ void CompilerInstance::performSema() {
   // Type-check each top-level input besides the main source file.
   for (auto File : MainModule->getFiles())
     if (auto SF = dyn_cast<SourceFile>(File))
-      if (PrimaryBufferID == NO_SUCH_BUFFER || SF == PrimarySourceFile)
+      if (PrimaryBufferIDs.empty() || isPrimarySourceFile(SF))
         performTypeChecking(*SF, PersistentState.getTopLevelContext(),
                             TypeCheckOptions, /*curElem*/0,
                             options.WarnLongFunctionBodies);
@@ -539,7 +567,7 @@ void CompilerInstance::performSema() {
 
   for (auto File : MainModule->getFiles())
     if (auto SF = dyn_cast<SourceFile>(File))
-      if (PrimaryBufferID == NO_SUCH_BUFFER || SF == PrimarySourceFile)
+      if (PrimaryBufferIDs.empty() || isPrimarySourceFile(SF))
         finishTypeChecking(*SF);
 }
 
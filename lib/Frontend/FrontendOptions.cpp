@@ -88,3 +88,20 @@ void FrontendOptions::forAllOutputPaths(
       fn(*next);
   }
 }
+
+FrontendOptions
+FrontendOptions::getOptionsForBatchPrimary(unsigned Index) const {
+  const BatchPrimaryInput &Primary = BatchPrimaryInputs[Index];
+
+  FrontendOptions Result = *this;
+  Result.BatchPrimaryInputs.clear();
+  Result.PrimaryInput = Primary.Input;
+  if (!Primary.OutputFilename.empty())
+    Result.setSingleOutputFilename(Primary.OutputFilename);
+  Result.ModuleOutputPath = Primary.ModuleOutputPath;
+  Result.ModuleDocOutputPath = Primary.ModuleDocOutputPath;
+  Result.SerializedDiagnosticsPath = Primary.SerializedDiagnosticsPath;
+  Result.DependenciesFilePath = Primary.DependenciesFilePath;
+  Result.ReferenceDependenciesFilePath = Primary.ReferenceDependenciesFilePath;
+  return Result;
+}
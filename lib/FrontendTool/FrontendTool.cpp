@@ -33,6 +33,7 @@
 #include "swift/Basic/Dwarf.h"
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/FileSystem.h"
+#include "swift/Basic/ReferenceDependencyFile.h"
 #include "swift/Basic/SourceManager.h"
 #include "swift/Basic/Timer.h"
 #include "swift/Frontend/DiagnosticVerifier.h"
@@ -49,7 +50,9 @@
 // This API should be sunk down to LLVM.
 #include "clang/Frontend/CompilerInstance.h"
 
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
@@ -60,8 +63,8 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Timer.h"
-#include "llvm/Support/YAMLParser.h"
 
+#include <map>
 #include <memory>
 #include <unordered_set>
 
@@ -197,6 +200,104 @@ static std::string mangleTypeAsContext(const NominalTypeDecl *type) {
   return mangler.finalize();
 }
 
+/// Returns the declaration at the top level of its file that contains \p D.
+static const Decl *getTopLevelDecl(const Decl *D) {
+  while (!D->getDeclContext()->isModuleScopeContext())
+    D = D->getDeclContext()->getInnermostDeclarationDeclContext();
+  return D;
+}
+
+/// Returns true if \p D is a top-level declaration that other files can't
+/// refer to, so that no name the file provides has it as a provider.
+static bool isHiddenFromOtherFiles(const Decl *D) {
+  auto *VD = dyn_cast<ValueDecl>(D);
+  return VD && VD->hasAccessibility() &&
+         VD->getFormalAccess() <= Accessibility::FilePrivate;
+}
+
+namespace {
+/// Computes a fingerprint for each name a file provides from the interface
+/// hashes of the top-level declarations that provide it, so that the driver
+/// only rebuilds the dependents of the declarations that changed.
+class ProvidedNameFingerprints {
+  const SourceFile &SF;
+
+  /// The combined interface hash of the file's imports and of the top-level
+  /// declarations other files can't see, such as a fileprivate typealias.
+  /// These can change how any of the file's declarations are interpreted
+  /// without changing the declarations themselves.
+  llvm::MD5 FileScopeHash;
+  bool FileScopeHashValid = true;
+
+  using DeclSet = llvm::SmallSetVector<const Decl *, 2>;
+  using Key = std::pair<ReferenceDependencySection, std::string>;
+  std::map<Key, DeclSet> Providers;
+  llvm::DenseMap<const NominalTypeDecl *, DeclSet> TypeProviders;
+
+  std::string combine(const DeclSet &decls) const {
+    if (!FileScopeHashValid)
+      return std::string();
+
+    llvm::MD5 hash = FileScopeHash;
+    for (const Decl *D : decls) {
+      StringRef declHash = SF.getDeclInterfaceHash(D);
+      if (declHash.empty())
+        return std::string();
+      hash.update(declHash);
+    }
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> str;
+    llvm::MD5::stringifyResult(result, str);
+    return str.str();
+  }
+
+public:
+  explicit ProvidedNameFingerprints(const SourceFile &SF) : SF(SF) {
+    for (const Decl *D : SF.Decls) {
+      if (!isa<ImportDecl>(D) && !isHiddenFromOtherFiles(D))
+        continue;
+      StringRef hash = SF.getDeclInterfaceHash(D);
+      if (hash.empty())
+        FileScopeHashValid = false;
+      FileScopeHash.update(hash);
+    }
+  }
+
+  /// Records that \p name in \p section is provided by \p D, or by the
+  /// top-level declaration that contains it.
+  void addProvider(ReferenceDependencySection section, StringRef name,
+                   const Decl *D) {
+    Providers[{section, name}].insert(getTopLevelDecl(D));
+  }
+
+  /// Records that \p type is declared or extended by \p D, or by the
+  /// top-level declaration that contains it.
+  void addTypeProvider(const NominalTypeDecl *type, const Decl *D) {
+    TypeProviders[type].insert(getTopLevelDecl(D));
+  }
+
+  /// Returns the fingerprint of \p name in \p section, or an empty string if
+  /// one of its providers has no interface hash, so that dependents always
+  /// treat it as changed.
+  std::string get(ReferenceDependencySection section, StringRef name) const {
+    auto iter = Providers.find({section, name});
+    if (iter == Providers.end())
+      return std::string();
+    return combine(iter->second);
+  }
+
+  /// Returns the fingerprint of the parts of \p type this file provides.
+  std::string getForType(const NominalTypeDecl *type) const {
+    auto iter = TypeProviders.find(type);
+    if (iter == TypeProviders.end())
+      return std::string();
+    return combine(iter->second);
+  }
+};
+} // end anonymous namespace
+
 /// Emits a Swift-style dependencies file.
 static bool emitReferenceDependencies(DiagnosticEngine &diags,
                                       SourceFile *SF,
@@ -219,17 +320,23 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
     return true;
   }
 
-  auto escape = [](Identifier name) -> std::string {
-    return llvm::yaml::escape(name.str());
-  };
-
-  out << "### Swift dependencies file v0 ###\n";
+  using Section = ReferenceDependencySection;
+  ReferenceDependencyFileWriter deps;
 
   llvm::MapVector<const NominalTypeDecl *, bool> extendedNominals;
   llvm::SmallVector<const FuncDecl *, 8> memberOperatorDecls;
   llvm::SmallVector<const ExtensionDecl *, 8> extensionsWithJustMembers;
 
-  out << "provides-top-level:\n";
+  // Provided names are written once all of their providers are known, so
+  // that each can be given a fingerprint.
+  ProvidedNameFingerprints fingerprints(*SF);
+  std::vector<std::string> providedTopLevelNames;
+  auto addProvidedTopLevelName = [&](StringRef name, const Decl *D) {
+    providedTopLevelNames.push_back(name);
+    fingerprints.addProvider(Section::ProvidesTopLevel, name, D);
+  };
+
+  deps.addSection(Section::ProvidesTopLevel);
   for (const Decl *D : SF->Decls) {
     switch (D->getKind()) {
     case DeclKind::Module:
@@ -244,6 +351,7 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
       auto *NTD = ED->getExtendedType()->getAnyNominal();
       if (!NTD)
         break;
+      fingerprints.addTypeProvider(NTD, ED);
       if (NTD->hasAccessibility() &&
           NTD->getFormalAccess() <= Accessibility::FilePrivate) {
         break;
@@ -269,11 +377,12 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
     case DeclKind::InfixOperator:
     case DeclKind::PrefixOperator:
     case DeclKind::PostfixOperator:
-      out << "- \"" << escape(cast<OperatorDecl>(D)->getName()) << "\"\n";
+      addProvidedTopLevelName(cast<OperatorDecl>(D)->getName().str(), D);
       break;
 
     case DeclKind::PrecedenceGroup:
-      out << "- \"" << escape(cast<PrecedenceGroupDecl>(D)->getName()) << "\"\n";
+      addProvidedTopLevelName(cast<PrecedenceGroupDecl>(D)->getName().str(),
+                              D);
       break;
 
     case DeclKind::Enum:
@@ -287,7 +396,7 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           NTD->getFormalAccess() <= Accessibility::FilePrivate) {
         break;
       }
-      out << "- \"" << escape(NTD->getName()) << "\"\n";
+      addProvidedTopLevelName(NTD->getName().str(), D);
       extendedNominals[NTD] |= true;
       findNominalsAndOperators(extendedNominals, memberOperatorDecls,
                                NTD->getMembers());
@@ -304,7 +413,7 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           VD->getFormalAccess() <= Accessibility::FilePrivate) {
         break;
       }
-      out << "- \"" << escape(VD->getName()) << "\"\n";
+      addProvidedTopLevelName(VD->getName().str(), D);
       break;
     }
 
@@ -327,26 +436,47 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
   }
 
   // This is also part of "provides-top-level".
-  for (auto *operatorFunction : memberOperatorDecls)
-    out << "- \"" << escape(operatorFunction->getName()) << "\"\n";
+  for (auto *operatorFunction : memberOperatorDecls) {
+    addProvidedTopLevelName(operatorFunction->getName().str(),
+                            operatorFunction);
+  }
+
+  for (StringRef name : providedTopLevelNames) {
+    deps.addEntry(Section::ProvidesTopLevel, name, /*isCascading=*/true,
+                  fingerprints.get(Section::ProvidesTopLevel, name));
+  }
 
-  out << "provides-nominal:\n";
+  // A type's own declaration provides it too, including when it's nested in
+  // another of this file's declarations.
+  std::vector<std::pair<std::string, std::string>> nominalFingerprints;
   for (auto entry : extendedNominals) {
-    if (!entry.second)
+    const NominalTypeDecl *NTD = entry.first;
+    if (NTD->getParentSourceFile() == SF)
+      fingerprints.addTypeProvider(NTD, NTD);
+    nominalFingerprints.push_back({mangleTypeAsContext(NTD),
+                                   fingerprints.getForType(NTD)});
+  }
+
+  deps.addSection(Section::ProvidesNominal);
+  for (size_t i = 0, e = nominalFingerprints.size(); i != e; ++i) {
+    if (!(extendedNominals.begin() + i)->second)
       continue;
-    out << "- \"";
-    out << mangleTypeAsContext(entry.first);
-    out << "\"\n";
+    deps.addEntry(Section::ProvidesNominal, nominalFingerprints[i].first,
+                  /*isCascading=*/true, nominalFingerprints[i].second);
   }
 
-  out << "provides-member:\n";
-  for (auto entry : extendedNominals) {
-    out << "- [\"";
-    out << mangleTypeAsContext(entry.first);
-    out << "\", \"\"]\n";
+  deps.addSection(Section::ProvidesMember);
+  for (auto &entry : nominalFingerprints) {
+    deps.addMemberEntry(Section::ProvidesMember, entry.first, "",
+                        /*isCascading=*/true, entry.second);
   }
 
-  // This is also part of "provides-member".
+  // This is also part of "provides-member". Overloads can be spread across
+  // several extensions, so every extension providing a member is hashed.
+  auto memberKey = [](StringRef mangledName, StringRef memberName) {
+    return (mangledName + Twine('\0') + memberName).str();
+  };
+  std::vector<std::pair<std::string, StringRef>> providedMembers;
   for (auto *ED : extensionsWithJustMembers) {
     auto mangledName = mangleTypeAsContext(
                                         ED->getExtendedType()->getAnyNominal());
@@ -357,45 +487,50 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           VD->getFormalAccess() <= Accessibility::FilePrivate) {
         continue;
       }
-      out << "- [\"" << mangledName << "\", \""
-          << escape(VD->getName()) << "\"]\n";
+      providedMembers.push_back({mangledName, VD->getName().str()});
+      fingerprints.addProvider(Section::ProvidesMember,
+                               memberKey(mangledName, VD->getName().str()),
+                               ED);
     }
   }
+  for (auto &member : providedMembers) {
+    auto fingerprint = fingerprints.get(Section::ProvidesMember,
+                                        memberKey(member.first, member.second));
+    deps.addMemberEntry(Section::ProvidesMember, member.first, member.second,
+                        /*isCascading=*/true, fingerprint);
+  }
 
   if (SF->getASTContext().LangOpts.EnableObjCInterop) {
     // FIXME: This requires a traversal of the whole file to compute.
     // We should (a) see if there's a cheaper way to keep it up to date,
     // and/or (b) see if we can fast-path cases where there's no ObjC involved.
-    out << "provides-dynamic-lookup:\n";
-    class ValueDeclPrinter : public VisibleDeclConsumer {
+    deps.addSection(Section::ProvidesDynamicLookup);
+    class ValueDeclRecorder : public VisibleDeclConsumer {
     private:
-      raw_ostream &out;
-      std::string (*escape)(Identifier);
+      ReferenceDependencyFileWriter &deps;
     public:
-      ValueDeclPrinter(raw_ostream &out, decltype(escape) escape)
-        : out(out), escape(escape) {}
+      explicit ValueDeclRecorder(ReferenceDependencyFileWriter &deps)
+        : deps(deps) {}
 
       void foundDecl(ValueDecl *VD, DeclVisibilityKind Reason) override {
-        out << "- \"" << escape(VD->getName()) << "\"\n";
+        deps.addEntry(ReferenceDependencySection::ProvidesDynamicLookup,
+                      VD->getName().str());
       }
     };
-    ValueDeclPrinter printer(out, escape);
-    SF->lookupClassMembers({}, printer);
+    ValueDeclRecorder recorder(deps);
+    SF->lookupClassMembers({}, recorder);
   }
 
   ReferencedNameTracker *tracker = SF->getReferencedNameTracker();
 
   // FIXME: Sort these?
-  out << "depends-top-level:\n";
+  deps.addSection(Section::DependsTopLevel);
   for (auto &entry : tracker->getTopLevelNames()) {
     assert(!entry.first.empty());
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "\"" << escape(entry.first) << "\"\n";
+    deps.addEntry(Section::DependsTopLevel, entry.first.str(), entry.second);
   }
 
-  out << "depends-member:\n";
+  deps.addSection(Section::DependsMember);
   auto &memberLookupTable = tracker->getUsedMembers();
   using TableEntryTy = std::pair<ReferencedNameTracker::MemberPair, bool>;
   std::vector<TableEntryTy> sortedMembers{
@@ -422,18 +557,15 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
         entry.first.first->getFormalAccess() <= Accessibility::FilePrivate)
       continue;
 
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "[\"";
-    out << mangleTypeAsContext(entry.first.first);
-    out << "\", \"";
+    StringRef memberName;
     if (!entry.first.second.empty())
-      out << escape(entry.first.second);
-    out << "\"]\n";
+      memberName = entry.first.second.str();
+    deps.addMemberEntry(Section::DependsMember,
+                        mangleTypeAsContext(entry.first.first), memberName,
+                        entry.second);
   }
 
-  out << "depends-nominal:\n";
+  deps.addSection(Section::DependsNominal);
   for (auto i = sortedMembers.begin(), e = sortedMembers.end(); i != e; ++i) {
     bool isCascading = i->second;
     while (i+1 != e && i[0].first.first == i[1].first.first) {
@@ -445,32 +577,30 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
         i->first.first->getFormalAccess() <= Accessibility::FilePrivate)
       continue;
 
-    out << "- ";
-    if (!isCascading)
-      out << "!private ";
-    out << "\"";
-    out <<  mangleTypeAsContext(i->first.first);
-    out << "\"\n";
+    deps.addEntry(Section::DependsNominal,
+                  mangleTypeAsContext(i->first.first), isCascading);
   }
 
   // FIXME: Sort these?
-  out << "depends-dynamic-lookup:\n";
+  deps.addSection(Section::DependsDynamicLookup);
   for (auto &entry : tracker->getDynamicLookupNames()) {
     assert(!entry.first.empty());
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "\"" << escape(entry.first) << "\"\n";
+    deps.addEntry(Section::DependsDynamicLookup, entry.first.str(),
+                  entry.second);
   }
 
-  out << "depends-external:\n";
-  for (auto &entry : depTracker.getDependencies()) {
-    out << "- \"" << llvm::yaml::escape(entry) << "\"\n";
-  }
+  deps.addSection(Section::DependsExternal);
+  for (auto &entry : depTracker.getDependencies())
+    deps.addEntry(Section::DependsExternal, entry);
 
   llvm::SmallString<32> interfaceHash;
   SF->getInterfaceHash(interfaceHash);
-  out << "interface-hash: \"" << interfaceHash << "\"\n";
+  deps.setInterfaceHash(interfaceHash);
+
+  if (opts.EmitBinaryReferenceDependencies)
+    deps.writeBinary(out);
+  else
+    deps.writeYAML(out);
 
   return false;
 }
@@ -677,8 +807,68 @@ private:
   }
 };
 
+/// In batch mode, sends each diagnostic to the consumer of the primary file
+/// it is in, so that each primary file gets its own serialized diagnostics.
+///
+/// Diagnostics that aren't in any primary file go to every consumer. Notes
+/// go wherever the diagnostic they are attached to went.
+class PrimaryFileDiagnosticRouter : public DiagnosticConsumer {
+  llvm::StringMap<DiagnosticConsumer *> ConsumersByFilename;
+  std::vector<std::unique_ptr<DiagnosticConsumer>> Consumers;
+  SmallVector<DiagnosticConsumer *, 1> LastConsumers;
+
+public:
+  void addConsumer(StringRef primaryFilename,
+                   std::unique_ptr<DiagnosticConsumer> consumer) {
+    ConsumersByFilename[primaryFilename] = consumer.get();
+    Consumers.push_back(std::move(consumer));
+  }
+
+  void handleDiagnostic(SourceManager &SM, SourceLoc Loc,
+                        DiagnosticKind Kind, StringRef Text,
+                        const DiagnosticInfo &Info) override {
+    if (Kind != DiagnosticKind::Note) {
+      LastConsumers.clear();
+      DiagnosticConsumer *consumer = nullptr;
+      if (Loc.isValid()) {
+        unsigned bufferID = SM.findBufferContainingLoc(Loc);
+        consumer = ConsumersByFilename.lookup(
+            SM.getIdentifierForBuffer(bufferID));
+      }
+      if (consumer) {
+        LastConsumers.push_back(consumer);
+      } else {
+        for (auto &each : Consumers)
+          LastConsumers.push_back(each.get());
+      }
+    }
+
+    for (auto *consumer : LastConsumers)
+      consumer->handleDiagnostic(SM, Loc, Kind, Text, Info);
+  }
+};
+
 } // anonymous namespace
 
+/// Opens \p path and creates a consumer that serializes diagnostics to it.
+///
+/// \returns null, after diagnosing the failure, if the file can't be opened.
+static std::unique_ptr<DiagnosticConsumer>
+createSerializedDiagnosticConsumer(DiagnosticEngine &diags, StringRef path) {
+  std::error_code EC;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  OS.reset(new llvm::raw_fd_ostream(path, EC, llvm::sys::fs::F_None));
+
+  if (EC) {
+    diags.diagnose(SourceLoc(), diag::cannot_open_serialized_file, path,
+                   EC.message());
+    return nullptr;
+  }
+
+  return std::unique_ptr<DiagnosticConsumer>(
+      serialized_diagnostics::createConsumer(std::move(OS)));
+}
+
 // This is a separate function so that it shows up in stack traces.
 LLVM_ATTRIBUTE_NOINLINE
 static void debugFailWithAssertion() {
@@ -693,144 +883,26 @@ static void debugFailWithCrash() {
   LLVM_BUILTIN_TRAP;
 }
 
-/// Performs the compile requested by the user.
+/// Generates the outputs for one primary file, or for the whole module if
+/// there is no primary file, after type-checking.
 /// \returns true on error
-static bool performCompile(CompilerInstance &Instance,
-                           CompilerInvocation &Invocation,
-                           ArrayRef<const char *> Args,
-                           int &ReturnValue,
-                           FrontendObserver *observer) {
-  FrontendOptions opts = Invocation.getFrontendOptions();
+static bool performCompileStepsPostSema(CompilerInstance &Instance,
+                                        CompilerInvocation &Invocation,
+                                        const FrontendOptions &opts,
+                                        SourceFile *PrimarySourceFile,
+                                        bool moduleIsPublic,
+                                        int &ReturnValue,
+                                        FrontendObserver *observer) {
   FrontendOptions::ActionType Action = opts.RequestedAction;
-
-  IRGenOptions &IRGenOpts = Invocation.getIRGenOptions();
-
-  bool inputIsLLVMIr = Invocation.getInputKind() == InputFileKind::IFK_LLVM_IR;
-  if (inputIsLLVMIr) {
-    auto &LLVMContext = llvm::getGlobalContext();
-
-    // Load in bitcode file.
-    assert(Invocation.getInputFilenames().size() == 1 &&
-           "We expect a single input for bitcode input!");
-    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileBufOrErr =
-      llvm::MemoryBuffer::getFileOrSTDIN(Invocation.getInputFilenames()[0]);
-    if (!FileBufOrErr) {
-      Instance.getASTContext().Diags.diagnose(SourceLoc(),
-                                              diag::error_open_input_file,
-                                              Invocation.getInputFilenames()[0],
-                                              FileBufOrErr.getError().message());
-      return true;
-    }
-    llvm::MemoryBuffer *MainFile = FileBufOrErr.get().get();
-
-    llvm::SMDiagnostic Err;
-    std::unique_ptr<llvm::Module> Module = llvm::parseIR(
-                                             MainFile->getMemBufferRef(),
-                                             Err, LLVMContext);
-    if (!Module) {
-      // TODO: Translate from the diagnostic info to the SourceManager location
-      // if available.
-      Instance.getASTContext().Diags.diagnose(SourceLoc(),
-                                              diag::error_parse_input_file,
-                                              Invocation.getInputFilenames()[0],
-                                              Err.getMessage());
-      return true;
-    }
-
-    // TODO: remove once the frontend understands what action it should perform
-    IRGenOpts.OutputKind = getOutputKind(Action);
-
-    return performLLVM(IRGenOpts, Instance.getASTContext(), Module.get());
-  }
-
-  ReferencedNameTracker nameTracker;
-  bool shouldTrackReferences = !opts.ReferenceDependenciesFilePath.empty();
-  if (shouldTrackReferences)
-    Instance.setReferencedNameTracker(&nameTracker);
-
-  if (Action == FrontendOptions::DumpParse ||
-      Action == FrontendOptions::DumpInterfaceHash)
-    Instance.performParseOnly();
-  else
-    Instance.performSema();
-
-  if (observer) {
-    observer->performedSemanticAnalysis(Instance);
-  }
-
-  FrontendOptions::DebugCrashMode CrashMode = opts.CrashMode;
-  if (CrashMode == FrontendOptions::DebugCrashMode::AssertAfterParse)
-    debugFailWithAssertion();
-  else if (CrashMode == FrontendOptions::DebugCrashMode::CrashAfterParse)
-    debugFailWithCrash();
-
   ASTContext &Context = Instance.getASTContext();
 
-  if (Action == FrontendOptions::REPL) {
-    runREPL(Instance, ProcessCmdLine(Args.begin(), Args.end()),
-            Invocation.getParseStdlib());
-    return false;
-  }
-
-  SourceFile *PrimarySourceFile = Instance.getPrimarySourceFile();
-
-  // We've been told to dump the AST (either after parsing or type-checking,
-  // which is already differentiated in CompilerInstance::performSema()),
-  // so dump or print the main source file and return.
-  if (Action == FrontendOptions::DumpParse ||
-      Action == FrontendOptions::DumpAST ||
-      Action == FrontendOptions::PrintAST ||
-      Action == FrontendOptions::DumpTypeRefinementContexts ||
-      Action == FrontendOptions::DumpInterfaceHash) {
-    SourceFile *SF = PrimarySourceFile;
-    if (!SF) {
-      SourceFileKind Kind = Invocation.getSourceFileKind();
-      SF = &Instance.getMainModule()->getMainSourceFile(Kind);
-    }
-    if (Action == FrontendOptions::PrintAST)
-      SF->print(llvm::outs(), PrintOptions::printEverything());
-    else if (Action == FrontendOptions::DumpTypeRefinementContexts)
-      SF->getTypeRefinementContext()->dump(llvm::errs(), Context.SourceMgr);
-    else if (Action == FrontendOptions::DumpInterfaceHash)
-      SF->dumpInterfaceHash(llvm::errs());
-    else
-      SF->dump();
-    return false;
-  }
-
-  // If we were asked to print Clang stats, do so.
-  if (opts.PrintClangStats && Context.getClangModuleLoader())
-    Context.getClangModuleLoader()->printStatistics();
-
-  if (!opts.DependenciesFilePath.empty())
-    (void)emitMakeDependencies(Context.Diags, *Instance.getDependencyTracker(),
-                               opts);
-
-  if (shouldTrackReferences)
-    emitReferenceDependencies(Context.Diags, Instance.getPrimarySourceFile(),
-                              *Instance.getDependencyTracker(), opts);
-
-  if (Context.hadError())
-    return true;
-
-  // FIXME: This is still a lousy approximation of whether the module file will
-  // be externally consumed.
-  bool moduleIsPublic =
-      !Instance.getMainModule()->hasEntryPoint() &&
-      opts.ImplicitObjCHeaderPath.empty() &&
-      !Context.LangOpts.EnableAppExtensionRestrictions;
-
-  // We've just been told to perform a parse, so we can return now.
-  if (Action == FrontendOptions::Parse) {
-    if (!opts.ObjCHeaderOutputPath.empty())
-      return printAsObjC(opts.ObjCHeaderOutputPath, Instance.getMainModule(),
-                         opts.ImplicitObjCHeaderPath, moduleIsPublic);
-    return false;
+  // Start from the shared options, which are adjusted for each primary file.
+  IRGenOptions IRGenOpts = Invocation.getIRGenOptions();
+  if (Invocation.getFrontendOptions().isInBatchMode()) {
+    IRGenOpts.MainInputFilename = opts.InputFilenames[opts.PrimaryInput->Index];
+    IRGenOpts.OutputFilenames = opts.OutputFilenames;
   }
 
-  assert(Action >= FrontendOptions::EmitSILGen &&
-         "All actions not requiring SILGen must have been handled!");
-
   std::unique_ptr<SILModule> SM = Instance.takeSILModule();
   if (!SM) {
     if (opts.PrimaryInput.hasValue() && opts.PrimaryInput.getValue().isFilename()) {
@@ -1041,6 +1113,182 @@ static bool performCompile(CompilerInstance &Instance,
   return false;
 }
 
+/// Performs the compile requested by the user.
+/// \returns true on error
+static bool performCompile(CompilerInstance &Instance,
+                           CompilerInvocation &Invocation,
+                           ArrayRef<const char *> Args,
+                           int &ReturnValue,
+                           FrontendObserver *observer) {
+  FrontendOptions opts = Invocation.getFrontendOptions();
+  FrontendOptions::ActionType Action = opts.RequestedAction;
+
+  IRGenOptions &IRGenOpts = Invocation.getIRGenOptions();
+
+  bool inputIsLLVMIr = Invocation.getInputKind() == InputFileKind::IFK_LLVM_IR;
+  if (inputIsLLVMIr) {
+    auto &LLVMContext = llvm::getGlobalContext();
+
+    // Load in bitcode file.
+    assert(Invocation.getInputFilenames().size() == 1 &&
+           "We expect a single input for bitcode input!");
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileBufOrErr =
+      llvm::MemoryBuffer::getFileOrSTDIN(Invocation.getInputFilenames()[0]);
+    if (!FileBufOrErr) {
+      Instance.getASTContext().Diags.diagnose(SourceLoc(),
+                                              diag::error_open_input_file,
+                                              Invocation.getInputFilenames()[0],
+                                              FileBufOrErr.getError().message());
+      return true;
+    }
+    llvm::MemoryBuffer *MainFile = FileBufOrErr.get().get();
+
+    llvm::SMDiagnostic Err;
+    std::unique_ptr<llvm::Module> Module = llvm::parseIR(
+                                             MainFile->getMemBufferRef(),
+                                             Err, LLVMContext);
+    if (!Module) {
+      // TODO: Translate from the diagnostic info to the SourceManager location
+      // if available.
+      Instance.getASTContext().Diags.diagnose(SourceLoc(),
+                                              diag::error_parse_input_file,
+                                              Invocation.getInputFilenames()[0],
+                                              Err.getMessage());
+      return true;
+    }
+
+    // TODO: remove once the frontend understands what action it should perform
+    IRGenOpts.OutputKind = getOutputKind(Action);
+
+    return performLLVM(IRGenOpts, Instance.getASTContext(), Module.get());
+  }
+
+  // In batch mode, each primary file is compiled as if it were the only one,
+  // but they all share the work of parsing and type-checking the module.
+  SmallVector<FrontendOptions, 1> primaryOpts;
+  if (opts.isInBatchMode()) {
+    for (unsigned i = 0, e = opts.BatchPrimaryInputs.size(); i != e; ++i)
+      primaryOpts.push_back(opts.getOptionsForBatchPrimary(i));
+  } else {
+    primaryOpts.push_back(opts);
+  }
+
+  // Each primary file references names separately.
+  std::vector<ReferencedNameTracker> nameTrackers;
+  bool shouldTrackReferences = !opts.ReferenceDependenciesFilePath.empty();
+  if (shouldTrackReferences) {
+    nameTrackers.resize(primaryOpts.size());
+    SmallVector<ReferencedNameTracker *, 1> trackers;
+    for (auto &tracker : nameTrackers)
+      trackers.push_back(&tracker);
+    Instance.setReferencedNameTrackers(trackers);
+  }
+
+  if (Action == FrontendOptions::DumpParse ||
+      Action == FrontendOptions::DumpInterfaceHash)
+    Instance.performParseOnly();
+  else
+    Instance.performSema();
+
+  if (observer) {
+    observer->performedSemanticAnalysis(Instance);
+  }
+
+  FrontendOptions::DebugCrashMode CrashMode = opts.CrashMode;
+  if (CrashMode == FrontendOptions::DebugCrashMode::AssertAfterParse)
+    debugFailWithAssertion();
+  else if (CrashMode == FrontendOptions::DebugCrashMode::CrashAfterParse)
+    debugFailWithCrash();
+
+  ASTContext &Context = Instance.getASTContext();
+
+  if (Action == FrontendOptions::REPL) {
+    runREPL(Instance, ProcessCmdLine(Args.begin(), Args.end()),
+            Invocation.getParseStdlib());
+    return false;
+  }
+
+  SourceFile *PrimarySourceFile = Instance.getPrimarySourceFile();
+
+  // We've been told to dump the AST (either after parsing or type-checking,
+  // which is already differentiated in CompilerInstance::performSema()),
+  // so dump or print the main source file and return.
+  if (Action == FrontendOptions::DumpParse ||
+      Action == FrontendOptions::DumpAST ||
+      Action == FrontendOptions::PrintAST ||
+      Action == FrontendOptions::DumpTypeRefinementContexts ||
+      Action == FrontendOptions::DumpInterfaceHash) {
+    SourceFile *SF = PrimarySourceFile;
+    if (!SF) {
+      SourceFileKind Kind = Invocation.getSourceFileKind();
+      SF = &Instance.getMainModule()->getMainSourceFile(Kind);
+    }
+    if (Action == FrontendOptions::PrintAST)
+      SF->print(llvm::outs(), PrintOptions::printEverything());
+    else if (Action == FrontendOptions::DumpTypeRefinementContexts)
+      SF->getTypeRefinementContext()->dump(llvm::errs(), Context.SourceMgr);
+    else if (Action == FrontendOptions::DumpInterfaceHash)
+      SF->dumpInterfaceHash(llvm::errs());
+    else
+      SF->dump();
+    return false;
+  }
+
+  // If we were asked to print Clang stats, do so.
+  if (opts.PrintClangStats && Context.getClangModuleLoader())
+    Context.getClangModuleLoader()->printStatistics();
+
+  ArrayRef<SourceFile *> primarySourceFiles = Instance.getPrimarySourceFiles();
+  auto getPrimarySourceFile = [&](unsigned i) -> SourceFile * {
+    return i < primarySourceFiles.size() ? primarySourceFiles[i] : nullptr;
+  };
+
+  for (unsigned i = 0, e = primaryOpts.size(); i != e; ++i) {
+    if (!primaryOpts[i].DependenciesFilePath.empty())
+      (void)emitMakeDependencies(Context.Diags,
+                                 *Instance.getDependencyTracker(),
+                                 primaryOpts[i]);
+
+    if (shouldTrackReferences)
+      emitReferenceDependencies(Context.Diags, getPrimarySourceFile(i),
+                                *Instance.getDependencyTracker(),
+                                primaryOpts[i]);
+  }
+
+  if (Context.hadError())
+    return true;
+
+  // FIXME: This is still a lousy approximation of whether the module file will
+  // be externally consumed.
+  bool moduleIsPublic =
+      !Instance.getMainModule()->hasEntryPoint() &&
+      opts.ImplicitObjCHeaderPath.empty() &&
+      !Context.LangOpts.EnableAppExtensionRestrictions;
+
+  // We've just been told to perform a parse, so we can return now.
+  if (Action == FrontendOptions::Parse) {
+    if (!opts.ObjCHeaderOutputPath.empty())
+      return printAsObjC(opts.ObjCHeaderOutputPath, Instance.getMainModule(),
+                         opts.ImplicitObjCHeaderPath, moduleIsPublic);
+    return false;
+  }
+
+  assert(Action >= FrontendOptions::EmitSILGen &&
+         "All actions not requiring SILGen must have been handled!");
+
+  // Keep going after a primary file fails, so that the diagnostics of every
+  // primary file are reported.
+  bool hadError = false;
+  for (unsigned i = 0, e = primaryOpts.size(); i != e; ++i) {
+    hadError |= performCompileStepsPostSema(Instance, Invocation,
+                                            primaryOpts[i],
+                                            getPrimarySourceFile(i),
+                                            moduleIsPublic, ReturnValue,
+                                            observer);
+  }
+  return hadError;
+}
+
 /// Returns true if an error occurred.
 static bool dumpAPI(Module *Mod, StringRef OutDir) {
   using namespace llvm::sys;
@@ -1168,24 +1416,25 @@ int swift::performFrontend(ArrayRef<const char *> Args,
   // CompilerInvocation::parseArgs are included in the serialized file.
   std::unique_ptr<DiagnosticConsumer> SerializedConsumer;
   {
-    const std::string &SerializedDiagnosticsPath =
-      Invocation.getFrontendOptions().SerializedDiagnosticsPath;
-    if (!SerializedDiagnosticsPath.empty()) {
-      std::error_code EC;
-      std::unique_ptr<llvm::raw_fd_ostream> OS;
-      OS.reset(new llvm::raw_fd_ostream(SerializedDiagnosticsPath,
-                                        EC,
-                                        llvm::sys::fs::F_None));
-
-      if (EC) {
-        Instance.getDiags().diagnose(SourceLoc(),
-                                     diag::cannot_open_serialized_file,
-                                     SerializedDiagnosticsPath, EC.message());
-        return 1;
+    const FrontendOptions &opts = Invocation.getFrontendOptions();
+    if (opts.isInBatchMode() && !opts.SerializedDiagnosticsPath.empty()) {
+      std::unique_ptr<PrimaryFileDiagnosticRouter> router(
+          new PrimaryFileDiagnosticRouter());
+      for (const BatchPrimaryInput &primary : opts.BatchPrimaryInputs) {
+        auto consumer = createSerializedDiagnosticConsumer(
+            Instance.getDiags(), primary.SerializedDiagnosticsPath);
+        if (!consumer)
+          return 1;
+        router->addConsumer(opts.InputFilenames[primary.Input.Index],
+                            std::move(consumer));
       }
-
-      SerializedConsumer.reset(
-          serialized_diagnostics::createConsumer(std::move(OS)));
+      SerializedConsumer = std::move(router);
+      Instance.addDiagnosticConsumer(SerializedConsumer.get());
+    } else if (!opts.SerializedDiagnosticsPath.empty()) {
+      SerializedConsumer = createSerializedDiagnosticConsumer(
+          Instance.getDiags(), opts.SerializedDiagnosticsPath);
+      if (!SerializedConsumer)
+        return 1;
       Instance.addDiagnosticConsumer(SerializedConsumer.get());
     }
   }
@@ -876,7 +876,8 @@ static void VisitNodeAssociatedTypeRef(
   }
   result._types.clear();
   result._error = stringWithFormat(
-      "unable to find associated type %s in context", ident->getText().c_str());
+      "unable to find associated type %s in context",
+      ident->getText().str().c_str());
 }
 
 static void VisitNodeBoundGeneric(
@@ -923,7 +924,7 @@ static void VisitNodeBuiltinTypeName(
     ASTContext *ast, std::vector<Demangle::NodePointer> &nodes,
     Demangle::NodePointer &cur_node, VisitNodeResult &result,
     const VisitNodeResult &generic_context) { // set by GenericType case
-  std::string builtin_name = cur_node->getText();
+  std::string builtin_name = cur_node->getText().str();
 
   StringRef builtin_name_ref(builtin_name);
 
@@ -1352,7 +1353,7 @@ static void VisitNodeFunction(
       if (decl_scope_result._decls.size() == 0) {
         result._error = stringWithFormat(
             "demangled identifier %s could not be found by name lookup",
-            (*pos)->getText().c_str());
+            (*pos)->getText().str().c_str());
         break;
       }
       std::copy(decl_scope_result._decls.begin(),
@@ -1519,7 +1520,7 @@ static void VisitNodeSetterGetter(
       VisitNode(ast, nodes, decl_ctx_result, generic_context);
       break;
     case Demangle::Node::Kind::Identifier:
-      identifier.assign((*pos)->getText());
+      identifier = (*pos)->getText().str();
       break;
     case Demangle::Node::Kind::Type:
       nodes.push_back(*pos);
@@ -1688,7 +1689,7 @@ static void VisitNodeIdentifier(
     if (result._error.empty())
       result._error =
           stringWithFormat("unable to find Node::Kind::Identifier '%s'",
-                           cur_node->getText().c_str());
+                           cur_node->getText().str().c_str());
   }
 }
 
@@ -1747,7 +1748,8 @@ static void VisitNodePrivateDeclName(
     if (result._error.empty())
       result._error = stringWithFormat(
           "unable to find Node::Kind::PrivateDeclName '%s' in '%s'",
-          id_node->getText().c_str(), priv_decl_id_node->getText().c_str());
+          id_node->getText().str().c_str(),
+          priv_decl_id_node->getText().str().c_str());
   }
 }
 
@@ -1811,8 +1813,8 @@ static void VisitNodeModule(
     Demangle::NodePointer &cur_node, VisitNodeResult &result,
     const VisitNodeResult &generic_context) { // set by GenericType case
   std::string error;
-  const char *module_name = cur_node->getText().c_str();
-  if (!module_name || *module_name == '\0') {
+  std::string module_name = cur_node->getText().str();
+  if (module_name.empty()) {
     result._error = stringWithFormat("error: empty module name.");
     return;
   }
@@ -1821,7 +1823,7 @@ static void VisitNodeModule(
       DeclsLookupSource::GetDeclsLookupSource(*ast, ConstString(module_name));
   if (!result._module) {
     result._error = stringWithFormat("unable to load module '%s' (%s)",
-                                     module_name, error.data());
+                                     module_name.c_str(), error.data());
   }
 }
 
@@ -1984,14 +1986,14 @@ static void VisitNodeTupleElement(
     ASTContext *ast, std::vector<Demangle::NodePointer> &nodes,
     Demangle::NodePointer &cur_node, VisitNodeResult &result,
     const VisitNodeResult &generic_context) { // set by GenericType case
-  const char *tuple_name = NULL;
+  StringRef tuple_name;
   VisitNodeResult tuple_type_result;
   Demangle::Node::iterator end = cur_node->end();
   for (Demangle::Node::iterator pos = cur_node->begin(); pos != end; ++pos) {
     const Demangle::Node::Kind child_node_kind = (*pos)->getKind();
     switch (child_node_kind) {
     case Demangle::Node::Kind::TupleElementName:
-      tuple_name = (*pos)->getText().c_str();
+      tuple_name = (*pos)->getText();
       break;
     case Demangle::Node::Kind::Type:
       nodes.push_back((*pos)->getFirstChild());
@@ -2004,7 +2006,7 @@ static void VisitNodeTupleElement(
 
   if (tuple_type_result._error.empty() &&
       tuple_type_result._types.size() == 1) {
-    if (tuple_name)
+    if (!tuple_name.empty())
       result._tuple_type_element =
           TupleTypeElt(tuple_type_result._types.front().getPointer(),
                        ast->getIdentifier(tuple_name));
@@ -2304,9 +2306,11 @@ Decl *ide::getDeclFromUSR(ASTContext &context, StringRef USR,
 Decl *ide::getDeclFromMangledSymbolName(ASTContext &context,
                                         StringRef mangledName,
                                         std::string &error) {
+  Demangle::NodeFactory factory;
   std::vector<Demangle::NodePointer> nodes;
   nodes.push_back(
-      Demangle::demangleSymbolAsNode(mangledName.data(), mangledName.size()));
+      Demangle::demangleSymbolAsNode(mangledName.data(), mangledName.size(),
+                                     factory));
   VisitNodeResult emptyGenericContext;
   VisitNodeResult result;
   VisitNode(&context, nodes, result, emptyGenericContext);
@@ -2324,9 +2328,11 @@ Decl *ide::getDeclFromMangledSymbolName(ASTContext &context,
 Type ide::getTypeFromMangledTypename(ASTContext &Ctx,
                                      StringRef mangledName,
                                      std::string &error) {
+  Demangle::NodeFactory factory;
   std::vector<Demangle::NodePointer> nodes;
   nodes.push_back(
-      Demangle::demangleTypeAsNode(mangledName.data(), mangledName.size()));
+      Demangle::demangleTypeAsNode(mangledName.data(), mangledName.size(),
+                                   factory));
   VisitNodeResult empty_generic_context;
   VisitNodeResult result;
 
@@ -2345,9 +2351,11 @@ Type ide::getTypeFromMangledTypename(ASTContext &Ctx,
 Type ide::getTypeFromMangledSymbolname(ASTContext &Ctx,
                                        StringRef mangledName,
                                        std::string &error) {
+  Demangle::NodeFactory factory;
   std::vector<Demangle::NodePointer> nodes;
   nodes.push_back(
-      Demangle::demangleSymbolAsNode(mangledName.data(), mangledName.size()));
+      Demangle::demangleSymbolAsNode(mangledName.data(), mangledName.size(),
+                                     factory));
   VisitNodeResult empty_generic_context;
   VisitNodeResult result;
 
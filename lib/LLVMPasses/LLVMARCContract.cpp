@@ -17,6 +17,7 @@
 #include "swift/Basic/Fallthrough.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Transforms/Utils/SSAUpdater.h"
 
@@ -89,12 +90,51 @@ private:
 
 } // end anonymous namespace
 
+/// Return true if Inst cannot observe or change a reference count, so that
+/// retains and releases of the same object can be merged across it.
+///
+/// Ordinary loads and stores qualify, as do copies and sets of memory such as
+/// the memcpy used to copy a struct. They may load or store references, but
+/// reference counts are only read and changed by calls into the runtime.
+/// Merging moves retains earlier and releases later, and since every release
+/// but the last one in a region cannot free the object, no deinit is moved
+/// across such an instruction either.
+///
+/// Atomic and volatile accesses do not qualify, since another thread could be
+/// waiting for them before it checks a reference count.
+static bool isTransparentToRefCounts(Instruction &Inst) {
+  if (auto *LI = dyn_cast<LoadInst>(&Inst))
+    return LI->isUnordered();
+  if (auto *SI = dyn_cast<StoreInst>(&Inst))
+    return SI->isUnordered();
+  if (auto *MI = dyn_cast<MemIntrinsic>(&Inst))
+    return !MI->isVolatile();
+  if (auto *II = dyn_cast<IntrinsicInst>(&Inst)) {
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::lifetime_start:
+    case Intrinsic::lifetime_end:
+      return true;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+
 void SwiftARCContractImpl::
 performRRNOptimization(DenseMap<Value *, LocalState> &PtrToLocalStateMap) {
   // Go through all of our pointers and merge all of the retains with the
   // first retain we saw and all of the releases with the last release we saw.
   llvm::Value *O = nullptr;
   for (auto &P : PtrToLocalStateMap) {
+    const LocalState &State = P.second;
+    if (State.RetainList.size() > 1 || State.ReleaseList.size() > 1 ||
+        State.UnknownRetainList.size() > 1 ||
+        State.UnknownReleaseList.size() > 1 ||
+        State.BridgeRetainList.size() > 1 ||
+        State.BridgeReleaseList.size() > 1)
+      Changed = true;
+
     auto &RetainList = P.second.RetainList;
     if (RetainList.size() > 1) {
       // Create the retainN call right by the first retain.
@@ -278,6 +318,7 @@ bool SwiftARCContractImpl::run() {
       case RT_FixLifetime:
         Inst.eraseFromParent();
         ++NumNoopDeleted;
+        Changed = true;
         continue;
       case RT_Retain: {
         auto *CI = cast<CallInst>(&Inst);
@@ -341,7 +382,13 @@ bool SwiftARCContractImpl::run() {
 
       if (Kind != RT_Unknown)
         continue;
-      
+
+      // Plain memory accesses, like the loads and stores that copy a struct
+      // holding several references to the same object, do not end the
+      // region.
+      if (isTransparentToRefCounts(Inst))
+        continue;
+
       // If we have an unknown call, we need to create any retainN calls we
       // have seen. The reason why is that we do not want to move retains,
       // releases over isUniquelyReferenced calls. Specifically imagine this:
@@ -292,9 +292,15 @@ ParserStatus Parser::parseBraceItems(SmallVectorImpl<ASTNode> &Entries,
     PreviousHadSemi = false;
     if (isStartOfDecl()
         && Tok.isNot(tok::pound_if, tok::pound_sourceLocation)) {
+      // Hash the interface of each top-level declaration separately too, so
+      // that its dependents can tell whether it changed.
+      if (IsTopLevel)
+        SF.beginDeclInterfaceHash();
       ParserStatus Status =
           parseDecl(IsTopLevel ? PD_AllowTopLevel : PD_Default,
                     [&](Decl *D) {TmpDecls.push_back(D);});
+      if (IsTopLevel)
+        SF.endDeclInterfaceHash(TmpDecls);
       if (Status.isError()) {
         NeedParseErrorRecovery = true;
         if (Status.hasCodeCompletion() && IsTopLevel &&
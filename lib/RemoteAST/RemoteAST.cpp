@@ -122,7 +122,8 @@ public:
   }
 
   NominalTypeDecl *createNominalTypeDecl(StringRef mangledName) {
-    auto node = Demangle::demangleTypeAsNode(mangledName);
+    Demangle::NodeFactory factory;
+    auto node = Demangle::demangleTypeAsNode(mangledName, factory);
     if (!node) return nullptr;
 
     return createNominalTypeDecl(node);
@@ -431,19 +431,22 @@ bool isClass(Demangle::NodePointer Node) {
 }
 
 bool NominalTypeTrait::isStruct() const {
-  auto Demangled = Demangle::demangleTypeAsNode(MangledName);
+  Demangle::NodeFactory Factory;
+  auto Demangled = Demangle::demangleTypeAsNode(MangledName, Factory);
   return ::isStruct(Demangled);
 }
 
 
 bool NominalTypeTrait::isEnum() const {
-  auto Demangled = Demangle::demangleTypeAsNode(MangledName);
+  Demangle::NodeFactory Factory;
+  auto Demangled = Demangle::demangleTypeAsNode(MangledName, Factory);
   return ::isEnum(Demangled);
 }
 
 
 bool NominalTypeTrait::isClass() const {
-  auto Demangled = Demangle::demangleTypeAsNode(MangledName);
+  Demangle::NodeFactory Factory;
+  auto Demangled = Demangle::demangleTypeAsNode(MangledName, Factory);
   return ::isClass(Demangled);
 }
 
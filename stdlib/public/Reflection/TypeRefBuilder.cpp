@@ -39,7 +39,9 @@ lookupAssociatedTypes(const std::string &MangledTypeName,
       if (ConformingTypeName.compare(MangledTypeName) != 0)
         continue;
       std::string ProtocolMangledName(AssocTyDescriptor.ProtocolTypeName);
-      auto DemangledProto = Demangle::demangleTypeAsNode(ProtocolMangledName);
+      Demangle::NodeFactory Factory;
+      auto DemangledProto =
+        Demangle::demangleTypeAsNode(ProtocolMangledName, Factory);
       auto TR = swift::remote::decodeMangledType(*this, DemangledProto);
 
       auto &Conformance = *DependentMember->getProtocol();
@@ -63,7 +65,9 @@ getDependentMemberTypeRef(const std::string &MangledTypeName,
         continue;
 
       auto SubstitutedTypeName = AssocTy.getMangledSubstitutedTypeName();
-      auto Demangled = Demangle::demangleTypeAsNode(SubstitutedTypeName);
+      Demangle::NodeFactory Factory;
+      auto Demangled =
+        Demangle::demangleTypeAsNode(SubstitutedTypeName, Factory);
       return swift::remote::decodeMangledType(*this, Demangled);
     }
   }
@@ -114,8 +118,9 @@ TypeRefBuilder::getFieldTypeRefs(const TypeRef *TR, const FieldDescriptor *FD) {
       continue;
     }
 
+    Demangle::NodeFactory Factory;
     auto Demangled
-      = Demangle::demangleTypeAsNode(Field.getMangledTypeName());
+      = Demangle::demangleTypeAsNode(Field.getMangledTypeName(), Factory);
     auto Unsubstituted = swift::remote::decodeMangledType(*this, Demangled);
     if (!Unsubstituted)
       return {};
@@ -183,7 +188,8 @@ TypeRefBuilder::getClosureContextInfo(const CaptureDescriptor &CD) {
     const TypeRef *TR = nullptr;
     if (i->hasMangledTypeName()) {
       auto MangledName = i->getMangledTypeName();
-      auto DemangleTree = Demangle::demangleTypeAsNode(MangledName);
+      Demangle::NodeFactory Factory;
+      auto DemangleTree = Demangle::demangleTypeAsNode(MangledName, Factory);
       TR = swift::remote::decodeMangledType(*this, DemangleTree);
     }
     Info.CaptureTypes.push_back(TR);
@@ -193,7 +199,8 @@ TypeRefBuilder::getClosureContextInfo(const CaptureDescriptor &CD) {
     const TypeRef *TR = nullptr;
     if (i->hasMangledTypeName()) {
       auto MangledName = i->getMangledTypeName();
-      auto DemangleTree = Demangle::demangleTypeAsNode(MangledName);
+      Demangle::NodeFactory Factory;
+      auto DemangleTree = Demangle::demangleTypeAsNode(MangledName, Factory);
       TR = swift::remote::decodeMangledType(*this, DemangleTree);
     }
 
@@ -221,7 +228,8 @@ TypeRefBuilder::dumpTypeRef(const std::string &MangledName,
   auto TypeName = Demangle::demangleTypeAsString(MangledName);
   OS << TypeName << '\n';
 
-  auto DemangleTree = Demangle::demangleTypeAsNode(MangledName);
+  Demangle::NodeFactory Factory;
+  auto DemangleTree = Demangle::demangleTypeAsNode(MangledName, Factory);
   auto TR = swift::remote::decodeMangledType(*this, DemangleTree);
   if (!TR) {
     OS << "!!! Invalid typeref: " << MangledName << '\n';
@@ -237,6 +237,159 @@ class StrongRefCount {
     return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_DEALLOCATING_FLAG;
   }
 
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
+  // Biased reference counting.
+  //
+  // An object allocated by a thread that has an owner slot starts out
+  // biased to that thread: the top bit is set, the next bits hold the
+  // owner's slot, and the count bits hold the references counted by the
+  // owner.  Only the owner updates them, with plain loads and stores.
+  // Other threads count their references in a side table instead (see
+  // BiasedRefCount.cpp) until the owner merges both counts, which clears
+  // the biased bit for good.  The deallocating flag is never set while the
+  // object is biased.
+  enum : uint32_t {
+    RC_BIASED_FLAG = 0x80000000,
+    RC_BIASED_OWNER_SHIFT = 21,
+    RC_BIASED_OWNER_MASK = 0x7FE00000,
+    RC_BIASED_COUNT_MASK = 0x001FFFFC,
+
+    RC_BIASED_MAX_OWNER = RC_BIASED_OWNER_MASK >> RC_BIASED_OWNER_SHIFT,
+    RC_BIASED_MAX_COUNT = RC_BIASED_COUNT_MASK >> RC_FLAGS_COUNT
+  };
+
+  static_assert((RC_BIASED_FLAG | RC_BIASED_OWNER_MASK | RC_BIASED_COUNT_MASK
+                 | RC_FLAGS_MASK) == ~0u,
+                "biased refcount fields must cover the refcount");
+
+  // Return the bits that identify the given owner slot in a biased
+  // refcount.  Slot 0 means "no owner" and matches no object.
+  static constexpr uint32_t getBiasedOwnerBits(uint32_t owner) {
+    return RC_BIASED_FLAG | (owner << RC_BIASED_OWNER_SHIFT);
+  }
+
+  // Refcount of a new object biased to the given owner is 1.
+  void initBiased(uint32_t ownerBits) {
+    refCount = ownerBits | RC_ONE;
+  }
+
+  // Return true if the object is biased to some thread.
+  bool isBiased() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_BIASED_FLAG;
+  }
+
+  // Return true if the object is biased to the owner slot with the given
+  // bits.
+  bool isBiasedTo(uint32_t ownerBits) const {
+    return valueIsBiasedTo(__atomic_load_n(&refCount, __ATOMIC_RELAXED),
+                           ownerBits);
+  }
+
+  // Return the owner slot of a biased object, or 0 if it isn't biased.
+  uint32_t getBiasedOwner() const {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    if (!(val & RC_BIASED_FLAG))
+      return 0;
+    return (val & RC_BIASED_OWNER_MASK) >> RC_BIASED_OWNER_SHIFT;
+  }
+
+  // Return the number of references counted by the owner of a biased
+  // object.
+  uint32_t getBiasedCount() const {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    assert((val & RC_BIASED_FLAG) && "object is not biased");
+    return (val & RC_BIASED_COUNT_MASK) >> RC_FLAGS_COUNT;
+  }
+
+  // Return true if the pinned flag is set.
+  bool isPinned() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_PINNED_FLAG;
+  }
+
+  // Increment the owner's count of an object biased to ownerBits.
+  // Returns false without changing anything if the object isn't biased to
+  // ownerBits or the count would overflow.
+  bool incrementBiased(uint32_t ownerBits, uint32_t n) {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    if (!valueIsBiasedTo(val, ownerBits) ||
+        n > RC_BIASED_MAX_COUNT - getBiasedCount(val))
+      return false;
+    __atomic_store_n(&refCount, val + (n << RC_FLAGS_COUNT),
+                     __ATOMIC_RELAXED);
+    return true;
+  }
+
+  // Decrement the owner's count of an object biased to ownerBits, and
+  // clear the pinned flag if ClearPinnedFlag.  Returns false without
+  // changing anything if the object isn't biased to ownerBits or this
+  // would release the owner's last reference.
+  template <bool ClearPinnedFlag>
+  bool decrementBiased(uint32_t ownerBits, uint32_t n) {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    if (!valueIsBiasedTo(val, ownerBits) || getBiasedCount(val) <= n)
+      return false;
+    assert((!ClearPinnedFlag || (val & RC_PINNED_FLAG)) &&
+           "unpinning reference that was not pinned");
+    val -= (n << RC_FLAGS_COUNT) + (ClearPinnedFlag ? RC_PINNED_FLAG : 0);
+    __atomic_store_n(&refCount, val, __ATOMIC_RELAXED);
+    return true;
+  }
+
+  // Try to set the pinned flag and increment the owner's count of an
+  // object biased to ownerBits, as tryIncrementAndPin does.  Returns false
+  // without changing anything if the object isn't biased to ownerBits or
+  // the count would overflow.
+  bool tryIncrementAndPinBiased(uint32_t ownerBits, bool &pinned) {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    if (!valueIsBiasedTo(val, ownerBits) ||
+        getBiasedCount(val) == RC_BIASED_MAX_COUNT)
+      return false;
+    pinned = !(val & RC_PINNED_FLAG);
+    if (pinned)
+      __atomic_store_n(&refCount, val + (RC_PINNED_FLAG + RC_ONE),
+                       __ATOMIC_RELAXED);
+    return true;
+  }
+
+  // Replace the owner's count of a biased object.  Only the owner, or a
+  // thread that holds its slot, may call this.
+  void setBiasedCount(uint32_t count, bool pinned) {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    assert((val & RC_BIASED_FLAG) && "object is not biased");
+    assert(count <= RC_BIASED_MAX_COUNT && "biased refcount overflow");
+    val &= RC_BIASED_FLAG | RC_BIASED_OWNER_MASK;
+    val |= (count << RC_FLAGS_COUNT) | (pinned ? RC_PINNED_FLAG : 0);
+    __atomic_store_n(&refCount, val, __ATOMIC_RELAXED);
+  }
+
+  // Stop biasing the object, giving it the combined count of all threads.
+  // Only the owner, or a thread that holds its slot, may call this.
+  void unbias(uint32_t count, bool pinned) {
+    assert(isBiased() && "object is not biased");
+    assert(count <= (RC_COUNT_MASK >> RC_FLAGS_COUNT) && "refcount overflow");
+    uint32_t newval = (count << RC_FLAGS_COUNT) | (pinned ? RC_PINNED_FLAG : 0);
+    __atomic_store_n(&refCount, newval, __ATOMIC_RELEASE);
+  }
+
+  // Stop biasing an object whose references are all gone, and set the
+  // deallocating flag.  Only the owner, or a thread that holds its slot,
+  // may call this, after synchronizing with every thread that released a
+  // reference to the object.
+  void unbiasAndDeallocate() {
+    assert(isBiased() && "object is not biased");
+    __atomic_store_n(&refCount, RC_DEALLOCATING_FLAG, __ATOMIC_RELAXED);
+  }
+
+private:
+  static bool valueIsBiasedTo(uint32_t val, uint32_t ownerBits) {
+    return ((val ^ ownerBits) & (RC_BIASED_FLAG | RC_BIASED_OWNER_MASK)) == 0;
+  }
+
+  static uint32_t getBiasedCount(uint32_t val) {
+    return (val & RC_BIASED_COUNT_MASK) >> RC_FLAGS_COUNT;
+  }
+#endif
+
 private:
   template <bool ClearPinnedFlag>
   bool doDecrementShouldDeallocate() {
@@ -397,12 +550,24 @@ private:
 class WeakRefCount {
   uint32_t refCount;
 
+  // The low bit is set once the object has a weak reference side table.
+  // With biased reference counting, the next two bits record the state of
+  // a biased object: whether other threads have counted references to it,
+  // and whether its owner has released all of its own.
+  // The remaining bits are the reference count.
   enum : uint32_t {
-    // There isn't really a flag here.
-    RC_UNUSED_FLAG = 1,
+    RC_SIDE_TABLE_FLAG = 1,
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
+    RC_BIASED_SHARED_FLAG = 2,
+    RC_BIASED_RELEASED_FLAG = 4,
 
+    RC_FLAGS_COUNT = 3,
+    RC_FLAGS_MASK = 7,
+#else
     RC_FLAGS_COUNT = 1,
     RC_FLAGS_MASK = 1,
+#endif
     RC_COUNT_MASK = ~RC_FLAGS_MASK,
 
     RC_ONE = RC_FLAGS_MASK + 1
@@ -476,6 +641,56 @@ class WeakRefCount {
   uint32_t getCount() const {
     return __atomic_load_n(&refCount, __ATOMIC_RELAXED) >> RC_FLAGS_COUNT;
   }
+
+  // Record that the object has a weak reference side table.
+  void setHasSideTable() {
+    __atomic_fetch_or(&refCount, RC_SIDE_TABLE_FLAG, __ATOMIC_RELAXED);
+  }
+
+  // Record that the object's weak reference side table has been detached.
+  void clearHasSideTable() {
+    __atomic_fetch_and(&refCount, ~uint32_t(RC_SIDE_TABLE_FLAG),
+                       __ATOMIC_RELAXED);
+  }
+
+  // Return true if the object has a weak reference side table.
+  bool hasSideTable() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_SIDE_TABLE_FLAG;
+  }
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
+  // Record that a thread other than the owner of a biased object has
+  // counted a reference to it.  Fails if the owner has already released
+  // all of its references and nobody else had counted any.
+  bool trySetBiasedShared() {
+    uint32_t oldval = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    while (true) {
+      if (oldval & RC_BIASED_SHARED_FLAG)
+        return true;
+      if (oldval & RC_BIASED_RELEASED_FLAG)
+        return false;
+      uint32_t newval = oldval | RC_BIASED_SHARED_FLAG;
+      if (__atomic_compare_exchange(&refCount, &oldval, &newval, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return true;
+    }
+  }
+
+  // Return true if other threads have counted references to a biased
+  // object.
+  bool isBiasedShared() const {
+    return __atomic_load_n(&refCount, __ATOMIC_ACQUIRE) & RC_BIASED_SHARED_FLAG;
+  }
+
+  // Record that the owner of a biased object has released all of its
+  // references.  Returns true if other threads have counted references
+  // to it, in which case the object may still be alive.
+  bool setBiasedReleased() {
+    uint32_t oldval = __atomic_fetch_or(&refCount, RC_BIASED_RELEASED_FLAG,
+                                        __ATOMIC_ACQ_REL);
+    return oldval & RC_BIASED_SHARED_FLAG;
+  }
+#endif
 };
 
 static_assert(swift::IsTriviallyConstructible<StrongRefCount>::value,
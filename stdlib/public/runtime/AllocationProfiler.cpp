@@ -0,0 +1,492 @@
+//===--- AllocationProfiler.cpp - Sampling heap object profiler -----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// A sampling profiler for heap objects allocated with swift_allocObject,
+// which includes the boxes allocated by swift_allocBox.  It aggregates the
+// sampled objects by their heap metadata and writes, for each kind of object,
+// an estimate of how many objects and bytes were allocated and how many are
+// still live.  It is meant to be cheap enough to leave on in production.
+//
+// Profiling is configured through the environment:
+//
+//   SWIFT_ALLOCATION_PROFILE=<path>
+//     Enables profiling and names the file to write the profile to.  "%p"
+//     in the path is replaced by the process ID.  The profile is written
+//     at exit, and whenever swift_dumpAllocationProfile is called.
+//   SWIFT_ALLOCATION_PROFILE_SAMPLE_BYTES=<bytes>
+//     The mean number of bytes each thread allocates between samples.  The
+//     default is 512KiB.
+//   SWIFT_ALLOCATION_PROFILE_PERIOD=<seconds>
+//     Also write the profile this often.
+//   SWIFT_ALLOCATION_PROFILE_SIGNAL=<signal number>
+//     Also write the profile when the process receives this signal.
+//
+// The distance between samples is drawn from an exponential distribution,
+// so an allocation of n bytes is sampled with probability
+// 1 - exp(-n / <sample bytes>), and each sample is scaled by the inverse of
+// that to estimate the totals.  Periodic and signalled dumps are written by a
+// background thread, never from the signal handler or an allocating thread.
+//
+// The profile is a text file with one line per kind of object, sorted by
+// estimated allocated bytes:
+//
+//   <objects> <bytes> <live objects> <live bytes> <samples> <metadata> <type>
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/Mutex.h"
+#include "swift/Runtime/Once.h"
+#include "AllocationProfiler.h"
+
+#if defined(__linux__)
+#include "llvm/ADT/DenseMap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <semaphore.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#endif
+
+using namespace swift;
+
+#if defined(__linux__)
+
+__thread intptr_t swift::_swift_allocationBytesUntilSample
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC = 0;
+
+std::atomic<bool> swift::_swift_allocationProfileHasLiveSamples(false);
+
+namespace {
+
+/// The sampled allocations of one kind of heap object, and the estimates
+/// derived from them.
+struct TypeProfile {
+  uint64_t Samples = 0;
+  double Objects = 0;
+  double Bytes = 0;
+  double LiveObjects = 0;
+  double LiveBytes = 0;
+};
+
+/// A sampled object that hasn't been deallocated yet.
+struct LiveSample {
+  const HeapMetadata *Metadata;
+  size_t Size;
+
+  /// The number of objects this sample stands for.
+  double Weight;
+};
+
+class AllocationProfiler {
+  /// The mean number of bytes allocated between samples.
+  const double SampleBytes;
+
+  Mutex Lock;
+
+  /// Serializes writing profiles, which may be requested by the dumper
+  /// thread, swift_dumpAllocationProfile and exit at the same time.
+  Mutex DumpLock;
+
+  llvm::DenseMap<const HeapMetadata *, TypeProfile> Types;
+
+  /// The addresses of live sampled objects, in an open-addressed table that
+  /// deallocations probe without taking the lock.  Slots are only changed
+  /// with the lock held.  A sampled object with no free slot within
+  /// MaxProbes of its hash isn't tracked as live; with a low sampling rate
+  /// the table is nearly empty, so that is rare.  Removals shift the rest of
+  /// the probe sequence back instead of leaving tombstones, so the table
+  /// doesn't fill up with them over a long run.
+  static const unsigned NumSlotsLog2 = 14;
+  static const size_t NumSlots = size_t(1) << NumSlotsLog2;
+  static const unsigned MaxProbes = 8;
+  std::atomic<uintptr_t> Slots[NumSlots];
+  LiveSample LiveSamples[NumSlots];
+
+  /// The number of addresses in Slots.  Guarded by the lock.
+  size_t NumLiveSamples = 0;
+
+  /// Odd while a removal is moving slots, and bumped again when it is done,
+  /// so that a probe without the lock can tell that it may have missed a
+  /// sample that was being moved.
+  std::atomic<unsigned> RemovalSequence;
+
+  static size_t getFirstSlot(uintptr_t address) {
+    return size_t((uint64_t(address) * 0x9E3779B97F4A7C15ULL)
+                  >> (64 - NumSlotsLog2));
+  }
+
+  static size_t getSlot(size_t first, unsigned probe) {
+    return (first + probe) & (NumSlots - 1);
+  }
+
+  /// Return the slot holding the given address, or NumSlots if it isn't in
+  /// the table.  Without the lock, the answer may be wrong while a removal
+  /// is in progress.
+  size_t findLiveSample(uintptr_t address) {
+    size_t first = getFirstSlot(address);
+    for (unsigned probe = 0; probe != MaxProbes; ++probe) {
+      size_t slot = getSlot(first, probe);
+      uintptr_t value = Slots[slot].load(std::memory_order_relaxed);
+      if (value == 0)
+        return NumSlots;
+      if (value == address)
+        return slot;
+    }
+    return NumSlots;
+  }
+
+  /// Remove the live sample in the given slot.  Called with the lock held.
+  void removeLiveSample(size_t slot) {
+    auto &sample = LiveSamples[slot];
+    auto &type = Types[sample.Metadata];
+    type.LiveObjects -= sample.Weight;
+    type.LiveBytes -= sample.Weight * sample.Size;
+
+    unsigned sequence = RemovalSequence.load(std::memory_order_relaxed);
+    RemovalSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Move each later address in the probe sequence that may live in the
+    // hole into it.  An address more than MaxProbes past the hole can't.
+    size_t hole = slot;
+    for (unsigned distance = 1; distance != MaxProbes; ++distance) {
+      size_t next = getSlot(hole, distance);
+      uintptr_t value = Slots[next].load(std::memory_order_relaxed);
+      if (value == 0)
+        break;
+      size_t home = getFirstSlot(value);
+      if (((next - home) & (NumSlots - 1)) < distance)
+        continue;
+      LiveSamples[hole] = LiveSamples[next];
+      Slots[hole].store(value, std::memory_order_relaxed);
+      hole = next;
+      distance = 0;
+    }
+    Slots[hole].store(0, std::memory_order_relaxed);
+
+    RemovalSequence.store(sequence + 2, std::memory_order_release);
+
+    if (--NumLiveSamples == 0)
+      _swift_allocationProfileHasLiveSamples.store(false,
+                                                   std::memory_order_relaxed);
+  }
+
+  /// Start tracking a sampled object as live.  Called with the lock held.
+  void addLiveSample(HeapObject *object, const LiveSample &sample) {
+    auto address = reinterpret_cast<uintptr_t>(object);
+
+    // An object freed without going through swift_deallocObject leaves a
+    // stale sample behind; drop it now that its memory has been reused.
+    size_t staleSlot = findLiveSample(address);
+    if (staleSlot != NumSlots)
+      removeLiveSample(staleSlot);
+
+    size_t first = getFirstSlot(address);
+    size_t freeSlot = NumSlots;
+    for (unsigned probe = 0; probe != MaxProbes; ++probe) {
+      size_t slot = getSlot(first, probe);
+      if (Slots[slot].load(std::memory_order_relaxed) == 0) {
+        freeSlot = slot;
+        break;
+      }
+    }
+    if (freeSlot == NumSlots)
+      return;
+
+    LiveSamples[freeSlot] = sample;
+    auto &type = Types[sample.Metadata];
+    type.LiveObjects += sample.Weight;
+    type.LiveBytes += sample.Weight * sample.Size;
+    Slots[freeSlot].store(address, std::memory_order_release);
+    ++NumLiveSamples;
+    _swift_allocationProfileHasLiveSamples.store(true,
+                                                 std::memory_order_relaxed);
+  }
+
+public:
+  /// The file the profile is written to by default.
+  const std::string Path;
+
+  AllocationProfiler(std::string path, double sampleBytes)
+    : SampleBytes(sampleBytes), RemovalSequence(0), Path(std::move(path)) {
+    for (auto &slot : Slots)
+      slot.store(0, std::memory_order_relaxed);
+  }
+
+  /// Choose the number of bytes until this thread's next sample.
+  intptr_t getNextSampleDistance() {
+    // A per-thread xorshift generator.  It is seeded from the address of
+    // its state, which differs between threads.
+    static __thread uint64_t state;
+    if (state == 0)
+      state = reinterpret_cast<uintptr_t>(&state) ^ uint64_t(time(nullptr))
+              ^ 0x2545F4914F6CDD1DULL;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    uint64_t bits = state * 0x2545F4914F6CDD1DULL;
+
+    // A uniform value in (0, 1], scaled to an exponential distance.
+    double uniform = double((bits >> 11) + 1) * (1.0 / 9007199254740992.0);
+    double distance = -std::log(uniform) * SampleBytes;
+    if (distance < 1)
+      return 1;
+    if (distance >= double(INTPTR_MAX))
+      return INTPTR_MAX;
+    return intptr_t(distance);
+  }
+
+  void sample(HeapObject *object, size_t size) {
+    // The probability that an allocation of this size would be sampled,
+    // whose inverse is the number of allocations the sample stands for.
+    double probability = -std::expm1(-double(size) / SampleBytes);
+    LiveSample sample = { object->metadata, size, 1 / probability };
+
+    Lock.withLock([&] {
+      auto &type = Types[sample.Metadata];
+      type.Samples += 1;
+      type.Objects += sample.Weight;
+      type.Bytes += sample.Weight * size;
+      addLiveSample(object, sample);
+    });
+  }
+
+  void noteDeallocation(HeapObject *object) {
+    auto address = reinterpret_cast<uintptr_t>(object);
+    unsigned sequence = RemovalSequence.load(std::memory_order_acquire);
+    bool found = findLiveSample(address) != NumSlots;
+    if (!found) {
+      // Unless a removal moved slots while we probed, the object wasn't
+      // sampled.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!(sequence & 1) &&
+          RemovalSequence.load(std::memory_order_relaxed) == sequence)
+        return;
+    }
+
+    Lock.withLock([&] {
+      size_t slot = findLiveSample(address);
+      if (slot != NumSlots)
+        removeLiveSample(slot);
+    });
+  }
+
+  void dump(FILE *output);
+  void write(const char *path);
+};
+
+} // end anonymous namespace
+
+/// Return a name for the objects allocated with the given heap metadata.
+static std::string nameForHeapMetadata(const HeapMetadata *metadata) {
+  switch (metadata->getKind()) {
+  case MetadataKind::HeapGenericLocalVariable: {
+    auto box = static_cast<const GenericBoxHeapMetadata *>(metadata);
+    return "Box<" + nameForMetadata(box->BoxedType) + ">";
+  }
+  case MetadataKind::HeapLocalVariable:
+    return "<<<closure context or box>>>";
+  case MetadataKind::ErrorObject:
+    return "<<<error box>>>";
+  default:
+    return nameForMetadata(metadata);
+  }
+}
+
+void AllocationProfiler::dump(FILE *output) {
+  // Copy the profile so that allocations aren't blocked while we look up
+  // type names.
+  std::vector<std::pair<const HeapMetadata *, TypeProfile>> types;
+  Lock.withLock([&] {
+    types.assign(Types.begin(), Types.end());
+  });
+  std::sort(types.begin(), types.end(),
+            [](const std::pair<const HeapMetadata *, TypeProfile> &lhs,
+               const std::pair<const HeapMetadata *, TypeProfile> &rhs) {
+    return lhs.second.Bytes > rhs.second.Bytes;
+  });
+
+  fprintf(output, "# Swift allocation profile for process %d, sampling "
+          "every %.0f bytes\n", int(getpid()), SampleBytes);
+  fprintf(output, "# <objects> <bytes> <live objects> <live bytes> "
+          "<samples> <metadata> <type>\n");
+  TypeProfile total;
+  for (const auto &type : types) {
+    const auto &profile = type.second;
+    fprintf(output, "%.0f %.0f %.0f %.0f %" PRIu64 " %p %s\n",
+            profile.Objects, profile.Bytes, profile.LiveObjects,
+            profile.LiveBytes, profile.Samples,
+            static_cast<const void *>(type.first),
+            nameForHeapMetadata(type.first).c_str());
+    total.Samples += profile.Samples;
+    total.Objects += profile.Objects;
+    total.Bytes += profile.Bytes;
+    total.LiveObjects += profile.LiveObjects;
+    total.LiveBytes += profile.LiveBytes;
+  }
+  fprintf(output, "# total: %.0f %.0f %.0f %.0f %" PRIu64 "\n",
+          total.Objects, total.Bytes, total.LiveObjects, total.LiveBytes,
+          total.Samples);
+}
+
+/*****************************************************************************/
+/********************************* Dumping ***********************************/
+/*****************************************************************************/
+
+void AllocationProfiler::write(const char *path) {
+  // Write to a temporary file and rename it into place, so that a reader
+  // never sees a partial profile.
+  std::string temporaryPath = path;
+  temporaryPath += ".tmp";
+  DumpLock.withLock([&] {
+    FILE *output = fopen(temporaryPath.c_str(), "w");
+    if (!output)
+      return;
+    dump(output);
+    if (fclose(output) == 0)
+      rename(temporaryPath.c_str(), path);
+    else
+      unlink(temporaryPath.c_str());
+  });
+}
+
+static AllocationProfiler *Profiler;
+static swift_once_t AllocationProfilingOnce;
+
+/// Posted by the dump signal handler to wake the dumper thread.
+static sem_t DumpRequested;
+
+static void handleDumpSignal(int signal) {
+  sem_post(&DumpRequested);
+}
+
+static void runDumper(unsigned period) {
+  while (true) {
+    int result;
+    if (period) {
+      timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += period;
+      do {
+        result = sem_timedwait(&DumpRequested, &deadline);
+      } while (result == -1 && errno == EINTR);
+    } else {
+      do {
+        result = sem_wait(&DumpRequested);
+      } while (result == -1 && errno == EINTR);
+    }
+    Profiler->write(Profiler->Path.c_str());
+  }
+}
+
+static unsigned long getEnvironmentNumber(const char *name,
+                                          unsigned long defaultValue) {
+  const char *value = getenv(name);
+  if (!value || !*value)
+    return defaultValue;
+  char *end;
+  unsigned long result = strtoul(value, &end, 10);
+  return *end ? defaultValue : result;
+}
+
+static void initializeAllocationProfiling(void *) {
+  const char *pathTemplate = getenv("SWIFT_ALLOCATION_PROFILE");
+  if (!pathTemplate || !*pathTemplate)
+    return;
+
+  std::string path;
+  for (const char *c = pathTemplate; *c; ++c) {
+    if (c[0] == '%' && c[1] == 'p') {
+      path += std::to_string(getpid());
+      ++c;
+    } else {
+      path += *c;
+    }
+  }
+
+  unsigned long sampleBytes =
+    getEnvironmentNumber("SWIFT_ALLOCATION_PROFILE_SAMPLE_BYTES", 512 * 1024);
+  unsigned long period =
+    getEnvironmentNumber("SWIFT_ALLOCATION_PROFILE_PERIOD", 0);
+  unsigned long signal =
+    getEnvironmentNumber("SWIFT_ALLOCATION_PROFILE_SIGNAL", 0);
+
+  Profiler = new AllocationProfiler(std::move(path),
+                                    sampleBytes ? sampleBytes : 1);
+  atexit([] { Profiler->write(Profiler->Path.c_str()); });
+
+  if (period == 0 && signal == 0)
+    return;
+  sem_init(&DumpRequested, /*pshared*/ 0, 0);
+  if (signal != 0 && signal < unsigned(NSIG)) {
+    struct sigaction action = {};
+    action.sa_handler = handleDumpSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(int(signal), &action, nullptr);
+  }
+  std::thread(runDumper, unsigned(std::min(period, (unsigned long)UINT_MAX)))
+    .detach();
+}
+
+static AllocationProfiler *getProfiler() {
+  swift_once(&AllocationProfilingOnce, initializeAllocationProfiling);
+  return Profiler;
+}
+
+/*****************************************************************************/
+/****************************** Entry points *********************************/
+/*****************************************************************************/
+
+void swift::_swift_sampleAllocation(HeapObject *object, size_t size) {
+  auto profiler = getProfiler();
+  if (!profiler) {
+    // Profiling is off, so this thread never needs to come back here.
+    _swift_allocationBytesUntilSample = INTPTR_MAX;
+    return;
+  }
+
+  // The first allocation on each thread only starts the countdown, so that
+  // it isn't always sampled.
+  static __thread bool isCountingDown;
+  if (isCountingDown)
+    profiler->sample(object, size);
+  isCountingDown = true;
+  _swift_allocationBytesUntilSample = profiler->getNextSampleDistance();
+}
+
+void swift::_swift_noteSampledDeallocation(HeapObject *object) {
+  Profiler->noteDeallocation(object);
+}
+
+void swift::swift_dumpAllocationProfile(const char *path) {
+  if (auto profiler = getProfiler())
+    profiler->write(path ? path : profiler->Path.c_str());
+}
+
+#else // !defined(__linux__)
+
+void swift::swift_dumpAllocationProfile(const char *path) {}
+
+#endif
@@ -0,0 +1,75 @@
+//===--- AllocationProfiler.h - Sampling heap object profiler ---*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// The allocation and deallocation hooks for the sampling allocation profiler.
+// They are inline so that, with profiling off or between samples, an
+// allocation costs a thread-local subtraction and a deallocation costs one
+// relaxed load.  See AllocationProfiler.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_ALLOCATIONPROFILER_H
+#define SWIFT_RUNTIME_ALLOCATIONPROFILER_H
+
+#include "swift/Runtime/Config.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace swift {
+
+struct HeapObject;
+
+#if defined(__linux__)
+
+/// The number of bytes this thread may still allocate before the profiler
+/// samples an allocation.  This starts at zero, so that the first
+/// allocation on each thread decides whether profiling is on.  Every
+/// allocation touches this.
+extern __thread intptr_t _swift_allocationBytesUntilSample
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC;
+
+/// True while any sampled object is live, during which deallocations have
+/// to check whether they are freeing a sampled object.
+extern std::atomic<bool> _swift_allocationProfileHasLiveSamples;
+
+void _swift_sampleAllocation(HeapObject *object, size_t size);
+void _swift_noteSampledDeallocation(HeapObject *object);
+
+/// Note that an object was allocated, sampling it if this thread has
+/// allocated enough bytes since its last sample.
+static inline void _swift_noteAllocation(HeapObject *object, size_t size) {
+  _swift_allocationBytesUntilSample -= size;
+  if (LLVM_UNLIKELY(_swift_allocationBytesUntilSample < 0))
+    _swift_sampleAllocation(object, size);
+}
+
+/// Note that an object is about to be deallocated.
+static inline void _swift_noteDeallocation(HeapObject *object) {
+  if (LLVM_UNLIKELY(_swift_allocationProfileHasLiveSamples.load(
+                                                  std::memory_order_relaxed)))
+    _swift_noteSampledDeallocation(object);
+}
+
+#else
+
+// Allocation profiling is only supported on Linux.
+
+static inline void _swift_noteAllocation(HeapObject *object, size_t size) {}
+static inline void _swift_noteDeallocation(HeapObject *object) {}
+
+#endif
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_ALLOCATIONPROFILER_H
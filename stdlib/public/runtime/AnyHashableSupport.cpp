@@ -15,6 +15,7 @@
 #include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Debug.h"
 #include "swift/Runtime/Metadata.h"
+#include "CacheReplicas.h"
 #include "Private.h"
 #include "SwiftValue.h"
 #include "SwiftHashableSupport.h"
@@ -70,8 +71,13 @@ template<bool KnownToConformToHashable>
 LLVM_ATTRIBUTE_ALWAYS_INLINE
 static const Metadata *findHashableBaseTypeImpl(const Metadata *type) {
   // Check the cache first.
+  if (auto baseType = _swift_findInCacheReplica(
+                          ReplicatedCache::HashableBaseTypes, type, nullptr))
+    return static_cast<const Metadata *>(baseType);
   if (HashableConformanceEntry *entry =
           HashableConformances->find(HashableConformanceKey{type})) {
+    _swift_fillCacheReplica(ReplicatedCache::HashableBaseTypes, type, nullptr,
+                            entry->baseTypeThatConformsToHashable);
     return entry->baseTypeThatConformsToHashable;
   }
   if (!KnownToConformToHashable &&
@@ -94,6 +100,8 @@ static const Metadata *findHashableBaseTypeImpl(const Metadata *type) {
   }
   HashableConformances->getOrInsert(HashableConformanceKey{type},
                                     baseTypeThatConformsToHashable);
+  _swift_fillCacheReplica(ReplicatedCache::HashableBaseTypes, type, nullptr,
+                          baseTypeThatConformsToHashable);
   return baseTypeThatConformsToHashable;
 }
 
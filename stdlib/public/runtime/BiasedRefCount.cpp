@@ -0,0 +1,509 @@
+//===--- BiasedRefCount.cpp - Thread-biased reference counting ------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Biased reference counting, enabled with
+// SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING.
+//
+// Most objects are only ever retained and released by the thread that
+// allocated them, so each thread takes one of a fixed number of owner slots
+// the first time it allocates an object, and every object it allocates is
+// biased to its slot.  The owner retains and releases a biased object with
+// plain loads and stores of the owner's count in StrongRefCount.
+//
+// Any other thread counts its references in a striped side table of shared
+// counts instead.  The first time it does so for an object, it sets the
+// object's shared flag in WeakRefCount and asks the owner to merge the
+// object's counts by pushing it onto the owner slot's list of merge
+// requests.  The owner merges requested objects whenever it allocates or
+// releases an object.  Merging adds the shared count to the owner's count,
+// stores the sum as a normal refcount and clears the biased flag, after
+// which every thread uses the usual atomic operations.  Apart from the
+// deallocation described below, only the thread that holds an object's
+// owner slot ever writes to the refcount of a biased object.
+//
+// When the owner releases its last reference to an object, it sets the
+// object's released flag.  If no other thread had set the shared flag by
+// then, nobody else can have counted a reference, and the object is
+// deallocated right away; once the released flag is set, other threads can
+// no longer set the shared flag, so swift_tryRetain fails.  Otherwise the
+// owner merges the object's counts, and it is only deallocated if they add
+// up to zero.
+//
+// A thread other than the owner that releases an object's last reference
+// usually deallocates the object itself, without waiting for the owner.  If
+// the owner releases the last reference on its fast path, after other
+// threads released references it counted, the object is deallocated when
+// that release merges the pending requests.
+//
+// Deallocation can still be delayed when the owner's fast-path release and
+// another thread's first release of the object race: the other thread may
+// read the owner's count from before the owner's store, see a nonzero total
+// and push a merge request, while the owner's relaxed load of its requests
+// misses that push.  Neither deallocates the object then; it stays allocated
+// until the owner next allocates or releases an object, or exits.  An owner
+// that blocks indefinitely without doing either delays the deinit just as
+// long.  A fence on the owner's release path alone wouldn't close this,
+// since the other thread reads the count before it pushes its request; the
+// race is rare, so we accept the delay instead.
+// When a thread exits, it merges its pending requests and frees its slot.
+// A thread that later sends a request to a free slot merges the slot's
+// requests itself, and the next thread to take the slot becomes the owner
+// of the objects still biased to it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BiasedRefCount.h"
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
+
+#include "swift/Basic/Lazy.h"
+#include "swift/Runtime/Debug.h"
+#include "swift/Runtime/Mutex.h"
+#include "swift/Runtime/Once.h"
+#include "llvm/ADT/DenseMap.h"
+#include <pthread.h>
+
+using namespace swift;
+
+// Defined in HeapObject.cpp.
+extern "C" LLVM_LIBRARY_VISIBILITY void
+_swift_release_dealloc(HeapObject *object) SWIFT_CC(RegisterPreservingCC_IMPL)
+    __attribute__((__noinline__, __used__));
+
+__thread BiasedRefCountThread swift::_swift_biasedRefCountThread
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC = {
+    StrongRefCount::getBiasedOwnerBits(0), nullptr
+  };
+
+/// A request to merge the counts of an object biased to some owner slot.
+struct swift::BiasedMergeRequest {
+  HeapObject *Object;
+  BiasedMergeRequest *Next;
+};
+
+namespace {
+
+enum class OwnerSlotState : uint8_t {
+  /// No thread holds the slot.
+  Free,
+
+  /// A live thread owns the slot.
+  Owned,
+
+  /// A thread is merging the requests sent to the slot after its owner
+  /// exited.
+  Claimed
+};
+
+/// One slot per thread that biases the objects it allocates.  These must
+/// stay trivially constructible, so that the slots need no initializer.
+struct alignas(64) OwnerSlot {
+  std::atomic<OwnerSlotState> State;
+
+  /// A stack of merge requests, pushed by other threads and taken all at
+  /// once by the thread that holds the slot.
+  std::atomic<BiasedMergeRequest *> MergeRequests;
+};
+
+/// The references that threads other than their owners have counted to
+/// biased objects.  An object has an entry from the time another thread
+/// first counts a reference to it until its counts are merged.
+class SharedCountTable {
+  static constexpr unsigned NumStripes = 64;
+
+  struct alignas(64) Stripe {
+    Mutex Lock;
+    llvm::DenseMap<HeapObject *, int32_t> Counts;
+  };
+
+  Stripe Stripes[NumStripes];
+
+public:
+  using CountMap = llvm::DenseMap<HeapObject *, int32_t>;
+
+  /// Call body with the shared counts of the stripe the object belongs to,
+  /// holding its lock.
+  template <class Body>
+  void withCounts(HeapObject *object, const Body &body) {
+    auto bits = reinterpret_cast<uintptr_t>(object);
+    auto &stripe = Stripes[(bits >> 4) % NumStripes];
+    stripe.Lock.withLock([&] { body(stripe.Counts); });
+  }
+};
+
+} // end anonymous namespace
+
+static OwnerSlot OwnerSlots[StrongRefCount::RC_BIASED_MAX_OWNER + 1];
+static std::atomic<uint32_t> NextOwnerSlot;
+static pthread_key_t OwnerSlotKey;
+static bool OwnerSlotKeyIsValid;
+static swift_once_t OwnerSlotKeyOnce;
+
+static Lazy<SharedCountTable> SharedCounts;
+
+/// The calling thread's owner slot, or 0 if it doesn't have one.
+static __thread uint32_t LocalOwner;
+
+/// Whether the calling thread has tried to take an owner slot.
+static __thread bool LocalOwnerIsRegistered;
+
+/// Merge the counts of a biased object into a normal refcount, and
+/// deallocate the object if they add up to zero.  ownerDelta is added to
+/// the owner's count.  The calling thread must hold the object's owner
+/// slot.
+///
+/// If isRequest, the object may have been merged, and even deallocated,
+/// since the request was made, so it is left alone unless it still has
+/// shared counts.
+static void mergeCounts(uint32_t owner, HeapObject *object,
+                        int64_t ownerDelta, bool isRequest) {
+  bool shouldDeallocate = false;
+  SharedCounts->withCounts(object, [&](SharedCountTable::CountMap &counts) {
+    auto found = counts.find(object);
+    if (isRequest && found == counts.end())
+      return;
+
+    // The entry may belong to another object allocated at the same address
+    // since the request was made.
+    if (object->refCount.getBiasedOwner() != owner) {
+      assert(isRequest && "merging an object biased to another thread");
+      return;
+    }
+
+    int64_t count = object->refCount.getBiasedCount() + ownerDelta;
+    if (found != counts.end()) {
+      count += found->second;
+      counts.erase(found);
+    }
+    assert(count >= 0 && "releasing reference with a refcount of zero");
+
+    bool pinned = object->refCount.isPinned();
+    if (count == 0 && !pinned) {
+      object->refCount.unbiasAndDeallocate();
+      shouldDeallocate = true;
+    } else {
+      object->refCount.unbias(uint32_t(count), pinned);
+    }
+  });
+
+  if (shouldDeallocate)
+    _swift_release_dealloc(object);
+}
+
+/// Merge every object that other threads have asked the holder of the
+/// given slot to merge.  The calling thread must hold the slot.
+static void mergeRequests(uint32_t owner) {
+  auto request = OwnerSlots[owner].MergeRequests.exchange(
+                                              nullptr, std::memory_order_acquire);
+  while (request) {
+    auto next = request->Next;
+    mergeCounts(owner, request->Object, 0, /*isRequest*/ true);
+    delete request;
+    request = next;
+  }
+}
+
+/// Merge the requests sent to a slot whose owner has exited, unless a
+/// thread has taken the slot since.
+static void mergeOrphanedRequests(uint32_t owner) {
+  auto &slot = OwnerSlots[owner];
+
+  // A request pushed while we hold the slot is merged by the next
+  // iteration, or by whoever pushed it if we already freed the slot again.
+  while (slot.MergeRequests.load(std::memory_order_seq_cst)) {
+    auto expected = OwnerSlotState::Free;
+    if (!slot.State.compare_exchange_strong(expected, OwnerSlotState::Claimed,
+                                            std::memory_order_seq_cst))
+      return;
+    mergeRequests(owner);
+    slot.State.store(OwnerSlotState::Free, std::memory_order_seq_cst);
+  }
+}
+
+/// Ask the holder of the given slot to merge the counts of an object.
+static void requestMerge(uint32_t owner, HeapObject *object) {
+  auto &slot = OwnerSlots[owner];
+  auto request = new BiasedMergeRequest{
+    object, slot.MergeRequests.load(std::memory_order_relaxed)
+  };
+  while (!slot.MergeRequests.compare_exchange_weak(request->Next, request,
+                                                   std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed))
+    ;
+
+  // If the owner has exited, nobody else is going to merge it.
+  if (slot.State.load(std::memory_order_seq_cst) == OwnerSlotState::Free)
+    mergeOrphanedRequests(owner);
+}
+
+/// Add delta to the shared count of an object, on a thread other than its
+/// owner.  Returns false if the object is no longer biased, in which case
+/// the caller should update its refcount as usual.
+///
+/// If the total this sees is zero, the object is deallocated here rather
+/// than when its owner next merges.  The owner can't be touching its count
+/// then: it only writes to it while it holds a reference, and every
+/// reference it handed to another thread was counted before that thread got
+/// it.  The total can be stale, though: if the owner's fast-path release of
+/// its last reference races with this, this may see the owner's earlier
+/// count and request a merge that the owner doesn't notice until its next
+/// allocation or release, so the deallocation waits until then.  See the
+/// comment at the top of this file.
+static bool updateSharedCount(HeapObject *object, int32_t delta) {
+  bool isBiased = false;
+  bool shouldDeallocate = false;
+  uint32_t newEntryOwner = 0;
+  SharedCounts->withCounts(object, [&](SharedCountTable::CountMap &counts) {
+    uint32_t owner = object->refCount.getBiasedOwner();
+    if (!owner)
+      return;
+    isBiased = true;
+
+    auto inserted = counts.insert({object, 0});
+    if (inserted.second) {
+      bool isShared = object->weakRefCount.trySetBiasedShared();
+      assert(isShared && "retaining or releasing a deallocated object");
+      (void) isShared;
+      newEntryOwner = owner;
+    }
+    inserted.first->second += delta;
+
+    if (delta < 0 &&
+        object->refCount.getBiasedCount() + inserted.first->second == 0 &&
+        !object->refCount.isPinned()) {
+      counts.erase(inserted.first);
+      object->refCount.unbiasAndDeallocate();
+      shouldDeallocate = true;
+      newEntryOwner = 0;
+    }
+  });
+
+  if (newEntryOwner)
+    requestMerge(newEntryOwner, object);
+  if (shouldDeallocate)
+    _swift_release_dealloc(object);
+  return isBiased;
+}
+
+/// Free the calling thread's owner slot when it exits.
+static void releaseOwnerSlot(void *value) {
+  auto owner = uint32_t(reinterpret_cast<uintptr_t>(value));
+
+  // Destructors that run after this one count references like any thread
+  // without a slot.
+  _swift_biasedRefCountThread = {
+    StrongRefCount::getBiasedOwnerBits(0), nullptr
+  };
+  LocalOwner = 0;
+
+  mergeRequests(owner);
+  OwnerSlots[owner].State.store(OwnerSlotState::Free,
+                                std::memory_order_seq_cst);
+  mergeOrphanedRequests(owner);
+}
+
+static void createOwnerSlotKey(void *) {
+  OwnerSlotKeyIsValid =
+    pthread_key_create(&OwnerSlotKey, releaseOwnerSlot) == 0;
+}
+
+/// Take a free owner slot for the calling thread, if there is one.
+static void registerOwner() {
+  LocalOwnerIsRegistered = true;
+
+  swift_once(&OwnerSlotKeyOnce, createOwnerSlotKey);
+  if (!OwnerSlotKeyIsValid)
+    return;
+
+  const uint32_t numSlots = StrongRefCount::RC_BIASED_MAX_OWNER;
+  uint32_t start = NextOwnerSlot.fetch_add(1, std::memory_order_relaxed);
+  for (uint32_t i = 0; i != numSlots; ++i) {
+    uint32_t owner = (start + i) % numSlots + 1;
+    auto &slot = OwnerSlots[owner];
+    auto expected = OwnerSlotState::Free;
+    if (!slot.State.compare_exchange_strong(expected, OwnerSlotState::Owned,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+      continue;
+
+    LocalOwner = owner;
+    _swift_biasedRefCountThread = {
+      StrongRefCount::getBiasedOwnerBits(owner), &slot.MergeRequests
+    };
+    pthread_setspecific(OwnerSlotKey, reinterpret_cast<void *>(
+                                        static_cast<uintptr_t>(owner)));
+    return;
+  }
+}
+
+void swift::_swift_biasedInitSlow(HeapObject *object) {
+  if (!LocalOwnerIsRegistered)
+    registerOwner();
+
+  auto &thread = _swift_biasedRefCountThread;
+  if (thread.MergeRequests)
+    object->refCount.initBiased(thread.OwnerBits);
+  else
+    object->refCount.init();
+  object->weakRefCount.init();
+}
+
+void swift::_swift_biasedMergePending() {
+  mergeRequests(LocalOwner);
+}
+
+void swift::_swift_biasedRetainSlow(HeapObject *object, uint32_t n) {
+  if (object->refCount.isBiasedTo(_swift_biasedRefCountThread.OwnerBits)) {
+    // The owner's count would overflow.
+    mergeCounts(LocalOwner, object, 0, /*isRequest*/ false);
+    object->refCount.increment(n);
+    return;
+  }
+
+  if (!updateSharedCount(object, int32_t(n)))
+    object->refCount.increment(n);
+}
+
+void swift::_swift_biasedReleaseSlow(HeapObject *object, uint32_t n,
+                                     bool unpin) {
+  if (object->refCount.isBiasedTo(_swift_biasedRefCountThread.OwnerBits)) {
+    // This releases the last of the references the owner counted.
+    uint32_t count = object->refCount.getBiasedCount();
+    bool pinned = object->refCount.isPinned();
+    assert((!unpin || pinned) && "unpinning reference that was not pinned");
+    if (!object->weakRefCount.setBiasedReleased()) {
+      assert(count == n && (!pinned || unpin) &&
+             "releasing reference with a refcount of zero");
+      object->refCount.unbiasAndDeallocate();
+      _swift_release_dealloc(object);
+      return;
+    }
+
+    // Other threads have counted references, so the object may still be
+    // alive.
+    object->refCount.setBiasedCount(count, pinned && !unpin);
+    mergeCounts(LocalOwner, object, -int64_t(n), /*isRequest*/ false);
+    return;
+  }
+
+  // The pinned flag of a biased object can only be set by its owner, and
+  // pins are strictly nested, so they never cross threads.
+  if (unpin && object->refCount.isBiased())
+    swift::fatalError(/* flags = */ 0,
+                      "fatal error: unpinned an object on a thread that "
+                      "didn't pin it\n");
+
+  if (updateSharedCount(object, -int32_t(n)))
+    return;
+
+  bool shouldDeallocate =
+    unpin ? object->refCount.decrementAndUnpinShouldDeallocate()
+          : object->refCount.decrementShouldDeallocateN(n);
+  if (shouldDeallocate)
+    _swift_release_dealloc(object);
+}
+
+bool swift::_swift_biasedTryPinSlow(HeapObject *object) {
+  if (object->refCount.isBiasedTo(_swift_biasedRefCountThread.OwnerBits)) {
+    // The owner's count would overflow.
+    mergeCounts(LocalOwner, object, 0, /*isRequest*/ false);
+    return object->refCount.tryIncrementAndPin();
+  }
+
+  // Only the owner may pin a biased object.  Failing to pin is always
+  // allowed; ask the owner to merge the object so later pins can succeed.
+  if (updateSharedCount(object, 0))
+    return false;
+  return object->refCount.tryIncrementAndPin();
+}
+
+bool swift::_swift_biasedTryRetainSlow(HeapObject *object, bool &retained) {
+  // Unless other threads have counted references, the owner's count is
+  // the whole count, and the owner holds one of them.
+  if (object->refCount.isBiasedTo(_swift_biasedRefCountThread.OwnerBits) &&
+      !object->weakRefCount.isBiasedShared()) {
+    retained = true;
+    return _swift_biasedRetain(object, 1);
+  }
+
+  bool isBiased = false;
+  uint32_t newEntryOwner = 0;
+  SharedCounts->withCounts(object, [&](SharedCountTable::CountMap &counts) {
+    uint32_t owner = object->refCount.getBiasedOwner();
+    if (!owner)
+      return;
+    isBiased = true;
+    retained = false;
+
+    auto found = counts.find(object);
+    if (found == counts.end()) {
+      // The owner still holds a reference unless it has set the released
+      // flag.  If it hasn't, it will see our shared count when it does.
+      if (!object->weakRefCount.trySetBiasedShared())
+        return;
+      found = counts.insert({object, 0}).first;
+      newEntryOwner = owner;
+    } else if (object->refCount.getBiasedCount() + found->second <= 0) {
+      // The object is waiting for its owner to deallocate it.
+      return;
+    }
+    found->second += 1;
+    retained = true;
+  });
+
+  if (newEntryOwner)
+    requestMerge(newEntryOwner, object);
+  return isBiased;
+}
+
+bool swift::_swift_biasedIsUniquelyReferencedSlow(HeapObject *object,
+                                                  bool orPinned,
+                                                  bool &result) {
+  size_t count;
+  if (!_swift_biasedGetCount(object, count))
+    return false;
+  result = count == 1 || (orPinned && object->refCount.isPinned());
+  return true;
+}
+
+bool swift::_swift_biasedGetCount(HeapObject *object, size_t &count) {
+  if (!object->refCount.isBiased())
+    return false;
+
+  bool isBiased = false;
+  SharedCounts->withCounts(object, [&](SharedCountTable::CountMap &counts) {
+    if (!object->refCount.isBiased())
+      return;
+    isBiased = true;
+    int64_t total = object->refCount.getBiasedCount();
+    auto found = counts.find(object);
+    if (found != counts.end())
+      total += found->second;
+    count = total > 0 ? size_t(total) : 0;
+  });
+  return isBiased;
+}
+
+bool swift::_swift_biasedSetDeallocating(HeapObject *object) {
+  if (!object->refCount.isBiased())
+    return false;
+
+  // The caller holds the only reference, so nobody else can be updating
+  // the object's counts.
+  SharedCounts->withCounts(object, [&](SharedCountTable::CountMap &counts) {
+    counts.erase(object);
+    object->refCount.unbiasAndDeallocate();
+  });
+  return true;
+}
+
+#endif // SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
@@ -0,0 +1,187 @@
+//===--- BiasedRefCount.h - Thread-biased reference counting ----*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// The reference counting hooks for biased reference counting.  Each one
+// returns true if it handled an object that is biased to some thread, and
+// false if the caller should update the object's refcount as usual.  They
+// are inline so that the owning thread never makes a call or an atomic
+// read-modify-write.  See BiasedRefCount.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_BIASEDREFCOUNT_H
+#define SWIFT_RUNTIME_BIASEDREFCOUNT_H
+
+#include "swift/Runtime/HeapObject.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <cstdint>
+
+namespace swift {
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNTING
+
+#if !defined(__linux__)
+#error "biased reference counting is only supported on Linux"
+#endif
+
+struct BiasedMergeRequest;
+
+/// The biased reference counting state of a thread.
+struct BiasedRefCountThread {
+  /// StrongRefCount::getBiasedOwnerBits of the thread's owner slot, or of
+  /// slot 0 if the thread doesn't have one.
+  uint32_t OwnerBits;
+
+  /// The objects that other threads have counted references to, which are
+  /// waiting for this thread to merge their counts.  Null if the thread
+  /// doesn't have an owner slot.
+  std::atomic<BiasedMergeRequest *> *MergeRequests;
+};
+
+/// The calling thread's biased reference counting state.  Every retain and
+/// release of a biased object reads this.
+extern __thread BiasedRefCountThread _swift_biasedRefCountThread
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC;
+
+void _swift_biasedInitSlow(HeapObject *object);
+void _swift_biasedMergePending();
+void _swift_biasedRetainSlow(HeapObject *object, uint32_t n);
+void _swift_biasedReleaseSlow(HeapObject *object, uint32_t n, bool unpin);
+bool _swift_biasedTryPinSlow(HeapObject *object);
+bool _swift_biasedTryRetainSlow(HeapObject *object, bool &retained);
+bool _swift_biasedIsUniquelyReferencedSlow(HeapObject *object, bool orPinned,
+                                           bool &result);
+bool _swift_biasedGetCount(HeapObject *object, size_t &count);
+bool _swift_biasedSetDeallocating(HeapObject *object);
+
+/// Initialize the refcounts of a new object, biasing it to this thread.
+/// Also merges the counts that other threads have sent this thread.
+static inline void _swift_biasedInit(HeapObject *object) {
+  auto &thread = _swift_biasedRefCountThread;
+  if (LLVM_UNLIKELY(!thread.MergeRequests)) {
+    _swift_biasedInitSlow(object);
+    return;
+  }
+  object->refCount.initBiased(thread.OwnerBits);
+  object->weakRefCount.init();
+  if (LLVM_UNLIKELY(thread.MergeRequests->load(std::memory_order_relaxed)))
+    _swift_biasedMergePending();
+}
+
+static inline bool _swift_biasedRetain(HeapObject *object, uint32_t n) {
+  if (LLVM_LIKELY(object->refCount.incrementBiased(
+                    _swift_biasedRefCountThread.OwnerBits, n)))
+    return true;
+  if (!object->refCount.isBiased())
+    return false;
+  _swift_biasedRetainSlow(object, n);
+  return true;
+}
+
+/// Also merges the counts that other threads have sent this thread, which
+/// may include the object's if other threads released references to it.
+static inline bool _swift_biasedRelease(HeapObject *object, uint32_t n) {
+  auto &thread = _swift_biasedRefCountThread;
+  if (LLVM_LIKELY(object->refCount.decrementBiased<false>(thread.OwnerBits,
+                                                           n))) {
+    if (LLVM_UNLIKELY(thread.MergeRequests->load(std::memory_order_relaxed)))
+      _swift_biasedMergePending();
+    return true;
+  }
+  if (!object->refCount.isBiased())
+    return false;
+  _swift_biasedReleaseSlow(object, n, /*unpin*/ false);
+  return true;
+}
+
+static inline bool _swift_biasedUnpin(HeapObject *object) {
+  if (LLVM_LIKELY(object->refCount.decrementBiased<true>(
+                    _swift_biasedRefCountThread.OwnerBits, 1)))
+    return true;
+  if (!object->refCount.isBiased())
+    return false;
+  _swift_biasedReleaseSlow(object, 1, /*unpin*/ true);
+  return true;
+}
+
+static inline bool _swift_biasedTryPin(HeapObject *object, bool &pinned) {
+  if (LLVM_LIKELY(object->refCount.tryIncrementAndPinBiased(
+                    _swift_biasedRefCountThread.OwnerBits, pinned)))
+    return true;
+  if (!object->refCount.isBiased())
+    return false;
+  pinned = _swift_biasedTryPinSlow(object);
+  return true;
+}
+
+static inline bool _swift_biasedTryRetain(HeapObject *object,
+                                          bool &retained) {
+  if (!object->refCount.isBiased())
+    return false;
+  return _swift_biasedTryRetainSlow(object, retained);
+}
+
+static inline bool _swift_biasedIsUniquelyReferenced(HeapObject *object,
+                                                     bool orPinned,
+                                                     bool &result) {
+  if (!object->refCount.isBiased())
+    return false;
+
+  // Unless other threads have counted references, the owner's count is
+  // the whole count.
+  if (object->refCount.isBiasedTo(_swift_biasedRefCountThread.OwnerBits) &&
+      !object->weakRefCount.isBiasedShared()) {
+    result = object->refCount.getBiasedCount() == 1 ||
+             (orPinned && object->refCount.isPinned());
+    return true;
+  }
+  return _swift_biasedIsUniquelyReferencedSlow(object, orPinned, result);
+}
+
+#else
+
+static inline void _swift_biasedInit(HeapObject *object) {
+  object->refCount.init();
+  object->weakRefCount.init();
+}
+static inline bool _swift_biasedRetain(HeapObject *object, uint32_t n) {
+  return false;
+}
+static inline bool _swift_biasedRelease(HeapObject *object, uint32_t n) {
+  return false;
+}
+static inline bool _swift_biasedUnpin(HeapObject *object) { return false; }
+static inline bool _swift_biasedTryPin(HeapObject *object, bool &pinned) {
+  return false;
+}
+static inline bool _swift_biasedTryRetain(HeapObject *object,
+                                          bool &retained) {
+  return false;
+}
+static inline bool _swift_biasedIsUniquelyReferenced(HeapObject *object,
+                                                     bool orPinned,
+                                                     bool &result) {
+  return false;
+}
+static inline bool _swift_biasedGetCount(HeapObject *object, size_t &count) {
+  return false;
+}
+static inline bool _swift_biasedSetDeallocating(HeapObject *object) {
+  return false;
+}
+
+#endif
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_BIASEDREFCOUNT_H
@@ -0,0 +1,249 @@
+//===--- CacheReplicas.cpp - Per-node replicas of runtime caches ----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Read replicas of the positive results of the conformance and metadata
+// caches, for hosts with several sockets.  Lookups that hit in the canonical
+// caches don't write to them, but the hot entries still live in the memory
+// of one node, and every insertion near them invalidates their cache lines
+// in the other sockets.  A replica is only written by lookups that missed
+// in it, which after warm-up are rare, and its pages are placed on the node
+// of the first thread to write them.
+//
+// Replication is configured through the environment:
+//
+//   SWIFT_CACHE_REPLICAS=node
+//     Keep one replica per NUMA node.
+//   SWIFT_CACHE_REPLICAS=<n>
+//     Keep n replicas, each shared by a contiguous range of CPU numbers.
+//
+// or by calling swift_setCacheReplicas.
+//
+// It is off by default.  A thread checks which CPU it is running on every
+// few thousand lookups, so a thread that migrates to another node soon
+// switches to that node's replica.  A replica is lossy: two results that
+// hash to the same slot evict each other, and a lookup that sees a slot
+// being written treats it as a miss.  Only results that can never change
+// are replicated, so replicas never need to be invalidated.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/Once.h"
+#include "CacheReplicas.h"
+
+#if defined(__linux__)
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+using namespace swift;
+
+#if defined(__linux__)
+
+__thread CacheReplicaThread swift::_swift_cacheReplicaThread
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC = { nullptr, 0, 0 };
+
+std::atomic<uint32_t> swift::_swift_cacheReplicaGeneration(0);
+
+namespace {
+  enum : unsigned {
+    /// The most replicas we keep, however many nodes the host has.
+    MaxReplicas = 64,
+
+    /// How many lookups a thread makes before it checks which CPU it is
+    /// running on again.
+    RefreshInterval = 4096,
+  };
+} // end anonymous namespace
+
+/// The replica used by each CPU, indexed by CPU number, or null if
+/// replication is off.  Replaced vectors are never freed, since other threads
+/// may still be reading them.
+static std::atomic<std::vector<uint8_t> *> CPUReplicas;
+
+static std::atomic<CacheReplica *> Replicas[MaxReplicas];
+
+static swift_once_t CacheReplicasOnce;
+
+/// Parse a kernel CPU list such as "0-23,48-71" and call \p body with each
+/// CPU number in it.
+template <class Fn>
+static void forEachCPUInList(const char *list, const Fn &body) {
+  while (*list) {
+    char *end;
+    unsigned long first = strtoul(list, &end, 10);
+    if (end == list)
+      return;
+    unsigned long last = first;
+    if (*end == '-') {
+      list = end + 1;
+      last = strtoul(list, &end, 10);
+      if (end == list)
+        return;
+    }
+    for (unsigned long cpu = first; cpu <= last; ++cpu)
+      body(cpu);
+    list = end;
+    if (*list == ',')
+      ++list;
+    else
+      return;
+  }
+}
+
+/// Map every CPU to a replica for its NUMA node.  Returns false if the
+/// kernel doesn't describe the host's nodes.
+static bool assignReplicasByNode(std::vector<uint8_t> &cpuReplicas) {
+  DIR *nodes = opendir("/sys/devices/system/node");
+  if (!nodes)
+    return false;
+
+  unsigned numNodes = 0;
+  while (auto entry = readdir(nodes)) {
+    unsigned node;
+    char extra;
+    if (sscanf(entry->d_name, "node%u%c", &node, &extra) != 1)
+      continue;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+             node);
+    FILE *file = fopen(path, "r");
+    if (!file)
+      continue;
+    char list[4096];
+    if (fgets(list, sizeof(list), file)) {
+      uint8_t replica = numNodes % MaxReplicas;
+      forEachCPUInList(list, [&](unsigned long cpu) {
+        if (cpu < cpuReplicas.size())
+          cpuReplicas[cpu] = replica;
+      });
+      ++numNodes;
+    }
+    fclose(file);
+  }
+  closedir(nodes);
+  return numNodes != 0;
+}
+
+/// Map every CPU to one of \p numReplicas replicas, giving each replica a
+/// contiguous range of CPU numbers.
+static void assignReplicasByRange(std::vector<uint8_t> &cpuReplicas,
+                                  unsigned long numReplicas) {
+  numReplicas = std::min(numReplicas, (unsigned long)MaxReplicas);
+  for (size_t cpu = 0; cpu != cpuReplicas.size(); ++cpu)
+    cpuReplicas[cpu] = cpu * numReplicas / cpuReplicas.size();
+}
+
+static void initializeCacheReplicas(void *) {
+  const char *value = getenv("SWIFT_CACHE_REPLICAS");
+  if (!value || !*value)
+    return;
+
+  long numCPUs = sysconf(_SC_NPROCESSORS_CONF);
+  if (numCPUs <= 0)
+    return;
+  auto cpuReplicas = new std::vector<uint8_t>(numCPUs, 0);
+
+  if (strcmp(value, "node") == 0) {
+    if (!assignReplicasByNode(*cpuReplicas)) {
+      delete cpuReplicas;
+      return;
+    }
+  } else {
+    char *end;
+    unsigned long numReplicas = strtoul(value, &end, 10);
+    if (*end || numReplicas == 0) {
+      delete cpuReplicas;
+      return;
+    }
+    assignReplicasByRange(*cpuReplicas, numReplicas);
+  }
+
+  CPUReplicas.store(cpuReplicas, std::memory_order_release);
+}
+
+static CacheReplica *getOrCreateReplica(unsigned index) {
+  auto &slot = Replicas[index];
+  CacheReplica *replica = slot.load(std::memory_order_acquire);
+  if (replica)
+    return replica;
+
+  // Map fresh pages rather than using malloc, so that nothing touches them
+  // until a thread of this group fills in a result.
+  void *memory = mmap(nullptr, sizeof(CacheReplica), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+  auto newReplica = static_cast<CacheReplica *>(memory);
+  if (slot.compare_exchange_strong(replica, newReplica,
+                                   std::memory_order_acq_rel,
+                                   std::memory_order_acquire))
+    return newReplica;
+
+  munmap(memory, sizeof(CacheReplica));
+  return replica;
+}
+
+CacheReplica *swift::_swift_refreshCacheReplica() {
+  swift_once(&CacheReplicasOnce, initializeCacheReplicas);
+
+  // Load the generation first: if the replicas are reconfigured after this,
+  // the next lookup sees a newer generation and comes back here.
+  auto &thread = _swift_cacheReplicaThread;
+  thread.Generation =
+    _swift_cacheReplicaGeneration.load(std::memory_order_acquire);
+  auto cpuReplicas = CPUReplicas.load(std::memory_order_acquire);
+  if (!cpuReplicas) {
+    // Replication is off, so this thread doesn't need to come back here
+    // until the generation changes.
+    thread.Replica = nullptr;
+    thread.LookupsUntilRefresh = UINT32_MAX;
+    return nullptr;
+  }
+
+  int cpu = sched_getcpu();
+  unsigned index = 0;
+  if (cpu >= 0 && size_t(cpu) < cpuReplicas->size())
+    index = (*cpuReplicas)[cpu];
+  thread.Replica = getOrCreateReplica(index);
+  thread.LookupsUntilRefresh = RefreshInterval;
+  return thread.Replica;
+}
+
+void swift::swift_setCacheReplicas(unsigned numReplicas) {
+  swift_once(&CacheReplicasOnce, initializeCacheReplicas);
+
+  std::vector<uint8_t> *cpuReplicas = nullptr;
+  long numCPUs = sysconf(_SC_NPROCESSORS_CONF);
+  if (numReplicas != 0 && numCPUs > 0) {
+    cpuReplicas = new std::vector<uint8_t>(numCPUs, 0);
+    assignReplicasByRange(*cpuReplicas, numReplicas);
+  }
+  CPUReplicas.store(cpuReplicas, std::memory_order_release);
+
+  // Make every thread pick a replica on its next lookup.
+  _swift_cacheReplicaGeneration.fetch_add(1, std::memory_order_release);
+}
+
+#else // !defined(__linux__)
+
+void swift::swift_setCacheReplicas(unsigned numReplicas) {}
+
+#endif
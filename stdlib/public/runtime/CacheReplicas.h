@@ -0,0 +1,189 @@
+//===--- CacheReplicas.h - Per-node replicas of runtime caches --*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Read replicas of the positive results of the runtime's global caches.
+// When replication is on, every group of CPUs has its own small, lossy copy
+// of those results, which is filled from the canonical cache on a miss.  A
+// hit then only reads memory that was allocated and written by threads of
+// the same group.  The lookups are inline so that, with replication off, a
+// lookup costs a thread-local decrement.  See CacheReplicas.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_CACHEREPLICAS_H
+#define SWIFT_RUNTIME_CACHEREPLICAS_H
+
+#include "swift/Runtime/Config.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace swift {
+
+/// The caches that can be replicated.
+enum class ReplicatedCache : unsigned {
+  /// swift_conformsToProtocol, keyed by type and protocol.
+  Conformances,
+
+  /// The base type that introduces a type's Hashable conformance, keyed by
+  /// type.
+  HashableBaseTypes,
+
+  /// swift_getGenericMetadata for patterns with one key argument, keyed by
+  /// pattern and argument.
+  GenericMetadata,
+
+  /// swift_getMetatypeMetadata, keyed by instance type.
+  Metatypes,
+
+  /// swift_getExistentialMetatypeMetadata, keyed by instance type.
+  ExistentialMetatypes,
+};
+
+enum : unsigned { NumReplicatedCaches = 5 };
+
+#if defined(__linux__)
+
+/// One cached result.  The sequence number is odd while the slot is being
+/// written, so a reader can tell that it saw a torn entry and treat it as a
+/// miss.
+struct CacheReplicaSlot {
+  std::atomic<uintptr_t> Sequence;
+  std::atomic<const void *> Key1;
+  std::atomic<const void *> Key2;
+  std::atomic<const void *> Value;
+};
+
+/// One group's copy of the replicated caches.  Each cache is direct-mapped,
+/// and a new result simply replaces whatever was in its slot.
+struct CacheReplica {
+  enum : unsigned { SlotBits = 10, NumSlots = 1u << SlotBits };
+
+  CacheReplicaSlot Slots[NumReplicatedCaches][NumSlots];
+
+  CacheReplicaSlot &getSlot(ReplicatedCache cache, const void *key1,
+                            const void *key2) {
+    uint64_t hash = (uint64_t(uintptr_t(key1)) >> 3) * 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ (uint64_t(uintptr_t(key2)) >> 3)) * 0x9E3779B97F4A7C15ULL;
+    return Slots[unsigned(cache)][hash >> (64 - SlotBits)];
+  }
+
+  const void *find(ReplicatedCache cache, const void *key1,
+                   const void *key2) {
+    auto &slot = getSlot(cache, key1, key2);
+    uintptr_t sequence = slot.Sequence.load(std::memory_order_acquire);
+    if (sequence & 1)
+      return nullptr;
+    auto slotKey1 = slot.Key1.load(std::memory_order_relaxed);
+    auto slotKey2 = slot.Key2.load(std::memory_order_relaxed);
+    auto value = slot.Value.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+      return nullptr;
+    if (slotKey1 != key1 || slotKey2 != key2)
+      return nullptr;
+    return value;
+  }
+
+  void fill(ReplicatedCache cache, const void *key1, const void *key2,
+            const void *value) {
+    auto &slot = getSlot(cache, key1, key2);
+
+    // If another thread is writing this slot, let it win.
+    uintptr_t sequence = slot.Sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) ||
+        !slot.Sequence.compare_exchange_strong(sequence, sequence + 1,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed))
+      return;
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.Key1.store(key1, std::memory_order_relaxed);
+    slot.Key2.store(key2, std::memory_order_relaxed);
+    slot.Value.store(value, std::memory_order_relaxed);
+    slot.Sequence.store(sequence + 2, std::memory_order_release);
+  }
+};
+
+/// The replica used by a thread.
+struct CacheReplicaThread {
+  /// The replica of the group of the CPU this thread last ran on, or null
+  /// if replication is off.
+  CacheReplica *Replica;
+
+  /// The number of lookups left before the thread checks which CPU it is
+  /// running on again.  This starts at zero, so that the first lookup on
+  /// each thread decides whether replication is on.
+  uint32_t LookupsUntilRefresh;
+
+  /// The value of _swift_cacheReplicaGeneration when Replica was chosen.
+  uint32_t Generation;
+};
+
+/// Incremented whenever the replicas are reconfigured, so that every thread
+/// chooses its replica again on its next lookup.
+extern std::atomic<uint32_t> _swift_cacheReplicaGeneration;
+
+/// The calling thread's replica.  This is read by every conformance and
+/// cached metadata lookup, including the ones that find replication off.
+extern __thread CacheReplicaThread _swift_cacheReplicaThread
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC;
+
+CacheReplica *_swift_refreshCacheReplica();
+
+/// Look up a result in this thread's replica of a cache.  Returns null if
+/// the result isn't replicated.
+static inline const void *_swift_findInCacheReplica(ReplicatedCache cache,
+                                                    const void *key1,
+                                                    const void *key2) {
+  auto &thread = _swift_cacheReplicaThread;
+  CacheReplica *replica;
+  if (LLVM_LIKELY(thread.LookupsUntilRefresh != 0 &&
+                  thread.Generation == _swift_cacheReplicaGeneration.load(
+                                         std::memory_order_relaxed))) {
+    --thread.LookupsUntilRefresh;
+    replica = thread.Replica;
+  } else {
+    replica = _swift_refreshCacheReplica();
+  }
+  if (LLVM_LIKELY(!replica))
+    return nullptr;
+  return replica->find(cache, key1, key2);
+}
+
+/// Copy a result that was found in the canonical cache into this thread's
+/// replica.  Only results that never change may be replicated.
+static inline void _swift_fillCacheReplica(ReplicatedCache cache,
+                                           const void *key1, const void *key2,
+                                           const void *value) {
+  if (auto replica = _swift_cacheReplicaThread.Replica)
+    replica->fill(cache, key1, key2, value);
+}
+
+#else
+
+// Cache replicas are only supported on Linux.
+
+static inline const void *_swift_findInCacheReplica(ReplicatedCache cache,
+                                                    const void *key1,
+                                                    const void *key2) {
+  return nullptr;
+}
+static inline void _swift_fillCacheReplica(ReplicatedCache cache,
+                                           const void *key1, const void *key2,
+                                           const void *value) {}
+
+#endif
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_CACHEREPLICAS_H
@@ -18,17 +18,21 @@
 #include "swift/Basic/Demangle.h"
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/Lazy.h"
+#include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Config.h"
 #include "swift/Runtime/Enum.h"
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
-#include "swift/Runtime/Mutex.h"
-#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/PointerIntPair.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "swift/Runtime/Debug.h"
 #include "ErrorObject.h"
 #include "ExistentialMetadataImpl.h"
 #include "Private.h"
+#include "RuntimeStatistics.h"
 #include "SwiftHashableSupport.h"
 #include "../SwiftShims/RuntimeShims.h"
 #include "stddef.h"
@@ -37,7 +41,9 @@
 #include "SwiftValue.h"
 #endif
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <type_traits>
 
 using namespace swift;
@@ -315,53 +321,66 @@ std::string swift::nameForMetadata(const Metadata *type,
   return result;
 }
 
-SWIFT_CC(swift) SWIFT_RUNTIME_EXPORT
-TwoWordPair<const char *, uintptr_t>::Return
-swift::swift_getTypeName(const Metadata *type, bool qualified) {
-  using Pair = TwoWordPair<const char *, uintptr_t>;
+namespace {
+/// A cache entry for swift_getTypeName.  The name is stored inline after
+/// the entry and lives as long as the cache.
+class TypeNameCacheEntry {
+public:
   using Key = llvm::PointerIntPair<const Metadata *, 1, bool>;
 
-  static StaticReadWriteLock TypeNameCacheLock;
-  static Lazy<llvm::DenseMap<Key, std::pair<const char *, size_t>>>
-    TypeNameCache;
-  
-  Key key(type, qualified);
-  auto &cache = TypeNameCache.get();
+private:
+  Key TheKey;
+  size_t Length;
 
-  // Attempt read-only lookup of cache entry.
-  {
-    StaticScopedReadLock guard(TypeNameCacheLock);
+  char *getNameStorage() { return reinterpret_cast<char *>(this + 1); }
 
-    auto found = cache.find(key);
-    if (found != cache.end()) {
-      auto result = found->second;
-      return Pair{result.first, result.second};
-    }
+public:
+  TypeNameCacheEntry(Key key, llvm::StringRef name)
+    : TheKey(key), Length(name.size()) {
+    memcpy(getNameStorage(), name.data(), Length);
+    getNameStorage()[Length] = 0;
   }
 
-  // Read-only lookup failed to find item, we may need to create it.
-  {
-    StaticScopedWriteLock guard(TypeNameCacheLock);
+  const char *getName() const {
+    return reinterpret_cast<const char *>(this + 1);
+  }
+  size_t getLength() const { return Length; }
 
-    // Do lookup again just to make sure it wasn't created by another
-    // thread before we acquired the write lock.
-    auto found = cache.find(key);
-    if (found != cache.end()) {
-      auto result = found->second;
-      return Pair{result.first, result.second};
-    }
+  int compareWithKey(Key key) const {
+    auto keyValue = reinterpret_cast<uintptr_t>(key.getOpaqueValue());
+    auto value = reinterpret_cast<uintptr_t>(TheKey.getOpaqueValue());
+    return (keyValue == value ? 0 : keyValue < value ? -1 : 1);
+  }
 
-    // Build the metadata name.
-    auto name = nameForMetadata(type, qualified);
-    // Copy it to memory we can reference forever.
-    auto size = name.size();
-    auto result = (char *)malloc(size + 1);
-    memcpy(result, name.data(), size);
-    result[size] = 0;
+  static size_t getKeyHash(Key key) {
+    return llvm::hash_value(key.getOpaqueValue());
+  }
 
-    cache.insert({key, {result, size}});
-    return Pair{result, size};
+  static size_t getExtraAllocationSize(Key key, llvm::StringRef name) {
+    return name.size() + 1;
   }
+};
+} // end anonymous namespace
+
+SWIFT_CC(swift) SWIFT_RUNTIME_EXPORT
+TwoWordPair<const char *, uintptr_t>::Return
+swift::swift_getTypeName(const Metadata *type, bool qualified) {
+  using Pair = TwoWordPair<const char *, uintptr_t>;
+  using Key = TypeNameCacheEntry::Key;
+
+  // The cache is insert-only, so a hit is just a lookup with no locking and
+  // no writes to shared memory.
+  static ConcurrentHashMap<TypeNameCacheEntry, false> TypeNameCache;
+
+  Key key(type, qualified);
+  if (auto found = TypeNameCache.find(key))
+    return Pair{found->getName(), found->getLength()};
+
+  // Build the metadata name.  If another thread races us to insert it, the
+  // name it inserted wins and ours is discarded.
+  auto name = nameForMetadata(type, qualified);
+  auto entry = TypeNameCache.getOrInsert(key, llvm::StringRef(name)).first;
+  return Pair{entry->getName(), entry->getLength()};
 }
 
 /// Report a dynamic cast failure.
@@ -2483,6 +2502,265 @@ static bool _dynamicCastStructToStruct(OpaqueValue *destination,
   return result;
 }
 
+/******************************************************************************/
+/******************************** Cast Plans **********************************/
+/******************************************************************************/
+
+// swift_dynamicCast works out how to perform a cast by inspecting the source
+// and target metadata on every call.  For the common cases where the answer
+// only depends on the dynamic source type and the target type, we remember
+// the answer in a cast plan so that repeated casts between the same pair of
+// types skip the decision tree.
+//
+// A plan is keyed by the dynamic type of the source value: the type itself
+// for value types, or the class of the instance for Swift class references.
+// The flags are not part of the key; they only affect how the value is moved
+// into place, which the plan executor honors directly.
+//
+// Plans are only recorded for answers that can never change.  In particular
+// a failed protocol conformance lookup can start succeeding once a new image
+// is loaded, so such casts get a Generic plan and always take the full path.
+
+namespace {
+
+enum class CastPlanKind : uint8_t {
+  /// Nothing is known; perform the cast the slow way.
+  Generic,
+
+  /// The source and target types are the same.
+  Identity,
+
+  /// The source class is the target class or one of its subclasses.
+  ClassSucceed,
+
+  /// The source class is not a subclass of the target class.
+  ClassFail,
+
+  /// The target is an opaque or class existential whose witness tables are
+  /// stored in the plan.
+  Existential,
+};
+
+struct CastPlanKey {
+  const Metadata *SourceType;
+  const Metadata *TargetType;
+};
+
+class CastPlanEntry {
+  CastPlanKey Key;
+  CastPlanKind Kind;
+  unsigned NumWitnessTables;
+
+  const WitnessTable **getWitnessTableStorage() {
+    return reinterpret_cast<const WitnessTable **>(this + 1);
+  }
+
+public:
+  CastPlanEntry(CastPlanKey key, CastPlanKind kind,
+                llvm::ArrayRef<const WitnessTable *> witnessTables)
+    : Key(key), Kind(kind), NumWitnessTables(witnessTables.size()) {
+    std::copy(witnessTables.begin(), witnessTables.end(),
+              getWitnessTableStorage());
+  }
+
+  CastPlanKind getKind() const { return Kind; }
+  const Metadata *getSourceType() const { return Key.SourceType; }
+
+  llvm::ArrayRef<const WitnessTable *> getWitnessTables() const {
+    return {reinterpret_cast<const WitnessTable * const *>(this + 1),
+            NumWitnessTables};
+  }
+
+  int compareWithKey(CastPlanKey key) const {
+    if (key.SourceType != Key.SourceType)
+      return std::less<const Metadata *>()(key.SourceType, Key.SourceType)
+               ? -1 : 1;
+    if (key.TargetType != Key.TargetType)
+      return std::less<const Metadata *>()(key.TargetType, Key.TargetType)
+               ? -1 : 1;
+    return 0;
+  }
+
+  static size_t getKeyHash(CastPlanKey key) {
+    return llvm::hash_combine(key.SourceType, key.TargetType);
+  }
+
+  static size_t
+  getExtraAllocationSize(CastPlanKey key, CastPlanKind kind,
+                         llvm::ArrayRef<const WitnessTable *> witnessTables) {
+    return witnessTables.size() * sizeof(const WitnessTable *);
+  }
+};
+
+} // end anonymous namespace
+
+static ConcurrentHashMap<CastPlanEntry, false> CastPlans;
+
+/// Is this a Swift class whose superclass chain and conformances are fixed?
+static bool isSwiftClassForCastPlan(const Metadata *type) {
+  if (type->getKind() != MetadataKind::Class)
+    return false;
+  return cast<ClassMetadata>(type)->isTypeMetadata();
+}
+
+/// Work out a plan for casting a value of the given dynamic type to an
+/// existential, filling in the witness tables if it succeeds.
+static CastPlanKind
+planCastToExistential(const Metadata *sourceType, bool sourceIsClass,
+                      const ExistentialTypeMetadata *targetType,
+                      llvm::SmallVectorImpl<const WitnessTable *> &tables) {
+  switch (targetType->getRepresentation()) {
+  case ExistentialTypeRepresentation::Opaque:
+    break;
+  case ExistentialTypeRepresentation::Class:
+    // Value types are boxed on the way into a class existential.
+    if (!sourceIsClass)
+      return CastPlanKind::Generic;
+    break;
+  case ExistentialTypeRepresentation::Error:
+    return CastPlanKind::Generic;
+  }
+
+  for (unsigned i = 0, e = targetType->Protocols.NumProtocols; i != e; ++i) {
+    const ProtocolDescriptor *protocol = targetType->Protocols[i];
+    if (protocol->Flags.getSpecialProtocol() == SpecialProtocol::AnyObject) {
+      if (!sourceIsClass)
+        return CastPlanKind::Generic;
+      continue;
+    }
+
+    // Objective-C protocol conformances are checked on the instance.
+    if (!protocol->Flags.needsWitnessTable())
+      return CastPlanKind::Generic;
+
+    auto witness = swift_conformsToProtocol(sourceType, protocol);
+    if (!witness)
+      return CastPlanKind::Generic;
+    tables.push_back(witness);
+  }
+
+  assert(tables.size() == targetType->Flags.getNumWitnessTables());
+  return CastPlanKind::Existential;
+}
+
+/// Work out a plan for casting a value of the given dynamic type to the
+/// target type.
+static CastPlanKind
+planCast(const Metadata *sourceType, bool sourceIsClass,
+         const Metadata *targetType,
+         llvm::SmallVectorImpl<const WitnessTable *> &tables) {
+  if (sourceIsClass) {
+    if (isSwiftClassForCastPlan(targetType)) {
+      auto targetClass = cast<ClassMetadata>(targetType);
+      for (auto theClass = cast<ClassMetadata>(sourceType); theClass;
+           theClass = _swift_getSuperclass(theClass)) {
+        if (theClass == targetClass)
+          return CastPlanKind::ClassSucceed;
+      }
+      return CastPlanKind::ClassFail;
+    }
+  } else if (sourceType == targetType) {
+    return CastPlanKind::Identity;
+  }
+
+  if (auto targetExistential = dyn_cast<ExistentialTypeMetadata>(targetType))
+    return planCastToExistential(sourceType, sourceIsClass,
+                                 targetExistential, tables);
+
+  return CastPlanKind::Generic;
+}
+
+/// Find or create the cast plan for a value of the given static type.
+/// Returns null if the value's type isn't eligible for a plan.
+static const CastPlanEntry *findCastPlan(OpaqueValue *src,
+                                         const Metadata *srcType,
+                                         const Metadata *targetType) {
+  const Metadata *sourceType;
+  bool sourceIsClass = false;
+  switch (srcType->getKind()) {
+  case MetadataKind::Class: {
+    // Plan on the class of the instance rather than the static type.
+    sourceType = swift_getObjectType(*reinterpret_cast<HeapObject **>(src));
+    if (!isSwiftClassForCastPlan(sourceType))
+      return nullptr;
+    sourceIsClass = true;
+    break;
+  }
+
+  case MetadataKind::Struct:
+  case MetadataKind::Enum:
+  case MetadataKind::Tuple:
+  case MetadataKind::Function:
+  case MetadataKind::Opaque:
+    // The dynamic type of these is always the static type.
+    sourceType = srcType;
+    break;
+
+  default:
+    return nullptr;
+  }
+
+  CastPlanKey key{sourceType, targetType};
+  if (auto plan = CastPlans.find(key))
+    return plan;
+
+  llvm::SmallVector<const WitnessTable *, 4> tables;
+  auto kind = planCast(sourceType, sourceIsClass, targetType, tables);
+  return CastPlans.getOrInsert(key, kind,
+                               llvm::ArrayRef<const WitnessTable *>(tables))
+           .first;
+}
+
+/// Perform a cast according to a plan that is not Generic.
+static bool _dynamicCastWithPlan(const CastPlanEntry &plan,
+                                 OpaqueValue *dest, OpaqueValue *src,
+                                 const Metadata *srcType,
+                                 const Metadata *targetType,
+                                 DynamicCastFlags flags) {
+  switch (plan.getKind()) {
+  case CastPlanKind::Generic:
+    break;
+
+  case CastPlanKind::Identity:
+  case CastPlanKind::ClassSucceed:
+    return _succeed(dest, src, srcType, flags);
+
+  case CastPlanKind::ClassFail:
+    return _fail(src, srcType, targetType, flags, plan.getSourceType());
+
+  case CastPlanKind::Existential: {
+    auto targetExistential = cast<ExistentialTypeMetadata>(targetType);
+    auto tables = plan.getWitnessTables();
+    bool isTake = (flags & DynamicCastFlags::TakeOnSuccess);
+
+    if (targetExistential->getRepresentation()
+          == ExistentialTypeRepresentation::Class) {
+      auto destExistential = reinterpret_cast<ClassExistentialContainer *>(dest);
+      std::copy(tables.begin(), tables.end(),
+                destExistential->getWitnessTables());
+      auto object = *reinterpret_cast<HeapObject **>(src);
+      destExistential->Value = object;
+      if (!isTake)
+        swift_retain(object);
+      return true;
+    }
+
+    auto destExistential = reinterpret_cast<OpaqueExistentialContainer *>(dest);
+    std::copy(tables.begin(), tables.end(),
+              destExistential->getWitnessTables());
+    auto sourceType = plan.getSourceType();
+    destExistential->Type = sourceType;
+    if (isTake)
+      sourceType->vw_initializeBufferWithTake(&destExistential->Buffer, src);
+    else
+      sourceType->vw_initializeBufferWithCopy(&destExistential->Buffer, src);
+    return true;
+  }
+  }
+
+  swift::crash("generic cast plans are not executed");
+}
+
 /******************************************************************************/
 /****************************** Main Entrypoint *******************************/
 /******************************************************************************/
@@ -2495,6 +2773,8 @@ bool swift::swift_dynamicCast(OpaqueValue *dest,
                               const Metadata *targetType,
                               DynamicCastFlags flags)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::DynamicCast);
+
   auto unwrapResult = checkDynamicCastFromOptional(dest, src, srcType,
                                                    targetType, flags);
   srcType = unwrapResult.payloadType;
@@ -2509,6 +2789,13 @@ bool swift::swift_dynamicCast(OpaqueValue *dest,
   }
 #endif
 
+  // If we've cast between these types before, reuse what we learned.
+  if (auto plan = findCastPlan(src, srcType, targetType)) {
+    if (plan->getKind() != CastPlanKind::Generic)
+      return _dynamicCastWithPlan(*plan, dest, src, srcType, targetType,
+                                  flags);
+  }
+
   switch (targetType->getKind()) {
   // Handle wrapping an Optional target.
   case MetadataKind::Optional: {
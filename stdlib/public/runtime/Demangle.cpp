@@ -11,54 +11,61 @@
 static Demangle::NodePointer
 _buildDemanglingForNominalType(Demangle::Node::Kind boundGenericKind,
                                const Metadata *type,
-                               const NominalTypeDescriptor *description) {
+                               const NominalTypeDescriptor *description,
+                               Demangle::NodeFactory &factory) {
   using namespace Demangle;
   
   // Demangle the base name.
   auto node = demangleTypeAsNode(description->Name,
-                                     strlen(description->Name));
+                                     strlen(description->Name), factory);
   // If generic, demangle the type parameters.
   if (description->GenericParams.NumPrimaryParams > 0) {
-    auto typeParams = NodeFactory::create(Node::Kind::TypeList);
+    auto typeParams = factory.createNode(Node::Kind::TypeList);
     auto typeBytes = reinterpret_cast<const char *>(type);
     auto genericParam = reinterpret_cast<const Metadata * const *>(
                  typeBytes + sizeof(void*) * description->GenericParams.Offset);
     for (unsigned i = 0, e = description->GenericParams.NumPrimaryParams;
          i < e; ++i, ++genericParam) {
-      auto demangling = _swift_buildDemanglingForMetadata(*genericParam);
+      auto demangling =
+        _swift_buildDemanglingForMetadata(*genericParam, factory);
       if (demangling == nullptr)
         return nullptr;
-      typeParams->addChild(demangling);
+      typeParams->addChild(demangling, factory);
     }
 
-    auto genericNode = NodeFactory::create(boundGenericKind);
-    genericNode->addChild(node);
-    genericNode->addChild(typeParams);
+    auto genericNode = factory.createNode(boundGenericKind);
+    genericNode->addChild(node, factory);
+    genericNode->addChild(typeParams, factory);
     return genericNode;
   }
   return node;
 }
 
 // Build a demangled type tree for a type.
-Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *type) {
+Demangle::NodePointer
+swift::_swift_buildDemanglingForMetadata(const Metadata *type,
+                                         Demangle::NodeFactory &factory) {
   using namespace Demangle;
 
   switch (type->getKind()) {
   case MetadataKind::Class: {
     auto classType = static_cast<const ClassMetadata *>(type);
     return _buildDemanglingForNominalType(Node::Kind::BoundGenericClass,
-                                          type, classType->getDescription());
+                                          type, classType->getDescription(),
+                                          factory);
   }
   case MetadataKind::Enum:
   case MetadataKind::Optional: {
     auto structType = static_cast<const EnumMetadata *>(type);
     return _buildDemanglingForNominalType(Node::Kind::BoundGenericEnum,
-                                          type, structType->Description);
+                                          type, structType->Description,
+                                          factory);
   }
   case MetadataKind::Struct: {
     auto structType = static_cast<const StructMetadata *>(type);
     return _buildDemanglingForNominalType(Node::Kind::BoundGenericStructure,
-                                          type, structType->Description);
+                                          type, structType->Description,
+                                          factory);
   }
   case MetadataKind::ObjCClassWrapper: {
 #if SWIFT_OBJC_INTEROP
@@ -66,12 +73,13 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
     const char *className = class_getName((Class)objcWrapper->Class);
     
     // ObjC classes mangle as being in the magic "__ObjC" module.
-    auto module = NodeFactory::create(Node::Kind::Module, "__ObjC");
+    auto module = factory.createNode(Node::Kind::Module, "__ObjC");
     
-    auto node = NodeFactory::create(Node::Kind::Class);
-    node->addChild(module);
-    node->addChild(NodeFactory::create(Node::Kind::Identifier,
-                                       llvm::StringRef(className)));
+    auto node = factory.createNode(Node::Kind::Class);
+    node->addChild(module, factory);
+    node->addChild(factory.createNode(Node::Kind::Identifier,
+                                      llvm::StringRef(className)),
+                   factory);
     
     return node;
 #else
@@ -82,14 +90,14 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
   case MetadataKind::ForeignClass: {
     auto foreign = static_cast<const ForeignClassMetadata *>(type);
     return Demangle::demangleTypeAsNode(foreign->getName(),
-                                        strlen(foreign->getName()));
+                                        strlen(foreign->getName()), factory);
   }
   case MetadataKind::Existential: {
     auto exis = static_cast<const ExistentialTypeMetadata *>(type);
-    NodePointer proto_list = NodeFactory::create(Node::Kind::ProtocolList);
-    NodePointer type_list = NodeFactory::create(Node::Kind::TypeList);
+    NodePointer proto_list = factory.createNode(Node::Kind::ProtocolList);
+    NodePointer type_list = factory.createNode(Node::Kind::TypeList);
 
-    proto_list->addChild(type_list);
+    proto_list->addChild(type_list, factory);
     
     std::vector<const ProtocolDescriptor *> protocols;
     protocols.reserve(exis->Protocols.NumProtocols);
@@ -107,19 +115,20 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
     for (auto *protocol : protocols) {
       // The protocol name is mangled as a type symbol, with the _Tt prefix.
       auto protocolNode = demangleSymbolAsNode(protocol->Name,
-                                               strlen(protocol->Name));
+                                               strlen(protocol->Name), factory);
       
       // ObjC protocol names aren't mangled.
       if (!protocolNode) {
-        auto module = NodeFactory::create(Node::Kind::Module,
-                                          MANGLING_MODULE_OBJC);
-        auto node = NodeFactory::create(Node::Kind::Protocol);
-        node->addChild(module);
-        node->addChild(NodeFactory::create(Node::Kind::Identifier,
-                                           llvm::StringRef(protocol->Name)));
-        auto typeNode = NodeFactory::create(Node::Kind::Type);
-        typeNode->addChild(node);
-        type_list->addChild(typeNode);
+        auto module = factory.createNode(Node::Kind::Module,
+                                         MANGLING_MODULE_OBJC);
+        auto node = factory.createNode(Node::Kind::Protocol);
+        node->addChild(module, factory);
+        node->addChild(factory.createNode(Node::Kind::Identifier,
+                                          llvm::StringRef(protocol->Name)),
+                       factory);
+        auto typeNode = factory.createNode(Node::Kind::Type);
+        typeNode->addChild(node, factory);
+        type_list->addChild(typeNode, factory);
         continue;
       }
 
@@ -133,16 +142,17 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
       
       assert(protocolNode->getKind() == Node::Kind::Type);
       assert(protocolNode->getChild(0)->getKind() == Node::Kind::Protocol);
-      type_list->addChild(protocolNode);
+      type_list->addChild(protocolNode, factory);
     }
     
     return proto_list;
   }
   case MetadataKind::ExistentialMetatype: {
     auto metatype = static_cast<const ExistentialMetatypeMetadata *>(type);
-    auto instance = _swift_buildDemanglingForMetadata(metatype->InstanceType);
-    auto node = NodeFactory::create(Node::Kind::ExistentialMetatype);
-    node->addChild(instance);
+    auto instance =
+      _swift_buildDemanglingForMetadata(metatype->InstanceType, factory);
+    auto node = factory.createNode(Node::Kind::ExistentialMetatype);
+    node->addChild(instance, factory);
     return node;
   }
   case MetadataKind::Function: {
@@ -167,52 +177,55 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
     std::vector<NodePointer> inputs;
     for (unsigned i = 0, e = func->getNumArguments(); i < e; ++i) {
       auto arg = func->getArguments()[i];
-      auto input = _swift_buildDemanglingForMetadata(arg.getPointer());
+      auto input = _swift_buildDemanglingForMetadata(arg.getPointer(), factory);
       if (arg.getFlag()) {
-        NodePointer inout = NodeFactory::create(Node::Kind::InOut);
-        inout->addChild(input);
+        NodePointer inout = factory.createNode(Node::Kind::InOut);
+        inout->addChild(input, factory);
         input = inout;
       }
       inputs.push_back(input);
     }
 
-    NodePointer totalInput;
+    NodePointer totalInput = nullptr;
     if (inputs.size() > 1) {
-      auto tuple = NodeFactory::create(Node::Kind::NonVariadicTuple);
+      auto tuple = factory.createNode(Node::Kind::NonVariadicTuple);
       for (auto &input : inputs)
-        tuple->addChild(input);
+        tuple->addChild(input, factory);
       totalInput = tuple;
     } else {
       totalInput = inputs.front();
     }
     
-    NodePointer args = NodeFactory::create(Node::Kind::ArgumentTuple);
-    args->addChild(totalInput);
+    NodePointer args = factory.createNode(Node::Kind::ArgumentTuple);
+    args->addChild(totalInput, factory);
     
-    NodePointer resultTy = _swift_buildDemanglingForMetadata(func->ResultType);
-    NodePointer result = NodeFactory::create(Node::Kind::ReturnType);
-    result->addChild(resultTy);
+    NodePointer resultTy =
+      _swift_buildDemanglingForMetadata(func->ResultType, factory);
+    NodePointer result = factory.createNode(Node::Kind::ReturnType);
+    result->addChild(resultTy, factory);
     
-    auto funcNode = NodeFactory::create(kind);
+    auto funcNode = factory.createNode(kind);
     if (func->throws())
-      funcNode->addChild(NodeFactory::create(Node::Kind::ThrowsAnnotation));
-    funcNode->addChild(args);
-    funcNode->addChild(result);
+      funcNode->addChild(factory.createNode(Node::Kind::ThrowsAnnotation),
+                         factory);
+    funcNode->addChild(args, factory);
+    funcNode->addChild(result, factory);
     return funcNode;
   }
   case MetadataKind::Metatype: {
     auto metatype = static_cast<const MetatypeMetadata *>(type);
-    auto instance = _swift_buildDemanglingForMetadata(metatype->InstanceType);
-    auto node = NodeFactory::create(Node::Kind::Metatype);
-    node->addChild(instance);
+    auto instance =
+      _swift_buildDemanglingForMetadata(metatype->InstanceType, factory);
+    auto node = factory.createNode(Node::Kind::Metatype);
+    node->addChild(instance, factory);
     return node;
   }
   case MetadataKind::Tuple: {
     auto tuple = static_cast<const TupleTypeMetadata *>(type);
     const char *labels = tuple->Labels;
-    auto tupleNode = NodeFactory::create(Node::Kind::NonVariadicTuple);
+    auto tupleNode = factory.createNode(Node::Kind::NonVariadicTuple);
     for (unsigned i = 0, e = tuple->NumElements; i < e; ++i) {
-      auto elt = NodeFactory::create(Node::Kind::TupleElement);
+      auto elt = factory.createNode(Node::Kind::TupleElement);
 
       // Add a label child if applicable:
       if (labels) {
@@ -221,9 +234,9 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
           // If there is one, and the label isn't empty, add a label child.
           if (labels != space) {
             auto eltName =
-              NodeFactory::create(Node::Kind::TupleElementName,
-                                  std::string(labels, space));
-            elt->addChild(std::move(eltName));
+              factory.createNode(Node::Kind::TupleElementName,
+                                 llvm::StringRef(labels, space - labels));
+            elt->addChild(std::move(eltName), factory);
           }
 
           // Skip past the space.
@@ -233,11 +246,11 @@ Demangle::NodePointer swift::_swift_buildDemanglingForMetadata(const Metadata *t
 
       // Add the element type child.
       auto eltType =
-        _swift_buildDemanglingForMetadata(tuple->getElement(i).Type);
-      elt->addChild(std::move(eltType));
+        _swift_buildDemanglingForMetadata(tuple->getElement(i).Type, factory);
+      elt->addChild(std::move(eltType), factory);
 
       // Add the completed element to the tuple.
-      tupleNode->addChild(std::move(elt));
+      tupleNode->addChild(std::move(elt), factory);
     }
     return tupleNode;
   }
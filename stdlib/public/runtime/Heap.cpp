@@ -20,13 +20,307 @@
 #include "swift/Runtime/Debug.h"
 #include <stdlib.h>
 
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+#if !defined(__linux__) || !defined(__LP64__)
+#error "the size-class allocator is only supported on 64-bit Linux"
+#endif
+#include "swift/Basic/Malloc.h"
+#include "swift/Runtime/Mutex.h"
+#include "swift/Runtime/Once.h"
+#include <atomic>
+#include <cstddef>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
 using namespace swift;
 
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+
+// A thread-caching allocator for small runtime allocations.
+//
+// Small allocations are rounded up to one of a fixed set of size classes.
+// Each size class carves its blocks out of its own fixed region of a single
+// address space reservation, so both "is this ours?" and "which size class
+// is this?" can be answered from the address alone, without trusting the
+// size passed to swift_slowDealloc and without touching the block.
+//
+// Every thread keeps a singly-linked free list per size class.  Allocation
+// and deallocation only touch the calling thread's lists; blocks move
+// between threads in batches through a central free list per size class,
+// which is the only place a lock is taken.
+
+/// The alignment mask that malloc guarantees for every allocation.
+static const size_t MallocAlignMask = alignof(std::max_align_t) - 1;
+
+/// Does an allocation with the given alignment mask need more alignment than
+/// malloc provides?  An all-ones mask requests the default alignment.
+static bool needsAlignedAlloc(size_t alignMask) {
+  return alignMask > MallocAlignMask && alignMask != ~size_t(0);
+}
+
+namespace {
+
+/// Every block is a multiple of this size, and is aligned to it.
+constexpr size_t SizeClassQuantum = 16;
+
+/// The number of size classes.  Allocations larger than
+/// NumSizeClasses * SizeClassQuantum bytes go to malloc.
+constexpr size_t NumSizeClasses = 32;
+constexpr size_t MaxSizeClassSize = NumSizeClasses * SizeClassQuantum;
+
+/// The size of the address range reserved for each size class.
+constexpr unsigned SizeClassRegionShift = 30;
+constexpr size_t SizeClassRegionSize = size_t(1) << SizeClassRegionShift;
+
+/// The number of blocks moved between a thread cache and the central free
+/// list at once.
+constexpr unsigned TransferBatchSize = 32;
+
+/// A thread cache hands blocks back to the central free list once it holds
+/// this many blocks of one size class.
+constexpr unsigned MaxCachedBlocks = 2 * TransferBatchSize;
+
+struct FreeBlock {
+  FreeBlock *Next;
+};
+
+/// The blocks of a size class that are not cached by any thread.
+struct CentralFreeList {
+  StaticMutex Lock;
+
+  /// Blocks that were freed back from thread caches.
+  FreeBlock *Head;
+
+  /// The offset within the size class region of the first block that has
+  /// never been handed out.
+  size_t BumpOffset;
+};
+
+/// The per-thread free lists.  This must stay trivially constructible and
+/// destructible, so that accessing it never requires a TLS initializer.
+struct ThreadCache {
+  FreeBlock *Head[NumSizeClasses];
+  unsigned Count[NumSizeClasses];
+
+  /// Whether this cache has been registered to be flushed at thread exit.
+  bool IsRegistered;
+};
+
+} // end anonymous namespace
+
+/// The bounds of the address range reserved for all size classes.  These
+/// are zero if the allocator has not been initialized or could not reserve
+/// its address range, in which case nothing is considered to be ours.
+static std::atomic<uintptr_t> SizeClassRegionsBegin;
+static std::atomic<uintptr_t> SizeClassRegionsEnd;
+
+static CentralFreeList CentralFreeLists[NumSizeClasses];
+static thread_local ThreadCache LocalCache;
+static pthread_key_t ThreadCacheKey;
+static swift_once_t SizeClassAllocatorOnce;
+
+static unsigned getSizeClassForSize(size_t size) {
+  return (size ? size - 1 : 0) / SizeClassQuantum;
+}
+
+static size_t getSizeForSizeClass(unsigned sizeClass) {
+  return (sizeClass + 1) * SizeClassQuantum;
+}
+
+/// Return all of the blocks in the given list to the central free list.
+static void releaseBlocks(unsigned sizeClass, FreeBlock *first,
+                          FreeBlock *last) {
+  auto &central = CentralFreeLists[sizeClass];
+  central.Lock.withLock([&] {
+    last->Next = central.Head;
+    central.Head = first;
+  });
+}
+
+/// Flush the calling thread's cache when it exits.
+static void flushThreadCache(void *cache) {
+  auto &local = *static_cast<ThreadCache *>(cache);
+  for (unsigned sizeClass = 0; sizeClass != NumSizeClasses; ++sizeClass) {
+    FreeBlock *first = local.Head[sizeClass];
+    if (!first)
+      continue;
+    FreeBlock *last = first;
+    while (last->Next)
+      last = last->Next;
+    releaseBlocks(sizeClass, first, last);
+    local.Head[sizeClass] = nullptr;
+    local.Count[sizeClass] = 0;
+  }
+
+  // Destructors that run after this one may still allocate, in which case
+  // the cache is registered again.
+  local.IsRegistered = false;
+}
+
+static void registerThreadCache() {
+  LocalCache.IsRegistered = true;
+  pthread_setspecific(ThreadCacheKey, &LocalCache);
+}
+
+static void initializeSizeClassAllocator(void *) {
+  if (pthread_key_create(&ThreadCacheKey, flushThreadCache) != 0)
+    return;
+
+  // Reserve address space for every size class up front.  Pages are only
+  // committed as blocks are first handed out.  If the reservation fails,
+  // for example because overcommit is disabled, every allocation falls back
+  // to malloc.
+  size_t reservationSize = NumSizeClasses * SizeClassRegionSize;
+  void *reservation = mmap(nullptr, reservationSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           -1, 0);
+  if (reservation == MAP_FAILED)
+    return;
+
+  auto begin = reinterpret_cast<uintptr_t>(reservation);
+  SizeClassRegionsEnd.store(begin + reservationSize, std::memory_order_relaxed);
+  SizeClassRegionsBegin.store(begin, std::memory_order_release);
+}
+
+/// Move a batch of blocks of the given size class into the calling thread's
+/// cache.  Returns false if no blocks are available.
+static bool refillThreadCache(unsigned sizeClass) {
+  swift_once(&SizeClassAllocatorOnce, initializeSizeClassAllocator);
+  uintptr_t regionsBegin =
+    SizeClassRegionsBegin.load(std::memory_order_acquire);
+  if (!regionsBegin)
+    return false;
+
+  if (!LocalCache.IsRegistered)
+    registerThreadCache();
+
+  auto &central = CentralFreeLists[sizeClass];
+  size_t blockSize = getSizeForSizeClass(sizeClass);
+  char *region = reinterpret_cast<char *>(regionsBegin)
+    + sizeClass * SizeClassRegionSize;
+
+  FreeBlock *head = LocalCache.Head[sizeClass];
+  unsigned count = LocalCache.Count[sizeClass];
+
+  central.Lock.withLock([&] {
+    // Prefer blocks that have been used before; their pages are already
+    // committed and likely to be in cache.
+    while (central.Head && count < TransferBatchSize) {
+      FreeBlock *block = central.Head;
+      central.Head = block->Next;
+      block->Next = head;
+      head = block;
+      ++count;
+    }
+
+    // Then carve new blocks out of the size class region.
+    while (count < TransferBatchSize &&
+           central.BumpOffset + blockSize <= SizeClassRegionSize) {
+      auto block = reinterpret_cast<FreeBlock *>(region + central.BumpOffset);
+      central.BumpOffset += blockSize;
+      block->Next = head;
+      head = block;
+      ++count;
+    }
+  });
+
+  LocalCache.Head[sizeClass] = head;
+  LocalCache.Count[sizeClass] = count;
+  return head != nullptr;
+}
+
+/// Allocate a block from the size class allocator, or return null if the
+/// allocation should be satisfied by malloc instead.
+static void *allocateFromSizeClass(size_t size, size_t alignMask) {
+  if (alignMask == ~size_t(0))
+    alignMask = MallocAlignMask;
+  if (size > MaxSizeClassSize || alignMask >= SizeClassQuantum)
+    return nullptr;
+
+  unsigned sizeClass = getSizeClassForSize(size);
+  FreeBlock *block = LocalCache.Head[sizeClass];
+  if (LLVM_UNLIKELY(!block)) {
+    if (!refillThreadCache(sizeClass))
+      return nullptr;
+    block = LocalCache.Head[sizeClass];
+  }
+
+  LocalCache.Head[sizeClass] = block->Next;
+  --LocalCache.Count[sizeClass];
+  return block;
+}
+
+/// If \p ptr was allocated from the size class allocator, set \p sizeClass
+/// to its size class and return true.
+static bool getSizeClassOfBlock(const void *ptr, unsigned &sizeClass) {
+  auto address = reinterpret_cast<uintptr_t>(ptr);
+  uintptr_t regionsBegin =
+    SizeClassRegionsBegin.load(std::memory_order_relaxed);
+  if (address < regionsBegin ||
+      address >= SizeClassRegionsEnd.load(std::memory_order_relaxed))
+    return false;
+  sizeClass = (address - regionsBegin) >> SizeClassRegionShift;
+  return true;
+}
+
+/// Return a block to the size class allocator if it was allocated from it.
+/// Returns false if the block was allocated by malloc.
+static bool deallocateToSizeClass(void *ptr) {
+  // The size class is determined by the address, not by the size passed to
+  // swift_slowDealloc: some callers, like swift_unownedRelease, only know
+  // the instance size of the class rather than the size actually allocated.
+  unsigned sizeClass;
+  if (!getSizeClassOfBlock(ptr, sizeClass))
+    return false;
+
+  auto block = static_cast<FreeBlock *>(ptr);
+  block->Next = LocalCache.Head[sizeClass];
+  LocalCache.Head[sizeClass] = block;
+
+  if (LLVM_UNLIKELY(++LocalCache.Count[sizeClass] > MaxCachedBlocks)) {
+    // Hand a batch back so that blocks freed by a consumer thread can be
+    // reused by the producer thread.
+    FreeBlock *first = LocalCache.Head[sizeClass];
+    FreeBlock *last = first;
+    for (unsigned i = 1; i != TransferBatchSize; ++i)
+      last = last->Next;
+    LocalCache.Head[sizeClass] = last->Next;
+    LocalCache.Count[sizeClass] -= TransferBatchSize;
+    releaseBlocks(sizeClass, first, last);
+  }
+
+  if (LLVM_UNLIKELY(!LocalCache.IsRegistered))
+    registerThreadCache();
+
+  return true;
+}
+
+size_t swift::_swift_getSizeClassBlockSize(const void *ptr) {
+  unsigned sizeClass;
+  if (!getSizeClassOfBlock(ptr, sizeClass))
+    return 0;
+  return getSizeForSizeClass(sizeClass);
+}
+
+#endif // SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+
 SWIFT_RT_ENTRY_VISIBILITY
 void *swift::swift_slowAlloc(size_t size, size_t alignMask)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+  if (void *p = allocateFromSizeClass(size, alignMask))
+    return p;
+
+  void *p;
+  if (needsAlignedAlloc(alignMask))
+    p = AlignedAlloc(size, alignMask + 1);
+  else
+    p = malloc(size);
+#else
   // FIXME: use posix_memalign if alignMask is larger than the system guarantee.
   void *p = malloc(size);
+#endif
   if (!p) swift::crash("Could not allocate memory.");
   return p;
 }
@@ -34,5 +328,11 @@ void *swift::swift_slowAlloc(size_t size, size_t alignMask)
 SWIFT_RT_ENTRY_VISIBILITY
 void swift::swift_slowDealloc(void *ptr, size_t bytes, size_t alignMask)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+  if (deallocateToSizeClass(ptr))
+    return;
+#endif
+
+  // Memory from AlignedAlloc is freed by free on Linux.
   free(ptr);
 }
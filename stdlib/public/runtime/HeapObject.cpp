@@ -19,11 +19,13 @@
 #include "swift/Runtime/Heap.h"
 #include "swift/Runtime/Metadata.h"
 #include "swift/ABI/System.h"
+#include "swift/Runtime/Mutex.h"
 #include "llvm/Support/MathExtras.h"
 #include "MetadataCache.h"
 #include "Private.h"
 #include "swift/Runtime/Debug.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <cstdio>
@@ -38,6 +40,9 @@
 #include "swift/Runtime/ObjCBridge.h"
 #endif
 #include "Leaks.h"
+#include "AllocationProfiler.h"
+#include "BiasedRefCount.h"
+#include "RuntimeStatistics.h"
 
 using namespace swift;
 
@@ -59,18 +64,21 @@ SWIFT_RT_ENTRY_IMPL(swift_allocObject)(HeapMetadata const *metadata,
                                        size_t requiredSize,
                                        size_t requiredAlignmentMask)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::AllocObject);
   assert(isAlignmentMask(requiredAlignmentMask));
   auto object = reinterpret_cast<HeapObject *>(
       SWIFT_RT_ENTRY_CALL(swift_slowAlloc)(requiredSize,
                                            requiredAlignmentMask));
   // FIXME: this should be a placement new but that adds a null check
   object->metadata = metadata;
-  object->refCount.init();
-  object->weakRefCount.init();
+  _swift_biasedInit(object);
 
   // If leak tracking is enabled, start tracking this object.
   SWIFT_LEAKS_START_TRACKING_OBJECT(object);
 
+  // If allocation profiling is enabled, this may sample the object.
+  _swift_noteAllocation(object, requiredSize);
+
   return object;
 }
 
@@ -85,15 +93,21 @@ swift::swift_initStackObject(HeapMetadata const *metadata,
 
 }
 
+static void detachWeakSideTable(HeapObject *object);
+
 void
 swift::swift_verifyEndOfLifetime(HeapObject *object) {
   if (object->refCount.getCount() != 0)
     swift::fatalError(/* flags = */ 0,
                       "fatal error: stack object escaped\n");
-  
+
+  // Weak references don't point at the object, so they may outlive it; they
+  // just need to stop finding it before its stack slot is reused.
+  detachWeakSideTable(object);
+
   if (object->weakRefCount.getCount() != 1)
     swift::fatalError(/* flags = */ 0,
-                      "fatal error: weak/unowned reference to stack object\n");
+                      "fatal error: unowned reference to stack object\n");
 }
 
 /// \brief Allocate a reference-counted object on the heap that
@@ -246,6 +260,9 @@ void swift::swift_nonatomic_retain(HeapObject *object) {
 SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_nonatomic_retain)(HeapObject *object) {
+  _swift_countRuntimeCall(RuntimeCounter::Retain);
+  if (object && _swift_biasedRetain(object, 1))
+    return;
   _swift_nonatomic_retain_inlined(object);
 }
 
@@ -258,6 +275,9 @@ void swift::swift_nonatomic_release(HeapObject *object) {
 SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_nonatomic_release)(HeapObject *object) {
+  _swift_countRuntimeCall(RuntimeCounter::Release);
+  if (object && _swift_biasedRelease(object, 1))
+    return;
   if (object  &&  object->refCount.decrementShouldDeallocateNonAtomic()) {
     // TODO: Use non-atomic _swift_release_dealloc?
     _swift_release_dealloc(object);
@@ -268,6 +288,9 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_retain)(HeapObject *object)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Retain);
+  if (object && _swift_biasedRetain(object, 1))
+    return;
   _swift_retain_inlined(object);
 }
 
@@ -282,6 +305,9 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_retain_n)(HeapObject *object, uint32_t n)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Retain);
+  if (object && _swift_biasedRetain(object, n))
+    return;
   if (object) {
     object->refCount.increment(n);
   }
@@ -298,6 +324,9 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_nonatomic_retain_n)(HeapObject *object, uint32_t n)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Retain);
+  if (object && _swift_biasedRetain(object, n))
+    return;
   if (object) {
     object->refCount.incrementNonAtomic(n);
   }
@@ -314,6 +343,9 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_release)(HeapObject *object)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Release);
+  if (object && _swift_biasedRelease(object, 1))
+    return;
   if (object  &&  object->refCount.decrementShouldDeallocate()) {
     _swift_release_dealloc(object);
   }
@@ -329,12 +361,17 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_release_n)(HeapObject *object, uint32_t n)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Release);
+  if (object && _swift_biasedRelease(object, n))
+    return;
   if (object && object->refCount.decrementShouldDeallocateN(n)) {
     _swift_release_dealloc(object);
   }
 }
 
 void swift::swift_setDeallocating(HeapObject *object) {
+  if (_swift_biasedSetDeallocating(object))
+    return;
   object->refCount.decrementFromOneAndDeallocateNonAtomic();
 }
 
@@ -348,12 +385,18 @@ SWIFT_RT_ENTRY_IMPL_VISIBILITY
 extern "C"
 void SWIFT_RT_ENTRY_IMPL(swift_nonatomic_release_n)(HeapObject *object, uint32_t n)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::Release);
+  if (object && _swift_biasedRelease(object, n))
+    return;
   if (object && object->refCount.decrementShouldDeallocateNNonAtomic(n)) {
     _swift_release_dealloc(object);
   }
 }
 
 size_t swift::swift_retainCount(HeapObject *object) {
+  size_t count;
+  if (_swift_biasedGetCount(object, count))
+    return count;
   return object->refCount.getCount();
 }
 
@@ -424,6 +467,9 @@ HeapObject *swift::swift_tryPin(HeapObject *object)
 
   // Try to set the flag.  If this succeeds, the caller will be
   // responsible for clearing it.
+  bool pinned;
+  if (_swift_biasedTryPin(object, pinned))
+    return pinned ? object : nullptr;
   if (object->refCount.tryIncrementAndPin()) {
     return object;
   }
@@ -436,6 +482,8 @@ HeapObject *swift::swift_tryPin(HeapObject *object)
 SWIFT_RT_ENTRY_VISIBILITY
 void swift::swift_unpin(HeapObject *object)
   SWIFT_CC(RegisterPreservingCC_IMPL) {
+  if (object && _swift_biasedUnpin(object))
+    return;
   if (object && object->refCount.decrementAndUnpinShouldDeallocate()) {
     _swift_release_dealloc(object);
   }
@@ -454,6 +502,9 @@ HeapObject *swift::swift_nonatomic_tryPin(HeapObject *object)
 
   // Try to set the flag.  If this succeeds, the caller will be
   // responsible for clearing it.
+  bool pinned;
+  if (_swift_biasedTryPin(object, pinned))
+    return pinned ? object : nullptr;
   if (object->refCount.tryIncrementAndPinNonAtomic()) {
     return object;
   }
@@ -466,6 +517,8 @@ HeapObject *swift::swift_nonatomic_tryPin(HeapObject *object)
 SWIFT_RT_ENTRY_VISIBILITY
 void swift::swift_nonatomic_unpin(HeapObject *object)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  if (object && _swift_biasedUnpin(object))
+    return;
   if (object && object->refCount.decrementAndUnpinShouldDeallocateNonAtomic()) {
     _swift_release_dealloc(object);
   }
@@ -478,6 +531,9 @@ HeapObject *SWIFT_RT_ENTRY_IMPL(swift_tryRetain)(HeapObject *object)
   if (!object)
     return nullptr;
 
+  bool retained;
+  if (_swift_biasedTryRetain(object, retained))
+    return retained ? object : nullptr;
   if (object->refCount.tryIncrement()) return object;
   else return nullptr;
 }
@@ -503,7 +559,7 @@ void swift::swift_unownedRetainStrong(HeapObject *object)
   assert(object->weakRefCount.getCount() &&
          "object is not currently weakly retained");
 
-  if (! object->refCount.tryIncrement())
+  if (!SWIFT_RT_ENTRY_CALL(swift_tryRetain)(object))
     _swift_abortRetainUnowned(object);
 }
 
@@ -516,7 +572,7 @@ swift::swift_unownedRetainStrongAndRelease(HeapObject *object)
   assert(object->weakRefCount.getCount() &&
          "object is not currently weakly retained");
 
-  if (! object->refCount.tryIncrement())
+  if (!SWIFT_RT_ENTRY_CALL(swift_tryRetain)(object))
     _swift_abortRetainUnowned(object);
 
   // This should never cause a deallocation.
@@ -618,9 +674,11 @@ extern "C" void swift_deallocPartialClassInstance(HeapObject *object,
 #endif
 
   // The strong reference count should be +1 -- tear down the object
-  bool shouldDeallocate = object->refCount.decrementShouldDeallocate();
-  assert(shouldDeallocate);
-  (void) shouldDeallocate;
+  if (!_swift_biasedSetDeallocating(object)) {
+    bool shouldDeallocate = object->refCount.decrementShouldDeallocate();
+    assert(shouldDeallocate);
+    (void) shouldDeallocate;
+  }
   swift_deallocClassInstance(object, allocatedSize, allocatedAlignMask);
 }
 
@@ -636,6 +694,303 @@ static inline void memset_pattern8(void *b, const void *pattern8, size_t len) {
 }
 #endif
 
+/*****************************************************************************/
+/*************************** WEAK REFERENCE SIDE TABLES **********************/
+/*****************************************************************************/
+
+namespace {
+
+/// The state shared by all native weak references to an object.
+///
+/// Weak references point at the side table instead of at the object, so
+/// they don't keep the object's memory alive, and loading one never writes
+/// to the weak reference itself.
+class WeakSideTable {
+  /// The object, or null once it has begun deallocation.
+  std::atomic<HeapObject *> Object;
+
+  /// The number of weak references to the side table, plus one that is held
+  /// by the object until it is deallocated.
+  std::atomic<size_t> RefCount;
+
+  /// The number of threads that are currently trying to retain the object
+  /// through the side table.  The object's memory must not be freed until
+  /// this drops to zero.  Loads that find the object already cleared never
+  /// touch this, so once detachObject has cleared the object it only waits
+  /// for loads that started before that.
+  std::atomic<size_t> Readers;
+
+public:
+  explicit WeakSideTable(HeapObject *object)
+    : Object(object), RefCount(1), Readers(0) {}
+
+  void retain() {
+    RefCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() {
+    if (RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  /// Return the object retained, or null if it has begun deallocation.
+  HeapObject *tryRetainObject() {
+    // Once the object is gone, leave without registering as a reader, so
+    // that a steady stream of loads can't hold up detachObject.
+    if (!Object.load(std::memory_order_relaxed))
+      return nullptr;
+
+    // These accesses pair with the ones in detachObject: either we see the
+    // object cleared, or detachObject sees us as a reader and waits for us
+    // before the object's memory can be freed.
+    Readers.fetch_add(1, std::memory_order_seq_cst);
+    HeapObject *result = Object.load(std::memory_order_seq_cst);
+    if (result)
+      result = swift_tryRetain(result);
+    Readers.fetch_sub(1, std::memory_order_release);
+    return result;
+  }
+
+  /// Called when the object is deallocated.  Every later load through the
+  /// side table produces null.
+  void detachObject() {
+    Object.store(nullptr, std::memory_order_seq_cst);
+
+    // Only loads that saw the object before it was cleared can still be
+    // registered, and each is at most a failing swift_tryRetain away from
+    // being done with it.
+    while (Readers.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+  }
+};
+
+/// Maps objects to their weak reference side tables.
+///
+/// This is only consulted when a weak reference is formed from a strong one
+/// and when an object that has a side table is deallocated.  Everything else
+/// reaches the side table through the weak reference.
+///
+/// Each stripe is an open-addressed hash table with linear probing that is
+/// only modified with the stripe's lock held.  Forming a weak reference to
+/// an object that already has a side table reads the stripe without the
+/// lock, and uses the result if the stripe's version shows that nothing
+/// modified it in the meantime.  The entry cannot be removed after that,
+/// because the caller keeps the object alive.
+class WeakSideTableRegistry {
+  static constexpr unsigned NumStripes = 64;
+
+  struct Slot {
+    std::atomic<HeapObject *> Object;
+    std::atomic<WeakSideTable *> Table;
+  };
+
+  struct Array {
+    /// The number of slots minus one.  The number of slots is always a
+    /// power of two.
+    size_t Mask;
+
+    /// The array that this array replaced.  Old arrays are never freed,
+    /// because readers without the lock may still be probing them.
+    Array *Previous;
+
+    /// The slots; the actual number of slots is Mask + 1.
+    Slot Slots[1];
+
+    static Array *create(size_t capacity, Array *previous) {
+      size_t allocSize = sizeof(Array) + (capacity - 1) * sizeof(Slot);
+      auto array = static_cast<Array *>(calloc(1, allocSize));
+      if (!array)
+        crash("Could not allocate memory.");
+      array->Mask = capacity - 1;
+      array->Previous = previous;
+      return array;
+    }
+
+    size_t getCapacity() const { return Mask + 1; }
+
+    Slot &getSlot(size_t index) { return Slots[index & Mask]; }
+  };
+
+  struct alignas(64) Stripe {
+    Mutex Lock;
+
+    /// Incremented before and after every modification, so it is odd while
+    /// the stripe is being modified.
+    std::atomic<size_t> Version{0};
+
+    /// The current array, or null if nothing has been inserted yet.
+    std::atomic<Array *> Slots{nullptr};
+
+    /// The number of entries.  Only accessed with the lock held.
+    size_t Count = 0;
+
+    template <class Fn>
+    void modify(Fn &&fn) {
+      size_t version = Version.load(std::memory_order_relaxed);
+      Version.store(version + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      fn();
+      Version.store(version + 2, std::memory_order_release);
+    }
+  };
+
+  Stripe Stripes[NumStripes];
+
+  static size_t getHash(HeapObject *object) {
+    auto bits = reinterpret_cast<uintptr_t>(object);
+    return (bits >> 4) / NumStripes;
+  }
+
+  Stripe &getStripe(HeapObject *object) {
+    auto bits = reinterpret_cast<uintptr_t>(object);
+    return Stripes[(bits >> 4) % NumStripes];
+  }
+
+  /// Return the index of the slot of \p object in \p array, or the index of
+  /// the empty slot where it would be inserted.  Gives up after probing
+  /// every slot, which can only happen when racing with a modification.
+  static size_t probe(Array *array, HeapObject *object) {
+    size_t index = getHash(object) & array->Mask;
+    for (size_t n = 0; n != array->Mask; ++n, ++index) {
+      HeapObject *key =
+        array->getSlot(index).Object.load(std::memory_order_relaxed);
+      if (key == object || !key)
+        break;
+    }
+    return index & array->Mask;
+  }
+
+  /// Return the side table of \p object, or null if it has none.  Must be
+  /// called with the stripe's lock held.
+  static WeakSideTable *find(Stripe &stripe, HeapObject *object) {
+    Array *array = stripe.Slots.load(std::memory_order_acquire);
+    if (!array)
+      return nullptr;
+    Slot &slot = array->getSlot(probe(array, object));
+    if (slot.Object.load(std::memory_order_relaxed) != object)
+      return nullptr;
+    return slot.Table.load(std::memory_order_relaxed);
+  }
+
+  /// Like find, but without the lock.  Returns null if the stripe was
+  /// modified concurrently.
+  static WeakSideTable *findWithoutLock(Stripe &stripe, HeapObject *object) {
+    size_t version = stripe.Version.load(std::memory_order_acquire);
+    if (version & 1)
+      return nullptr;
+    WeakSideTable *result = find(stripe, object);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (stripe.Version.load(std::memory_order_relaxed) != version)
+      return nullptr;
+    return result;
+  }
+
+  static void insert(Array *array, HeapObject *object, WeakSideTable *table) {
+    Slot &slot = array->getSlot(probe(array, object));
+    slot.Object.store(object, std::memory_order_relaxed);
+    slot.Table.store(table, std::memory_order_relaxed);
+  }
+
+  /// Make room for one more entry, moving the entries into a larger array
+  /// if the current one would be over half full.
+  static void reserve(Stripe &stripe) {
+    Array *array = stripe.Slots.load(std::memory_order_relaxed);
+    if (array && (stripe.Count + 1) * 2 <= array->getCapacity())
+      return;
+
+    Array *newArray = Array::create(array ? array->getCapacity() * 2 : 16,
+                                    array);
+    for (size_t i = 0; array && i != array->getCapacity(); ++i) {
+      Slot &slot = array->Slots[i];
+      if (auto key = slot.Object.load(std::memory_order_relaxed))
+        insert(newArray, key, slot.Table.load(std::memory_order_relaxed));
+    }
+    stripe.Slots.store(newArray, std::memory_order_release);
+  }
+
+  /// Remove the entry in slot \p index, moving later entries of the same
+  /// run back so that no probe sequence passes through an empty slot.
+  static void remove(Array *array, size_t index) {
+    for (size_t next = index + 1;; ++next) {
+      Slot &slot = array->getSlot(next);
+      HeapObject *key = slot.Object.load(std::memory_order_relaxed);
+      if (!key)
+        break;
+      // The entry can fill the hole unless its probe sequence starts after
+      // the hole.
+      size_t home = getHash(key);
+      if (((next - home) & array->Mask) < ((next - index) & array->Mask))
+        continue;
+      Slot &hole = array->getSlot(index);
+      hole.Object.store(key, std::memory_order_relaxed);
+      hole.Table.store(slot.Table.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+      index = next;
+    }
+    array->getSlot(index).Object.store(nullptr, std::memory_order_relaxed);
+  }
+
+public:
+  /// Return a new reference to the side table of the given object, creating
+  /// it if necessary.  Returns null if the object has begun deallocation.
+  WeakSideTable *getOrCreate(HeapObject *object) {
+    auto &stripe = getStripe(object);
+
+    if (object->weakRefCount.hasSideTable()) {
+      if (auto result = findWithoutLock(stripe, object)) {
+        result->retain();
+        return result;
+      }
+    }
+
+    WeakSideTable *result = nullptr;
+    stripe.Lock.withLock([&] {
+      result = find(stripe, object);
+      if (!result) {
+        if (object->refCount.isDeallocating())
+          return;
+        result = new WeakSideTable(object);
+        stripe.modify([&] {
+          reserve(stripe);
+          insert(stripe.Slots.load(std::memory_order_relaxed), object, result);
+          ++stripe.Count;
+        });
+        object->weakRefCount.setHasSideTable();
+      }
+      result->retain();
+    });
+    return result;
+  }
+
+  /// Detach the side table from an object that is being deallocated, or
+  /// from a stack object at the end of its lifetime.
+  void detach(HeapObject *object) {
+    auto &stripe = getStripe(object);
+    WeakSideTable *table = nullptr;
+    stripe.Lock.withLock([&] {
+      table = find(stripe, object);
+      assert(table && "object has no side table");
+      stripe.modify([&] {
+        Array *array = stripe.Slots.load(std::memory_order_relaxed);
+        remove(array, probe(array, object));
+        --stripe.Count;
+      });
+      object->weakRefCount.clearHasSideTable();
+    });
+    table->detachObject();
+    table->release();
+  }
+};
+
+} // end anonymous namespace
+
+static Lazy<WeakSideTableRegistry> WeakSideTables;
+
+static void detachWeakSideTable(HeapObject *object) {
+  if (object->weakRefCount.hasSideTable())
+    WeakSideTables->detach(object);
+}
+
 SWIFT_RT_ENTRY_VISIBILITY
 void swift::swift_deallocObject(HeapObject *object,
                                 size_t allocatedSize,
@@ -652,6 +1007,13 @@ void swift::swift_deallocObject(HeapObject *object,
   // If we are tracking leaks, stop tracking this object.
   SWIFT_LEAKS_STOP_TRACKING_OBJECT(object);
 
+  // If this object was sampled by the allocation profiler, it's no longer live.
+  _swift_noteDeallocation(object);
+  _swift_countRuntimeCall(RuntimeCounter::DeallocObject);
+
+  // Clear any weak references before the object's memory can be reused.
+  detachWeakSideTable(object);
+
   // Drop the initial weak retain of the object.
   //
   // If the outstanding weak retain count is 1 (i.e. only the initial
@@ -728,142 +1090,91 @@ void swift::swift_deallocObject(HeapObject *object,
 
 enum: uintptr_t {
   WR_NATIVE = 1<<(swift::heap_object_abi::ObjCReservedLowBits),
-  WR_READING = 1<<(swift::heap_object_abi::ObjCReservedLowBits+1),
 
   WR_NATIVEMASK = WR_NATIVE | swift::heap_object_abi::ObjCReservedBitsMask,
 };
 
-static_assert(WR_READING < alignof(void*),
-              "weakref lock bit mustn't interfere with real pointer bits");
+static_assert(WR_NATIVE < alignof(WeakSideTable),
+              "weakref native bit mustn't interfere with real pointer bits");
 
-enum: short {
-  WR_SPINLIMIT = 64,
-};
+static WeakSideTable *getSideTable(WeakReference *ref) {
+  return reinterpret_cast<WeakSideTable *>(ref->Value & ~WR_NATIVE);
+}
+
+static void setSideTable(WeakReference *ref, WeakSideTable *table) {
+  ref->Value = reinterpret_cast<uintptr_t>(table) | WR_NATIVE;
+}
+
+static WeakSideTable *getOrCreateSideTable(HeapObject *object) {
+  if (object == nullptr)
+    return nullptr;
+  return WeakSideTables->getOrCreate(object);
+}
 
 bool swift::isNativeSwiftWeakReference(WeakReference *ref) {
   return (ref->Value & WR_NATIVEMASK) == WR_NATIVE;
 }
 
 void swift::swift_weakInit(WeakReference *ref, HeapObject *value) {
-  ref->Value = (uintptr_t)value | WR_NATIVE;
-  SWIFT_RT_ENTRY_CALL(swift_unownedRetain)(value);
+  setSideTable(ref, getOrCreateSideTable(value));
 }
 
 void swift::swift_weakAssign(WeakReference *ref, HeapObject *newValue) {
-  SWIFT_RT_ENTRY_CALL(swift_unownedRetain)(newValue);
-  auto oldValue = (HeapObject*) (ref->Value & ~WR_NATIVE);
-  ref->Value = (uintptr_t)newValue | WR_NATIVE;
-  SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(oldValue);
+  auto newTable = getOrCreateSideTable(newValue);
+  auto oldTable = getSideTable(ref);
+  setSideTable(ref, newTable);
+  if (oldTable)
+    oldTable->release();
 }
 
 HeapObject *swift::swift_weakLoadStrong(WeakReference *ref) {
-  if (ref->Value == (uintptr_t)nullptr) {
-    return nullptr;
-  }
-
-  // ref might be visible to other threads
-  auto ptr = __atomic_fetch_or(&ref->Value, WR_READING, __ATOMIC_RELAXED);
-  while (ptr & WR_READING) {
-    short c = 0;
-    while (__atomic_load_n(&ref->Value, __ATOMIC_RELAXED) & WR_READING) {
-      if (++c == WR_SPINLIMIT) {
-        std::this_thread::yield();
-        c -= 1;
-      }
-    }
-    ptr = __atomic_fetch_or(&ref->Value, WR_READING, __ATOMIC_RELAXED);
-  }
-
-  auto object = (HeapObject*)(ptr & ~WR_NATIVE);
-  if (object == nullptr) {
-    __atomic_store_n(&ref->Value, (uintptr_t)nullptr, __ATOMIC_RELAXED);
+  // ref might be visible to other threads, but it is only ever read here;
+  // the side table outlives every weak reference to it.
+  auto table = getSideTable(ref);
+  if (table == nullptr)
     return nullptr;
-  }
-  if (object->refCount.isDeallocating()) {
-    __atomic_store_n(&ref->Value, (uintptr_t)nullptr, __ATOMIC_RELAXED);
-    SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(object);
-    return nullptr;
-  }
-  auto result = swift_tryRetain(object);
-  __atomic_store_n(&ref->Value, ptr, __ATOMIC_RELAXED);
-  return result;
+  return table->tryRetainObject();
 }
 
 HeapObject *swift::swift_weakTakeStrong(WeakReference *ref) {
-  auto object = (HeapObject*) (ref->Value & ~WR_NATIVE);
-  if (object == nullptr) return nullptr;
-  auto result = swift_tryRetain(object);
+  auto table = getSideTable(ref);
+  if (table == nullptr) return nullptr;
+  auto result = table->tryRetainObject();
   ref->Value = (uintptr_t)nullptr;
-  swift_unownedRelease(object);
+  table->release();
   return result;
 }
 
 void swift::swift_weakDestroy(WeakReference *ref) {
-  auto tmp = (HeapObject*) (ref->Value & ~WR_NATIVE);
+  auto table = getSideTable(ref);
   ref->Value = (uintptr_t)nullptr;
-  SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(tmp);
+  if (table)
+    table->release();
 }
 
 void swift::swift_weakCopyInit(WeakReference *dest, WeakReference *src) {
-  if (src->Value == (uintptr_t)nullptr) {
-    dest->Value = (uintptr_t)nullptr;
-    return;
-  }
-
-  // src might be visible to other threads
-  auto ptr = __atomic_fetch_or(&src->Value, WR_READING, __ATOMIC_RELAXED);
-  while (ptr & WR_READING) {
-    short c = 0;
-    while (__atomic_load_n(&src->Value, __ATOMIC_RELAXED) & WR_READING) {
-      if (++c == WR_SPINLIMIT) {
-        std::this_thread::yield();
-        c -= 1;
-      }
-    }
-    ptr = __atomic_fetch_or(&src->Value, WR_READING, __ATOMIC_RELAXED);
-  }
-
-  auto object = (HeapObject*)(ptr & ~WR_NATIVE);
-  if (object == nullptr) {
-    __atomic_store_n(&src->Value, (uintptr_t)nullptr, __ATOMIC_RELAXED);
-    dest->Value = (uintptr_t)nullptr;
-  } else if (object->refCount.isDeallocating()) {
-    __atomic_store_n(&src->Value, (uintptr_t)nullptr, __ATOMIC_RELAXED);
-    SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(object);
-    dest->Value = (uintptr_t)nullptr;
-  } else {
-    SWIFT_RT_ENTRY_CALL(swift_unownedRetain)(object);
-    __atomic_store_n(&src->Value, ptr, __ATOMIC_RELAXED);
-    dest->Value = (uintptr_t)object | WR_NATIVE;
-  }
+  auto table = getSideTable(src);
+  if (table)
+    table->retain();
+  setSideTable(dest, table);
 }
 
 void swift::swift_weakTakeInit(WeakReference *dest, WeakReference *src) {
-  auto object = (HeapObject*) (src->Value & ~WR_NATIVE);
-  if (object == nullptr) {
-    dest->Value = (uintptr_t)nullptr;
-  } else if (object->refCount.isDeallocating()) {
-    dest->Value = (uintptr_t)nullptr;
-    SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(object);
-  } else {
-    dest->Value = (uintptr_t)object | WR_NATIVE;
-  }
+  setSideTable(dest, getSideTable(src));
   src->Value = (uintptr_t)nullptr;
 }
 
 void swift::swift_weakCopyAssign(WeakReference *dest, WeakReference *src) {
-  if (dest->Value) {
-    auto object = (HeapObject*) (dest->Value & ~WR_NATIVE);
-    SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(object);
-  }
+  if (dest == src)
+    return;
+  swift_weakDestroy(dest);
   swift_weakCopyInit(dest, src);
 }
 
 void swift::swift_weakTakeAssign(WeakReference *dest, WeakReference *src) {
-  if (dest->Value) {
-    auto object = (HeapObject*) (dest->Value & ~WR_NATIVE);
-    SWIFT_RT_ENTRY_CALL(swift_unownedRelease)(object);
-  }
+  if (dest == src)
+    return;
+  swift_weakDestroy(dest);
   swift_weakTakeInit(dest, src);
 }
 
@@ -0,0 +1,98 @@
+//===--- MangledNameIndex.h - Records indexed by mangled name ---*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// An index of type metadata and protocol conformance records by the mangled
+// name of the type they refer to, built as images are registered, so that
+// looking up a type by name doesn't have to scan every record.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_MANGLEDNAMEINDEX_H
+#define SWIFT_RUNTIME_MANGLEDNAMEINDEX_H
+
+#include "swift/Runtime/Concurrent.h"
+#include "swift/Runtime/Metadata.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+#include "Private.h"
+
+namespace swift {
+
+/// The records registered for types with a particular mangled name.  This is
+/// an entry type for ConcurrentHashMap, keyed by the name.
+template <class RecordTy>
+struct MangledNameIndexEntry {
+private:
+  /// The name is the one in the nominal type descriptor of the indexed
+  /// type, so it lives as long as the image that registered the records.
+  llvm::StringRef Name;
+
+public:
+  /// The records for the name, in the order they were registered.
+  ConcurrentList<const RecordTy *> Records;
+
+  MangledNameIndexEntry(llvm::StringRef name) : Name(name) {}
+
+  int compareWithKey(llvm::StringRef key) const {
+    return key.compare(Name);
+  }
+
+  static size_t getKeyHash(llvm::StringRef key) {
+    return llvm::hash_value(key);
+  }
+
+  static size_t getExtraAllocationSize(llvm::StringRef key) {
+    return 0;
+  }
+};
+
+template <class RecordTy>
+using MangledNameIndex = ConcurrentHashMap<MangledNameIndexEntry<RecordTy>>;
+
+/// Return the metadata of the type named \p typeName described by the first
+/// of \p records that describes it, or null if none does.
+template <class RecordTy>
+const Metadata *
+searchRecordsByMangledName(const ConcurrentList<const RecordTy *> &records,
+                           llvm::StringRef typeName) {
+  for (auto record : records) {
+    const Metadata *metadata = nullptr;
+    if (auto canonical = record->getCanonicalTypeMetadata())
+      metadata = _matchMetadataByMangledTypeName(typeName, canonical, nullptr);
+    else if (auto ntd = record->getNominalTypeDescriptor())
+      metadata = _matchMetadataByMangledTypeName(typeName, nullptr, ntd);
+
+    if (metadata != nullptr)
+      return metadata;
+  }
+  return nullptr;
+}
+
+/// Return the metadata of the type named \p typeName, looking first at the
+/// records filed under that name in \p index and then at the records that
+/// couldn't be filed under any name.  Records are appended as images are
+/// registered, so the first match is the one registered first, which is
+/// what scanning every image in load order would find.
+template <class RecordTy>
+const Metadata *
+findMetadataByMangledName(MangledNameIndex<RecordTy> &index,
+                          const ConcurrentList<const RecordTy *> &unnamed,
+                          llvm::StringRef typeName) {
+  if (auto entry = index.find(typeName))
+    if (auto metadata = searchRecordsByMangledName(entry->Records, typeName))
+      return metadata;
+  return searchRecordsByMangledName(unnamed, typeName);
+}
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_MANGLEDNAMEINDEX_H
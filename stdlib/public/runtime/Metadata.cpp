@@ -39,10 +39,12 @@
 #endif
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Hashing.h"
+#include "CacheReplicas.h"
 #include "ErrorObject.h"
 #include "ExistentialMetadataImpl.h"
 #include "swift/Runtime/Debug.h"
 #include "Private.h"
+#include "RuntimeStatistics.h"
 
 #if defined(__APPLE__)
 #include <mach/vm_page_size.h>
@@ -202,6 +204,15 @@ namespace {
 using GenericMetadataCache = MetadataCache<GenericCacheEntry>;
 using LazyGenericMetadataCache = Lazy<GenericMetadataCache>;
 
+/// Construct the metadata cache in a generic metadata structure's private
+/// data, making the structure the owner of the cache's statistics.
+static void initGenericMetadataCache(void *cache) {
+  auto metadata = reinterpret_cast<const GenericMetadata *>(
+    reinterpret_cast<const char *>(cache) -
+    offsetof(GenericMetadata, PrivateData));
+  ::new (cache) GenericMetadataCache(metadata);
+}
+
 /// Fetch the metadata cache for a generic metadata structure.
 static GenericMetadataCache &getCache(GenericMetadata *metadata) {
   // Keep this assert even if you change the representation above.
@@ -211,7 +222,7 @@ static GenericMetadataCache &getCache(GenericMetadata *metadata) {
 
   auto lazyCache =
     reinterpret_cast<LazyGenericMetadataCache*>(metadata->PrivateData);
-  return lazyCache->get();
+  return lazyCache->get(initGenericMetadataCache);
 }
 
 /// Fetch the metadata cache for a generic metadata structure,
@@ -326,18 +337,40 @@ const Metadata *
 swift::swift_getGenericMetadata(GenericMetadata *pattern,
                                 const void *arguments)
     SWIFT_CC(RegisterPreservingCC_IMPL) {
+  _swift_countRuntimeCall(RuntimeCounter::GetGenericMetadata);
+  _swift_startMetadataProfiling();
+
   auto genericArgs = (const void * const *) arguments;
   size_t numGenericArgs = pattern->NumKeyArguments;
 
+  // Only patterns with a single key argument fit in the cache replicas.
+  if (numGenericArgs == 1) {
+    if (auto metadata = _swift_findInCacheReplica(
+                ReplicatedCache::GenericMetadata, pattern, genericArgs[0]))
+      return static_cast<const Metadata *>(metadata);
+  }
+
+  bool created = false;
   auto entry = getCache(pattern).findOrAdd(genericArgs, numGenericArgs,
     [&]() -> GenericCacheEntry* {
+      RuntimeLatencyTimer timer(RuntimeLatency::GenericMetadataInstantiation);
+
       // Create new metadata to cache.
       auto metadata = pattern->CreateFunction(pattern, arguments);
       auto entry = GenericCacheEntry::getFromMetadata(pattern, metadata);
       entry->Value = metadata;
+      created = true;
       return entry;
     });
 
+  // Record the metadata once it's published, so that recording doesn't
+  // delay the threads waiting for it.
+  if (created)
+    _swift_noteGenericMetadata(pattern, genericArgs, entry->Value);
+
+  if (numGenericArgs == 1)
+    _swift_fillCacheReplica(ReplicatedCache::GenericMetadata, pattern,
+                            genericArgs[0], entry->Value);
   return entry->Value;
 }
 
@@ -366,6 +399,10 @@ namespace {
       return comparePointers(theClass, Data.Class);
     }
 
+    static size_t getKeyHash(const ClassMetadata *theClass) {
+      return llvm::hash_value(theClass);
+    }
+
     static size_t getExtraAllocationSize(const ClassMetadata *key) {
       return 0;
     }
@@ -373,7 +410,7 @@ namespace {
 }
 
 /// The uniquing structure for ObjC class-wrapper metadata.
-static ConcurrentMap<ObjCClassCacheEntry, false> ObjCClassWrappers;
+static ConcurrentHashMap<ObjCClassCacheEntry, false> ObjCClassWrappers;
 
 #endif
 
@@ -444,6 +481,13 @@ public:
     return 0;
   }
 
+  static size_t getKeyHash(Key key) {
+    // Hash the flags, the arguments and the result together.
+    return llvm::hash_combine_range(key.FlagsArgsAndResult,
+                                    key.FlagsArgsAndResult
+                                      + key.getFlags().getNumArguments() + 2);
+  }
+
   static size_t getExtraAllocationSize(Key key) {
     return key.getFlags().getNumArguments()
          * sizeof(FunctionTypeMetadata::Argument);
@@ -453,7 +497,7 @@ public:
 } // end anonymous namespace
 
 /// The uniquing structure for function type metadata.
-static ConcurrentMap<FunctionCacheEntry, false> FunctionTypes;
+static ConcurrentHashMap<FunctionCacheEntry, false> FunctionTypes;
 
 const FunctionTypeMetadata *
 swift::swift_getFunctionTypeMetadata1(FunctionTypeFlags flags,
@@ -504,7 +548,10 @@ swift::swift_getFunctionTypeMetadata3(FunctionTypeFlags flags,
 const FunctionTypeMetadata *
 swift::swift_getFunctionTypeMetadata(const void *flagsArgsAndResult[]) {
   FunctionCacheEntry::Key key = { flagsArgsAndResult };
-  return &FunctionTypes.getOrInsert(key).first->Data;
+  auto result = FunctionTypes.getOrInsert(key);
+  if (result.second)
+    _swift_noteFunctionTypeMetadata(&result.first->Data);
+  return &result.first->Data;
 }
 
 FunctionCacheEntry::FunctionCacheEntry(Key key) {
@@ -606,6 +653,19 @@ public:
     return 0;
   }
 
+  static size_t getKeyHash(const Key &key) {
+    // Labels are compared by content, so they must be hashed by content.
+    llvm::hash_code labelsHash = 0;
+    if (key.Labels)
+      labelsHash = llvm::hash_value(llvm::StringRef(key.Labels));
+
+    return llvm::hash_combine(key.NumElements,
+                              llvm::hash_combine_range(key.Elements,
+                                                       key.Elements
+                                                         + key.NumElements),
+                              labelsHash);
+  }
+
   static size_t getExtraAllocationSize(const Key &key,
                                        const ValueWitnessTable *proposed) {
     return key.NumElements * sizeof(TupleTypeMetadata::Element);
@@ -615,7 +675,7 @@ public:
 }
 
 /// The uniquing structure for tuple type metadata.
-static ConcurrentMap<TupleCacheEntry, false> TupleTypes;
+static ConcurrentHashMap<TupleCacheEntry, false> TupleTypes;
 
 /// Given a metatype pointer, produce the value-witness table for it.
 /// This is equivalent to metatype->ValueWitnesses but more efficient.
@@ -1083,7 +1143,10 @@ swift::swift_getTupleTypeMetadata(size_t numElements,
 
   // Search the cache.
   TupleCacheEntry::Key key = { numElements, elements, labels };
-  return &TupleTypes.getOrInsert(key, proposedWitnesses).first->Data;
+  auto result = TupleTypes.getOrInsert(key, proposedWitnesses);
+  if (result.second)
+    _swift_noteTupleTypeMetadata(&result.first->Data);
+  return &result.first->Data;
 }
 
 TupleCacheEntry::TupleCacheEntry(const Key &key,
@@ -1528,15 +1591,14 @@ static inline ClassROData *getROData(ClassMetadata *theClass) {
 
 static void _swift_initGenericClassObjCName(ClassMetadata *theClass) {
   // Use the remangler to generate a mangled name from the type metadata.
-  auto demangling = _swift_buildDemanglingForMetadata(theClass);
+  Demangle::NodeFactory factory;
+  auto demangling = _swift_buildDemanglingForMetadata(theClass, factory);
 
   // Remangle that into a new type mangling string.
-  auto typeNode
-    = Demangle::NodeFactory::create(Demangle::Node::Kind::TypeMangling);
-  typeNode->addChild(demangling);
-  auto globalNode
-    = Demangle::NodeFactory::create(Demangle::Node::Kind::Global);
-  globalNode->addChild(typeNode);
+  auto typeNode = factory.createNode(Demangle::Node::Kind::TypeMangling);
+  typeNode->addChild(demangling, factory);
+  auto globalNode = factory.createNode(Demangle::Node::Kind::Global);
+  globalNode->addChild(typeNode, factory);
   
   auto string = Demangle::mangleNode(globalNode);
   
@@ -1884,6 +1946,10 @@ namespace {
       return comparePointers(instanceType, Data.InstanceType);
     }
 
+    static size_t getKeyHash(const Metadata *instanceType) {
+      return llvm::hash_value(instanceType);
+    }
+
     static size_t getExtraAllocationSize(const Metadata *instanceType) {
       return 0;
     }
@@ -1891,13 +1957,21 @@ namespace {
 }
 
 /// The uniquing structure for metatype type metadata.
-static ConcurrentMap<MetatypeCacheEntry, false> MetatypeTypes;
+static ConcurrentHashMap<MetatypeCacheEntry, false> MetatypeTypes;
 
 /// \brief Fetch a uniqued metadata for a metatype type.
 SWIFT_RUNTIME_EXPORT
 extern "C" const MetatypeMetadata *
 swift::swift_getMetatypeMetadata(const Metadata *instanceMetadata) {
-  return &MetatypeTypes.getOrInsert(instanceMetadata).first->Data;
+  if (auto metadata = _swift_findInCacheReplica(ReplicatedCache::Metatypes,
+                                                instanceMetadata, nullptr))
+    return static_cast<const MetatypeMetadata *>(metadata);
+
+  const MetatypeMetadata *metadata =
+    &MetatypeTypes.getOrInsert(instanceMetadata).first->Data;
+  _swift_fillCacheReplica(ReplicatedCache::Metatypes, instanceMetadata,
+                          nullptr, metadata);
+  return metadata;
 }
 
 /***************************************************************************/
@@ -1926,6 +2000,10 @@ public:
     return compareIntegers(key, getNumWitnessTables());
   }
 
+  static size_t getKeyHash(unsigned key) {
+    return llvm::hash_value(key);
+  }
+
   static size_t getExtraAllocationSize(unsigned numTables) {
     return 0;
   }
@@ -1945,6 +2023,10 @@ public:
     return comparePointers(instanceType, Data.InstanceType);
   }
 
+  static size_t getKeyHash(const Metadata *instanceType) {
+    return llvm::hash_value(instanceType);
+  }
+
   static size_t getExtraAllocationSize(const Metadata *key) {
     return 0;
   }
@@ -1953,11 +2035,12 @@ public:
 } // end anonymous namespace 
 
 /// The uniquing structure for existential metatype value witness tables.
-static ConcurrentMap<ExistentialMetatypeValueWitnessTableCacheEntry, false>
+static ConcurrentHashMap<ExistentialMetatypeValueWitnessTableCacheEntry, false>
 ExistentialMetatypeValueWitnessTables;
 
 /// The uniquing structure for existential metatype type metadata.
-static ConcurrentMap<ExistentialMetatypeCacheEntry, false> ExistentialMetatypes;
+static ConcurrentHashMap<ExistentialMetatypeCacheEntry, false>
+ExistentialMetatypes;
 
 static const ExtraInhabitantsValueWitnessTable
 ExistentialMetatypeValueWitnesses_1 =
@@ -2014,7 +2097,16 @@ ExistentialMetatypeValueWitnessTableCacheEntry(unsigned numWitnessTables) {
 SWIFT_RUNTIME_EXPORT
 extern "C" const ExistentialMetatypeMetadata *
 swift::swift_getExistentialMetatypeMetadata(const Metadata *instanceMetadata) {
-  return &ExistentialMetatypes.getOrInsert(instanceMetadata).first->Data;
+  if (auto metadata = _swift_findInCacheReplica(
+                  ReplicatedCache::ExistentialMetatypes, instanceMetadata,
+                  nullptr))
+    return static_cast<const ExistentialMetatypeMetadata *>(metadata);
+
+  const ExistentialMetatypeMetadata *metadata =
+    &ExistentialMetatypes.getOrInsert(instanceMetadata).first->Data;
+  _swift_fillCacheReplica(ReplicatedCache::ExistentialMetatypes,
+                          instanceMetadata, nullptr, metadata);
+  return metadata;
 }
 
 ExistentialMetatypeCacheEntry::ExistentialMetatypeCacheEntry(
@@ -2070,6 +2162,11 @@ public:
     return 0;
   }
 
+  static size_t getKeyHash(Key key) {
+    return llvm::hash_combine_range(key.Protocols,
+                                    key.Protocols + key.NumProtocols);
+  }
+
   static size_t getExtraAllocationSize(Key key) {
     return sizeof(const ProtocolDescriptor *) * key.NumProtocols;
   }
@@ -2094,6 +2191,10 @@ public:
     return compareIntegers(key, getNumWitnessTables());
   }
 
+  static size_t getKeyHash(unsigned key) {
+    return llvm::hash_value(key);
+  }
+
   static size_t getExtraAllocationSize(unsigned numTables) {
     return 0;
   }
@@ -2118,6 +2219,10 @@ public:
     return compareIntegers(key, getNumWitnessTables());
   }
 
+  static size_t getKeyHash(unsigned key) {
+    return llvm::hash_value(key);
+  }
+
   static size_t getExtraAllocationSize(unsigned numTables) {
     return 0;
   }
@@ -2126,7 +2231,7 @@ public:
 } // end anonymous namespace
 
 /// The uniquing structure for existential type metadata.
-static ConcurrentMap<ExistentialCacheEntry, false> ExistentialTypes;
+static ConcurrentHashMap<ExistentialCacheEntry, false> ExistentialTypes;
 
 static const ValueWitnessTable OpaqueExistentialValueWitnesses_0 =
   ValueWitnessTableForBox<OpaqueExistentialBox<0>>::table;
@@ -2134,7 +2239,7 @@ static const ValueWitnessTable OpaqueExistentialValueWitnesses_1 =
   ValueWitnessTableForBox<OpaqueExistentialBox<1>>::table;
 
 /// The uniquing structure for opaque existential value witness tables.
-static ConcurrentMap<OpaqueExistentialValueWitnessTableCacheEntry, false>
+static ConcurrentHashMap<OpaqueExistentialValueWitnessTableCacheEntry, false>
 OpaqueExistentialValueWitnessTables;
 
 /// Instantiate a value witness table for an opaque existential container with
@@ -2180,7 +2285,7 @@ static const ExtraInhabitantsValueWitnessTable ClassExistentialValueWitnesses_2
   ValueWitnessTableForBox<ClassExistentialBox<2>>::table;
 
 /// The uniquing structure for class existential value witness tables.
-static ConcurrentMap<ClassExistentialValueWitnessTableCacheEntry, false>
+static ConcurrentHashMap<ClassExistentialValueWitnessTableCacheEntry, false>
 ClassExistentialValueWitnessTables;
 
 /// Instantiate a value witness table for a class-constrained existential
@@ -2425,7 +2530,10 @@ swift::swift_getExistentialTypeMetadata(size_t numProtocols,
   std::sort(protocols, protocols + numProtocols);
 
   ExistentialCacheEntry::Key key = { numProtocols, protocols };
-  return &ExistentialTypes.getOrInsert(key).first->Data;
+  auto result = ExistentialTypes.getOrInsert(key);
+  if (result.second)
+    _swift_noteExistentialTypeMetadata(&result.first->Data);
+  return &result.first->Data;
 }
 
 ExistentialCacheEntry::ExistentialCacheEntry(Key key) {
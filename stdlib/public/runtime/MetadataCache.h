@@ -17,6 +17,7 @@
 #include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Metadata.h"
 #include "swift/Runtime/Mutex.h"
+#include "RuntimeStatistics.h"
 #include <condition_variable>
 #include <thread>
 
@@ -27,10 +28,9 @@
 namespace swift {
 
 /// A bump pointer for metadata allocations. Since metadata is (currently)
-/// never released, it does not support deallocation. This allocator by itself
-/// is not thread-safe; in concurrent uses, allocations must be guarded by
-/// a lock, such as the per-metadata-cache lock used to guard metadata
-/// instantiations. All allocations are pointer-aligned.
+/// never released, it does not support deallocation. Allocations are made
+/// with a compare-and-swap, so the allocator can be used from several
+/// threads at once. All allocations are pointer-aligned.
 class MetadataAllocator {
   /// Address of the next available space. The allocator grabs a page at a time,
   /// so the need for a new page can be determined by page alignment.
@@ -191,6 +191,20 @@ template <class ValueTy> class MetadataCache {
     Key(KeyDataRef data) : Hash(data.hash()), KeyData(data) {}
   };
 
+  /// The threads waiting for an entry to be initialized.  This is only
+  /// allocated when some thread actually has to wait, so that a thread
+  /// initializing one entry never wakes up threads waiting for another.
+  ///
+  /// It is deliberately never freed.  Entries are never removed from the
+  /// cache, so it lives as long as its entry does, and freeing it when the
+  /// last waiter leaves would mean counting waiters and keeping setValue
+  /// from notifying through it afterwards.  At most one is leaked for each
+  /// entry that a thread ever had to wait for.
+  struct EntryWaiters {
+    Mutex Lock;
+    ConditionVariable Queue;
+  };
+
   /// The layout of an entry in the concurrent map.
   class Entry {
     size_t Hash;
@@ -199,15 +213,18 @@ template <class ValueTy> class MetadataCache {
     /// Does this entry have a value, or is it currently undergoing
     /// initialization?
     ///
-    /// This (and the following field) is ever modified under the lock,
-    /// but it can be read from any thread, including while the lock
-    /// is held.
+    /// This (and the following field) is only modified by the thread
+    /// initializing the entry, but it can be read from any thread.
     std::atomic<bool> HasValue;
     union {
       ValueTy *Value;
       std::thread::id InitializingThread;
     };
 
+    /// The threads waiting for this entry to be initialized, or null if
+    /// no thread has had to wait for it yet.
+    std::atomic<EntryWaiters *> Waiters;
+
     const void **getKeyDataBuffer() {
       return reinterpret_cast<const void **>(this + 1);
     }
@@ -216,7 +233,8 @@ template <class ValueTy> class MetadataCache {
     }
   public:
     Entry(const Key &key)
-      : Hash(key.Hash), KeyLength(key.KeyData.size()), HasValue(false) {
+      : Hash(key.Hash), KeyLength(key.KeyData.size()), HasValue(false),
+        Waiters(nullptr) {
       InitializingThread = std::this_thread::get_id();
       memcpy(getKeyDataBuffer(), key.KeyData.begin(),
              KeyLength * sizeof(void*));
@@ -238,45 +256,103 @@ template <class ValueTy> class MetadataCache {
       return key.KeyData.size() * sizeof(void*);
     }
 
+    static size_t getKeyHash(const Key &key) {
+      return key.Hash;
+    }
+
     int compareWithKey(const Key &key) const {
-      // Order by hash first, then by the actual key data.
-      if (key.Hash != Hash) {
-        return (key.Hash < Hash ? -1 : 1);
-      } else {
-        return key.KeyData.compare(getKeyData());
-      }
+      // The hash map only needs to know whether the keys are equal, and it
+      // has already compared the hashes.
+      return key.KeyData.compare(getKeyData());
     }
 
-    ValueTy *getValue() const {
-      if (HasValue.load(std::memory_order_acquire)) {
+    ValueTy *getValue(std::memory_order order = std::memory_order_acquire)
+        const {
+      if (HasValue.load(order)) {
         return Value;
       }
       return nullptr;
     }
 
+    /// Set the value of the entry and wake up any threads waiting for it.
     void setValue(ValueTy *value) {
       Value = value;
-      HasValue.store(true, std::memory_order_release);
+
+      // This store and the load of Waiters are sequentially consistent,
+      // as are the exchange of Waiters and the load of HasValue in
+      // waitForValue, so either we see the waiters or they see the value.
+      HasValue.store(true, std::memory_order_seq_cst);
+      if (auto waiters = Waiters.load(std::memory_order_seq_cst))
+        waiters->Lock.withLockThenNotifyAll(waiters->Queue, [] {});
+    }
+
+    /// Wait for another thread to finish initializing the entry.
+    ValueTy *waitForValue(const void *cache) {
+      auto waiters = Waiters.load(std::memory_order_acquire);
+      if (!waiters) {
+        auto newWaiters = new EntryWaiters();
+        if (Waiters.compare_exchange_strong(waiters, newWaiters,
+                                            std::memory_order_seq_cst)) {
+          waiters = newWaiters;
+        } else {
+          delete newWaiters;
+        }
+      }
+
+      // Note that we have to check for the value again immediately after
+      // acquiring the lock to prevent a race.
+      ValueTy *value = nullptr;
+      waiters->Lock.withLockOrWait(waiters->Queue, [&] {
+        if ((value = getValue(std::memory_order_seq_cst))) {
+          return true; // found a value, done waiting
+        }
+
+        // As a QoI safe-guard against the simplest form of cyclic
+        // dependency, check whether this thread is the one responsible
+        // for initializing the metadata.
+        if (isBeingInitializedByCurrentThread()) {
+          fprintf(stderr,
+                  "%s(%p): cyclic metadata dependency detected, aborting\n",
+                  ValueTy::getName(), cache);
+          abort();
+        }
+
+        return false; // don't have a value, continue waiting
+      });
+
+      return value;
     }
   };
 
   /// The concurrent map.
-  ConcurrentMap<Entry> Map;
+  ConcurrentHashMap<Entry> Map;
 
-  static_assert(sizeof(Map) == 2 * sizeof(void*),
+  static_assert(sizeof(Map) == sizeof(void*),
                 "offset of Head is not at proper offset");
 
-  struct ConcurrencyControl {
-    Mutex Lock;
-    ConditionVariable Queue;
-  };
-  std::unique_ptr<ConcurrencyControl> Concurrency;
-
   /// Allocator for entries of this cache.
   MetadataAllocator Allocator;
-  
+
+  /// How many entries this cache has instantiated and how long that took,
+  /// while runtime statistics were enabled.
+  MetadataCacheStatistics Statistics;
+
+  void noteInstantiation(uint64_t nanoseconds) {
+    Statistics.Instantiations.fetch_add(1, std::memory_order_relaxed);
+    Statistics.InstantiationNanoseconds.fetch_add(nanoseconds,
+                                                  std::memory_order_relaxed);
+    if (Statistics.Owner &&
+        !Statistics.IsRegistered.load(std::memory_order_relaxed))
+      _swift_registerMetadataCacheStatistics(&Statistics);
+  }
+
 public:
-  MetadataCache() : Concurrency(new ConcurrencyControl()) {}
+  /// Create a cache.  If an owner is given, such as the generic metadata
+  /// pattern that the cache belongs to, the cache's instantiation
+  /// statistics are reported for that owner.
+  explicit MetadataCache(const void *owner = nullptr) {
+    Statistics.Owner = owner;
+  }
   ~MetadataCache() {}
 
   /// Caches are not copyable.
@@ -284,8 +360,8 @@ public:
   MetadataCache &operator=(const MetadataCache &other) = delete;
 
   /// Get the allocator for metadata in this cache.
-  /// The allocator can only be safely used while the cache is locked during
-  /// an addMetadataEntry call.
+  /// The allocator is thread-safe, so it can be used by builders running
+  /// concurrently for different entries.
   MetadataAllocator &getAllocator() { return Allocator; }
 
   /// Look up a cached metadata entry. If a cache match exists, return it.
@@ -322,44 +398,31 @@ public:
         return value;
       }
 
-      // Otherwise, we have to grab the lock and wait for the value to
-      // appear there.  Note that we have to check again immediately
-      // after acquiring the lock to prevent a race.
-      auto concurrency = Concurrency.get();
-      concurrency->Lock.withLockOrWait(concurrency->Queue, [&, this] {
-        if ((value = entry->getValue())) {
-          return true; // found a value, done waiting
-        }
-
-        // As a QoI safe-guard against the simplest form of cyclic
-        // dependency, check whether this thread is the one responsible
-        // for initializing the metadata.
-        if (entry->isBeingInitializedByCurrentThread()) {
-          fprintf(stderr,
-                  "%s(%p): cyclic metadata dependency detected, aborting\n",
-                  ValueTy::getName(), (void*) this);
-          abort();
-        }
-
-        return false; // don't have a value, continue waiting
-      });
-
-      return value;
+      // Otherwise, we have to wait for the thread that inserted the entry
+      // to initialize it.
+      if (LLVM_UNLIKELY(_swift_runtimeStatisticsEnabled()))
+        Statistics.Waits.fetch_add(1, std::memory_order_relaxed);
+      return entry->waitForValue(this);
     }
 
     // Otherwise, we created the entry and are responsible for
     // creating the metadata.
-    auto value = builder();
+    ValueTy *value;
+    if (LLVM_UNLIKELY(_swift_runtimeStatisticsEnabled())) {
+      uint64_t start = _swift_getRuntimeStatisticsTime();
+      value = builder();
+      noteInstantiation(_swift_getRuntimeStatisticsTime() - start);
+    } else {
+      value = builder();
+    }
 
 #if SWIFT_DEBUG_RUNTIME
         printf("%s(%p): created %p\n",
                ValueTy::getName(), (void*) this, value);
 #endif
 
-    // Acquire the lock, set the value, and notify any waiters.
-    auto concurrency = Concurrency.get();
-    concurrency->Lock.withLockThenNotifyAll(
-        concurrency->Queue, [&entry, &value] { entry->setValue(value); });
+    // Set the value and notify any waiters.
+    entry->setValue(value);
 
     return value;
   }
@@ -19,11 +19,11 @@
 #include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
-#include "swift/Runtime/Mutex.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/PointerIntPair.h"
 #include "llvm/ADT/StringExtras.h"
+#include "MangledNameIndex.h"
 #include "Private.h"
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -54,16 +54,6 @@ using namespace Demangle;
 // Type Metadata Cache.
 
 namespace {
-  struct TypeMetadataSection {
-    const TypeMetadataRecord *Begin, *End;
-    const TypeMetadataRecord *begin() const {
-      return Begin;
-    }
-    const TypeMetadataRecord *end() const {
-      return End;
-    }
-  };
-
   struct TypeMetadataCacheEntry {
   private:
     std::string Name;
@@ -104,11 +94,15 @@ static void _addImageTypeMetadataRecordsBlock(const uint8_t *records,
 
 struct TypeMetadataState {
   ConcurrentMap<TypeMetadataCacheEntry> Cache;
-  std::vector<TypeMetadataSection> SectionsToScan;
-  Mutex SectionsToScanLock;
+
+  /// The registered type metadata records, indexed by the mangled name of
+  /// the type they refer to.
+  MangledNameIndex<TypeMetadataRecord> NameIndex;
+
+  /// Records whose type can't be named without realizing its metadata.
+  ConcurrentList<const TypeMetadataRecord *> UnnamedRecords;
 
   TypeMetadataState() {
-    SectionsToScan.reserve(16);
 #if defined(__APPLE__) && defined(__MACH__)
     _initializeCallbacksToInspectDylib();
 #else
@@ -126,8 +120,12 @@ static void
 _registerTypeMetadataRecords(TypeMetadataState &T,
                              const TypeMetadataRecord *begin,
                              const TypeMetadataRecord *end) {
-  ScopedLock guard(T.SectionsToScanLock);
-  T.SectionsToScan.push_back(TypeMetadataSection{begin, end});
+  for (auto record = begin; record != end; ++record) {
+    if (auto ntd = _getRecordTypeDescriptor(*record))
+      T.NameIndex.getOrInsert(ntd->Name.get()).first->Records.push_back(record);
+    else
+      T.UnnamedRecords.push_back(record);
+  }
 }
 
 static void _addImageTypeMetadataRecordsBlock(const uint8_t *records,
@@ -228,26 +226,9 @@ swift::_matchMetadataByMangledTypeName(const llvm::StringRef typeName,
 
 // returns the type metadata for the type named by typeName
 static const Metadata *
-_searchTypeMetadataRecords(const TypeMetadataState &T,
+_searchTypeMetadataRecords(TypeMetadataState &T,
                            const llvm::StringRef typeName) {
-  unsigned sectionIdx = 0;
-  unsigned endSectionIdx = T.SectionsToScan.size();
-  const Metadata *foundMetadata = nullptr;
-
-  for (; sectionIdx < endSectionIdx; ++sectionIdx) {
-    auto &section = T.SectionsToScan[sectionIdx];
-    for (const auto &record : section) {
-      if (auto metadata = record.getCanonicalTypeMetadata())
-        foundMetadata = _matchMetadataByMangledTypeName(typeName, metadata, nullptr);
-      else if (auto ntd = record.getNominalTypeDescriptor())
-        foundMetadata = _matchMetadataByMangledTypeName(typeName, nullptr, ntd);
-
-      if (foundMetadata != nullptr)
-        return foundMetadata;
-    }
-  }
-
-  return nullptr;
+  return findMetadataByMangledName(T.NameIndex, T.UnnamedRecords, typeName);
 }
 
 static const Metadata *
@@ -261,9 +242,7 @@ _typeByMangledName(const llvm::StringRef typeName) {
     return Value->getMetadata();
 
   // Check type metadata records
-  T.SectionsToScanLock.withLock([&] {
-    foundMetadata = _searchTypeMetadataRecords(T, typeName);
-  });
+  foundMetadata = _searchTypeMetadataRecords(T, typeName);
 
   // Check protocol conformances table. Note that this has no support for
   // resolving generic types yet.
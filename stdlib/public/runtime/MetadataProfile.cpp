@@ -0,0 +1,1014 @@
+//===--- MetadataProfile.cpp - Recording and replaying metadata requests --===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// A metadata profile lists the generic metadata instantiations, tuple,
+// function and existential type metadata, and protocol conformances that a
+// process created.
+// A later run of the same binaries can replay the profile on a background
+// thread at startup, so that the first requests for those entities find them
+// already in the runtime caches.
+//
+// Set SWIFT_METADATA_PROFILE_OUTPUT to a path, or call
+// swift_recordMetadataProfile, to record a profile.  Set
+// SWIFT_METADATA_PROFILE to a path, or call swift_prewarmMetadata, to replay
+// one.
+//
+// Static runtime data such as generic metadata patterns and protocol
+// descriptors is identified by its offset within a loaded image, and images
+// are identified by their GNU build ID.  A profile therefore only applies to
+// the exact binaries it was recorded with; records that refer to any other
+// image are skipped.
+//
+// A profile is a text file with one record per line:
+//
+//   image <image#> <build-id> <path>
+//   type <ref#> <static>
+//   generic <ref#> <static> <argument>...
+//   tuple <ref#> <labels> <ref>...
+//   function <ref#> <flags> <ref> <ref>...
+//   existential <ref#> <static>...
+//   conformance <ref> <static>
+//
+// A <static> is "<image#>+<hex offset>".  A <ref> is "@<ref#>", naming the
+// metadata produced by an earlier record, with a "!" suffix for an inout
+// function argument.  A generic metadata <argument> is either.  In tuple
+// labels, '/' stands for a space, "-" means there are no labels, and "."
+// stands for an empty labels string.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/Mutex.h"
+#include "swift/Runtime/Once.h"
+#include "Private.h"
+
+#if defined(__ELF__)
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <link.h>
+#include <string>
+#include <thread>
+#include <vector>
+#endif
+
+using namespace swift;
+
+#if defined(__ELF__)
+
+namespace {
+
+/// A loaded image, as found by dl_iterate_phdr.
+struct LoadedImage {
+  /// The path the image was loaded from; empty for the main executable.
+  std::string Path;
+
+  /// The GNU build ID of the image in hex, or empty if it has none.
+  std::string BuildID;
+
+  /// The difference between addresses in the image and in memory.
+  uintptr_t Bias;
+};
+
+} // end anonymous namespace
+
+/// Return the GNU build ID of a loaded image in hex.
+static std::string getBuildID(const dl_phdr_info *info) {
+  for (unsigned i = 0; i != info->dlpi_phnum; ++i) {
+    const auto &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE)
+      continue;
+
+    auto notes = reinterpret_cast<const char *>(info->dlpi_addr + phdr.p_vaddr);
+    size_t offset = 0;
+    while (offset + sizeof(ElfW(Nhdr)) <= phdr.p_memsz) {
+      auto note = reinterpret_cast<const ElfW(Nhdr) *>(notes + offset);
+      size_t nameOffset = offset + sizeof(ElfW(Nhdr));
+      size_t descOffset = nameOffset + ((note->n_namesz + 3) & ~3);
+      offset = descOffset + ((note->n_descsz + 3) & ~3);
+      if (offset > phdr.p_memsz)
+        break;
+
+      if (note->n_type != NT_GNU_BUILD_ID || note->n_namesz != 4 ||
+          memcmp(notes + nameOffset, "GNU", 4) != 0)
+        continue;
+
+      std::string result;
+      auto desc = reinterpret_cast<const unsigned char *>(notes + descOffset);
+      for (unsigned j = 0; j != note->n_descsz; ++j) {
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", desc[j]);
+        result += hex;
+      }
+      return result;
+    }
+  }
+  return std::string();
+}
+
+static LoadedImage makeLoadedImage(const dl_phdr_info *info) {
+  return LoadedImage{info->dlpi_name ? info->dlpi_name : "",
+                     getBuildID(info),
+                     static_cast<uintptr_t>(info->dlpi_addr)};
+}
+
+namespace {
+
+/// The address ranges of the loaded images, so that the image containing
+/// an address can usually be found without asking the dynamic linker.
+/// Safe to use from any thread.
+class LoadedImageMap {
+  struct Segment {
+    uintptr_t Start;
+    uintptr_t End;
+    unsigned Image;
+
+    bool operator<(const Segment &other) const { return Start < other.Start; }
+  };
+
+  /// Protects everything below.  The dynamic linker is only asked for the
+  /// loaded images while it isn't held.
+  Mutex Lock;
+
+  /// Every image a scan has found.  Images are never removed, so pointers
+  /// to them stay valid.
+  std::deque<LoadedImage> Images;
+
+  /// The loadable segments of the images found by the last scan, sorted by
+  /// address.
+  std::vector<Segment> Segments;
+
+  /// Addresses that weren't in any image the last time they were looked up.
+  /// Addresses of images that are loaded later can't be among them.
+  llvm::DenseSet<uintptr_t> Unmapped;
+
+  /// Called with the lock held.
+  const LoadedImage *lookup(uintptr_t address) const {
+    auto next = std::upper_bound(Segments.begin(), Segments.end(),
+                                 Segment{address, 0, 0});
+    if (next == Segments.begin())
+      return nullptr;
+    auto &segment = *(next - 1);
+    if (address >= segment.End)
+      return nullptr;
+    return &Images[segment.Image];
+  }
+
+  /// Replace the segments with those found by a scan, adding the images
+  /// that haven't been seen before.  Called with the lock held.
+  void update(const std::vector<LoadedImage> &images,
+              std::vector<Segment> &segments) {
+    std::vector<unsigned> numbers;
+    for (const auto &image : images) {
+      auto existing = std::find_if(Images.begin(), Images.end(),
+                                   [&](const LoadedImage &other) {
+        return other.Bias == image.Bias && other.Path == image.Path &&
+               other.BuildID == image.BuildID;
+      });
+      numbers.push_back(existing - Images.begin());
+      if (existing == Images.end())
+        Images.push_back(image);
+    }
+    for (auto &segment : segments)
+      segment.Image = numbers[segment.Image];
+    std::sort(segments.begin(), segments.end());
+    Segments = std::move(segments);
+  }
+
+public:
+  /// Find the loaded image that contains the given address, or return null.
+  const LoadedImage *find(const void *address) {
+    auto bits = reinterpret_cast<uintptr_t>(address);
+    const LoadedImage *image = nullptr;
+    bool unmapped = false;
+    Lock.withLock([&] {
+      image = lookup(bits);
+      unmapped = !image && Unmapped.count(bits);
+    });
+    if (image || unmapped)
+      return image;
+
+    // The image may have been loaded since the last scan.
+    struct ScanResult {
+      std::vector<LoadedImage> Images;
+      std::vector<Segment> Segments;
+    } scan;
+    dl_iterate_phdr([](dl_phdr_info *info, size_t size, void *data) -> int {
+      auto &scan = *static_cast<ScanResult *>(data);
+      unsigned image = scan.Images.size();
+      scan.Images.push_back(makeLoadedImage(info));
+      for (unsigned i = 0; i != info->dlpi_phnum; ++i) {
+        const auto &phdr = info->dlpi_phdr[i];
+        if (phdr.p_type != PT_LOAD)
+          continue;
+        uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+        scan.Segments.push_back({start, start + phdr.p_memsz, image});
+      }
+      return 0;
+    }, &scan);
+
+    Lock.withLock([&] {
+      update(scan.Images, scan.Segments);
+      image = lookup(bits);
+      if (!image)
+        Unmapped.insert(bits);
+    });
+    return image;
+  }
+};
+
+} // end anonymous namespace
+
+/*****************************************************************************/
+/********************************* Recording *********************************/
+/*****************************************************************************/
+
+namespace {
+
+/// A profile record, along with the image and type records it depends on
+/// that haven't been written yet.  The recorder numbers them with its lock
+/// held, and formats and writes them after releasing it.
+struct PendingRecord {
+  struct Static {
+    unsigned Image;
+    uintptr_t Offset;
+  };
+
+  struct NewImage {
+    unsigned Number;
+    const LoadedImage *Image;
+  };
+
+  struct NewType {
+    unsigned Ref;
+    Static Address;
+  };
+
+  struct Operand {
+    bool IsRef;
+    unsigned Ref;
+    Static Address;
+    bool IsInOut;
+  };
+
+  std::vector<NewImage> NewImages;
+  std::vector<NewType> NewTypes;
+
+  /// The kind of the record, or null if only the records it depends on are
+  /// to be written.
+  const char *Kind = nullptr;
+
+  /// Whether the record produces metadata, and the number of its result.
+  bool HasRef = false;
+  unsigned Ref = 0;
+
+  /// Text that comes before the operands, such as tuple labels.
+  std::string Prefix;
+
+  std::vector<Operand> Operands;
+
+  static void appendStatic(Static address, std::string &text) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%u+%" PRIxPTR, address.Image,
+             address.Offset);
+    text += buffer;
+  }
+
+  std::string format() const {
+    std::string text;
+    for (const auto &image : NewImages) {
+      text += "image ";
+      text += std::to_string(image.Number);
+      text += ' ';
+      text += image.Image->BuildID;
+      text += ' ';
+      text += image.Image->Path.empty() ? "-" : image.Image->Path;
+      text += '\n';
+    }
+
+    for (const auto &type : NewTypes) {
+      text += "type ";
+      text += std::to_string(type.Ref);
+      text += ' ';
+      appendStatic(type.Address, text);
+      text += '\n';
+    }
+
+    if (!Kind)
+      return text;
+    text += Kind;
+    if (HasRef) {
+      text += ' ';
+      text += std::to_string(Ref);
+    }
+    if (!Prefix.empty()) {
+      text += ' ';
+      text += Prefix;
+    }
+    for (const auto &operand : Operands) {
+      text += ' ';
+      if (operand.IsRef) {
+        text += '@';
+        text += std::to_string(operand.Ref);
+      } else {
+        appendStatic(operand.Address, text);
+      }
+      if (operand.IsInOut)
+        text += '!';
+    }
+    text += '\n';
+    return text;
+  }
+};
+
+/// Writes a metadata profile as the process creates metadata.
+///
+/// Records refer to the images and records before them, so they have to be
+/// written in the order they are numbered.  Each batch of records takes a
+/// ticket when it is numbered, and batches are written in ticket order
+/// under a separate lock, so that threads numbering new records never wait
+/// for the file.
+class MetadataProfileRecorder {
+  /// Protects the output, the numbering of images and records, and the
+  /// ticket counter.
+  Mutex Lock;
+
+  /// The profile being written, or null if recording has stopped.
+  FILE *Output = nullptr;
+
+  /// Whether a profile is being written.  Checked without the lock so that
+  /// the images of a record's addresses aren't looked up for nothing.
+  std::atomic<bool> IsRecording{false};
+
+  /// The image number of each image seen so far.
+  llvm::DenseMap<const LoadedImage *, unsigned> Images;
+
+  /// The record number of each piece of metadata recorded so far.
+  llvm::DenseMap<const void *, unsigned> Refs;
+
+  unsigned NextRef = 0;
+
+  /// The ticket of the next batch of records to be numbered.
+  uint64_t NextTicket = 0;
+
+  /// Serializes writing to the output.
+  Mutex OutputLock;
+  ConditionVariable OutputTurn;
+
+  /// The ticket of the next batch of records to be written.
+  uint64_t NextTicketToWrite = 0;
+
+  /// The images loaded in the process.
+  LoadedImageMap LoadedImages;
+
+  /// Find the image containing a static address, or return null if it isn't
+  /// in an image a profile can refer to.  Called without the lock, since it
+  /// may ask the dynamic linker.
+  const LoadedImage *findImage(const void *address) {
+    const LoadedImage *image = LoadedImages.find(address);
+    if (!image || image->BuildID.empty())
+      return nullptr;
+    return image;
+  }
+
+  /// Describe a static address as "<image#>+<offset>", numbering its image
+  /// if necessary.  Called with the lock held.
+  PendingRecord::Static describeStatic(const void *address,
+                                       const LoadedImage *image,
+                                       PendingRecord &record) {
+    auto found = Images.find(image);
+    unsigned imageNumber;
+    if (found != Images.end()) {
+      imageNumber = found->second;
+    } else {
+      imageNumber = Images.size();
+      Images.insert({image, imageNumber});
+      record.NewImages.push_back({imageNumber, image});
+    }
+    return {imageNumber, reinterpret_cast<uintptr_t>(address) - image->Bias};
+  }
+
+  /// Add an operand for a static address.  Called with the lock held.
+  bool addStatic(const void *address, const LoadedImage *image,
+                 PendingRecord &record) {
+    if (!image)
+      return false;
+    record.Operands.push_back(
+      {false, 0, describeStatic(address, image, record), false});
+    return true;
+  }
+
+  /// Add an operand referring to the record that produces a piece of type
+  /// metadata, adding a type record for static metadata if necessary.
+  /// Called with the lock held.
+  bool addMetadata(const Metadata *type, const LoadedImage *image,
+                   PendingRecord &record, bool isInOut = false) {
+    unsigned ref;
+    auto found = Refs.find(type);
+    if (found != Refs.end()) {
+      ref = found->second;
+    } else {
+      if (!image)
+        return false;
+      auto address = describeStatic(type, image, record);
+      ref = NextRef++;
+      Refs.insert({type, ref});
+      record.NewTypes.push_back({ref, address});
+    }
+    record.Operands.push_back({true, ref, {0, 0}, isInOut});
+    return true;
+  }
+
+  /// Add an operand for a generic argument, which may be metadata or a
+  /// witness table.  Called with the lock held.
+  bool addGenericArgument(const void *argument, const LoadedImage *image,
+                          PendingRecord &record) {
+    auto found = Refs.find(argument);
+    if (found != Refs.end()) {
+      record.Operands.push_back({true, found->second, {0, 0}, false});
+      return true;
+    }
+    return addStatic(argument, image, record);
+  }
+
+  /// Number the record as producing the given metadata.  Called with the
+  /// lock held.
+  void produce(const char *kind, const void *metadata, PendingRecord &record) {
+    record.Kind = kind;
+    record.HasRef = true;
+    record.Ref = NextRef++;
+    Refs.insert({metadata, record.Ref});
+  }
+
+  /// Run a function once every batch with an earlier ticket has been
+  /// written.  Called without the lock.
+  template <typename Fn>
+  void inTurn(uint64_t ticket, Fn fn) {
+    OutputLock.withLockOrWait(OutputTurn, [&] {
+      if (NextTicketToWrite != ticket)
+        return false;
+      fn();
+      ++NextTicketToWrite;
+      return true;
+    });
+    OutputTurn.notifyAll();
+  }
+
+  /// Number a record by calling describe with the lock held, then format
+  /// and write it without the lock.  If describe fails, only the records it
+  /// depends on are written.
+  template <typename Describe>
+  void record(Describe describe) {
+    PendingRecord record;
+    FILE *output = nullptr;
+    uint64_t ticket = 0;
+    Lock.withLock([&] {
+      output = Output;
+      if (!output)
+        return;
+      ticket = NextTicket++;
+      if (!describe(record))
+        record.Kind = nullptr;
+    });
+    if (!output)
+      return;
+
+    std::string text = record.format();
+    inTurn(ticket, [&] {
+      if (!text.empty())
+        fputs(text.c_str(), output);
+    });
+  }
+
+public:
+  /// Start writing a new profile, closing the current one.  Records in the
+  /// new profile only refer to each other, so everything is forgotten.
+  ///
+  /// The profile is written through a large buffer, which is flushed when
+  /// it is closed or when the process exits.
+  void setOutput(FILE *output) {
+    FILE *previous = nullptr;
+    uint64_t ticket = 0;
+    Lock.withLock([&] {
+      previous = Output;
+      Output = output;
+      IsRecording.store(output != nullptr, std::memory_order_relaxed);
+      Images.clear();
+      Refs.clear();
+      NextRef = 0;
+      ticket = NextTicket++;
+    });
+
+    // Records numbered for the previous profile may still be on their way
+    // to it.
+    inTurn(ticket, [&] {
+      if (previous)
+        fclose(previous);
+      if (output)
+        setvbuf(output, nullptr, _IOFBF, 64 * 1024);
+    });
+  }
+
+  void recordGenericMetadata(const GenericMetadata *pattern,
+                             const void * const *arguments,
+                             const Metadata *metadata) {
+    if (!IsRecording.load(std::memory_order_relaxed))
+      return;
+    auto patternImage = findImage(pattern);
+    if (!patternImage)
+      return;
+    std::vector<const LoadedImage *> argumentImages;
+    for (unsigned i = 0, e = pattern->NumKeyArguments; i != e; ++i)
+      argumentImages.push_back(findImage(arguments[i]));
+
+    record([&](PendingRecord &record) {
+      if (!addStatic(pattern, patternImage, record))
+        return false;
+      for (unsigned i = 0, e = argumentImages.size(); i != e; ++i) {
+        if (!addGenericArgument(arguments[i], argumentImages[i], record))
+          return false;
+      }
+      produce("generic", metadata, record);
+      return true;
+    });
+  }
+
+  void recordTupleTypeMetadata(const TupleTypeMetadata *metadata) {
+    if (!IsRecording.load(std::memory_order_relaxed))
+      return;
+    std::string labels;
+    if (const char *label = metadata->Labels) {
+      for (; *label; ++label)
+        labels += (*label == ' ' ? '/' : *label);
+      if (labels.empty())
+        labels = ".";
+    } else {
+      labels = "-";
+    }
+    std::vector<const LoadedImage *> elementImages;
+    for (unsigned i = 0, e = metadata->NumElements; i != e; ++i)
+      elementImages.push_back(findImage(metadata->getElement(i).Type));
+
+    record([&](PendingRecord &record) {
+      record.Prefix = labels;
+      for (unsigned i = 0, e = elementImages.size(); i != e; ++i) {
+        if (!addMetadata(metadata->getElement(i).Type, elementImages[i],
+                         record))
+          return false;
+      }
+      produce("tuple", metadata, record);
+      return true;
+    });
+  }
+
+  void recordFunctionTypeMetadata(const FunctionTypeMetadata *metadata) {
+    if (!IsRecording.load(std::memory_order_relaxed))
+      return;
+    char flags[32];
+    snprintf(flags, sizeof(flags), "%zx",
+             size_t(metadata->Flags.getIntValue()));
+    auto resultImage = findImage(metadata->ResultType);
+    std::vector<const LoadedImage *> argumentImages;
+    for (unsigned i = 0, e = metadata->getNumArguments(); i != e; ++i)
+      argumentImages.push_back(
+        findImage(metadata->getArguments()[i].getPointer()));
+
+    record([&](PendingRecord &record) {
+      record.Prefix = flags;
+      if (!addMetadata(metadata->ResultType, resultImage, record))
+        return false;
+      for (unsigned i = 0, e = argumentImages.size(); i != e; ++i) {
+        auto argument = metadata->getArguments()[i];
+        if (!addMetadata(argument.getPointer(), argumentImages[i], record,
+                         argument.getFlag()))
+          return false;
+      }
+      produce("function", metadata, record);
+      return true;
+    });
+  }
+
+  void recordExistentialTypeMetadata(const ExistentialTypeMetadata *metadata) {
+    if (!IsRecording.load(std::memory_order_relaxed))
+      return;
+    std::vector<const LoadedImage *> protocolImages;
+    for (unsigned i = 0, e = metadata->Protocols.NumProtocols; i != e; ++i)
+      protocolImages.push_back(findImage(metadata->Protocols[i]));
+
+    record([&](PendingRecord &record) {
+      for (unsigned i = 0, e = protocolImages.size(); i != e; ++i) {
+        if (!addStatic(metadata->Protocols[i], protocolImages[i], record))
+          return false;
+      }
+      produce("existential", metadata, record);
+      return true;
+    });
+  }
+
+  void recordConformance(const Metadata *type,
+                         const ProtocolDescriptor *protocol) {
+    if (!IsRecording.load(std::memory_order_relaxed))
+      return;
+    auto typeImage = findImage(type);
+    auto protocolImage = findImage(protocol);
+
+    record([&](PendingRecord &record) {
+      if (!addMetadata(type, typeImage, record) ||
+          !addStatic(protocol, protocolImage, record))
+        return false;
+      record.Kind = "conformance";
+      return true;
+    });
+  }
+};
+
+} // end anonymous namespace
+
+/*****************************************************************************/
+/********************************** Replay ***********************************/
+/*****************************************************************************/
+
+namespace {
+
+/// Instantiates everything listed in a metadata profile.
+class MetadataProfileReplayer {
+  /// Every image loaded when replay started.
+  std::vector<LoadedImage> LoadedImages;
+
+  /// The loaded image for each image in the profile, or null for images
+  /// that aren't loaded or don't match the profile.
+  std::vector<const LoadedImage *> Images;
+
+  /// The metadata produced by each record, or null if it was skipped.
+  std::vector<const void *> Refs;
+
+  /// Called with the metadata produced by each record.
+  void (*Callback)(const void *metadata, void *context);
+  void *Context;
+
+  const void *resolveStatic(const char *token) {
+    char *end;
+    unsigned long imageNumber = strtoul(token, &end, 10);
+    if (*end != '+' || imageNumber >= Images.size() || !Images[imageNumber])
+      return nullptr;
+    uintptr_t offset = strtoull(end + 1, &end, 16);
+    if (*end != '\0')
+      return nullptr;
+    return reinterpret_cast<const void *>(Images[imageNumber]->Bias + offset);
+  }
+
+  const void *resolve(const char *token) {
+    if (token[0] != '@')
+      return resolveStatic(token);
+    unsigned long ref = strtoul(token + 1, nullptr, 10);
+    return ref < Refs.size() ? Refs[ref] : nullptr;
+  }
+
+  const Metadata *resolveMetadata(const char *token) {
+    if (token[0] != '@')
+      return nullptr;
+    return static_cast<const Metadata *>(resolve(token));
+  }
+
+  void define(const char *refToken, const void *value) {
+    unsigned long ref = strtoul(refToken, nullptr, 10);
+    if (ref >= Refs.size())
+      Refs.resize(ref + 1);
+    Refs[ref] = value;
+    if (Callback && value)
+      Callback(value, Context);
+  }
+
+  void addImage(unsigned long imageNumber, const char *buildID,
+                const char *path) {
+    if (imageNumber >= Images.size())
+      Images.resize(imageNumber + 1);
+    if (strcmp(path, "-") == 0)
+      path = "";
+    for (const auto &image : LoadedImages) {
+      if (image.Path == path && image.BuildID == buildID) {
+        Images[imageNumber] = &image;
+        return;
+      }
+    }
+  }
+
+  /// Non-generic type metadata may need to be initialized by its accessor
+  /// before it can be used.
+  static const Metadata *getInitializedMetadata(const Metadata *type) {
+    if (auto description = type->getNominalTypeDescriptor().get()) {
+      if (!description->GenericParams.isGeneric())
+        if (auto accessor = description->getAccessFunction())
+          return accessor();
+    }
+    return type;
+  }
+
+  void replayRecord(char *line) {
+    std::vector<const char *> tokens;
+    char *state;
+    for (char *token = strtok_r(line, " \n", &state); token;
+         token = strtok_r(nullptr, " \n", &state))
+      tokens.push_back(token);
+    if (tokens.empty())
+      return;
+
+    const char *kind = tokens[0];
+    if (strcmp(kind, "image") == 0) {
+      if (tokens.size() == 4)
+        addImage(strtoul(tokens[1], nullptr, 10), tokens[2], tokens[3]);
+      return;
+    }
+
+    if (strcmp(kind, "conformance") == 0) {
+      if (tokens.size() != 3)
+        return;
+      auto type = resolveMetadata(tokens[1]);
+      auto protocol =
+        static_cast<const ProtocolDescriptor *>(resolveStatic(tokens[2]));
+      if (type && protocol)
+        swift_conformsToProtocol(type, protocol);
+      return;
+    }
+
+    if (tokens.size() < 2)
+      return;
+    const char *ref = tokens[1];
+
+    if (strcmp(kind, "existential") == 0) {
+      std::vector<const ProtocolDescriptor *> protocols;
+      for (size_t i = 2; i != tokens.size(); ++i) {
+        auto protocol =
+          static_cast<const ProtocolDescriptor *>(resolveStatic(tokens[i]));
+        if (!protocol)
+          return;
+        protocols.push_back(protocol);
+      }
+      define(ref, swift_getExistentialTypeMetadata(protocols.size(),
+                                                   protocols.data()));
+      return;
+    }
+
+    if (tokens.size() < 3)
+      return;
+
+    if (strcmp(kind, "type") == 0) {
+      if (auto type = static_cast<const Metadata *>(resolveStatic(tokens[2])))
+        define(ref, getInitializedMetadata(type));
+      return;
+    }
+
+    if (strcmp(kind, "generic") == 0) {
+      auto pattern = const_cast<GenericMetadata *>(
+        static_cast<const GenericMetadata *>(resolveStatic(tokens[2])));
+      if (!pattern || tokens.size() - 3 != pattern->NumKeyArguments)
+        return;
+      std::vector<const void *> arguments;
+      for (size_t i = 3; i != tokens.size(); ++i) {
+        auto argument = resolve(tokens[i]);
+        if (!argument)
+          return;
+        arguments.push_back(argument);
+      }
+      define(ref, swift_getGenericMetadata(pattern, arguments.data()));
+      return;
+    }
+
+    if (strcmp(kind, "tuple") == 0) {
+      std::vector<const Metadata *> elements;
+      for (size_t i = 3; i != tokens.size(); ++i) {
+        auto element = resolveMetadata(tokens[i]);
+        if (!element)
+          return;
+        elements.push_back(element);
+      }
+
+      // Tuple metadata keeps the labels string, so it must live forever
+      // unless the tuple type already existed.
+      char *labels = nullptr;
+      if (strcmp(tokens[2], ".") == 0) {
+        labels = strdup("");
+      } else if (strcmp(tokens[2], "-") != 0) {
+        labels = strdup(tokens[2]);
+        for (char *c = labels; *c; ++c)
+          if (*c == '/')
+            *c = ' ';
+      }
+      auto tuple = swift_getTupleTypeMetadata(elements.size(), elements.data(),
+                                              labels, nullptr);
+      if (tuple->Labels != labels)
+        free(labels);
+      define(ref, tuple);
+      return;
+    }
+
+    if (strcmp(kind, "function") == 0) {
+      if (tokens.size() < 4)
+        return;
+      auto flags = FunctionTypeFlags::fromIntValue(
+                                            strtoull(tokens[2], nullptr, 16));
+      if (tokens.size() - 4 != flags.getNumArguments())
+        return;
+
+      std::vector<const void *> flagsArgsAndResult;
+      flagsArgsAndResult.push_back(
+        reinterpret_cast<const void *>(flags.getIntValue()));
+      for (size_t i = 4; i != tokens.size(); ++i) {
+        auto argument = resolveMetadata(tokens[i]);
+        if (!argument)
+          return;
+        bool isInOut = tokens[i][strlen(tokens[i]) - 1] == '!';
+        flagsArgsAndResult.push_back(
+          FunctionTypeMetadata::Argument(argument, isInOut).getOpaqueValue());
+      }
+      auto result = resolveMetadata(tokens[3]);
+      if (!result)
+        return;
+      flagsArgsAndResult.push_back(result);
+      define(ref, swift_getFunctionTypeMetadata(flagsArgsAndResult.data()));
+      return;
+    }
+  }
+
+public:
+  MetadataProfileReplayer(void (*callback)(const void *metadata,
+                                           void *context),
+                          void *context)
+    : Callback(callback), Context(context) {
+    dl_iterate_phdr([](dl_phdr_info *info, size_t size, void *data) -> int {
+      auto &images = *static_cast<std::vector<LoadedImage> *>(data);
+      images.push_back(makeLoadedImage(info));
+      return 0;
+    }, &LoadedImages);
+  }
+
+  void replay(FILE *input) {
+    char *line = nullptr;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, input) != -1)
+      replayRecord(line);
+    free(line);
+  }
+};
+
+} // end anonymous namespace
+
+static void replayMetadataProfile(FILE *input) {
+  MetadataProfileReplayer(nullptr, nullptr).replay(input);
+  fclose(input);
+}
+
+/*****************************************************************************/
+/****************************** Entry points *********************************/
+/*****************************************************************************/
+
+/// The recorder, or null if no profile has ever been recorded.  Once
+/// created, it is never destroyed, because other threads may be recording
+/// through it.
+static std::atomic<MetadataProfileRecorder *> Recorder;
+static swift_once_t MetadataProfilingOnce;
+static StaticMutex RecorderCreationLock;
+
+static void setMetadataProfileOutput(FILE *output) {
+  auto recorder = Recorder.load(std::memory_order_acquire);
+  if (!recorder) {
+    if (!output)
+      return;
+    RecorderCreationLock.withLock([&] {
+      recorder = Recorder.load(std::memory_order_relaxed);
+      if (!recorder) {
+        recorder = new MetadataProfileRecorder();
+        Recorder.store(recorder, std::memory_order_release);
+      }
+    });
+  }
+  recorder->setOutput(output);
+}
+
+std::atomic<bool> swift::_swift_metadataProfilingStarted(false);
+
+static void initializeMetadataProfiling(void *) {
+  _swift_metadataProfilingStarted.store(true, std::memory_order_relaxed);
+
+  if (const char *path = getenv("SWIFT_METADATA_PROFILE_OUTPUT")) {
+    if (FILE *output = fopen(path, "w"))
+      setMetadataProfileOutput(output);
+  }
+
+  if (const char *path = getenv("SWIFT_METADATA_PROFILE"))
+    swift_prewarmMetadata(path);
+}
+
+static MetadataProfileRecorder *getRecorder() {
+  swift_once(&MetadataProfilingOnce, initializeMetadataProfiling);
+  return Recorder.load(std::memory_order_acquire);
+}
+
+void swift::_swift_startMetadataProfilingSlow() {
+  swift_once(&MetadataProfilingOnce, initializeMetadataProfiling);
+}
+
+void swift::swift_recordMetadataProfile(const char *profilePath) {
+  // Let the environment variables take effect first, so that they don't
+  // replace this profile later.
+  getRecorder();
+
+  FILE *output = nullptr;
+  if (profilePath && !(output = fopen(profilePath, "w")))
+    return;
+  setMetadataProfileOutput(output);
+}
+
+void swift::swift_prewarmMetadata(const char *profilePath) {
+  // Open the profile now, so that the caller may delete it after we return.
+  FILE *input = fopen(profilePath, "r");
+  if (!input)
+    return;
+  std::thread(replayMetadataProfile, input).detach();
+}
+
+void swift::swift_replayMetadataProfile(const char *profilePath,
+                                        void (*callback)(const void *metadata,
+                                                         void *context),
+                                        void *context) {
+  FILE *input = fopen(profilePath, "r");
+  if (!input)
+    return;
+  MetadataProfileReplayer(callback, context).replay(input);
+  fclose(input);
+}
+
+void swift::_swift_noteGenericMetadata(const GenericMetadata *pattern,
+                                       const void * const *arguments,
+                                       const Metadata *metadata) {
+  if (auto recorder = getRecorder())
+    recorder->recordGenericMetadata(pattern, arguments, metadata);
+}
+
+void swift::_swift_noteTupleTypeMetadata(const TupleTypeMetadata *metadata) {
+  if (auto recorder = getRecorder())
+    recorder->recordTupleTypeMetadata(metadata);
+}
+
+void
+swift::_swift_noteFunctionTypeMetadata(const FunctionTypeMetadata *metadata) {
+  if (auto recorder = getRecorder())
+    recorder->recordFunctionTypeMetadata(metadata);
+}
+
+void swift::_swift_noteExistentialTypeMetadata(
+                                    const ExistentialTypeMetadata *metadata) {
+  if (auto recorder = getRecorder())
+    recorder->recordExistentialTypeMetadata(metadata);
+}
+
+void swift::_swift_noteConformance(const Metadata *type,
+                                   const ProtocolDescriptor *protocol) {
+  if (auto recorder = getRecorder())
+    recorder->recordConformance(type, protocol);
+}
+
+#else // !defined(__ELF__)
+
+// Metadata profiles are only supported for ELF images.
+
+void swift::swift_recordMetadataProfile(const char *profilePath) {}
+
+void swift::swift_prewarmMetadata(const char *profilePath) {}
+
+void swift::swift_replayMetadataProfile(const char *profilePath,
+                                        void (*callback)(const void *metadata,
+                                                         void *context),
+                                        void *context) {}
+
+void swift::_swift_noteGenericMetadata(const GenericMetadata *pattern,
+                                       const void * const *arguments,
+                                       const Metadata *metadata) {}
+
+void swift::_swift_noteTupleTypeMetadata(const TupleTypeMetadata *metadata) {}
+
+void
+swift::_swift_noteFunctionTypeMetadata(const FunctionTypeMetadata *metadata) {}
+
+void swift::_swift_noteExistentialTypeMetadata(
+                                    const ExistentialTypeMetadata *metadata) {}
+
+void swift::_swift_noteConformance(const Metadata *type,
+                                   const ProtocolDescriptor *protocol) {}
+
+#endif
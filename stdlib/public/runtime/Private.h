@@ -21,6 +21,7 @@
 #include "swift/Runtime/Config.h"
 #include "swift/Runtime/Metadata.h"
 #include "llvm/Support/Compiler.h"
+#include <atomic>
 
 // Opaque ISAs need to use object_getClass which is in runtime.h
 #if SWIFT_HAS_OPAQUE_ISAS
@@ -156,8 +157,75 @@ namespace swift {
   const Metadata *
   _searchConformancesByMangledTypeName(const llvm::StringRef typeName);
 
+  /// Return the nominal type descriptor of the type a type metadata or
+  /// protocol conformance record refers to, or null if it can't be found
+  /// yet.
+  ///
+  /// This runs while images are being registered, so it must not call back
+  /// into the runtime to instantiate or realize metadata.
+  template <class RecordTy>
+  const NominalTypeDescriptor *
+  _getRecordTypeDescriptor(const RecordTy &record) {
+    switch (record.getTypeKind()) {
+    case TypeMetadataRecordKind::UniqueDirectType:
+    case TypeMetadataRecordKind::NonuniqueDirectType:
+      if (auto metadata = record.getDirectType())
+        return metadata->getNominalTypeDescriptor().get();
+      return nullptr;
+
+    case TypeMetadataRecordKind::UniqueDirectClass:
+      // Only native Swift classes have a nominal type descriptor; the
+      // accessor checks for that without realizing an ObjC class.
+      if (auto classMetadata = record.getDirectClass())
+        return classMetadata->getNominalTypeDescriptor().get();
+      return nullptr;
+
+    case TypeMetadataRecordKind::UniqueNominalTypeDescriptor:
+      return record.getNominalTypeDescriptor();
+
+    case TypeMetadataRecordKind::UniqueIndirectClass:
+      // The class reference may not be bound yet, or may be weak-linked.
+    case TypeMetadataRecordKind::Universal:
+      return nullptr;
+    }
+  }
+
+  /// Record newly-created metadata, or a newly-found conformance, in the
+  /// metadata profile if one is being recorded.  See MetadataProfile.cpp.
+  void _swift_noteGenericMetadata(const GenericMetadata *pattern,
+                                  const void * const *arguments,
+                                  const Metadata *metadata);
+  void _swift_noteTupleTypeMetadata(const TupleTypeMetadata *metadata);
+  void _swift_noteFunctionTypeMetadata(const FunctionTypeMetadata *metadata);
+  void _swift_noteExistentialTypeMetadata(
+                                      const ExistentialTypeMetadata *metadata);
+  void _swift_noteConformance(const Metadata *type,
+                              const ProtocolDescriptor *protocol);
+
+#if defined(__ELF__)
+  /// True once the metadata profile environment variables have been read.
+  extern std::atomic<bool> _swift_metadataProfilingStarted;
+
+  void _swift_startMetadataProfilingSlow();
+
+  /// Read the metadata profile environment variables on the first generic
+  /// metadata or conformance lookup, so that replaying a profile starts
+  /// before the lookups it is meant to speed up.
+  static inline void _swift_startMetadataProfiling() {
+    if (LLVM_UNLIKELY(!_swift_metadataProfilingStarted.load(
+                                                  std::memory_order_relaxed)))
+      _swift_startMetadataProfilingSlow();
+  }
+#else
+  static inline void _swift_startMetadataProfiling() {}
+#endif
+
 #if SWIFT_OBJC_INTEROP
-  Demangle::NodePointer _swift_buildDemanglingForMetadata(const Metadata *type);
+  /// Build a demangled type tree for a type, allocating its nodes from the
+  /// given factory.
+  Demangle::NodePointer
+  _swift_buildDemanglingForMetadata(const Metadata *type,
+                                    Demangle::NodeFactory &factory);
 #endif
 
   /// A helper function which avoids performing a store if the destination
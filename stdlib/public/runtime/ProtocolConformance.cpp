@@ -18,8 +18,11 @@
 #include "swift/Basic/Lazy.h"
 #include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Metadata.h"
-#include "swift/Runtime/Mutex.h"
+#include "llvm/ADT/Hashing.h"
+#include "CacheReplicas.h"
+#include "MangledNameIndex.h"
 #include "Private.h"
+#include "RuntimeStatistics.h"
 
 #if defined(__APPLE__) && defined(__MACH__)
 #include <mach-o/dyld.h>
@@ -155,16 +158,6 @@ const {
 #endif
 
 namespace {
-  struct ConformanceSection {
-    const ProtocolConformanceRecord *Begin, *End;
-    const ProtocolConformanceRecord *begin() const {
-      return Begin;
-    }
-    const ProtocolConformanceRecord *end() const {
-      return End;
-    }
-  };
-
   struct ConformanceCacheKey {
     /// Either a Metadata* or a NominalTypeDescriptor*.
     const void *Type;
@@ -199,6 +192,10 @@ namespace {
       }
     }
 
+    static size_t getKeyHash(const ConformanceCacheKey &key) {
+      return llvm::hash_combine(key.Type, key.Proto);
+    }
+
     template <class... Args>
     static size_t getExtraAllocationSize(Args &&... ignored) {
       return 0;
@@ -229,6 +226,74 @@ namespace {
       return FailureGeneration.load(std::memory_order_relaxed);
     }
   };
+
+  struct ConformanceIndexKey {
+    /// The nominal type descriptor of the conforming type, or null for
+    /// records that have to be checked for every lookup of the protocol.
+    const NominalTypeDescriptor *Description;
+    const ProtocolDescriptor *Proto;
+
+    ConformanceIndexKey(const NominalTypeDescriptor *description,
+                        const ProtocolDescriptor *proto)
+      : Description(description), Proto(proto) {}
+  };
+
+  /// The conformance records registered for a particular nominal type and
+  /// protocol.
+  struct ConformanceIndexEntry {
+  private:
+    const NominalTypeDescriptor *Description;
+    const ProtocolDescriptor *Proto;
+
+  public:
+    ConcurrentList<const ProtocolConformanceRecord *> Records;
+
+    ConformanceIndexEntry(ConformanceIndexKey key)
+      : Description(key.Description), Proto(key.Proto) {}
+
+    int compareWithKey(const ConformanceIndexKey &key) const {
+      if (key.Description != Description) {
+        return (uintptr_t(key.Description) < uintptr_t(Description) ? -1 : 1);
+      } else if (key.Proto != Proto) {
+        return (uintptr_t(key.Proto) < uintptr_t(Proto) ? -1 : 1);
+      } else {
+        return 0;
+      }
+    }
+
+    static size_t getKeyHash(const ConformanceIndexKey &key) {
+      return llvm::hash_combine(key.Description, key.Proto);
+    }
+
+    static size_t getExtraAllocationSize(const ConformanceIndexKey &key) {
+      return 0;
+    }
+  };
+
+  /// A nominal type descriptor whose conformance records have been added to
+  /// the index of conforming type names.
+  struct NamedTypeEntry {
+  private:
+    const NominalTypeDescriptor *Description;
+
+  public:
+    NamedTypeEntry(const NominalTypeDescriptor *description)
+      : Description(description) {}
+
+    int compareWithKey(const NominalTypeDescriptor *key) const {
+      if (key == Description)
+        return 0;
+      return (uintptr_t(key) < uintptr_t(Description) ? -1 : 1);
+    }
+
+    static size_t getKeyHash(const NominalTypeDescriptor *key) {
+      return llvm::hash_value(key);
+    }
+
+    static size_t getExtraAllocationSize(const NominalTypeDescriptor *key) {
+      return 0;
+    }
+  };
 }
 
 // Conformance Cache.
@@ -246,12 +311,29 @@ static void _addImageProtocolConformancesBlock(const uint8_t *conformances,
 #endif
 
 struct ConformanceState {
-  ConcurrentMap<ConformanceCacheEntry> Cache;
-  std::vector<ConformanceSection> SectionsToScan;
-  Mutex SectionsToScanLock;
-  
-  ConformanceState() {
-    SectionsToScan.reserve(16);
+  ConcurrentHashMap<ConformanceCacheEntry> Cache;
+
+  /// The registered conformance records, indexed by nominal type descriptor
+  /// and protocol.
+  ConcurrentHashMap<ConformanceIndexEntry> Index;
+
+  /// The number of sections whose records have been completely added to
+  /// the index.  Negative cache entries are only valid for the generation
+  /// under which they were created.
+  std::atomic<unsigned> Generation;
+
+  /// The registered conformance records, indexed by the mangled name of the
+  /// conforming type, for looking up types by name.  Each type is listed
+  /// once per name, however many conformances it has.
+  MangledNameIndex<ProtocolConformanceRecord> NameIndex;
+
+  /// The types that already have a record in NameIndex.
+  ConcurrentHashMap<NamedTypeEntry> NamedTypes;
+
+  /// Records whose type can't be named without instantiating its metadata.
+  ConcurrentList<const ProtocolConformanceRecord *> UnnamedRecords;
+
+  ConformanceState() : Generation(0) {
 #if defined(__APPLE__) && defined(__MACH__)
     _initializeCallbacksToInspectDylib();
 #else
@@ -272,8 +354,8 @@ struct ConformanceState {
     }
   }
 
-  void cacheFailure(const void *type, const ProtocolDescriptor *proto) {
-    uintptr_t failureGeneration = SectionsToScan.size();
+  void cacheFailure(const void *type, const ProtocolDescriptor *proto,
+                    uintptr_t failureGeneration) {
     auto result = Cache.getOrInsert(ConformanceCacheKey(type, proto),
                                     (const WitnessTable *) nullptr,
                                     failureGeneration);
@@ -288,6 +370,57 @@ struct ConformanceState {
                                     const ProtocolDescriptor *proto) {
     return Cache.find(ConformanceCacheKey(type, proto));
   }
+
+  unsigned getGeneration() const {
+    return Generation.load(std::memory_order_acquire);
+  }
+
+  /// Add every record of a newly-registered section to the index.
+  void indexRecords(const ProtocolConformanceRecord *begin,
+                    const ProtocolConformanceRecord *end) {
+    for (auto record = begin; record != end; ++record) {
+      auto description = _getRecordTypeDescriptor(*record);
+
+      // Nonunique metadata is one of several copies of a foreign type's
+      // metadata, and lookups start from the uniqued copy, whose descriptor
+      // may be a different one.  So these records are checked for every
+      // lookup of the protocol, and matched against the uniqued metadata.
+      auto indexedDescription = description;
+      if (record->getTypeKind() == TypeMetadataRecordKind::NonuniqueDirectType)
+        indexedDescription = nullptr;
+
+      ConformanceIndexKey key(indexedDescription, record->getProtocol());
+      Index.getOrInsert(key).first->Records.push_front(record);
+      indexRecordName(record, description);
+    }
+
+    // Publish the new records to lookups that load the generation.
+    Generation.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Add a record to the index of conforming type names.
+  void indexRecordName(const ProtocolConformanceRecord *record,
+                       const NominalTypeDescriptor *description) {
+    if (!description) {
+      UnnamedRecords.push_back(record);
+      return;
+    }
+
+    if (!NamedTypes.getOrInsert(description).second)
+      return;
+    NameIndex.getOrInsert(description->Name.get()).first->Records
+      .push_back(record);
+  }
+
+  /// Return the list of records registered for the given nominal type
+  /// descriptor and protocol, or null if there are none.
+  const ConcurrentList<const ProtocolConformanceRecord *> *
+  findIndexedRecords(const NominalTypeDescriptor *description,
+                     const ProtocolDescriptor *proto) {
+    if (auto entry = Index.find(ConformanceIndexKey(description, proto)))
+      return &entry->Records;
+    return nullptr;
+  }
 };
 
 static Lazy<ConformanceState> Conformances;
@@ -296,8 +429,7 @@ static void
 _registerProtocolConformances(ConformanceState &C,
                               const ProtocolConformanceRecord *begin,
                               const ProtocolConformanceRecord *end) {
-  ScopedLock guard(C.SectionsToScanLock);
-  C.SectionsToScan.push_back(ConformanceSection{begin, end});
+  C.indexRecords(begin, end);
 }
 
 static void _addImageProtocolConformancesBlock(const uint8_t *conformances,
@@ -449,10 +581,6 @@ void swift::_swift_initializeCallbacksToInspectDylib(
 # error No known mechanism to inspect dynamic libraries on this platform.
 #endif
 
-// This variable is used to signal when a cache was generated and
-// it is correct to avoid a new scan.
-static unsigned ConformanceCacheGeneration = 0;
-
 void
 swift::swift_registerProtocolConformances(const ProtocolConformanceRecord *begin,
                                           const ProtocolConformanceRecord *end){
@@ -490,7 +618,7 @@ recur_inside_cache_lock:
         foundEntry = Value;
 
       // If we got a cached negative response, check the generation number.
-      if (Value->getFailureGeneration() == C.SectionsToScan.size()) {
+      if (Value->getFailureGeneration() == C.getGeneration()) {
         // We found an entry with a negative value.
         return std::make_pair(nullptr, true);
       }
@@ -561,139 +689,122 @@ bool isRelatedType(const Metadata *type, const void *candidate,
   return false;
 }
 
+/// Cache the conformance described by \p record if it could apply to
+/// \p type, one of its superclasses, or its generic pattern.
+static void cacheRecordIfRelated(ConformanceState &C, const Metadata *type,
+                                 const ProtocolConformanceRecord &record,
+                                 unsigned generation) {
+  // If the record applies to a specific type, cache it.
+  if (auto metadata = record.getCanonicalTypeMetadata()) {
+    if (!isRelatedType(type, metadata, /*isMetadata=*/true))
+      return;
+
+    // Store the type-protocol pair in the cache.
+    auto P = record.getProtocol();
+    auto witness = record.getWitnessTable(metadata);
+    if (witness) {
+      C.cacheSuccess(metadata, P, witness);
+    } else {
+      C.cacheFailure(metadata, P, generation);
+    }
+
+  // If the record provides a nondependent witness table for all instances
+  // of a generic type, cache it for the generic pattern.
+  // TODO: "Nondependent witness table" probably deserves its own flag.
+  // An accessor function might still be necessary even if the witness table
+  // can be shared.
+  } else if (record.getTypeKind()
+               == TypeMetadataRecordKind::UniqueNominalTypeDescriptor
+             && record.getConformanceKind()
+               == ProtocolConformanceReferenceKind::WitnessTable) {
+
+    auto R = record.getNominalTypeDescriptor();
+    if (!isRelatedType(type, R, /*isMetadata=*/false))
+      return;
+
+    // Store the type-protocol pair in the cache.
+    C.cacheSuccess(R, record.getProtocol(), record.getStaticWitnessTable());
+  }
+}
+
 const WitnessTable *
 swift::swift_conformsToProtocol(const Metadata *type,
                                 const ProtocolDescriptor *protocol) {
+  _swift_countRuntimeCall(RuntimeCounter::ConformsToProtocol);
+  _swift_startMetadataProfiling();
+
+  if (auto witness = _swift_findInCacheReplica(ReplicatedCache::Conformances,
+                                               type, protocol))
+    return static_cast<const WitnessTable *>(witness);
+
   auto &C = Conformances.get();
-  auto origType = type;
-  unsigned numSections = 0;
   ConformanceCacheEntry *foundEntry;
 
-recur:
-  // See if we have a cached conformance. The ConcurrentMap data structure
+  // See if we have a cached conformance. The ConcurrentHashMap data structure
   // allows us to insert and search the map concurrently without locking.
-  // We do lock the slow path because the SectionsToScan data structure is not
-  // concurrent.
   auto FoundConformance = searchInConformanceCache(type, protocol, foundEntry);
   // The negative answer does not always mean that there is no conformance,
   // unless it is an exact match on the type. If it is not an exact match,
   // it may mean that all of the superclasses do not have this conformance,
   // but the actual type may still have this conformance.
   if (FoundConformance.second) {
-    if (FoundConformance.first || foundEntry)
+    if (FoundConformance.first) {
+      _swift_fillCacheReplica(ReplicatedCache::Conformances, type, protocol,
+                              FoundConformance.first);
       return FoundConformance.first;
-  }
-
-  // If we didn't have an up-to-date cache entry, scan the conformance records.
-  C.SectionsToScanLock.lock();
-  unsigned failedGeneration = ConformanceCacheGeneration;
-
-  // If we have no new information to pull in (and nobody else pulled in
-  // new information while we waited on the lock), we're done.
-  if (C.SectionsToScan.size() == numSections) {
-    if (failedGeneration != ConformanceCacheGeneration) {
-      // Someone else pulled in new conformances while we were waiting.
-      // Start over with our newly-populated cache.
-      C.SectionsToScanLock.unlock();
-      type = origType;
-      goto recur;
     }
+    if (foundEntry)
+      return nullptr;
+  }
 
-
-    // Save the failure for this type-protocol pair in the cache.
-    C.cacheFailure(type, protocol);
-
-    C.SectionsToScanLock.unlock();
-    return nullptr;
+  RuntimeLatencyTimer timer(RuntimeLatency::ConformanceCacheMiss);
+
+  // Otherwise, consult the index of registered records.  Loading the
+  // generation first guarantees that every record of that many sections is
+  // visible in the index; if more sections are registered concurrently, the
+  // failure we may cache below is invalidated by the generation change.
+  unsigned generation = C.getGeneration();
+
+  auto cacheRecords =
+    [&](const ConcurrentList<const ProtocolConformanceRecord *> *records) {
+      if (!records)
+        return;
+      for (auto record : *records)
+        cacheRecordIfRelated(C, type, *record, generation);
+    };
+
+  // Records for the type itself, its superclasses, and their generic
+  // patterns are indexed under their nominal type descriptors.
+  for (auto searchType = type; searchType; ) {
+    if (auto description = searchType->getNominalTypeDescriptor().get())
+      cacheRecords(C.findIndexedRecords(description, protocol));
+
+    const ClassMetadata *classType = searchType->getClassObject();
+    if (!classType || !classHasSuperclass(classType))
+      break;
+    searchType = swift_getObjCClassMetadata(classType->SuperClass);
   }
 
-  // Update the last known number of sections to scan.
-  numSections = C.SectionsToScan.size();
-
-  // Scan only sections that were not scanned yet.
-  unsigned sectionIdx = foundEntry ? foundEntry->getFailureGeneration() : 0;
-  unsigned endSectionIdx = C.SectionsToScan.size();
-
-  for (; sectionIdx < endSectionIdx; ++sectionIdx) {
-    auto &section = C.SectionsToScan[sectionIdx];
-    // Eagerly pull records for nondependent witnesses into our cache.
-    for (const auto &record : section) {
-      // If the record applies to a specific type, cache it.
-      if (auto metadata = record.getCanonicalTypeMetadata()) {
-        auto P = record.getProtocol();
-
-        // Look for an exact match.
-        if (protocol != P)
-          continue;
-
-        if (!isRelatedType(type, metadata, /*isMetadata=*/true))
-          continue;
-
-        // Store the type-protocol pair in the cache.
-        auto witness = record.getWitnessTable(metadata);
-        if (witness) {
-          C.cacheSuccess(metadata, P, witness);
-        } else {
-          C.cacheFailure(metadata, P);
-        }
-
-      // If the record provides a nondependent witness table for all instances
-      // of a generic type, cache it for the generic pattern.
-      // TODO: "Nondependent witness table" probably deserves its own flag.
-      // An accessor function might still be necessary even if the witness table
-      // can be shared.
-      } else if (record.getTypeKind()
-                   == TypeMetadataRecordKind::UniqueNominalTypeDescriptor
-                 && record.getConformanceKind()
-                   == ProtocolConformanceReferenceKind::WitnessTable) {
-
-        auto R = record.getNominalTypeDescriptor();
-        auto P = record.getProtocol();
-
-        // Look for an exact match.
-        if (protocol != P)
-          continue;
-
-        if (!isRelatedType(type, R, /*isMetadata=*/false))
-          continue;
-
-        // Store the type-protocol pair in the cache.
-        C.cacheSuccess(R, P, record.getStaticWitnessTable());
-      }
-    }
+  // Records that could not be attributed to a nominal type have to be
+  // checked for every lookup of the protocol.
+  cacheRecords(C.findIndexedRecords(nullptr, protocol));
+
+  // Every relevant record is now in the cache.
+  FoundConformance = searchInConformanceCache(type, protocol, foundEntry);
+  if (FoundConformance.first) {
+    _swift_noteConformance(type, protocol);
+    _swift_fillCacheReplica(ReplicatedCache::Conformances, type, protocol,
+                            FoundConformance.first);
+    return FoundConformance.first;
   }
-  ++ConformanceCacheGeneration;
 
-  C.SectionsToScanLock.unlock();
-  // Start over with our newly-populated cache.
-  type = origType;
-  goto recur;
+  // Save the failure for this type-protocol pair in the cache.
+  C.cacheFailure(type, protocol, generation);
+  return nullptr;
 }
 
 const Metadata *
 swift::_searchConformancesByMangledTypeName(const llvm::StringRef typeName) {
   auto &C = Conformances.get();
-  const Metadata *foundMetadata = nullptr;
-
-  ScopedLock guard(C.SectionsToScanLock);
-
-  unsigned sectionIdx = 0;
-  unsigned endSectionIdx = C.SectionsToScan.size();
-
-  for (; sectionIdx < endSectionIdx; ++sectionIdx) {
-    auto &section = C.SectionsToScan[sectionIdx];
-    for (const auto &record : section) {
-      if (auto metadata = record.getCanonicalTypeMetadata())
-        foundMetadata = _matchMetadataByMangledTypeName(typeName, metadata, nullptr);
-      else if (auto ntd = record.getNominalTypeDescriptor())
-        foundMetadata = _matchMetadataByMangledTypeName(typeName, nullptr, ntd);
-
-      if (foundMetadata != nullptr)
-        break;
-    }
-    if (foundMetadata != nullptr)
-      break;
-  }
-
-  return foundMetadata;
+  return findMetadataByMangledName(C.NameIndex, C.UnnamedRecords, typeName);
 }
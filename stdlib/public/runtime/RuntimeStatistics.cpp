@@ -0,0 +1,365 @@
+//===--- RuntimeStatistics.cpp - Runtime call statistics ------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Counters of runtime entry point calls and sampled slow path latencies.
+//
+// Each thread counts into its own block of counters, which only that thread
+// writes, so counting a call never contends with other threads.  The blocks
+// are linked into a global list that snapshots sum over; when a thread exits
+// its counts are folded into a global total.  Resetting the statistics
+// records the current sums as a baseline to subtract from later snapshots,
+// rather than writing to other threads' counters.
+//
+// Retains, releases and object allocations are counted by their
+// implementations in HeapObject.cpp, like every other counted entry point.
+// The _swift_retain, _swift_release and _swift_allocObject function pointers
+// (see InstrumentsSupport.h) are never changed here: other threads call
+// through them without synchronization.  Calls that a tool redirects through
+// those pointers to its own functions are not counted.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Mutex.h"
+#include "swift/Runtime/Once.h"
+#include "swift/Runtime/Statistics.h"
+#include "RuntimeStatistics.h"
+#include <cstring>
+
+#if defined(__linux__)
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+#endif
+
+using namespace swift;
+
+#if defined(__linux__)
+
+std::atomic<unsigned char>
+swift::_swift_runtimeStatisticsState(RuntimeStatisticsUninitialized);
+
+std::atomic<unsigned> swift::_swift_runtimeLatencySampleInterval(0);
+
+namespace {
+
+/// The counters of one thread.
+struct ThreadCounters {
+  /// Only the owning thread writes these, but other threads read them.
+  std::atomic<uint64_t> Counts[NumRuntimeCounters];
+
+  ThreadCounters *Next;
+  ThreadCounters *Previous;
+};
+
+struct LatencyHistogram {
+  std::atomic<uint64_t> Buckets[RuntimeLatencyHistogram::NumBuckets];
+  std::atomic<uint64_t> Samples;
+  std::atomic<uint64_t> TotalNanoseconds;
+};
+
+} // end anonymous namespace
+
+/// Protects the list of thread counters, the totals of exited threads and the
+/// baseline, and serializes enabling and disabling statistics.
+static Mutex *CountersLock;
+static ThreadCounters *AllThreadCounters;
+static uint64_t ExitedThreadCounts[NumRuntimeCounters];
+static uint64_t BaselineCounts[NumRuntimeCounters];
+static pthread_key_t ThreadCountersKey;
+
+static __thread ThreadCounters *LocalCounters
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC;
+
+/// The number of slow paths this thread has run since its last latency
+/// sample.
+static __thread unsigned SlowPathsSinceLatencySample
+  SWIFT_RUNTIME_ATTRIBUTE_TLS_INITIAL_EXEC;
+
+static LatencyHistogram LatencyHistograms[NumRuntimeLatencies];
+
+/// The statistics of the metadata caches that have instantiated something
+/// while statistics were enabled.  Caches are never destroyed, so this list
+/// only grows.
+static std::atomic<MetadataCacheStatistics *> RegisteredCacheStatistics;
+
+static swift_once_t RuntimeStatisticsOnce;
+
+/// Fold the counts of an exiting thread into the totals.  This runs on the
+/// exiting thread.
+static void unregisterThreadCounters(void *value) {
+  auto counters = static_cast<ThreadCounters *>(value);
+  CountersLock->withLock([&] {
+    for (unsigned i = 0; i != NumRuntimeCounters; ++i)
+      ExitedThreadCounts[i] +=
+        counters->Counts[i].load(std::memory_order_relaxed);
+    if (counters->Previous)
+      counters->Previous->Next = counters->Next;
+    else
+      AllThreadCounters = counters->Next;
+    if (counters->Next)
+      counters->Next->Previous = counters->Previous;
+  });
+  LocalCounters = nullptr;
+  delete counters;
+}
+
+static ThreadCounters *registerThreadCounters() {
+  auto counters = new ThreadCounters();
+  for (auto &count : counters->Counts)
+    count.store(0, std::memory_order_relaxed);
+  counters->Previous = nullptr;
+  CountersLock->withLock([&] {
+    counters->Next = AllThreadCounters;
+    if (AllThreadCounters)
+      AllThreadCounters->Previous = counters;
+    AllThreadCounters = counters;
+  });
+  pthread_setspecific(ThreadCountersKey, counters);
+  LocalCounters = counters;
+  return counters;
+}
+
+/// Sum the counters of every thread.  Called with the lock held.
+static void sumCounts(uint64_t counts[NumRuntimeCounters]) {
+  memcpy(counts, ExitedThreadCounts, sizeof(ExitedThreadCounts));
+  for (auto counters = AllThreadCounters; counters;
+       counters = counters->Next) {
+    for (unsigned i = 0; i != NumRuntimeCounters; ++i)
+      counts[i] += counters->Counts[i].load(std::memory_order_relaxed);
+  }
+}
+
+static void countCall(RuntimeCounter counter) {
+  auto counters = LocalCounters;
+  if (LLVM_UNLIKELY(!counters))
+    counters = registerThreadCounters();
+  // Only this thread writes the counter, so it doesn't need an atomic
+  // read-modify-write.
+  auto &count = counters->Counts[unsigned(counter)];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+/*****************************************************************************/
+/****************************** Initialization *******************************/
+/*****************************************************************************/
+
+static void setEnabled(bool enabled, unsigned latencySampleInterval) {
+  CountersLock->withLock([&] {
+    _swift_runtimeLatencySampleInterval.store(latencySampleInterval,
+                                              std::memory_order_relaxed);
+    _swift_runtimeStatisticsState.store(enabled ? RuntimeStatisticsEnabled
+                                                : RuntimeStatisticsDisabled,
+                                        std::memory_order_relaxed);
+  });
+}
+
+static void initializeRuntimeStatistics(void *) {
+  CountersLock = new Mutex();
+  pthread_key_create(&ThreadCountersKey, unregisterThreadCounters);
+
+  const char *enabled = getenv("SWIFT_RUNTIME_STATISTICS");
+  if (!enabled || strcmp(enabled, "1") != 0) {
+    setEnabled(false, 0);
+    return;
+  }
+
+  unsigned latencySampleInterval = 0;
+  if (const char *interval = getenv("SWIFT_RUNTIME_STATISTICS_LATENCY_SAMPLE"))
+    latencySampleInterval = strtoul(interval, nullptr, 10);
+  setEnabled(true, latencySampleInterval);
+}
+
+static void initializeRuntimeStatisticsOnce() {
+  swift_once(&RuntimeStatisticsOnce, initializeRuntimeStatistics);
+}
+
+/*****************************************************************************/
+/****************************** Entry points *********************************/
+/*****************************************************************************/
+
+void swift::_swift_countRuntimeCallSlow(RuntimeCounter counter) {
+  auto state = _swift_runtimeStatisticsState.load(std::memory_order_relaxed);
+  if (state == RuntimeStatisticsUninitialized) {
+    initializeRuntimeStatisticsOnce();
+    state = _swift_runtimeStatisticsState.load(std::memory_order_relaxed);
+  }
+  if (state == RuntimeStatisticsEnabled)
+    countCall(counter);
+}
+
+static uint64_t getMonotonicNanoseconds() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000000 + uint64_t(now.tv_nsec);
+}
+
+uint64_t swift::_swift_getRuntimeStatisticsTime() {
+  return getMonotonicNanoseconds();
+}
+
+void swift::_swift_registerMetadataCacheStatistics(
+                                        MetadataCacheStatistics *stats) {
+  if (stats->IsRegistered.exchange(true, std::memory_order_relaxed))
+    return;
+
+  auto head = RegisteredCacheStatistics.load(std::memory_order_relaxed);
+  do {
+    stats->Next = head;
+  } while (!RegisteredCacheStatistics.compare_exchange_weak(
+             head, stats, std::memory_order_release,
+             std::memory_order_relaxed));
+}
+
+uint64_t swift::_swift_startRuntimeLatencySample() {
+  unsigned interval =
+    _swift_runtimeLatencySampleInterval.load(std::memory_order_relaxed);
+  if (++SlowPathsSinceLatencySample < interval)
+    return 0;
+  SlowPathsSinceLatencySample = 0;
+  // Zero means that no sample was taken.
+  return getMonotonicNanoseconds() | 1;
+}
+
+void swift::_swift_endRuntimeLatencySample(RuntimeLatency latency,
+                                           uint64_t start) {
+  uint64_t end = getMonotonicNanoseconds();
+  uint64_t nanoseconds = end > start ? end - start : 0;
+
+  unsigned bucket = 0;
+  if (nanoseconds != 0)
+    bucket = 63 - __builtin_clzll(nanoseconds);
+  if (bucket >= RuntimeLatencyHistogram::NumBuckets)
+    bucket = RuntimeLatencyHistogram::NumBuckets - 1;
+
+  auto &histogram = LatencyHistograms[unsigned(latency)];
+  histogram.Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.Samples.fetch_add(1, std::memory_order_relaxed);
+  histogram.TotalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void swift::swift_enableRuntimeStatistics(unsigned latencySampleInterval) {
+  initializeRuntimeStatisticsOnce();
+  setEnabled(true, latencySampleInterval);
+}
+
+void swift::swift_disableRuntimeStatistics() {
+  initializeRuntimeStatisticsOnce();
+  setEnabled(false, 0);
+}
+
+static void copyHistogram(const LatencyHistogram &source,
+                          RuntimeLatencyHistogram &dest) {
+  for (unsigned i = 0; i != RuntimeLatencyHistogram::NumBuckets; ++i)
+    dest.Buckets[i] = source.Buckets[i].load(std::memory_order_relaxed);
+  dest.Samples = source.Samples.load(std::memory_order_relaxed);
+  dest.TotalNanoseconds =
+    source.TotalNanoseconds.load(std::memory_order_relaxed);
+}
+
+void swift::swift_getRuntimeStatistics(RuntimeStatistics *statistics) {
+  initializeRuntimeStatisticsOnce();
+
+  uint64_t counts[NumRuntimeCounters];
+  CountersLock->withLock([&] {
+    sumCounts(counts);
+    for (unsigned i = 0; i != NumRuntimeCounters; ++i)
+      counts[i] -= BaselineCounts[i];
+  });
+
+  auto count = [&](RuntimeCounter counter) {
+    return counts[unsigned(counter)];
+  };
+  statistics->Retains = count(RuntimeCounter::Retain);
+  statistics->Releases = count(RuntimeCounter::Release);
+  statistics->ObjectAllocations = count(RuntimeCounter::AllocObject);
+  statistics->ObjectDeallocations = count(RuntimeCounter::DeallocObject);
+  statistics->DynamicCasts = count(RuntimeCounter::DynamicCast);
+  statistics->ConformanceLookups = count(RuntimeCounter::ConformsToProtocol);
+  statistics->GenericMetadataLookups =
+    count(RuntimeCounter::GetGenericMetadata);
+
+  copyHistogram(LatencyHistograms[unsigned(
+                  RuntimeLatency::GenericMetadataInstantiation)],
+                statistics->GenericMetadataInstantiation);
+  copyHistogram(LatencyHistograms[unsigned(
+                  RuntimeLatency::ConformanceCacheMiss)],
+                statistics->ConformanceCacheMisses);
+}
+
+void swift::swift_resetRuntimeStatistics() {
+  initializeRuntimeStatisticsOnce();
+
+  CountersLock->withLock([&] {
+    sumCounts(BaselineCounts);
+  });
+
+  for (auto &histogram : LatencyHistograms) {
+    for (auto &bucket : histogram.Buckets)
+      bucket.store(0, std::memory_order_relaxed);
+    histogram.Samples.store(0, std::memory_order_relaxed);
+    histogram.TotalNanoseconds.store(0, std::memory_order_relaxed);
+  }
+
+  for (auto stats = RegisteredCacheStatistics.load(std::memory_order_acquire);
+       stats; stats = stats->Next) {
+    stats->Instantiations.store(0, std::memory_order_relaxed);
+    stats->InstantiationNanoseconds.store(0, std::memory_order_relaxed);
+    stats->Waits.store(0, std::memory_order_relaxed);
+  }
+}
+
+void swift::swift_enumerateGenericMetadataStatistics(
+    void (*callback)(const GenericMetadataStatistics *statistics,
+                     void *context),
+    void *context) {
+  for (auto stats = RegisteredCacheStatistics.load(std::memory_order_acquire);
+       stats; stats = stats->Next) {
+    GenericMetadataStatistics patternStatistics;
+    patternStatistics.Pattern =
+      static_cast<const GenericMetadata *>(stats->Owner);
+    patternStatistics.Instantiations =
+      stats->Instantiations.load(std::memory_order_relaxed);
+    patternStatistics.TotalNanoseconds =
+      stats->InstantiationNanoseconds.load(std::memory_order_relaxed);
+    patternStatistics.Waits = stats->Waits.load(std::memory_order_relaxed);
+
+    // Skip patterns that haven't done anything since the last reset.
+    if (patternStatistics.Instantiations == 0 && patternStatistics.Waits == 0)
+      continue;
+    callback(&patternStatistics, context);
+  }
+}
+
+#else // !defined(__linux__)
+
+// Runtime statistics are only collected on Linux.
+
+void swift::swift_enableRuntimeStatistics(unsigned latencySampleInterval) {}
+
+void swift::swift_disableRuntimeStatistics() {}
+
+void swift::swift_getRuntimeStatistics(RuntimeStatistics *statistics) {
+  memset(statistics, 0, sizeof(*statistics));
+}
+
+void swift::swift_resetRuntimeStatistics() {}
+
+void swift::swift_enumerateGenericMetadataStatistics(
+    void (*callback)(const GenericMetadataStatistics *statistics,
+                     void *context),
+    void *context) {}
+
+void swift::_swift_registerMetadataCacheStatistics(
+                                        MetadataCacheStatistics *stats) {}
+
+#endif
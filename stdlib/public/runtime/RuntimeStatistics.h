@@ -0,0 +1,148 @@
+//===--- RuntimeStatistics.h - Runtime call statistics hooks ----*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// The hooks that runtime entry points use to update the statistics declared
+// in swift/Runtime/Statistics.h.  They are inline so that, with statistics
+// off, a counted call costs one relaxed load.  See RuntimeStatistics.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_RUNTIMESTATISTICS_H
+#define SWIFT_RUNTIME_RUNTIMESTATISTICS_H
+
+#include "swift/Runtime/Statistics.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <cstdint>
+
+namespace swift {
+
+/// The calls counted by the runtime entry points.
+enum class RuntimeCounter : unsigned {
+  Retain,
+  Release,
+  AllocObject,
+  DeallocObject,
+  DynamicCast,
+  ConformsToProtocol,
+  GetGenericMetadata,
+};
+enum : unsigned { NumRuntimeCounters = 7 };
+
+/// The slow paths whose latency is sampled.
+enum class RuntimeLatency : unsigned {
+  GenericMetadataInstantiation,
+  ConformanceCacheMiss,
+};
+enum : unsigned { NumRuntimeLatencies = 2 };
+
+/// The instantiation statistics of one metadata cache.  Caches with an
+/// owner register their statistics the first time they instantiate
+/// something, so that swift_enumerateGenericMetadataStatistics can find
+/// them.
+struct MetadataCacheStatistics {
+  /// The generic metadata pattern that owns the cache, or null.
+  const void *Owner = nullptr;
+
+  /// The next registered cache.
+  MetadataCacheStatistics *Next = nullptr;
+  std::atomic<bool> IsRegistered{false};
+
+  std::atomic<uint64_t> Instantiations{0};
+  std::atomic<uint64_t> InstantiationNanoseconds{0};
+
+  /// How many times a thread had to wait for another thread to finish
+  /// instantiating an entry.
+  std::atomic<uint64_t> Waits{0};
+};
+
+void _swift_registerMetadataCacheStatistics(MetadataCacheStatistics *stats);
+
+#if defined(__linux__)
+
+enum : unsigned char {
+  RuntimeStatisticsUninitialized,
+  RuntimeStatisticsDisabled,
+  RuntimeStatisticsEnabled,
+};
+
+/// Whether statistics are being collected.  This starts out uninitialized,
+/// so that the first counted call reads the environment.
+extern std::atomic<unsigned char> _swift_runtimeStatisticsState;
+
+/// How many slow paths each thread runs per latency sample, or zero if
+/// latencies aren't being sampled.
+extern std::atomic<unsigned> _swift_runtimeLatencySampleInterval;
+
+void _swift_countRuntimeCallSlow(RuntimeCounter counter);
+uint64_t _swift_startRuntimeLatencySample();
+void _swift_endRuntimeLatencySample(RuntimeLatency latency, uint64_t start);
+
+/// Whether statistics are being collected.  This doesn't read the
+/// environment, so it is false until some counted call has been made.
+static inline bool _swift_runtimeStatisticsEnabled() {
+  return _swift_runtimeStatisticsState.load(std::memory_order_relaxed) ==
+           RuntimeStatisticsEnabled;
+}
+
+/// The current time for measuring slow paths, in nanoseconds.
+uint64_t _swift_getRuntimeStatisticsTime();
+
+/// Count a call to a runtime entry point.
+static inline void _swift_countRuntimeCall(RuntimeCounter counter) {
+  if (LLVM_UNLIKELY(_swift_runtimeStatisticsState.load(
+                      std::memory_order_relaxed) != RuntimeStatisticsDisabled))
+    _swift_countRuntimeCallSlow(counter);
+}
+
+/// Samples the latency of a slow path from its construction to its
+/// destruction, if this thread is due for a sample.
+class RuntimeLatencyTimer {
+  RuntimeLatency Latency;
+  uint64_t Start = 0;
+
+public:
+  explicit RuntimeLatencyTimer(RuntimeLatency latency) : Latency(latency) {
+    if (LLVM_UNLIKELY(_swift_runtimeLatencySampleInterval.load(
+                        std::memory_order_relaxed) != 0))
+      Start = _swift_startRuntimeLatencySample();
+  }
+
+  RuntimeLatencyTimer(const RuntimeLatencyTimer &) = delete;
+  RuntimeLatencyTimer &operator=(const RuntimeLatencyTimer &) = delete;
+
+  ~RuntimeLatencyTimer() {
+    if (LLVM_UNLIKELY(Start != 0))
+      _swift_endRuntimeLatencySample(Latency, Start);
+  }
+};
+
+#else
+
+// Runtime statistics are only collected on Linux.
+
+static inline bool _swift_runtimeStatisticsEnabled() { return false; }
+
+static inline uint64_t _swift_getRuntimeStatisticsTime() { return 0; }
+
+static inline void _swift_countRuntimeCall(RuntimeCounter counter) {}
+
+class RuntimeLatencyTimer {
+public:
+  explicit RuntimeLatencyTimer(RuntimeLatency latency) {}
+};
+
+#endif
+
+} // end namespace swift
+
+#endif // SWIFT_RUNTIME_RUNTIMESTATISTICS_H
@@ -32,6 +32,7 @@
 #include "swift/Runtime/ObjCBridge.h"
 #include "swift/Strings.h"
 #include "../SwiftShims/RuntimeShims.h"
+#include "BiasedRefCount.h"
 #include "Private.h"
 #include "SwiftObject.h"
 #include "swift/Runtime/Debug.h"
@@ -1338,6 +1339,10 @@ bool swift::swift_isUniquelyReferenced_nonNull_native(
 ) SWIFT_CC(RegisterPreservingCC_IMPL) {
   assert(object != nullptr);
   assert(!object->refCount.isDeallocating());
+  bool result;
+  if (_swift_biasedIsUniquelyReferenced(const_cast<HeapObject *>(object),
+                                        /*orPinned*/ false, result))
+    return result;
   return object->refCount.isUniquelyReferenced();
 }
 
@@ -1448,6 +1453,10 @@ bool swift::swift_isUniquelyReferencedOrPinned_nonNull_native(
   SWIFT_CC(RegisterPreservingCC_IMPL) {
   assert(object != nullptr);
   assert(!object->refCount.isDeallocating());
+  bool result;
+  if (_swift_biasedIsUniquelyReferenced(const_cast<HeapObject *>(object),
+                                        /*orPinned*/ true, result))
+    return result;
   return object->refCount.isUniquelyReferencedOrPinned();
 }
 
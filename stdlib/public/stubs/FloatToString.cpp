@@ -0,0 +1,733 @@
+//===--- FloatToString.cpp - Shortest round-trip float formatting ---------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Conversion of Float, Double and Float80 values to the shortest decimal
+// string that reads back as the same value.
+//
+// Float and Double use Grisu3 (Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers", PLDI 2010), which finds the
+// shortest digits for almost every value using only 64-bit arithmetic, and
+// reliably reports the few values it cannot handle.  Those values, and all
+// Float80 values, whose 64-bit significand leaves Grisu no spare precision,
+// use the exact free-format algorithm of Burger and Dybvig ("Printing
+// Floating-Point Numbers Quickly and Accurately", PLDI 1996) on bignums.
+//
+// The digits are laid out the way printf's "%g" would lay them out, so the
+// choice between fixed and exponential notation is unchanged from when
+// these values were formatted with snprintf.  No locale is involved.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/MathExtras.h"
+#include "swift/Runtime/Config.h"
+#include "swift/Runtime/Debug.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/// A finite, nonzero binary floating-point value, Significand * 2^Exponent.
+struct DecodedFloat {
+  uint64_t Significand;
+  int Exponent;
+
+  /// Whether the next smaller representable value is closer than the next
+  /// larger one.  This is true of powers of two other than the smallest
+  /// normal value.
+  bool LowerBoundaryIsCloser;
+};
+
+/// The shortest decimal digits of a value, which is Digits * 10^Exponent.
+struct DecimalDigits {
+  /// The maximum number of digits needed by any supported format.
+  static constexpr int MaxLength = 24;
+
+  char Digits[MaxLength];
+  int Length;
+  int Exponent;
+};
+
+} // end anonymous namespace
+
+/// Decode an IEEE 754 binary interchange format value from its biased
+/// exponent and fraction fields.
+static DecodedFloat decodeIEEE(uint64_t Fraction, unsigned BiasedExponent,
+                               unsigned FractionBits, int Bias) {
+  if (BiasedExponent == 0)
+    return {Fraction, 1 - Bias - int(FractionBits), false};
+  return {Fraction | (uint64_t(1) << FractionBits),
+          int(BiasedExponent) - Bias - int(FractionBits),
+          Fraction == 0 && BiasedExponent > 1};
+}
+
+//===----------------------------------------------------------------------===//
+// Grisu3
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// A "do-it-yourself" floating-point value, F * 2^E.
+struct DiyFp {
+  uint64_t F;
+  int E;
+};
+
+struct CachedPower {
+  uint64_t Significand;
+  int16_t BinaryExponent;
+  int16_t DecimalExponent;
+};
+
+} // end anonymous namespace
+
+/// Powers of ten from 10^-348 to 10^340 in steps of 10^8, as normalized
+/// 64-bit significands rounded to nearest.
+static const CachedPower CachedPowers[] = {
+  { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+  { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+  { 0x8b16fb203055ac76ULL, -1166, -332 },
+  { 0xcf42894a5dce35eaULL, -1140, -324 },
+  { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+  { 0xe61acf033d1a45dfULL, -1087, -308 },
+  { 0xab70fe17c79ac6caULL, -1060, -300 },
+  { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+  { 0xbe5691ef416bd60cULL, -1007, -284 },
+  { 0x8dd01fad907ffc3cULL, -980, -276 },
+  { 0xd3515c2831559a83ULL, -954, -268 },
+  { 0x9d71ac8fada6c9b5ULL, -927, -260 },
+  { 0xea9c227723ee8bcbULL, -901, -252 },
+  { 0xaecc49914078536dULL, -874, -244 },
+  { 0x823c12795db6ce57ULL, -847, -236 },
+  { 0xc21094364dfb5637ULL, -821, -228 },
+  { 0x9096ea6f3848984fULL, -794, -220 },
+  { 0xd77485cb25823ac7ULL, -768, -212 },
+  { 0xa086cfcd97bf97f4ULL, -741, -204 },
+  { 0xef340a98172aace5ULL, -715, -196 },
+  { 0xb23867fb2a35b28eULL, -688, -188 },
+  { 0x84c8d4dfd2c63f3bULL, -661, -180 },
+  { 0xc5dd44271ad3cdbaULL, -635, -172 },
+  { 0x936b9fcebb25c996ULL, -608, -164 },
+  { 0xdbac6c247d62a584ULL, -582, -156 },
+  { 0xa3ab66580d5fdaf6ULL, -555, -148 },
+  { 0xf3e2f893dec3f126ULL, -529, -140 },
+  { 0xb5b5ada8aaff80b8ULL, -502, -132 },
+  { 0x87625f056c7c4a8bULL, -475, -124 },
+  { 0xc9bcff6034c13053ULL, -449, -116 },
+  { 0x964e858c91ba2655ULL, -422, -108 },
+  { 0xdff9772470297ebdULL, -396, -100 },
+  { 0xa6dfbd9fb8e5b88fULL, -369, -92 },
+  { 0xf8a95fcf88747d94ULL, -343, -84 },
+  { 0xb94470938fa89bcfULL, -316, -76 },
+  { 0x8a08f0f8bf0f156bULL, -289, -68 },
+  { 0xcdb02555653131b6ULL, -263, -60 },
+  { 0x993fe2c6d07b7facULL, -236, -52 },
+  { 0xe45c10c42a2b3b06ULL, -210, -44 },
+  { 0xaa242499697392d3ULL, -183, -36 },
+  { 0xfd87b5f28300ca0eULL, -157, -28 },
+  { 0xbce5086492111aebULL, -130, -20 },
+  { 0x8cbccc096f5088ccULL, -103, -12 },
+  { 0xd1b71758e219652cULL, -77, -4 },
+  { 0x9c40000000000000ULL, -50, 4 },
+  { 0xe8d4a51000000000ULL, -24, 12 },
+  { 0xad78ebc5ac620000ULL, 3, 20 },
+  { 0x813f3978f8940984ULL, 30, 28 },
+  { 0xc097ce7bc90715b3ULL, 56, 36 },
+  { 0x8f7e32ce7bea5c70ULL, 83, 44 },
+  { 0xd5d238a4abe98068ULL, 109, 52 },
+  { 0x9f4f2726179a2245ULL, 136, 60 },
+  { 0xed63a231d4c4fb27ULL, 162, 68 },
+  { 0xb0de65388cc8ada8ULL, 189, 76 },
+  { 0x83c7088e1aab65dbULL, 216, 84 },
+  { 0xc45d1df942711d9aULL, 242, 92 },
+  { 0x924d692ca61be758ULL, 269, 100 },
+  { 0xda01ee641a708deaULL, 295, 108 },
+  { 0xa26da3999aef774aULL, 322, 116 },
+  { 0xf209787bb47d6b85ULL, 348, 124 },
+  { 0xb454e4a179dd1877ULL, 375, 132 },
+  { 0x865b86925b9bc5c2ULL, 402, 140 },
+  { 0xc83553c5c8965d3dULL, 428, 148 },
+  { 0x952ab45cfa97a0b3ULL, 455, 156 },
+  { 0xde469fbd99a05fe3ULL, 481, 164 },
+  { 0xa59bc234db398c25ULL, 508, 172 },
+  { 0xf6c69a72a3989f5cULL, 534, 180 },
+  { 0xb7dcbf5354e9beceULL, 561, 188 },
+  { 0x88fcf317f22241e2ULL, 588, 196 },
+  { 0xcc20ce9bd35c78a5ULL, 614, 204 },
+  { 0x98165af37b2153dfULL, 641, 212 },
+  { 0xe2a0b5dc971f303aULL, 667, 220 },
+  { 0xa8d9d1535ce3b396ULL, 694, 228 },
+  { 0xfb9b7cd9a4a7443cULL, 720, 236 },
+  { 0xbb764c4ca7a44410ULL, 747, 244 },
+  { 0x8bab8eefb6409c1aULL, 774, 252 },
+  { 0xd01fef10a657842cULL, 800, 260 },
+  { 0x9b10a4e5e9913129ULL, 827, 268 },
+  { 0xe7109bfba19c0c9dULL, 853, 276 },
+  { 0xac2820d9623bf429ULL, 880, 284 },
+  { 0x80444b5e7aa7cf85ULL, 907, 292 },
+  { 0xbf21e44003acdd2dULL, 933, 300 },
+  { 0x8e679c2f5e44ff8fULL, 960, 308 },
+  { 0xd433179d9c8cb841ULL, 986, 316 },
+  { 0x9e19db92b4e31ba9ULL, 1013, 324 },
+  { 0xeb96bf6ebadf77d9ULL, 1039, 332 },
+  { 0xaf87023b9bf0ee6bULL, 1066, 340 },
+};
+
+static const int CachedPowersFirstDecimalExponent = -348;
+static const int CachedPowersDecimalExponentDistance = 8;
+
+/// The range that the binary exponent of a scaled value is brought into, so
+/// that its integral part fits in 32 bits.
+static const int MinimalTargetExponent = -60;
+static const int MaximalTargetExponent = -32;
+
+static const double Log10Of2 = 0.30102999566398114;
+
+static DiyFp normalize(DiyFp V) {
+  unsigned Shift = llvm::countLeadingZeros(V.F);
+  return {V.F << Shift, V.E - int(Shift)};
+}
+
+/// Multiply two DiyFps, rounding the 128-bit product to its upper 64 bits.
+static DiyFp multiply(DiyFp A, DiyFp B) {
+  const uint64_t Mask32 = 0xFFFFFFFF;
+  uint64_t AHigh = A.F >> 32, ALow = A.F & Mask32;
+  uint64_t BHigh = B.F >> 32, BLow = B.F & Mask32;
+  uint64_t HighHigh = AHigh * BHigh;
+  uint64_t LowHigh = ALow * BHigh;
+  uint64_t HighLow = AHigh * BLow;
+  uint64_t LowLow = ALow * BLow;
+  uint64_t Middle = (LowLow >> 32) + (HighLow & Mask32) + (LowHigh & Mask32);
+  Middle += uint64_t(1) << 31;
+  return {HighHigh + (HighLow >> 32) + (LowHigh >> 32) + (Middle >> 32),
+          A.E + B.E + 64};
+}
+
+/// Find a cached power of ten c such that a normalized DiyFp with the given
+/// binary exponent, multiplied by c, has a binary exponent between
+/// MinimalTargetExponent and MaximalTargetExponent.
+static const CachedPower &getCachedPowerForBinaryExponent(int Exponent) {
+  int MinExponent = MinimalTargetExponent - (Exponent + 64);
+  int K = int(std::ceil((MinExponent + 63) * Log10Of2));
+  int Index = (-CachedPowersFirstDecimalExponent + K - 1) /
+                CachedPowersDecimalExponentDistance + 1;
+  const CachedPower &Power = CachedPowers[Index];
+  assert(MinimalTargetExponent <= Exponent + Power.BinaryExponent + 64 &&
+         Exponent + Power.BinaryExponent + 64 <= MaximalTargetExponent);
+  (void)MaximalTargetExponent;
+  return Power;
+}
+
+/// Adjust the last digit of a generated number towards the exact value, and
+/// check that the result is unambiguously the closest shortest number.
+/// All arguments are in units of the last digit's scale.
+static bool roundWeed(char *Digits, int Length, uint64_t DistanceTooHighW,
+                      uint64_t UnsafeInterval, uint64_t Rest,
+                      uint64_t TenKappa, uint64_t Unit) {
+  uint64_t SmallDistance = DistanceTooHighW - Unit;
+  uint64_t BigDistance = DistanceTooHighW + Unit;
+
+  while (Rest < SmallDistance &&
+         UnsafeInterval - Rest >= TenKappa &&
+         (Rest + TenKappa < SmallDistance ||
+          SmallDistance - Rest >= Rest + TenKappa - SmallDistance)) {
+    --Digits[Length - 1];
+    Rest += TenKappa;
+  }
+
+  // If the digits could still be moved closer to the upper bound of the
+  // approximated value, we can't tell which candidate is the closest.
+  if (Rest < BigDistance &&
+      UnsafeInterval - Rest >= TenKappa &&
+      (Rest + TenKappa < BigDistance ||
+       BigDistance - Rest > Rest + TenKappa - BigDistance))
+    return false;
+
+  // Make sure the result is inside the safe interval.
+  return 2 * Unit <= Rest && Rest <= UnsafeInterval - 4 * Unit;
+}
+
+/// Generate the shortest digits of a number within (Low, High), which are
+/// scaled approximations of the boundaries of W.  Returns false if the
+/// approximation error makes the result uncertain.
+static bool digitGen(DiyFp Low, DiyFp W, DiyFp High, DecimalDigits &Result,
+                     int &Kappa) {
+  assert(Low.E == W.E && W.E == High.E);
+
+  // Widen the interval by the largest possible error of the scaled values.
+  // Anything outside the unsafe interval is certainly not a candidate.
+  uint64_t Unit = 1;
+  DiyFp TooLow = {Low.F - Unit, Low.E};
+  DiyFp TooHigh = {High.F + Unit, High.E};
+  uint64_t UnsafeInterval = TooHigh.F - TooLow.F;
+
+  unsigned OneShift = -W.E;
+  uint64_t One = uint64_t(1) << OneShift;
+  uint32_t Integrals = uint32_t(TooHigh.F >> OneShift);
+  uint64_t Fractionals = TooHigh.F & (One - 1);
+
+  uint32_t Divisor = 0;
+  Kappa = 0;
+  if (Integrals != 0) {
+    Divisor = 1;
+    Kappa = 1;
+    while (Integrals / Divisor >= 10) {
+      Divisor *= 10;
+      ++Kappa;
+    }
+  }
+
+  Result.Length = 0;
+  while (Kappa > 0) {
+    Result.Digits[Result.Length++] = char('0' + Integrals / Divisor);
+    Integrals %= Divisor;
+    --Kappa;
+    uint64_t Rest = (uint64_t(Integrals) << OneShift) + Fractionals;
+    if (Rest < UnsafeInterval)
+      return roundWeed(Result.Digits, Result.Length, TooHigh.F - W.F,
+                       UnsafeInterval, Rest, uint64_t(Divisor) << OneShift,
+                       Unit);
+    Divisor /= 10;
+  }
+
+  while (true) {
+    Fractionals *= 10;
+    Unit *= 10;
+    UnsafeInterval *= 10;
+    Result.Digits[Result.Length++] = char('0' + (Fractionals >> OneShift));
+    Fractionals &= One - 1;
+    --Kappa;
+    if (Fractionals < UnsafeInterval)
+      return roundWeed(Result.Digits, Result.Length,
+                       (TooHigh.F - W.F) * Unit, UnsafeInterval, Fractionals,
+                       One, Unit);
+    if (Result.Length == DecimalDigits::MaxLength)
+      return false;
+  }
+}
+
+/// Try to find the shortest digits of a value with at most 54 significant
+/// bits using Grisu3.  Returns false if the exact algorithm is needed.
+static bool grisu3(const DecodedFloat &V, DecimalDigits &Result) {
+  assert(V.Significand < (uint64_t(1) << 54));
+
+  DiyFp W = normalize({V.Significand, V.Exponent});
+  DiyFp Plus = normalize({(V.Significand << 1) + 1, V.Exponent - 1});
+  DiyFp Minus = V.LowerBoundaryIsCloser
+    ? DiyFp{(V.Significand << 2) - 1, V.Exponent - 2}
+    : DiyFp{(V.Significand << 1) - 1, V.Exponent - 1};
+  Minus.F <<= Minus.E - Plus.E;
+  Minus.E = Plus.E;
+
+  const CachedPower &Power = getCachedPowerForBinaryExponent(W.E);
+  DiyFp TenMk = {Power.Significand, Power.BinaryExponent};
+
+  int Kappa;
+  if (!digitGen(multiply(Minus, TenMk), multiply(W, TenMk),
+                multiply(Plus, TenMk), Result, Kappa))
+    return false;
+  Result.Exponent = Kappa - Power.DecimalExponent;
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Exact shortest digits
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// A nonnegative integer of at most Capacity 32-bit words, with just the
+/// operations needed by the free-format algorithm.
+template <unsigned Capacity>
+class BigInt {
+  uint32_t Words[Capacity];
+
+  /// The number of words in use.  The most significant one is nonzero.
+  unsigned Size;
+
+  void trim() {
+    while (Size > 0 && Words[Size - 1] == 0)
+      --Size;
+  }
+
+  void reserve(unsigned NewSize) {
+    if (NewSize > Capacity)
+      swift::crash("floating-point formatting: bignum overflow");
+  }
+
+public:
+  explicit BigInt(uint64_t Value) {
+    Words[0] = uint32_t(Value);
+    Words[1] = uint32_t(Value >> 32);
+    Size = 2;
+    trim();
+  }
+
+  void multiplyBy(uint32_t Factor) {
+    uint64_t Carry = 0;
+    for (unsigned i = 0; i != Size; ++i) {
+      uint64_t Product = uint64_t(Words[i]) * Factor + Carry;
+      Words[i] = uint32_t(Product);
+      Carry = Product >> 32;
+    }
+    if (Carry) {
+      reserve(Size + 1);
+      Words[Size++] = uint32_t(Carry);
+    }
+  }
+
+  void multiplyByPowerOfTen(unsigned Exponent) {
+    static const uint32_t SmallPowersOfTen[] = {
+      1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+      1000000000
+    };
+    for (; Exponent >= 9; Exponent -= 9)
+      multiplyBy(SmallPowersOfTen[9]);
+    if (Exponent)
+      multiplyBy(SmallPowersOfTen[Exponent]);
+  }
+
+  void shiftLeft(unsigned Bits) {
+    if (Size == 0)
+      return;
+    unsigned WordShift = Bits / 32, BitShift = Bits % 32;
+    reserve(Size + WordShift + 1);
+    if (BitShift == 0) {
+      for (unsigned i = Size; i-- != 0; )
+        Words[i + WordShift] = Words[i];
+      Words[Size + WordShift] = 0;
+    } else {
+      Words[Size + WordShift] = Words[Size - 1] >> (32 - BitShift);
+      for (unsigned i = Size - 1; i != 0; --i)
+        Words[i + WordShift] =
+          (Words[i] << BitShift) | (Words[i - 1] >> (32 - BitShift));
+      Words[WordShift] = Words[0] << BitShift;
+    }
+    for (unsigned i = 0; i != WordShift; ++i)
+      Words[i] = 0;
+    Size += WordShift + 1;
+    trim();
+  }
+
+  /// Subtract a value no greater than this one.
+  void subtract(const BigInt &Other) {
+    uint64_t Borrow = 0;
+    for (unsigned i = 0; i != Size; ++i) {
+      uint64_t Difference = uint64_t(Words[i]) - Borrow
+        - (i < Other.Size ? Other.Words[i] : 0);
+      Words[i] = uint32_t(Difference);
+      Borrow = Difference >> 63;
+    }
+    assert(Borrow == 0 && "subtracted a larger bignum");
+    trim();
+  }
+
+  /// Compare A + B with C, returning a negative, zero or positive number.
+  static int compareSum(const BigInt &A, const BigInt &B, const BigInt &C) {
+    unsigned MaxSize = A.Size > B.Size ? A.Size : B.Size;
+    if (MaxSize + 1 < C.Size)
+      return -1;
+    if (MaxSize > C.Size)
+      return 1;
+
+    // Compute the sum word by word, and remember the most significant word
+    // that differs from C.
+    int Result = 0;
+    uint64_t Carry = 0;
+    for (unsigned i = 0; i != MaxSize + 1; ++i) {
+      uint64_t Sum = Carry + (i < A.Size ? A.Words[i] : 0)
+        + (i < B.Size ? B.Words[i] : 0);
+      Carry = Sum >> 32;
+      uint32_t Word = uint32_t(Sum);
+      uint32_t CWord = i < C.Size ? C.Words[i] : 0;
+      if (Word != CWord)
+        Result = Word < CWord ? -1 : 1;
+    }
+    return Result;
+  }
+
+  static int compare(const BigInt &A, const BigInt &B) {
+    if (A.Size != B.Size)
+      return A.Size < B.Size ? -1 : 1;
+    for (unsigned i = A.Size; i-- != 0; )
+      if (A.Words[i] != B.Words[i])
+        return A.Words[i] < B.Words[i] ? -1 : 1;
+    return 0;
+  }
+};
+
+} // end anonymous namespace
+
+/// Find the shortest digits of a value exactly, using Burger and Dybvig's
+/// free-format algorithm.  Capacity must be large enough for the value
+/// scaled by the largest power of ten and power of two its format needs.
+template <unsigned Capacity>
+static void generateShortestDigits(const DecodedFloat &V,
+                                   DecimalDigits &Result) {
+  using Int = BigInt<Capacity>;
+
+  // A value exactly halfway between two representable values reads back as
+  // the one with an even significand, so its boundaries are inclusive.
+  bool IsEven = (V.Significand & 1) == 0;
+
+  // Represent the value as R / S, and the distance to the halfway points
+  // to its neighbours as MPlus / S and MMinus / S.
+  Int R(V.Significand), S(1), MPlus(1), MMinus(1);
+  unsigned LowerShift = V.LowerBoundaryIsCloser ? 1 : 0;
+  if (V.Exponent >= 0) {
+    R.shiftLeft(V.Exponent + 1 + LowerShift);
+    S.shiftLeft(1 + LowerShift);
+    MPlus.shiftLeft(V.Exponent + LowerShift);
+    MMinus.shiftLeft(V.Exponent);
+  } else {
+    R.shiftLeft(1 + LowerShift);
+    S.shiftLeft(-V.Exponent + 1 + LowerShift);
+    MPlus.shiftLeft(LowerShift);
+  }
+
+  // Estimate K = ceil(log10(value)) from the position of the leading bit.
+  // The estimate is never too large, and at most one too small.
+  int LeadingBit =
+    V.Exponent + 63 - int(llvm::countLeadingZeros(V.Significand));
+  int K = int(std::ceil(LeadingBit * Log10Of2 - 1e-10));
+  if (K >= 0) {
+    S.multiplyByPowerOfTen(K);
+  } else {
+    R.multiplyByPowerOfTen(-K);
+    MPlus.multiplyByPowerOfTen(-K);
+    MMinus.multiplyByPowerOfTen(-K);
+  }
+
+  // Make sure the upper boundary is below 10^K, so the first digit is never
+  // rounded up to 10.
+  while (Int::compareSum(R, MPlus, S) >= (IsEven ? 0 : 1)) {
+    S.multiplyBy(10);
+    ++K;
+  }
+
+  Result.Length = 0;
+  while (true) {
+    R.multiplyBy(10);
+    MPlus.multiplyBy(10);
+    MMinus.multiplyBy(10);
+
+    unsigned Digit = 0;
+    while (Int::compare(R, S) >= 0) {
+      R.subtract(S);
+      ++Digit;
+    }
+
+    bool LowOK = Int::compare(R, MMinus) < (IsEven ? 1 : 0);
+    bool HighOK = Int::compareSum(R, MPlus, S) >= (IsEven ? 0 : 1);
+    if (!LowOK && !HighOK) {
+      Result.Digits[Result.Length++] = char('0' + Digit);
+      continue;
+    }
+
+    // Either this digit or the next one up ends the shortest number; pick
+    // whichever is closer to the value, or the even one on a tie.
+    if (LowOK && HighOK) {
+      int Comparison = Int::compareSum(R, R, S);
+      if (Comparison > 0 || (Comparison == 0 && (Digit & 1)))
+        ++Digit;
+    } else if (HighOK) {
+      ++Digit;
+    }
+    Result.Digits[Result.Length++] = char('0' + Digit);
+    break;
+  }
+
+  Result.Exponent = K - Result.Length;
+}
+
+//===----------------------------------------------------------------------===//
+// Formatting
+//===----------------------------------------------------------------------===//
+
+static uint64_t formatNonFinite(char *Buffer, bool Negative, bool IsNaN) {
+  char *P = Buffer;
+  if (Negative)
+    *P++ = '-';
+  memcpy(P, IsNaN ? "nan" : "inf", 3);
+  P += 3;
+  *P = '\0';
+  return uint64_t(P - Buffer);
+}
+
+/// Lay out the digits of a value like printf's "%g" with the given
+/// precision, except that every digit is printed and a value without a
+/// fractional part gets a trailing ".0".
+static uint64_t formatDecimal(char *Buffer, bool Negative,
+                              const DecimalDigits &Value, int Precision) {
+  char *P = Buffer;
+  if (Negative)
+    *P++ = '-';
+
+  const char *Digits = Value.Digits;
+  int Length = Value.Length;
+  int Exponent = Value.Exponent + Length - 1;
+
+  if (Exponent < -4 || Exponent >= Precision) {
+    *P++ = Digits[0];
+    if (Length > 1) {
+      *P++ = '.';
+      memcpy(P, Digits + 1, Length - 1);
+      P += Length - 1;
+    }
+    *P++ = 'e';
+    *P++ = Exponent < 0 ? '-' : '+';
+    unsigned Magnitude = Exponent < 0 ? -Exponent : Exponent;
+    char ExponentDigits[8];
+    int ExponentLength = 0;
+    do {
+      ExponentDigits[ExponentLength++] = char('0' + Magnitude % 10);
+      Magnitude /= 10;
+    } while (Magnitude);
+    if (ExponentLength < 2)
+      ExponentDigits[ExponentLength++] = '0';
+    while (ExponentLength)
+      *P++ = ExponentDigits[--ExponentLength];
+  } else if (Exponent < 0) {
+    *P++ = '0';
+    *P++ = '.';
+    for (int i = -1; i != Exponent; --i)
+      *P++ = '0';
+    memcpy(P, Digits, Length);
+    P += Length;
+  } else {
+    int IntegralLength = Exponent + 1;
+    if (Length <= IntegralLength) {
+      memcpy(P, Digits, Length);
+      P += Length;
+      for (int i = Length; i != IntegralLength; ++i)
+        *P++ = '0';
+      *P++ = '.';
+      *P++ = '0';
+    } else {
+      memcpy(P, Digits, IntegralLength);
+      P += IntegralLength;
+      *P++ = '.';
+      memcpy(P, Digits + IntegralLength, Length - IntegralLength);
+      P += Length - IntegralLength;
+    }
+  }
+
+  *P = '\0';
+  return uint64_t(P - Buffer);
+}
+
+static uint64_t formatZero(char *Buffer, bool Negative) {
+  DecimalDigits Zero;
+  Zero.Digits[0] = '0';
+  Zero.Length = 1;
+  Zero.Exponent = 0;
+  return formatDecimal(Buffer, Negative, Zero, /*Precision=*/1);
+}
+
+/// Format a Float or Double value from its decoded fields.
+static uint64_t formatBinary(char *Buffer, size_t BufferLength,
+                             bool Negative, uint64_t Fraction,
+                             unsigned BiasedExponent, unsigned FractionBits,
+                             unsigned ExponentBits, int Precision) {
+  if (BufferLength < 32)
+    swift::crash("swift_floatingPointToString: insufficient buffer size");
+
+  if (BiasedExponent == (1U << ExponentBits) - 1)
+    return formatNonFinite(Buffer, Negative, Fraction != 0);
+  if (BiasedExponent == 0 && Fraction == 0)
+    return formatZero(Buffer, Negative);
+
+  int Bias = (1 << (ExponentBits - 1)) - 1;
+  DecodedFloat Value = decodeIEEE(Fraction, BiasedExponent, FractionBits,
+                                  Bias);
+  DecimalDigits Digits;
+  if (!grisu3(Value, Digits))
+    generateShortestDigits<40>(Value, Digits);
+  return formatDecimal(Buffer, Negative, Digits, Precision);
+}
+
+/// The precision that decides between fixed and exponential notation.  This
+/// is the precision snprintf was given when it formatted these values.
+template <typename T>
+static int getLayoutPrecision(bool Debug) {
+  return Debug ? std::numeric_limits<T>::max_digits10
+               : std::numeric_limits<T>::digits10;
+}
+
+SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
+extern "C" uint64_t swift_float32ToString(char *Buffer, size_t BufferLength,
+                                          float Value, bool Debug) {
+  uint32_t Bits;
+  static_assert(sizeof(Bits) == sizeof(Value), "Float is not 32 bits");
+  memcpy(&Bits, &Value, sizeof(Bits));
+  return formatBinary(Buffer, BufferLength, Bits >> 31, Bits & 0x7FFFFF,
+                      (Bits >> 23) & 0xFF, 23, 8,
+                      getLayoutPrecision<float>(Debug));
+}
+
+SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
+extern "C" uint64_t swift_float64ToString(char *Buffer, size_t BufferLength,
+                                          double Value, bool Debug) {
+  uint64_t Bits;
+  static_assert(sizeof(Bits) == sizeof(Value), "Double is not 64 bits");
+  memcpy(&Bits, &Value, sizeof(Bits));
+  return formatBinary(Buffer, BufferLength, Bits >> 63,
+                      Bits & 0xFFFFFFFFFFFFFULL, (Bits >> 52) & 0x7FF, 52, 11,
+                      getLayoutPrecision<double>(Debug));
+}
+
+SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
+extern "C" uint64_t swift_float80ToString(char *Buffer, size_t BufferLength,
+                                          long double Value, bool Debug) {
+#if LDBL_MANT_DIG == 64
+  if (BufferLength < 32)
+    swift::crash("swift_floatingPointToString: insufficient buffer size");
+
+  // The x87 extended format has an explicit integer bit, so it isn't one of
+  // the interchange formats decodeIEEE understands.
+  uint64_t Significand;
+  uint16_t SignAndExponent;
+  memcpy(&Significand, &Value, sizeof(Significand));
+  memcpy(&SignAndExponent, reinterpret_cast<const char *>(&Value) + 8,
+         sizeof(SignAndExponent));
+  bool Negative = SignAndExponent >> 15;
+  unsigned BiasedExponent = SignAndExponent & 0x7FFF;
+
+  if (BiasedExponent == 0x7FFF)
+    return formatNonFinite(Buffer, Negative, (Significand << 1) != 0);
+  if (Significand == 0)
+    return formatZero(Buffer, Negative);
+
+  const int Bias = 16383;
+  DecodedFloat Decoded;
+  Decoded.Significand = Significand;
+  if (BiasedExponent == 0) {
+    Decoded.Exponent = 1 - Bias - 63;
+    Decoded.LowerBoundaryIsCloser = false;
+  } else {
+    Decoded.Exponent = int(BiasedExponent) - Bias - 63;
+    Decoded.LowerBoundaryIsCloser =
+      Significand == (uint64_t(1) << 63) && BiasedExponent > 1;
+  }
+
+  // The scaled value of the smallest Float80 needs about 16,520 bits.
+  DecimalDigits Digits;
+  generateShortestDigits<520>(Decoded, Digits);
+  return formatDecimal(Buffer, Negative, Digits,
+                       getLayoutPrecision<long double>(Debug));
+#else
+  // Float80 is only available where long double is the x87 extended format.
+  return swift_float64ToString(Buffer, BufferLength, double(Value), Debug);
+#endif
+}
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "swift/Basic/Lazy.h"
+#include "swift/Runtime/Heap.h"
 #include "../SwiftShims/LibcShims.h"
 #include "llvm/Support/DataTypes.h"
 
@@ -91,6 +92,12 @@ size_t swift::_swift_stdlib_malloc_size(const void *ptr) {
 #elif defined(__GNU_LIBRARY__) || defined(__CYGWIN__) || defined(__ANDROID__)
 #include <malloc.h>
 size_t swift::_swift_stdlib_malloc_size(const void *ptr) {
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+  // Small heap objects may come from the runtime's size class allocator
+  // rather than from malloc.
+  if (size_t size = _swift_getSizeClassBlockSize(ptr))
+    return size;
+#endif
   return malloc_usable_size(const_cast<void *>(ptr));
 }
 #elif defined(_MSC_VER)
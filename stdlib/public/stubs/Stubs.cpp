@@ -30,12 +30,14 @@
 #include <sys/errno.h>
 #include <unistd.h>
 #endif
+#include <cfloat>
 #include <climits>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <iterator>
 #if defined(__CYGWIN__) || defined(_MSC_VER)
 #include <sstream>
 #include <cmath>
@@ -65,37 +67,118 @@ static long double swift_strtold_l(const char *nptr,
 #endif
 #include <limits>
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MathExtras.h"
 #include "swift/Runtime/Debug.h"
 #include "swift/Basic/Lazy.h"
 
 #include "../SwiftShims/RuntimeShims.h"
 #include "../SwiftShims/RuntimeStubs.h"
 
+/// The decimal representations of 0 through 99, two digits each.
+static const char DecimalDigitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/// Return the number of decimal digits in a nonzero value.
+static unsigned countDecimalDigits(uint64_t Value) {
+  static const uint64_t PowersOf10[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+  };
+
+  // 1233 / 4096 is just above log10(2), so this is the number of digits of
+  // the smallest value with as many bits, which is either the right answer
+  // or one too few.
+  unsigned Bits = 64 - llvm::countLeadingZeros(Value);
+  unsigned Digits = (Bits * 1233) >> 12;
+  return Digits + (Value >= PowersOf10[Digits]);
+}
+
+/// Write the decimal digits of \p Value so that they end just before
+/// \p End.
+static void writeDecimalDigits(char *End, uint64_t Value) {
+  // Divide by 100 to produce two digits at a time, and switch to 32-bit
+  // divisions as soon as the value fits.
+  while (Value > UINT32_MAX) {
+    uint64_t Quotient = Value / 100;
+    End -= 2;
+    memcpy(End, &DecimalDigitPairs[(Value - Quotient * 100) * 2], 2);
+    Value = Quotient;
+  }
+  uint32_t Value32 = uint32_t(Value);
+  while (Value32 >= 100) {
+    uint32_t Quotient = Value32 / 100;
+    End -= 2;
+    memcpy(End, &DecimalDigitPairs[(Value32 - Quotient * 100) * 2], 2);
+    Value32 = Quotient;
+  }
+  if (Value32 >= 10) {
+    End -= 2;
+    memcpy(End, &DecimalDigitPairs[Value32 * 2], 2);
+  } else {
+    End[-1] = '0' + char(Value32);
+  }
+}
+
 static uint64_t uint64ToStringImpl(char *Buffer, uint64_t Value,
                                    int64_t Radix, bool Uppercase,
                                    bool Negative) {
   char *P = Buffer;
-  uint64_t Y = Value;
+  if (Negative)
+    *P++ = '-';
 
-  if (Y == 0) {
-    *P++ = '0';
+  // Compute the length first, so that the digits can be written straight
+  // into place from the least significant end.
+  size_t Length;
+  if (Value == 0) {
+    *P = '0';
+    Length = 1;
   } else if (Radix == 10) {
-    while (Y) {
-      *P++ = '0' + char(Y % 10);
-      Y /= 10;
-    }
+    Length = countDecimalDigits(Value);
+    writeDecimalDigits(P + Length, Value);
+  } else if (Radix >= 2 && llvm::isPowerOf2_64(Radix)) {
+    unsigned Shift = llvm::countTrailingZeros(uint64_t(Radix));
+    unsigned Bits = 64 - llvm::countLeadingZeros(Value);
+    Length = (Bits + Shift - 1) / Shift;
+    for (char *Q = P + Length; Q != P; Value >>= Shift)
+      *--Q = llvm::hexdigit(unsigned(Value & (Radix - 1)), !Uppercase);
   } else {
+    char Digits[64];
+    char *Q = std::end(Digits);
     unsigned Radix32 = Radix;
-    while (Y) {
-      *P++ = llvm::hexdigit(Y % Radix32, !Uppercase);
-      Y /= Radix32;
-    }
+    for (uint64_t Y = Value; Y; Y /= Radix32)
+      *--Q = llvm::hexdigit(Y % Radix32, !Uppercase);
+    Length = std::end(Digits) - Q;
+    memcpy(P, Q, Length);
   }
 
-  if (Negative)
-    *P++ = '-';
-  std::reverse(Buffer, P);
-  return size_t(P - Buffer);
+  return uint64_t(P + Length - Buffer);
 }
 
 SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
@@ -158,103 +241,6 @@ static locale_t getCLocale() {
 }
 #endif
 
-#if defined(__APPLE__)
-#define swift_snprintf_l snprintf_l
-#elif defined(__CYGWIN__) || defined(_MSC_VER)
-// In Cygwin, swift_snprintf_l() is not used.
-#else
-static int swift_snprintf_l(char *Str, size_t StrSize, locale_t Locale,
-                            const char *Format, ...) {
-  if (Locale == nullptr) {
-    Locale = getCLocale();
-  }
-  locale_t OldLocale = uselocale(Locale);
-
-  va_list Args;
-  va_start(Args, Format);
-  int Result = std::vsnprintf(Str, StrSize, Format, Args);
-  va_end(Args);
-
-  uselocale(OldLocale);
-
-  return Result;
-}
-#endif
-
-template <typename T>
-static uint64_t swift_floatingPointToString(char *Buffer, size_t BufferLength,
-                                            T Value, const char *Format, 
-                                            bool Debug) {
-  if (BufferLength < 32)
-    swift::crash("swift_floatingPointToString: insufficient buffer size");
-
-  int Precision = std::numeric_limits<T>::digits10;
-  if (Debug) {
-    Precision = std::numeric_limits<T>::max_digits10;
-  }
-
-#if defined(__CYGWIN__) || defined(_MSC_VER)
-  // Cygwin does not support uselocale(), but we can use the locale feature 
-  // in stringstream object.
-  std::ostringstream ValueStream;
-  ValueStream.width(0);
-  ValueStream.precision(Precision);
-  ValueStream.imbue(std::locale::classic());
-  ValueStream << Value;
-  std::string ValueString(ValueStream.str());
-  size_t i = ValueString.length();
-
-  if (i < BufferLength) {
-    std::copy(ValueString.begin(), ValueString.end(), Buffer);
-    Buffer[i] = '\0';
-  } else {
-    swift::crash("swift_floatingPointToString: insufficient buffer size");
-  }
-#else
-  // Pass a null locale to use the C locale.
-  int i = swift_snprintf_l(Buffer, BufferLength, /*locale=*/nullptr, Format,
-                           Precision, Value);
-
-  if (i < 0)
-    swift::crash(
-        "swift_floatingPointToString: unexpected return value from sprintf");
-  if (size_t(i) >= BufferLength)
-    swift::crash("swift_floatingPointToString: insufficient buffer size");
-#endif
-
-  // Add ".0" to a float that (a) is not in scientific notation, (b) does not
-  // already have a fractional part, (c) is not infinite, and (d) is not a NaN
-  // value.
-  if (strchr(Buffer, 'e') == nullptr && strchr(Buffer, '.') == nullptr &&
-      strchr(Buffer, 'n') == nullptr) {
-    Buffer[i++] = '.';
-    Buffer[i++] = '0';
-  }
-
-  return i;
-}
-
-SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
-extern "C" uint64_t swift_float32ToString(char *Buffer, size_t BufferLength,
-                                          float Value, bool Debug) {
-  return swift_floatingPointToString<float>(Buffer, BufferLength, Value,
-                                            "%0.*g", Debug);
-}
-
-SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
-extern "C" uint64_t swift_float64ToString(char *Buffer, size_t BufferLength,
-                                          double Value, bool Debug) {
-  return swift_floatingPointToString<double>(Buffer, BufferLength, Value,
-                                             "%0.*g", Debug);
-}
-
-SWIFT_CC(swift) SWIFT_RUNTIME_STDLIB_INTERFACE
-extern "C" uint64_t swift_float80ToString(char *Buffer, size_t BufferLength,
-                                          long double Value, bool Debug) {
-  return swift_floatingPointToString<long double>(Buffer, BufferLength, Value,
-                                                  "%0.*Lg", Debug);
-}
-
 /// \param[out] LinePtr Replaced with the pointer to the malloc()-allocated
 /// line.  Can be NULL if no characters were read. This buffer should be
 /// freed by the caller if this function returns a positive value.
@@ -438,12 +424,139 @@ __mulodi4(di_int a, di_int b, int* overflow)
 }
 #endif
 
+namespace {
+/// The inputs that parseDecimalFastPath can convert exactly with a single
+/// floating-point operation: the decimal significand must be exactly
+/// representable, and so must the power of ten it is scaled by.
+///
+/// isExact() tells whether that operation rounds only once.  float and
+/// double don't when they are evaluated in extended precision, and long
+/// double is only handled in the x87 format.
+template <typename T> struct DecimalFastPathLimits;
+
+template <> struct DecimalFastPathLimits<float> {
+  static const uint64_t MaxSignificand = uint64_t(1) << 24;
+  static const int MaxExponent = 10;
+  static bool isExact() { return FLT_EVAL_METHOD == 0; }
+};
+
+template <> struct DecimalFastPathLimits<double> {
+  static const uint64_t MaxSignificand = uint64_t(1) << 53;
+  static const int MaxExponent = 22;
+  static bool isExact() { return FLT_EVAL_METHOD == 0; }
+};
+
+template <> struct DecimalFastPathLimits<long double> {
+  static const uint64_t MaxSignificand = ~uint64_t(0);
+  static const int MaxExponent = 27;
+  static bool isExact() { return LDBL_MANT_DIG == 64; }
+};
+} // end anonymous namespace
+
+/// Parse a string consisting entirely of a decimal number, such as "-12.5"
+/// or "3e-7", without going through the C library.  This follows Clinger's
+/// fast path: a number with at most 19 significant digits whose value is
+/// D * 10^E, with D and 10^|E| both exactly representable, is correctly
+/// rounded by computing D * 10^E or D / 10^-E in T.
+///
+/// Returns a pointer to the terminating null character on success, or null
+/// if the string must be parsed by the C library instead.  That includes
+/// anything that isn't a complete decimal number, so that the C library
+/// decides where parsing stops for partial matches.
+template <typename T>
+static const char *parseDecimalFastPath(const char *nptr, T *outResult) {
+  typedef DecimalFastPathLimits<T> Limits;
+  if (!Limits::isExact())
+    return nullptr;
+
+  const char *P = nptr;
+  bool Negative = false;
+  if (*P == '+' || *P == '-')
+    Negative = *P++ == '-';
+
+  // Accumulate the significant digits, and the power of ten they need to
+  // be scaled by.
+  uint64_t Significand = 0;
+  int SignificantDigits = 0;
+  int Exponent = 0;
+  bool SawDigit = false;
+  auto addDigit = [&](char C) -> bool {
+    SawDigit = true;
+    if (Significand == 0 && C == '0')
+      return true;
+    if (++SignificantDigits > 19)
+      return false;
+    Significand = Significand * 10 + (C - '0');
+    return true;
+  };
+
+  for (; *P >= '0' && *P <= '9'; ++P)
+    if (!addDigit(*P))
+      return nullptr;
+  if (*P == '.') {
+    for (++P; *P >= '0' && *P <= '9'; ++P) {
+      if (!addDigit(*P))
+        return nullptr;
+      --Exponent;
+    }
+  }
+  if (!SawDigit)
+    return nullptr;
+
+  if (*P == 'e' || *P == 'E') {
+    ++P;
+    bool NegativeExponent = false;
+    if (*P == '+' || *P == '-')
+      NegativeExponent = *P++ == '-';
+    if (*P < '0' || *P > '9')
+      return nullptr;
+    int ExplicitExponent = 0;
+    for (; *P >= '0' && *P <= '9'; ++P)
+      if (ExplicitExponent < 100000)
+        ExplicitExponent = ExplicitExponent * 10 + (*P - '0');
+    Exponent += NegativeExponent ? -ExplicitExponent : ExplicitExponent;
+  }
+  if (*P != '\0')
+    return nullptr;
+
+  T Value = 0;
+  if (Significand != 0) {
+    if (Significand > Limits::MaxSignificand || Exponent < -Limits::MaxExponent)
+      return nullptr;
+
+    // A large exponent can still be handled if part of it can be moved into
+    // the significand exactly, as in "12e25".
+    for (; Exponent > Limits::MaxExponent; --Exponent) {
+      if (Significand > Limits::MaxSignificand / 10)
+        return nullptr;
+      Significand *= 10;
+    }
+
+    static const long double PowersOfTen[] = {
+      1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+      1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+      1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+    };
+    Value = T(Significand);
+    if (Exponent < 0)
+      Value /= T(PowersOfTen[-Exponent]);
+    else
+      Value *= T(PowersOfTen[Exponent]);
+  }
+
+  *outResult = Negative ? -Value : Value;
+  return P;
+}
+
 #if defined(__CYGWIN__) || defined(_MSC_VER)
 // Cygwin does not support uselocale(), but we can use the locale feature 
 // in stringstream object.
 template <typename T>
 static const char *_swift_stdlib_strtoX_clocale_impl(
     const char *nptr, T *outResult) {
+  if (const char *EndPtr = parseDecimalFastPath(nptr, outResult))
+    return EndPtr;
+
   std::istringstream ValueStream(nptr);
   ValueStream.imbue(std::locale::classic());
   T ParsedValue;
@@ -481,6 +594,9 @@ static const char *_swift_stdlib_strtoX_clocale_impl(
     const char * nptr, T* outResult, T huge,
     T (*posixImpl)(const char *, char **, locale_t)
 ) {
+  if (const char *EndPtr = parseDecimalFastPath(nptr, outResult))
+    return EndPtr;
+
   char *EndPtr;
   errno = 0;
   const auto result = posixImpl(nptr, &EndPtr, getCLocale());
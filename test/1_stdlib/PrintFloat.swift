@@ -205,10 +205,10 @@ PrintTests.test("Printable") {
   expectPrinted("1.25e-17", asFloat80(0.0000000000000000125))
 #endif
 
-  expectDebugPrinted("1.10000002", asFloat32(1.1))
-  expectDebugPrinted("1.24999998e+17", asFloat32(125000000000000000.0))
+  expectDebugPrinted("1.1", asFloat32(1.1))
+  expectDebugPrinted("1.25e+17", asFloat32(125000000000000000.0))
   expectDebugPrinted("1.25", asFloat32(1.25))
-  expectDebugPrinted("1.24999997e-05", asFloat32(0.0000125))
+  expectDebugPrinted("1.25e-05", asFloat32(0.0000125))
   expectDebugPrinted("inf", Float.infinity)
   expectDebugPrinted("-inf", -Float.infinity)
   expectDebugPrinted("nan", Float.nan)
@@ -228,10 +228,10 @@ PrintTests.test("Printable") {
   expectDebugPrinted("snan(0x1fffff)", Float(bitPattern: 0x7fbf_ffff))
 #endif
 
-  expectDebugPrinted("1.1000000000000001", asFloat64(1.1))
+  expectDebugPrinted("1.1", asFloat64(1.1))
   expectDebugPrinted("1.25e+17", asFloat64(125000000000000000.0))
   expectDebugPrinted("1.25", asFloat64(1.25))
-  expectDebugPrinted("1.2500000000000001e-05", asFloat64(0.0000125))
+  expectDebugPrinted("1.25e-05", asFloat64(0.0000125))
   expectDebugPrinted("inf", Double.infinity)
   expectDebugPrinted("-inf", -Double.infinity)
   expectDebugPrinted("nan", Double.nan)
@@ -248,10 +248,10 @@ PrintTests.test("Printable") {
 #endif
 
 #if arch(i386) || arch(x86_64)
-  expectDebugPrinted("1.10000000000000000002", asFloat80(1.1))
+  expectDebugPrinted("1.1", asFloat80(1.1))
   expectDebugPrinted("125000000000000000.0", asFloat80(125000000000000000.0))
   expectDebugPrinted("1.25", asFloat80(1.25))
-  expectDebugPrinted("1.25000000000000000001e-05", asFloat80(0.0000125))
+  expectDebugPrinted("1.25e-05", asFloat80(0.0000125))
   expectDebugPrinted("inf", Float80.infinity)
   expectDebugPrinted("-inf", -Float80.infinity)
   expectDebugPrinted("nan", Float80.nan)
@@ -267,4 +267,54 @@ PrintTests.test("Printable") {
 #endif
 }
 
+PrintTests.test("ShortestRoundTrip") {
+  func asFloat32(_ f: Float32) -> Float32 { return f }
+  func asFloat64(_ f: Float64) -> Float64 { return f }
+
+  // Every value prints with the fewest digits that read back as the same
+  // value, in both description and debugDescription.
+  expectPrinted("0.1", asFloat64(0.1))
+  expectPrinted("0.30000000000000004", asFloat64(0.1) + asFloat64(0.2))
+  expectDebugPrinted("0.30000000000000004", asFloat64(0.1) + asFloat64(0.2))
+  expectPrinted("1e+23", asFloat64(1e23))
+  // The fixed and exponential layouts are chosen the way "%g" chooses them,
+  // with digits10 (description) or max_digits10 (debugDescription) digits of
+  // precision, as before.
+  expectPrinted("9.007199254740992e+15", asFloat64(9007199254740992.0))
+  expectDebugPrinted("9007199254740992.0", asFloat64(9007199254740992.0))
+  expectPrinted("5e-324", Double.leastNonzeroMagnitude)
+  expectPrinted("2.2250738585072014e-308", Double.leastNormalMagnitude)
+  expectPrinted("1.7976931348623157e+308", Double.greatestFiniteMagnitude)
+  expectPrinted("2.220446049250313e-16", Double.ulpOfOne)
+  expectPrinted("-0.0", -asFloat64(0.0))
+
+  expectPrinted("0.1", asFloat32(0.1))
+  expectPrinted("1.6777216e+07", asFloat32(16777216.0))
+  expectDebugPrinted("16777216.0", asFloat32(16777216.0))
+  expectPrinted("1e-45", Float.leastNonzeroMagnitude)
+  expectPrinted("1.1754944e-38", Float.leastNormalMagnitude)
+  expectPrinted("3.4028235e+38", Float.greatestFiniteMagnitude)
+  expectPrinted("-0.0", -asFloat32(0.0))
+
+#if arch(i386) || arch(x86_64)
+  func asFloat80(_ f: Swift.Float80) -> Swift.Float80 { return f }
+  expectPrinted("0.1", asFloat80(0.1))
+  expectPrinted("4e-4951", Float80.leastNonzeroMagnitude)
+  expectPrinted("1.189731495357231765e+4932", Float80.greatestFiniteMagnitude)
+#endif
+
+  var doubleBits: UInt64 = 0
+  while doubleBits < 0x7ff0_0000_0000_0000 {
+    let value = Double(bitPattern: doubleBits)
+    expectEqual(value, Double(value.description)!)
+    doubleBits += 0x0000_7e31_9a5b_2c17
+  }
+  var floatBits: UInt32 = 0
+  while floatBits < 0x7f80_0000 {
+    let value = Float(bitPattern: floatBits)
+    expectEqual(value, Float(value.description)!)
+    floatBits += 0x01a3_b2c7
+  }
+}
+
 runAllTests()
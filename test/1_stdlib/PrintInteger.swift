@@ -146,4 +146,43 @@ PrintTests.test("Printable") {
   expectPrinted("*", CChar32(42)!)
 }
 
+PrintTests.test("DigitCount") {
+  var powerOfTen: UInt64 = 1
+  var digits = "1"
+  var nines = ""
+  for _ in 0..<19 {
+    powerOfTen *= 10
+    digits += "0"
+    nines += "9"
+    expectPrinted(nines, powerOfTen - 1)
+    expectPrinted(digits, powerOfTen)
+    if powerOfTen - 1 <= UInt64(Int64.max) {
+      expectPrinted("-" + nines, -Int64(powerOfTen - 1))
+    }
+  }
+  expectPrinted("4294967295", UInt64(UInt32.max))
+  expectPrinted("4294967296", UInt64(UInt32.max) + 1)
+}
+
+PrintTests.test("Radix") {
+  expectEqual("0", String(UInt64(0), radix: 2))
+  expectEqual("101010", String(UInt64(42), radix: 2))
+  expectEqual("-101010", String(Int64(-42), radix: 2))
+  expectEqual(String(repeating: "1", count: 64), String(UInt64.max, radix: 2))
+  expectEqual("-1" + String(repeating: "0", count: 63),
+              String(Int64.min, radix: 2))
+  expectEqual("1" + String(repeating: "0", count: 21),
+              String(UInt64(1) << 63, radix: 8))
+  expectEqual("-8000000000000000", String(Int64.min, radix: 16))
+  expectEqual("ffffffffffffffff", String(UInt64.max, radix: 16))
+  expectEqual("FFFFFFFFFFFFFFFF",
+              String(UInt64.max, radix: 16, uppercase: true))
+  expectEqual("fvvvvvvvvvvvv", String(UInt64.max, radix: 32))
+  expectEqual("3w5e11264sgsf", String(UInt64.max, radix: 36))
+  expectEqual("-1Y2P0IJ32E8E8",
+              String(Int64.min, radix: 36, uppercase: true))
+  expectEqual("11112220022122120101211020120210210211220",
+              String(UInt64.max, radix: 3))
+}
+
 runAllTests()
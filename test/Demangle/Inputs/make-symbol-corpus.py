@@ -0,0 +1,20 @@
+#!/usr/bin/env python
+#
+# Write a large corpus of nm-style lines for benchmarking swift-demangle.
+#
+# usage: make-symbol-corpus.py <symbols-file> <repetitions>
+
+from __future__ import print_function
+
+import random
+import sys
+
+symbols = [line.strip() for line in open(sys.argv[1]) if line.strip()]
+repetitions = int(sys.argv[2])
+
+# Use a fixed seed so that every run benchmarks the same input.
+rng = random.Random(0)
+for i in range(repetitions):
+    rng.shuffle(symbols)
+    for symbol in symbols:
+        print('%016x T %s' % (rng.randrange(1 << 32), symbol))
@@ -0,0 +1,20 @@
+; This is not really a Swift source file: -*- Text -*-
+
+Benchmark batch mode on a corpus of nm-style lines that spans many input
+blocks.  The throughput is in the statistics printed to the test log.
+
+RUN: sed -ne '/--->/s/ *--->.*$//p' < %S/Inputs/manglings.txt > %t.input
+RUN: %{python} %S/Inputs/make-symbol-corpus.py %t.input 200 > %t.corpus
+RUN: swift-demangle < %t.corpus > %t.check
+RUN: swift-demangle -batch -print-stats < %t.corpus > %t.output 2> %t.stats
+RUN: cat %t.stats
+RUN: diff %t.check %t.output
+RUN: %FileCheck %s < %t.stats
+
+CHECK: threads: {{[1-9][0-9]*}}
+CHECK-NEXT: bytes: {{[1-9][0-9]*}}
+CHECK-NEXT: symbols: {{[1-9][0-9]*}}
+CHECK-NEXT: cache hits: {{[0-9]+}}
+CHECK-NEXT: seconds: {{[0-9.]+}}
+CHECK-NEXT: MB/s: {{[0-9.]+}}
+CHECK-NEXT: symbols/s: {{[0-9]+}}
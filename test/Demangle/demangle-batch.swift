@@ -0,0 +1,20 @@
+; This is not really a Swift source file: -*- Text -*-
+
+%t.input: "A ---> B" ==> "A"
+RUN: sed -ne '/--->/s/ *--->.*$//p' < %S/Inputs/manglings.txt > %t.input
+
+%t.check: "A ---> B" ==> "B"
+RUN: sed -ne '/--->/s/^.*---> *//p' < %S/Inputs/manglings.txt > %t.check
+
+RUN: swift-demangle -batch -j 4 < %t.input > %t.output
+RUN: diff %t.check %t.output
+
+Batch mode replaces symbols embedded in free text exactly like the default
+mode does.
+RUN: sed -e 's/^/0000000000001234 T /' < %t.input > %t.nm
+RUN: swift-demangle < %t.nm > %t.nm.check
+RUN: swift-demangle -batch -j 3 < %t.nm > %t.nm.output
+RUN: diff %t.nm.check %t.nm.output
+
+RUN: printf 'no trailing newline _TtSi' | swift-demangle -batch | %FileCheck %s -check-prefix=NO-NEWLINE
+NO-NEWLINE: no trailing newline Swift.Int
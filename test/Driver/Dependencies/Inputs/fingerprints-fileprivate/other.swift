@@ -0,0 +1,3 @@
+# Dependencies after compilation:
+provides-top-level: [[usesAlias, "uses-alias-after"], [unrelatedFunc, "unrelated-after"]]
+interface-hash: "after"
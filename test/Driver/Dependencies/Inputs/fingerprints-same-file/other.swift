@@ -0,0 +1,4 @@
+# Dependencies after compilation:
+depends-top-level: [foo]
+provides-top-level: [[foo, "foo-after"], [x, "x-same"]]
+interface-hash: "after"
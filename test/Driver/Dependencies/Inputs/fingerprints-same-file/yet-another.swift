@@ -0,0 +1,2 @@
+# Dependencies after compilation:
+depends-top-level: [foo]
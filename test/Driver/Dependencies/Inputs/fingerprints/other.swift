@@ -0,0 +1,3 @@
+# Dependencies after compilation:
+provides-top-level: [[a, "a-same"], [b, "b-after"]]
+interface-hash: "after"
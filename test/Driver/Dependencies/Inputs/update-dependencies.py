@@ -24,6 +24,8 @@
 # the old dependencies (if present).
 #
 # If invoked in non-primary-file mode, it only creates the output file.
+# If invoked with several primary files, as in batch mode, it handles each of
+# them in turn, matching them to their outputs by position.
 #
 # ----------------------------------------------------------------------------
 
@@ -35,24 +37,28 @@ import sys
 
 assert sys.argv[1] == '-frontend'
 
-if '-primary-file' in sys.argv:
-    primaryFile = sys.argv[sys.argv.index('-primary-file') + 1]
-    depsFile = sys.argv[sys.argv.index(
-        '-emit-reference-dependencies-path') + 1]
 
+def values_of(option):
+    return [sys.argv[i + 1] for i, arg in enumerate(sys.argv)
+            if arg == option]
+
+
+primaryFiles = values_of('-primary-file')
+depsFiles = values_of('-emit-reference-dependencies-path')
+outputFiles = values_of('-o')
+
+for primaryFile, depsFile in zip(primaryFiles, depsFiles):
     # Replace the dependencies file with the input file.
     shutil.copyfile(primaryFile, depsFile)
-else:
-    primaryFile = None
-
-outputFile = sys.argv[sys.argv.index('-o') + 1]
 
-# Update the output file mtime, or create it if necessary.
+# Update the output file mtimes, or create them if necessary.
 # From http://stackoverflow.com/a/1160227.
-with open(outputFile, 'a'):
-    os.utime(outputFile, None)
+for outputFile in outputFiles:
+    with open(outputFile, 'a'):
+        os.utime(outputFile, None)
 
-if primaryFile:
-    print("Handled", os.path.basename(primaryFile))
+if primaryFiles:
+    for primaryFile in primaryFiles:
+        print("Handled", os.path.basename(primaryFile))
 else:
-    print("Produced", os.path.basename(outputFile))
+    print("Produced", os.path.basename(outputFiles[0]))
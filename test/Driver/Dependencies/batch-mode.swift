@@ -0,0 +1,52 @@
+// other ==> main ==> yet-another
+
+// RUN: rm -rf %t && cp -r %S/Inputs/chained/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -enable-batch-mode -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-FIRST %s
+
+// CHECK-FIRST-NOT: warning
+// CHECK-FIRST: -primary-file ./main.swift -primary-file ./other.swift -primary-file ./yet-another.swift
+// CHECK-FIRST-SAME: -emit-reference-dependencies-path ./main.swiftdeps -emit-reference-dependencies-path ./other.swiftdeps -emit-reference-dependencies-path ./yet-another.swiftdeps
+// CHECK-FIRST-SAME: -o ./main.o -o ./other.o -o ./yet-another.o
+// CHECK-FIRST-NEXT: Handled main.swift
+// CHECK-FIRST-NEXT: Handled other.swift
+// CHECK-FIRST-NEXT: Handled yet-another.swift
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -enable-batch-mode -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-SECOND %s
+
+// CHECK-SECOND-NOT: Handled
+
+// The dependents of other.swift are only known once it has been rebuilt, so
+// they are batched together afterwards.
+
+// RUN: touch -t 201401240006 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -enable-batch-mode -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-THIRD %s
+
+// CHECK-THIRD-NOT: -primary-file ./main.swift
+// CHECK-THIRD: -primary-file ./other.swift
+// CHECK-THIRD-NEXT: Handled other.swift
+// CHECK-THIRD-NEXT: -primary-file ./main.swift -primary-file ./yet-another.swift
+// CHECK-THIRD-NEXT: Handled main.swift
+// CHECK-THIRD-NEXT: Handled yet-another.swift
+
+// With two batches, each gets a contiguous run of the ready files.
+
+// RUN: touch -t 201401240007 %t/*.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -enable-batch-mode -driver-batch-count 2 -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-FOURTH %s
+
+// CHECK-FOURTH: -primary-file ./main.swift {{.*}}./other.swift {{.*}}./yet-another.swift
+// CHECK-FOURTH-NEXT: Handled main.swift
+// CHECK-FOURTH-NEXT: -primary-file ./other.swift -primary-file ./yet-another.swift
+// CHECK-FOURTH-NEXT: Handled other.swift
+// CHECK-FOURTH-NEXT: Handled yet-another.swift
+
+// -disable-batch-mode wins if it comes last.
+
+// RUN: touch -t 201401240008 %t/*.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -enable-batch-mode -disable-batch-mode -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-DISABLED %s
+
+// CHECK-DISABLED-NOT: -primary-file {{.*}} -primary-file
+// CHECK-DISABLED: Handled main.swift
+// CHECK-DISABLED: Handled other.swift
+// CHECK-DISABLED: Handled yet-another.swift
@@ -0,0 +1,52 @@
+// other ==> main ==> yet-another
+
+// RUN: rm -rf %t && cp -r %S/Inputs/chained/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// A build record without a version still provides job times, even though
+// everything has to be rebuilt.
+
+// RUN: echo '{job_usage: {"./main.swift": [1000, 0], "./other.swift": [5000, 0], "./yet-another.swift": [3000, 0]}}' > %t/main~buildrecord.swiftdeps
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j2 -driver-show-schedule 2>&1 | %FileCheck -check-prefix=CHECK-LONGEST-FIRST %s
+
+// CHECK-LONGEST-FIRST: Scheduling compile other.swift (expected 5000 ms, critical path 5000 ms)
+// CHECK-LONGEST-FIRST: Scheduling compile yet-another.swift (expected 3000 ms, critical path 3000 ms)
+// CHECK-LONGEST-FIRST: Scheduling compile main.swift (expected 1000 ms, critical path 1000 ms)
+// CHECK-LONGEST-FIRST-DAG: Finished compile main.swift in {{[0-9]+}} ms, peak RSS {{[0-9]+}} KB
+// CHECK-LONGEST-FIRST-DAG: Finished compile other.swift in {{[0-9]+}} ms, peak RSS {{[0-9]+}} KB
+// CHECK-LONGEST-FIRST-DAG: Finished compile yet-another.swift in {{[0-9]+}} ms, peak RSS {{[0-9]+}} KB
+
+// RUN: %FileCheck -check-prefix=CHECK-RECORD %s < %t/main~buildrecord.swiftdeps
+
+// CHECK-RECORD: job_usage:
+// CHECK-RECORD-DAG: "./main.swift": [{{[0-9]+}}, {{[0-9]+}}]
+// CHECK-RECORD-DAG: "./other.swift": [{{[0-9]+}}, {{[0-9]+}}]
+// CHECK-RECORD-DAG: "./yet-another.swift": [{{[0-9]+}}, {{[0-9]+}}]
+
+// Running one job at a time, the order doesn't matter, so it isn't changed.
+
+// RUN: echo '{job_usage: {"./main.swift": [1000, 0], "./other.swift": [5000, 0], "./yet-another.swift": [3000, 0]}}' > %t/main~buildrecord.swiftdeps
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -driver-show-schedule 2>&1 | %FileCheck -check-prefix=CHECK-IN-ORDER %s
+
+// CHECK-IN-ORDER: Scheduling compile main.swift
+// CHECK-IN-ORDER: Scheduling compile other.swift
+// CHECK-IN-ORDER: Scheduling compile yet-another.swift
+
+// A file without a previous time is expected to take as long as the average.
+
+// RUN: echo '{job_usage: {"./main.swift": [1000, 0], "./other.swift": [5000, 0]}}' > %t/main~buildrecord.swiftdeps
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j2 -driver-show-schedule 2>&1 | %FileCheck -check-prefix=CHECK-AVERAGE %s
+
+// CHECK-AVERAGE: Scheduling compile other.swift (expected 5000 ms, critical path 5000 ms)
+// CHECK-AVERAGE: Scheduling compile yet-another.swift (expected 3000 ms, critical path 3000 ms)
+// CHECK-AVERAGE: Scheduling compile main.swift (expected 1000 ms, critical path 1000 ms)
+
+// The critical path of each compile job includes the merge-module job.
+
+// RUN: echo '{job_usage: {"./main.swift": [1000, 0], "./other.swift": [2000, 0], "./yet-another.swift": [3000, 0], "merge-module": [4000, 0]}}' > %t/main~buildrecord.swiftdeps
+// RUN: cd %t && %swiftc_driver -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -emit-module-path %t/master.swiftmodule -module-name main -j2 -driver-show-schedule 2>&1 | %FileCheck -check-prefix=CHECK-MERGE-MODULE %s
+
+// CHECK-MERGE-MODULE: Scheduling compile yet-another.swift (expected 3000 ms, critical path 7000 ms)
+// CHECK-MERGE-MODULE: Scheduling compile other.swift (expected 2000 ms, critical path 6000 ms)
+// CHECK-MERGE-MODULE: Scheduling compile main.swift (expected 1000 ms, critical path 5000 ms)
+// CHECK-MERGE-MODULE: Scheduling merge-module master.swiftmodule (expected 4000 ms, critical path 4000 ms)
@@ -0,0 +1,76 @@
+/// other ==> main
+/// "./main1-external" ==> main
+/// "./main2-external" ==> main
+/// "./other1-external" ==> other
+/// "./other2-external" ==> other
+
+// RUN: rm -rf %t && cp -r %S/Inputs/one-way-external/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-FIRST %s
+
+// CHECK-FIRST-NOT: warning
+// CHECK-FIRST: Handled main.swift
+// CHECK-FIRST: Handled other.swift
+
+// RUN: %FileCheck -check-prefix=CHECK-RECORD %s < %t/main~buildrecord.swiftdeps
+
+// CHECK-RECORD: input_hashes:
+// CHECK-RECORD-NEXT: "./main.swift": "{{[0-9a-f]+}}"
+// CHECK-RECORD-NEXT: "./other.swift": "{{[0-9a-f]+}}"
+// CHECK-RECORD: external_dependency_hashes:
+// CHECK-RECORD-DAG: "./main1-external": "{{[0-9a-f]+}}"
+// CHECK-RECORD-DAG: "./other1-external": "{{[0-9a-f]+}}"
+
+// Touching an input without changing it doesn't rebuild anything.
+
+// RUN: touch -t 201401240006 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-NONE %s
+
+// CHECK-NONE-NOT: Handled
+
+// ...but without hashing, it does.
+
+// RUN: touch -t 201401240007 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -disable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-OTHER %s
+
+// CHECK-OTHER: Handled other.swift
+// CHECK-OTHER: Handled main.swift
+
+// Changing the contents of an input rebuilds it.
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-NONE %s
+// RUN: echo '# changed' >> %t/other.swift
+// RUN: touch -t 201401240008 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-OTHER %s
+
+// The same goes for external dependencies.
+
+// RUN: touch -t 203704010005 %t/other1-external
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-NONE %s
+
+// RUN: echo 'changed' >> %t/other1-external
+// RUN: touch -t 203704010005 %t/other1-external
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-EXTERNAL %s
+
+// CHECK-EXTERNAL-DAG: Handled other.swift
+// CHECK-EXTERNAL-DAG: Handled main.swift
+
+// A new external dependency that changed after the build started isn't
+// hashed, since the build may have read an older version of it.  The next
+// build treats it as changed.
+
+// RUN: rm -rf %t && cp -r %S/Inputs/one-way-external/ %t
+// RUN: touch -t 201401240005 %t/*
+// RUN: touch -t 203704010005 %t/main1-external
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-FIRST %s
+// RUN: %FileCheck -check-prefix=CHECK-NEW-EXTERNAL %s < %t/main~buildrecord.swiftdeps
+
+// CHECK-NEW-EXTERNAL: external_dependency_hashes:
+// CHECK-NEW-EXTERNAL-NOT: "./main1-external"
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -enable-incremental-file-hashing -driver-always-rebuild-dependents ./main.swift ./other.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-MAIN %s
+
+// CHECK-MAIN-NOT: Handled other.swift
+// CHECK-MAIN: Handled main.swift
+// CHECK-MAIN-NOT: Handled other.swift
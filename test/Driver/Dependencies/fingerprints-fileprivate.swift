@@ -0,0 +1,22 @@
+/// other ==> main (usesAlias)
+/// other ==> yet-another (unrelatedFunc)
+
+// other.swift has "fileprivate typealias Alias", "func usesAlias() -> Alias"
+// and "func unrelatedFunc()". Other files can't see Alias, so changing it
+// changes the fingerprint of every name other.swift provides.
+
+// RUN: rm -rf %t && cp -r %S/Inputs/fingerprints-fileprivate/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v
+
+// The old .swiftdeps has the fingerprints from before Alias changed, so
+// every file that uses other.swift is rebuilt.
+
+// RUN: cp %S/Inputs/fingerprints-fileprivate/other.swiftdeps %t
+// RUN: touch -t 201401240006 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v 2>&1 | %FileCheck %s
+
+// CHECK: Handled other.swift
+// CHECK-DAG: Handled main.swift
+// CHECK-DAG: Handled yet-another.swift
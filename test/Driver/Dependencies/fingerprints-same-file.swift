@@ -0,0 +1,21 @@
+/// other ==> main (x)
+/// other ==> yet-another (foo)
+
+// other.swift has "func foo()" and "let x = foo()", so x's type changes
+// whenever foo's result type does, though x's fingerprint doesn't.
+
+// RUN: rm -rf %t && cp -r %S/Inputs/fingerprints-same-file/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v
+
+// Only foo's fingerprint differs in the old .swiftdeps, but since other uses
+// foo itself, the files that use x are rebuilt too.
+
+// RUN: cp %S/Inputs/fingerprints-same-file/other.swiftdeps %t
+// RUN: touch -t 201401240006 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v 2>&1 | %FileCheck %s
+
+// CHECK: Handled other.swift
+// CHECK-DAG: Handled main.swift
+// CHECK-DAG: Handled yet-another.swift
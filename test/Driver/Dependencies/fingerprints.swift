@@ -0,0 +1,38 @@
+/// other ==> main (a)
+/// other ==> yet-another (b)
+
+// RUN: rm -rf %t && cp -r %S/Inputs/fingerprints/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// Generate the build record...
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v
+
+// ...then reset other's .swiftdeps, in which only b's fingerprint differs.
+// RUN: cp %S/Inputs/fingerprints/other.swiftdeps %t
+
+// Only the file that uses b is rebuilt.
+
+// RUN: touch -t 201401240006 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-B %s
+
+// CHECK-B-NOT: Handled main.swift
+// CHECK-B: Handled other.swift
+// CHECK-B-NOT: Handled main.swift
+// CHECK-B: Handled yet-another.swift
+// CHECK-B-NOT: Handled main.swift
+
+// Without fingerprints, every dependent is rebuilt.
+
+// RUN: sed -e 's/\[\([ab]\), "[^"]*"\]/\1/g' %S/Inputs/fingerprints/other.swiftdeps > %t/other.swiftdeps
+// RUN: touch -t 201401240007 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-ALL %s
+
+// CHECK-ALL: Handled other.swift
+// CHECK-ALL-DAG: Handled main.swift
+// CHECK-ALL-DAG: Handled yet-another.swift
+
+// Cascading builds still rebuild every dependent.
+
+// RUN: cp %S/Inputs/fingerprints/other.swiftdeps %t
+// RUN: touch -t 201401240008 %t/other.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./main.swift ./other.swift ./yet-another.swift -module-name main -j1 -v 2>&1 | %FileCheck -check-prefix=CHECK-ALL %s
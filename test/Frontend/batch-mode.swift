@@ -0,0 +1,40 @@
+// RUN: rm -rf %t && mkdir %t
+
+// RUN: %target-swift-frontend -emit-ir -primary-file %s -primary-file %S/Inputs/filelist-other.swift -module-name main -o %t/batch-mode.ll -o %t/filelist-other.ll -emit-reference-dependencies-path %t/batch-mode.swiftdeps -emit-reference-dependencies-path %t/filelist-other.swiftdeps
+// RUN: %FileCheck -check-prefix=CHECK-MAIN-IR %s < %t/batch-mode.ll
+// RUN: %FileCheck -check-prefix=CHECK-OTHER-IR %s < %t/filelist-other.ll
+// RUN: %FileCheck -check-prefix=CHECK-MAIN-DEPS %s < %t/batch-mode.swiftdeps
+// RUN: %FileCheck -check-prefix=CHECK-OTHER-DEPS %s < %t/filelist-other.swiftdeps
+
+// The primary files can be given in either order, as long as the outputs are
+// given in the same order.
+// RUN: %target-swift-frontend -emit-ir -primary-file %S/Inputs/filelist-other.swift -primary-file %s -module-name main -o %t/filelist-other.ll -o %t/batch-mode.ll
+// RUN: %FileCheck -check-prefix=CHECK-MAIN-IR %s < %t/batch-mode.ll
+// RUN: %FileCheck -check-prefix=CHECK-OTHER-IR %s < %t/filelist-other.ll
+
+// CHECK-MAIN-IR: define {{.*}}13batchModeMain
+// CHECK-MAIN-IR-NOT: define {{.*}}5other
+
+// CHECK-OTHER-IR-NOT: define {{.*}}13batchModeMain
+// CHECK-OTHER-IR: define {{.*}}5other
+// CHECK-OTHER-IR-NOT: define {{.*}}13batchModeMain
+
+// CHECK-MAIN-DEPS-LABEL: provides-top-level:
+// CHECK-MAIN-DEPS: "batchModeMain"
+// CHECK-MAIN-DEPS-NOT: "other"
+// CHECK-MAIN-DEPS-LABEL: depends-top-level:
+// CHECK-MAIN-DEPS: "Foo"
+
+// CHECK-OTHER-DEPS-LABEL: provides-top-level:
+// CHECK-OTHER-DEPS-NOT: "batchModeMain"
+// CHECK-OTHER-DEPS: "other"
+
+// RUN: not %target-swift-frontend -emit-ir -primary-file %s -primary-file %S/Inputs/filelist-other.swift -module-name main -o %t/batch-mode.ll 2>&1 | %FileCheck -check-prefix=CHECK-OUTPUT-COUNT %s
+// CHECK-OUTPUT-COUNT: error: with more than one primary file, '-o' must be given once for each of the 2 primary files
+
+// RUN: not %target-swift-frontend -emit-ir -primary-file %s -primary-file %S/Inputs/filelist-other.swift -module-name main -o %t/batch-mode.ll -o %t/filelist-other.ll -emit-reference-dependencies-path %t/batch-mode.swiftdeps 2>&1 | %FileCheck -check-prefix=CHECK-DEPS-COUNT %s
+// CHECK-DEPS-COUNT: error: with more than one primary file, '-emit-reference-dependencies-path' must be given once for each of the 2 primary files
+
+func batchModeMain() -> Foo {
+  return Foo()
+}
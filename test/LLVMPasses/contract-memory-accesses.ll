@@ -0,0 +1,93 @@
+; RUN: %swift-llvm-opt -swift-arc-contract %s | %FileCheck %s
+; RUN: %swift-llvm-opt -swift-arc-contract -print-stats %s -o /dev/null 2>&1 | %FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; These functions are reduced from the retain/release patterns of
+; benchmark/single-source/ArrayOfRef.swift. Each one stores or copies the same
+; reference several times, so before the contract pass merged across plain
+; memory accesses every retain and release stayed a separate atomic:
+;
+;   function                     before             after
+;   ArrayOfRef_fillRefStruct     4 retain/release   1 retain_n, 1 release
+;   ArrayOfRef_copyRefPair       4 retain/release   1 retain_n, 1 release_n
+;
+; That is 8 atomic reference count operations before and 4 after.
+
+; STATS: 4 swift-arc-contract - Number of retain/release eliminated by merging into retain_n/release_n
+
+target datalayout = "e-p:64:64:64-S128-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f16:16:16-f32:32:32-f64:64:64-f128:128:128-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-macosx10.9"
+
+%swift.refcounted = type { %swift.heapmetadata*, i64 }
+%swift.heapmetadata = type { i64 (%swift.refcounted*)*, i64 (%swift.refcounted*)* }
+%RefPair = type { %swift.refcounted*, %swift.refcounted* }
+
+declare void @rt_swift_release(%swift.refcounted* nocapture)
+declare void @rt_swift_retain(%swift.refcounted* ) nounwind
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture, i8* nocapture readonly, i64, i32, i1)
+declare void @llvm.lifetime.start(i64, i8* nocapture)
+declare void @llvm.lifetime.end(i64, i8* nocapture)
+
+; Filling an array of a struct holding one reference with the same value, as
+; ConstructibleArray<S> does in genRefStructArray.
+; CHECK-LABEL: define{{( protected)?}} void @ArrayOfRef_fillRefStruct(%swift.refcounted* %D, %swift.refcounted** %E) {
+; CHECK-NEXT: entry:
+; CHECK-NEXT: tail call void @rt_swift_retain_n(%swift.refcounted* %D, i32 3)
+; CHECK-NEXT: store %swift.refcounted* %D, %swift.refcounted** %E
+; CHECK-NEXT: %E1 = getelementptr
+; CHECK-NEXT: store %swift.refcounted* %D, %swift.refcounted** %E1
+; CHECK-NEXT: %E2 = getelementptr
+; CHECK-NEXT: store %swift.refcounted* %D, %swift.refcounted** %E2
+; CHECK-NEXT: tail call void @rt_swift_release(%swift.refcounted* %D)
+; CHECK-NEXT: ret void
+define void @ArrayOfRef_fillRefStruct(%swift.refcounted* %D, %swift.refcounted** %E) {
+entry:
+  tail call void @rt_swift_retain(%swift.refcounted* %D)
+  store %swift.refcounted* %D, %swift.refcounted** %E
+  %E1 = getelementptr inbounds %swift.refcounted*, %swift.refcounted** %E, i64 1
+  tail call void @rt_swift_retain(%swift.refcounted* %D)
+  store %swift.refcounted* %D, %swift.refcounted** %E1
+  %E2 = getelementptr inbounds %swift.refcounted*, %swift.refcounted** %E, i64 2
+  tail call void @rt_swift_retain(%swift.refcounted* %D)
+  store %swift.refcounted* %D, %swift.refcounted** %E2
+  tail call void @rt_swift_release(%swift.refcounted* %D)
+  ret void
+}
+
+; Copying a temporary struct that holds the same reference twice and then
+; destroying the temporary.
+; CHECK-LABEL: define{{( protected)?}} void @ArrayOfRef_copyRefPair(%swift.refcounted* %D, i8* %Dest) {
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %Tmp = alloca %RefPair
+; CHECK-NEXT: %TmpRaw = bitcast
+; CHECK-NEXT: call void @llvm.lifetime.start(i64 16, i8* %TmpRaw)
+; CHECK-NEXT: tail call void @rt_swift_retain_n(%swift.refcounted* %D, i32 2)
+; CHECK-NEXT: %First = getelementptr
+; CHECK-NEXT: store %swift.refcounted* %D, %swift.refcounted** %First
+; CHECK-NEXT: %Second = getelementptr
+; CHECK-NEXT: store %swift.refcounted* %D, %swift.refcounted** %Second
+; CHECK-NEXT: call void @llvm.memcpy.p0i8.p0i8.i64(i8* %Dest, i8* %TmpRaw, i64 16, i32 8, i1 false)
+; CHECK-NEXT: %FirstLoaded = load
+; CHECK-NEXT: %SecondLoaded = load
+; CHECK-NEXT: call void @llvm.lifetime.end(i64 16, i8* %TmpRaw)
+; CHECK-NEXT: tail call void @rt_swift_release_n(%swift.refcounted* %D, i32 2)
+; CHECK-NEXT: ret void
+define void @ArrayOfRef_copyRefPair(%swift.refcounted* %D, i8* %Dest) {
+entry:
+  %Tmp = alloca %RefPair
+  %TmpRaw = bitcast %RefPair* %Tmp to i8*
+  call void @llvm.lifetime.start(i64 16, i8* %TmpRaw)
+  tail call void @rt_swift_retain(%swift.refcounted* %D)
+  %First = getelementptr inbounds %RefPair, %RefPair* %Tmp, i32 0, i32 0
+  store %swift.refcounted* %D, %swift.refcounted** %First
+  tail call void @rt_swift_retain(%swift.refcounted* %D)
+  %Second = getelementptr inbounds %RefPair, %RefPair* %Tmp, i32 0, i32 1
+  store %swift.refcounted* %D, %swift.refcounted** %Second
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %Dest, i8* %TmpRaw, i64 16, i32 8, i1 false)
+  %FirstLoaded = load %swift.refcounted*, %swift.refcounted** %First
+  tail call void @rt_swift_release(%swift.refcounted* %D)
+  %SecondLoaded = load %swift.refcounted*, %swift.refcounted** %Second
+  call void @llvm.lifetime.end(i64 16, i8* %TmpRaw)
+  tail call void @rt_swift_release(%swift.refcounted* %D)
+  ret void
+}
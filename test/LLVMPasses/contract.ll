@@ -19,6 +19,7 @@ declare void @noread_user(%swift.refcounted*) readnone
 declare void @user(%swift.refcounted*)
 declare void @noread_user_bridged(%swift.bridge*) readnone
 declare void @user_bridged(%swift.bridge*)
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture, i8* nocapture readonly, i64, i32, i1)
 
 ; CHECK-LABEL: define{{( protected)?}} void @fixlifetime_removal(i8*) {
 ; CHECK-NOT: call void swift_fixLifetime
@@ -572,6 +573,42 @@ bb3:
   ret %swift.bridge* %A
 }
 
+; Copying a struct that holds the same reference twice does not separate
+; the retains and releases of the reference.
+; CHECK-LABEL: define{{( protected)?}} void @swift_contractRetainReleaseNAcrossMemoryAccesses(%swift.refcounted* %A, %swift.refcounted** %P, i8* %D, i8* %S) {
+; CHECK-NEXT: entry:
+; CHECK-NEXT: tail call void @rt_swift_retain_n(%swift.refcounted* %A, i32 2)
+; CHECK-NEXT: store %swift.refcounted* %A, %swift.refcounted** %P
+; CHECK-NEXT: call void @llvm.memcpy.p0i8.p0i8.i64(i8* %D, i8* %S, i64 16, i32 8, i1 false)
+; CHECK-NEXT: load %swift.refcounted*, %swift.refcounted** %P
+; CHECK-NEXT: tail call void @rt_swift_release_n(%swift.refcounted* %A, i32 2)
+; CHECK-NEXT: ret void
+define void @swift_contractRetainReleaseNAcrossMemoryAccesses(%swift.refcounted* %A, %swift.refcounted** %P, i8* %D, i8* %S) {
+entry:
+  tail call void @rt_swift_retain(%swift.refcounted* %A)
+  store %swift.refcounted* %A, %swift.refcounted** %P
+  tail call void @rt_swift_retain(%swift.refcounted* %A)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %D, i8* %S, i64 16, i32 8, i1 false)
+  tail call void @rt_swift_release(%swift.refcounted* %A)
+  %0 = load %swift.refcounted*, %swift.refcounted** %P
+  tail call void @rt_swift_release(%swift.refcounted* %A)
+  ret void
+}
+
+; Atomic and volatile accesses still separate them.
+; CHECK-LABEL: define{{( protected)?}} void @swift_contractRetainNAcrossOrderedMemoryAccesses(%swift.refcounted* %A, %swift.refcounted** %P, i8* %D, i8* %S) {
+; CHECK-NOT: @rt_swift_retain_n
+; CHECK: ret void
+define void @swift_contractRetainNAcrossOrderedMemoryAccesses(%swift.refcounted* %A, %swift.refcounted** %P, i8* %D, i8* %S) {
+entry:
+  tail call void @rt_swift_retain(%swift.refcounted* %A)
+  store atomic %swift.refcounted* %A, %swift.refcounted** %P release, align 8
+  tail call void @rt_swift_retain(%swift.refcounted* %A)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %D, i8* %S, i64 16, i32 8, i1 true)
+  tail call void @rt_swift_retain(%swift.refcounted* %A)
+  ret void
+}
+
 !llvm.dbg.cu = !{!1}
 !llvm.module.flags = !{!4}
 
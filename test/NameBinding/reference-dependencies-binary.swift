@@ -0,0 +1,20 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: cp %S/reference-dependencies.swift %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift %S/Inputs/reference-dependencies-helper.swift -emit-reference-dependencies-path %t/yaml.swiftdeps
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift %S/Inputs/reference-dependencies-helper.swift -emit-reference-dependencies-path %t/binary.swiftdeps -binary-reference-dependencies
+// RUN: not diff -q %t/yaml.swiftdeps %t/binary.swiftdeps
+// RUN: swift-dependency-tool %t/binary.swiftdeps -o %t/converted.swiftdeps
+// RUN: diff %t/yaml.swiftdeps %t/converted.swiftdeps
+
+// YAML files are printed unchanged.
+// RUN: swift-dependency-tool %t/yaml.swiftdeps | diff %t/yaml.swiftdeps -
+
+// RUN: mkdir %t/members
+// RUN: cp %S/reference-dependencies-members.swift %t/members/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/members/main.swift %S/Inputs/reference-dependencies-members-helper.swift -emit-reference-dependencies-path %t/members-yaml.swiftdeps
+// RUN: %target-swift-frontend -parse -primary-file %t/members/main.swift %S/Inputs/reference-dependencies-members-helper.swift -emit-reference-dependencies-path %t/members-binary.swiftdeps -binary-reference-dependencies
+// RUN: swift-dependency-tool %t/members-binary.swiftdeps | diff %t/members-yaml.swiftdeps -
+
+// RUN: printf '\000SWD' > %t/truncated.swiftdeps
+// RUN: not swift-dependency-tool %t/truncated.swiftdeps 2>&1 | %FileCheck -check-prefix=TRUNCATED %s
+// TRUNCATED: error: '{{.*}}truncated.swiftdeps' is not a valid binary dependencies file
@@ -0,0 +1,27 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: cp %s %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/before.swiftdeps
+
+// Other files can't see the fileprivate typealias, so no fingerprint covers
+// it on its own. Changing it changes what usesAlias returns, so it changes
+// every fingerprint in the file.
+
+// RUN: sed -e 's/fileprivate typealias Alias = Int/fileprivate typealias Alias = String/' %s > %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/after.swiftdeps
+// RUN: cat %t/before.swiftdeps %t/after.swiftdeps | %FileCheck %s
+
+// CHECK: provides-top-level:
+// CHECK-NEXT: - ["usesAlias", "[[USES_ALIAS:[0-9a-f]+]]"]
+// CHECK-NEXT: - ["unrelatedFunc", "[[UNRELATED:[0-9a-f]+]]"]
+
+// CHECK: provides-top-level:
+// CHECK-NEXT: - ["usesAlias", "
+// CHECK-NOT: [[USES_ALIAS]]
+// CHECK-SAME: "]
+// CHECK-NEXT: - ["unrelatedFunc", "
+// CHECK-NOT: [[UNRELATED]]
+// CHECK-SAME: "]
+
+fileprivate typealias Alias = Int
+func usesAlias() -> Alias { return Alias() }
+func unrelatedFunc() -> Int { return 0 }
@@ -0,0 +1,37 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: cp %s %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/before.swiftdeps
+
+// Changing one declaration's interface only changes its own fingerprint.
+// Changing a function body doesn't change any.
+
+// RUN: sed -e 's/func changedFunc() -> Int/func changedFunc() -> Int8/' -e 's/return 1 \/\/ body/return 2 \/\/ body/' %s > %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/after.swiftdeps
+// RUN: cat %t/before.swiftdeps %t/after.swiftdeps | %FileCheck %s
+
+// CHECK: provides-top-level:
+// CHECK-NEXT: - ["changedFunc", "[[CHANGED:[0-9a-f]+]]"]
+// CHECK-NEXT: - ["unchangedFunc", "[[UNCHANGED:[0-9a-f]+]]"]
+// CHECK-NEXT: - ["bodyChangedFunc", "[[BODY:[0-9a-f]+]]"]
+// CHECK-NEXT: - ["UnchangedStruct", "[[STRUCT:[0-9a-f]+]]"]
+// CHECK: provides-member:
+// CHECK-NEXT: - ["V4main15UnchangedStruct", "", "[[STRUCT_MEMBERS:[0-9a-f]+]]"]
+
+// CHECK: provides-top-level:
+// CHECK-NEXT: - ["changedFunc", "
+// CHECK-NOT: [[CHANGED]]
+// CHECK-SAME: "]
+// CHECK-NEXT: - ["unchangedFunc", "[[UNCHANGED]]"]
+// CHECK-NEXT: - ["bodyChangedFunc", "[[BODY]]"]
+// CHECK-NEXT: - ["UnchangedStruct", "[[STRUCT]]"]
+// CHECK: provides-member:
+// CHECK-NEXT: - ["V4main15UnchangedStruct", "", "[[STRUCT_MEMBERS]]"]
+
+func changedFunc() -> Int { return 0 }
+func unchangedFunc() -> Int { return 0 }
+func bodyChangedFunc() -> Int {
+  return 1 // body
+}
+struct UnchangedStruct {
+  func method() {}
+}
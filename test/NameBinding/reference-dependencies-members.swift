@@ -23,16 +23,16 @@
 
 // PROVIDES-NOMINAL-DAG: 4Base"
 class Base {
-  // PROVIDES-MEMBER-DAG: - ["{{.+}}4Base", ""]
-  // PROVIDES-MEMBER-NEGATIVE-NOT: - ["{{.+}}4Base", "{{.+}}"]
+  // PROVIDES-MEMBER-DAG: - ["{{.+}}4Base", "", "{{[0-9a-f]+}}"]
+  // PROVIDES-MEMBER-NEGATIVE-NOT: - ["{{.+}}4Base", "{{[^"]+}}"
   func foo() {}
 }
   
 // PROVIDES-NOMINAL-DAG: 3Sub"
 // DEPENDS-NOMINAL-DAG: 9OtherBase"
 class Sub : OtherBase {
-  // PROVIDES-MEMBER-DAG: - ["{{.+}}3Sub", ""]
-  // PROVIDES-MEMBER-NEGATIVE-NOT: - ["{{.+}}3Sub", "{{.+}}"]
+  // PROVIDES-MEMBER-DAG: - ["{{.+}}3Sub", "", "{{[0-9a-f]+}}"]
+  // PROVIDES-MEMBER-NEGATIVE-NOT: - ["{{.+}}3Sub", "{{[^"]+}}"
   // DEPENDS-MEMBER-DAG: - ["{{.+}}9OtherBase", ""]
   // DEPENDS-MEMBER-DAG: - ["{{.+}}9OtherBase", "foo"]
   // DEPENDS-MEMBER-DAG: - ["{{.+}}9OtherBase", "init"]
@@ -40,23 +40,23 @@ class Sub : OtherBase {
 }
 
 // PROVIDES-NOMINAL-DAG: 9SomeProto"
-// PROVIDES-MEMBER-DAG: - ["{{.+}}9SomeProto", ""]
+// PROVIDES-MEMBER-DAG: - ["{{.+}}9SomeProto", "", "{{[0-9a-f]+}}"]
 protocol SomeProto {}
 
 // PROVIDES-NOMINAL-DAG: 10OtherClass"
-// PROVIDES-MEMBER-DAG: - ["{{.+}}10OtherClass", ""]
+// PROVIDES-MEMBER-DAG: - ["{{.+}}10OtherClass", "", "{{[0-9a-f]+}}"]
 // DEPENDS-NOMINAL-DAG: 10OtherClass"
 // DEPENDS-NOMINAL-DAG: 9SomeProto"
 // DEPENDS-MEMBER-DAG: - ["{{.+}}9SomeProto", ""]
 // DEPENDS-MEMBER-DAG: - ["{{.+}}10OtherClass", "deinit"]
 extension OtherClass : SomeProto {}
 
-// PROVIDES-NOMINAL-NEGATIVE-NOT: 11OtherStruct"{{$}}
+// PROVIDES-NOMINAL-NEGATIVE-NOT: 11OtherStruct"{{(, "[0-9a-f]+"\])?$}}
 // DEPENDS-NOMINAL-DAG: 11OtherStruct"
 extension OtherStruct {
-  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", ""]
-  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", "foo"]
-  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", "bar"]
+  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", "", "{{[0-9a-f]+}}"]
+  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", "foo", "{{[0-9a-f]+}}"]
+  // PROVIDES-MEMBER-DAG: - ["{{.+}}11OtherStruct", "bar", "{{[0-9a-f]+}}"]
   // PROVIDES-MEMBER-NEGATIVE-NOT: "baz"
   // DEPENDS-MEMBER-DAG: - ["{{.+}}11OtherStruct", "foo"]
   // DEPENDS-MEMBER-DAG: - ["{{.+}}11OtherStruct", "bar"]
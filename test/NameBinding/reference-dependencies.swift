@@ -44,19 +44,19 @@
 // CHECK-NEXT: "V4main9Sentinel2"
 
 // CHECK-LABEL: {{^provides-member:$}}
-// CHECK-NEXT: - ["V4main10IntWrapper", ""]
-// CHECK-NEXT: - ["VV4main10IntWrapper16InnerForNoReason", ""]
-// CHECK-NEXT: - ["C4main8Subclass", ""]
-// CHECK-NEXT: - ["Ps25ExpressibleByArrayLiteral", ""]
-// CHECK-NEXT: - ["Sb", ""]
-// CHECK-NEXT: - ["VE4mainSb11InnerToBool", ""]
-// CHECK: - ["V4main9Sentinel1", ""]
-// CHECK-NEXT: - ["V4main9Sentinel2", ""]
-// CHECK: - ["Ps25ExpressibleByArrayLiteral", "useless"]
-// CHECK-NEXT: - ["Ps25ExpressibleByArrayLiteral", "useless2"]
-// CHECK-NEXT: - ["Sb", "InnerToBool"]
-// CHECK-NEXT: - ["{{.*[0-9]}}FourTildeImpl", "~~~~"]
-// CHECK-NEXT: - ["{{.*[0-9]}}FiveTildeImpl", "~~~~~"]
+// CHECK-NEXT: - ["V4main10IntWrapper", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["VV4main10IntWrapper16InnerForNoReason", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["C4main8Subclass", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["Ps25ExpressibleByArrayLiteral", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["Sb", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["VE4mainSb11InnerToBool", "", "{{[0-9a-f]+}}"]
+// CHECK: - ["V4main9Sentinel1", "", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["V4main9Sentinel2", "", "{{[0-9a-f]+}}"]
+// CHECK: - ["Ps25ExpressibleByArrayLiteral", "useless", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["Ps25ExpressibleByArrayLiteral", "useless2", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["Sb", "InnerToBool", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["{{.*[0-9]}}FourTildeImpl", "~~~~", "{{[0-9a-f]+}}"]
+// CHECK-NEXT: - ["{{.*[0-9]}}FiveTildeImpl", "~~~~~", "{{[0-9a-f]+}}"]
 
 // CHECK-LABEL: {{^depends-top-level:$}}
 
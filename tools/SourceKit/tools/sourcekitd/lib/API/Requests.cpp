@@ -1065,17 +1065,18 @@ static std::string mangleSimpleClass(StringRef moduleName,
                                      StringRef className) {
   using namespace swift::Demangle;
 
-  auto moduleNode = NodeFactory::create(Node::Kind::Module, moduleName);
-  auto IdNode = NodeFactory::create(Node::Kind::Identifier, className);
-  auto classNode = NodeFactory::create(Node::Kind::Class);
-  auto typeNode = NodeFactory::create(Node::Kind::Type);
-  auto typeManglingNode = NodeFactory::create(Node::Kind::TypeMangling);
-  auto globalNode = NodeFactory::create(Node::Kind::Global);
-
-  classNode->addChildren(moduleNode, IdNode);
-  typeNode->addChild(classNode);
-  typeManglingNode->addChild(typeNode);
-  globalNode->addChild(typeManglingNode);
+  NodeFactory Factory;
+  auto moduleNode = Factory.createNode(Node::Kind::Module, moduleName);
+  auto IdNode = Factory.createNode(Node::Kind::Identifier, className);
+  auto classNode = Factory.createNode(Node::Kind::Class);
+  auto typeNode = Factory.createNode(Node::Kind::Type);
+  auto typeManglingNode = Factory.createNode(Node::Kind::TypeMangling);
+  auto globalNode = Factory.createNode(Node::Kind::Global);
+
+  classNode->addChildren(moduleNode, IdNode, Factory);
+  typeNode->addChild(classNode, Factory);
+  typeManglingNode->addChild(typeNode, Factory);
+  globalNode->addChild(typeManglingNode, Factory);
   return mangleNode(globalNode);
 }
 
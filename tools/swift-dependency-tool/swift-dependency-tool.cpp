@@ -0,0 +1,95 @@
+//===--- swift-dependency-tool.cpp - Convert .swiftdeps files -------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Prints a reference dependencies file in the YAML format, so that binary
+// files written by the frontend can be read and compared when debugging
+// incremental builds. YAML files are printed unchanged.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Basic/ReferenceDependencyFile.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdlib>
+
+using namespace swift;
+
+static llvm::cl::opt<std::string>
+InputFilename(llvm::cl::Positional, llvm::cl::desc("<input .swiftdeps file>"),
+              llvm::cl::init("-"));
+
+static llvm::cl::opt<std::string>
+OutputFilename("o", llvm::cl::desc("Output file (defaults to stdout)"),
+               llvm::cl::value_desc("filename"), llvm::cl::init("-"));
+
+int main(int argc, char **argv) {
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+  llvm::PrettyStackTraceProgram X(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "Swift reference dependencies tool\n");
+
+  auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(InputFilename);
+  if (!buffer) {
+    llvm::errs() << "error: cannot read '" << InputFilename << "': "
+                 << buffer.getError().message() << "\n";
+    return EXIT_FAILURE;
+  }
+  StringRef data = buffer.get()->getBuffer();
+
+  std::error_code EC;
+  llvm::raw_fd_ostream out(OutputFilename, EC, llvm::sys::fs::F_None);
+  if (EC) {
+    llvm::errs() << "error: cannot open '" << OutputFilename << "': "
+                 << EC.message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!BinaryReferenceDependencyFile::isBinary(data)) {
+    out << data;
+    return EXIT_SUCCESS;
+  }
+
+  BinaryReferenceDependencyFile file;
+  if (!file.init(data)) {
+    llvm::errs() << "error: '" << InputFilename
+                 << "' is not a valid binary dependencies file\n";
+    return EXIT_FAILURE;
+  }
+
+  ReferenceDependencyFileWriter writer;
+  for (unsigned i = 0; i != NumReferenceDependencySections; ++i) {
+    auto section = ReferenceDependencySection(i);
+    if (file.hasSection(section))
+      writer.addSection(section);
+  }
+  for (unsigned i = 0, e = file.getNumEntries(); i != e; ++i) {
+    ReferenceDependencyEntry entry = file.getEntry(i);
+    if (isMemberSection(entry.Section)) {
+      auto split = entry.Name.split('\0');
+      writer.addMemberEntry(entry.Section, split.first, split.second,
+                            entry.IsCascading, entry.Fingerprint);
+    } else {
+      writer.addEntry(entry.Section, entry.Name, entry.IsCascading,
+                      entry.Fingerprint);
+    }
+  }
+  if (file.hasInterfaceHash())
+    writer.setInterfaceHash(file.getInterfaceHash());
+
+  writer.writeYAML(out);
+  return EXIT_SUCCESS;
+}
@@ -11,3 +11,33 @@ TEST(Demangle, DemangleWrappers) {
       demangleSymbolAsString(MangledName));
 }
 
+TEST(Demangle, NodeFactoryReuse) {
+  using namespace swift::Demangle;
+
+  NodeFactory Factory;
+  const char *Symbols[] = {
+    "_TFC3foo3barCfT_S0_",
+    "_TTSg5Si___TFSqcfT_GSqx_",
+    "_TF3foooi1pFTCS_3barVS_3bas_OS_3zim",
+  };
+
+  for (const char *Symbol : Symbols) {
+    Factory.clear();
+    NodePointer First =
+      swift::Demangle::demangleSymbolAsNode(Symbol, Factory);
+    ASSERT_NE(nullptr, First);
+    std::string Remangled = mangleNode(First);
+    EXPECT_EQ(Symbol, Remangled);
+
+    // Each of these trees fits in one slab, so demangling the same symbol
+    // again after clearing the factory reuses the slab that the clear kept
+    // instead of allocating another.
+    Factory.clear();
+    EXPECT_EQ(1u, Factory.getNumSlabs());
+    NodePointer Second =
+      swift::Demangle::demangleSymbolAsNode(Symbol, Factory);
+    ASSERT_NE(nullptr, Second);
+    EXPECT_EQ(1u, Factory.getNumSlabs());
+    EXPECT_EQ(Remangled, mangleNode(Second));
+  }
+}
@@ -0,0 +1,162 @@
+#include "swift/Basic/ReferenceDependencyFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace swift;
+using Section = ReferenceDependencySection;
+
+static void addSampleContents(ReferenceDependencyFileWriter &writer) {
+  writer.addSection(Section::ProvidesTopLevel);
+  writer.addEntry(Section::ProvidesTopLevel, "a");
+  writer.addEntry(Section::ProvidesTopLevel, "b\"c");
+  writer.addSection(Section::ProvidesNominal);
+  writer.addSection(Section::ProvidesMember);
+  writer.addMemberEntry(Section::ProvidesMember, "V4main1S", "");
+  writer.addSection(Section::DependsTopLevel);
+  writer.addEntry(Section::DependsTopLevel, "a", /*isCascading=*/false);
+  writer.addSection(Section::DependsMember);
+  writer.addMemberEntry(Section::DependsMember, "V4main1S", "foo",
+                        /*isCascading=*/false);
+  writer.addSection(Section::DependsExternal);
+  writer.addEntry(Section::DependsExternal, "/foo/bar.swiftmodule");
+  writer.setInterfaceHash("0123456789abcdef");
+}
+
+static const char SampleYAML[] =
+  "### Swift dependencies file v0 ###\n"
+  "provides-top-level:\n"
+  "- \"a\"\n"
+  "- \"b\\\"c\"\n"
+  "provides-nominal:\n"
+  "provides-member:\n"
+  "- [\"V4main1S\", \"\"]\n"
+  "depends-top-level:\n"
+  "- !private \"a\"\n"
+  "depends-member:\n"
+  "- !private [\"V4main1S\", \"foo\"]\n"
+  "depends-external:\n"
+  "- \"/foo/bar.swiftmodule\"\n"
+  "interface-hash: \"0123456789abcdef\"\n";
+
+TEST(ReferenceDependencyFile, WriteYAML) {
+  ReferenceDependencyFileWriter writer;
+  addSampleContents(writer);
+
+  std::string yaml;
+  llvm::raw_string_ostream out(yaml);
+  writer.writeYAML(out);
+  EXPECT_EQ(SampleYAML, out.str());
+}
+
+TEST(ReferenceDependencyFile, ReadBinary) {
+  ReferenceDependencyFileWriter writer;
+  addSampleContents(writer);
+
+  std::string binary;
+  llvm::raw_string_ostream out(binary);
+  writer.writeBinary(out);
+  out.flush();
+
+  EXPECT_TRUE(BinaryReferenceDependencyFile::isBinary(binary));
+  EXPECT_FALSE(BinaryReferenceDependencyFile::isBinary(SampleYAML));
+
+  BinaryReferenceDependencyFile file;
+  ASSERT_TRUE(file.init(binary));
+  EXPECT_TRUE(file.hasSection(Section::ProvidesNominal));
+  EXPECT_FALSE(file.hasSection(Section::ProvidesDynamicLookup));
+  ASSERT_TRUE(file.hasInterfaceHash());
+  EXPECT_EQ("0123456789abcdef", file.getInterfaceHash());
+
+  ASSERT_EQ(6u, file.getNumEntries());
+  EXPECT_EQ(Section::ProvidesTopLevel, file.getEntry(0).Section);
+  EXPECT_EQ("a", file.getEntry(0).Name);
+  EXPECT_TRUE(file.getEntry(0).IsCascading);
+  EXPECT_EQ("b\"c", file.getEntry(1).Name);
+  EXPECT_EQ(StringRef("V4main1S\0", 9), file.getEntry(2).Name);
+  EXPECT_EQ(Section::DependsTopLevel, file.getEntry(3).Section);
+  EXPECT_FALSE(file.getEntry(3).IsCascading);
+  EXPECT_EQ(StringRef("V4main1S\0foo", 12), file.getEntry(4).Name);
+  EXPECT_EQ("/foo/bar.swiftmodule", file.getEntry(5).Name);
+
+  // Repeated strings are only stored once.
+  EXPECT_EQ(file.getEntry(0).Name.data(), file.getEntry(3).Name.data());
+}
+
+TEST(ReferenceDependencyFile, RejectMalformedBinary) {
+  ReferenceDependencyFileWriter writer;
+  addSampleContents(writer);
+
+  std::string binary;
+  llvm::raw_string_ostream out(binary);
+  writer.writeBinary(out);
+  out.flush();
+
+  BinaryReferenceDependencyFile file;
+  for (size_t size = 0; size != binary.size(); ++size)
+    EXPECT_FALSE(file.init(StringRef(binary).substr(0, size)));
+
+  // An unknown major version.
+  std::string badVersion = binary;
+  badVersion[4] = binary_swiftdeps::MajorVersion + 1;
+  EXPECT_FALSE(file.init(badVersion));
+
+  // A string index past the end of the string table.
+  std::string badIndex = binary;
+  size_t firstEntry = sizeof(binary_swiftdeps::Header) +
+    7 * sizeof(binary_swiftdeps::StringOffset);
+  badIndex[firstEntry] = 100;
+  EXPECT_FALSE(file.init(badIndex));
+
+  // String offsets that go backwards.
+  std::string badOffsets = binary;
+  badOffsets[sizeof(binary_swiftdeps::Header) +
+             2 * sizeof(binary_swiftdeps::StringOffset)] = 0;
+  EXPECT_FALSE(file.init(badOffsets));
+
+  EXPECT_TRUE(file.init(binary));
+}
+
+TEST(ReferenceDependencyFile, Fingerprints) {
+  ReferenceDependencyFileWriter writer;
+  writer.addEntry(Section::ProvidesTopLevel, "a", /*isCascading=*/true,
+                  "fp-a");
+  writer.addEntry(Section::ProvidesTopLevel, "b");
+  writer.addMemberEntry(Section::ProvidesMember, "V4main1S", "",
+                        /*isCascading=*/true, "fp-S");
+
+  std::string yaml;
+  llvm::raw_string_ostream yamlOut(yaml);
+  writer.writeYAML(yamlOut);
+  EXPECT_EQ("### Swift dependencies file v0 ###\n"
+            "provides-top-level:\n"
+            "- [\"a\", \"fp-a\"]\n"
+            "- \"b\"\n"
+            "provides-member:\n"
+            "- [\"V4main1S\", \"\", \"fp-S\"]\n",
+            yamlOut.str());
+
+  std::string binary;
+  llvm::raw_string_ostream binaryOut(binary);
+  writer.writeBinary(binaryOut);
+  binaryOut.flush();
+
+  BinaryReferenceDependencyFile file;
+  ASSERT_TRUE(file.init(binary));
+  ASSERT_EQ(3u, file.getNumEntries());
+  EXPECT_EQ("fp-a", file.getEntry(0).Fingerprint);
+  EXPECT_EQ("", file.getEntry(1).Fingerprint);
+  EXPECT_EQ("fp-S", file.getEntry(2).Fingerprint);
+
+  // Files without fingerprints don't have a fingerprint table.
+  ReferenceDependencyFileWriter plainWriter;
+  plainWriter.addEntry(Section::ProvidesTopLevel, "a");
+  std::string plain;
+  llvm::raw_string_ostream plainOut(plain);
+  plainWriter.writeBinary(plainOut);
+  plainOut.flush();
+  EXPECT_LT(plain.size(), binary.size());
+  ASSERT_TRUE(file.init(plain));
+  EXPECT_EQ("", file.getEntry(0).Fingerprint);
+}
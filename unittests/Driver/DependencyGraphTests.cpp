@@ -1,8 +1,22 @@
 #include "swift/Driver/DependencyGraph.h"
+#include "swift/Basic/ReferenceDependencyFile.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace swift;
 using LoadResult = DependencyGraphImpl::LoadResult;
+using Section = ReferenceDependencySection;
+
+/// Returns the binary form of the dependencies added by \p body.
+static std::string
+makeBinaryDeps(llvm::function_ref<void(ReferenceDependencyFileWriter &)> body) {
+  ReferenceDependencyFileWriter writer;
+  body(writer);
+  std::string result;
+  llvm::raw_string_ostream out(result);
+  writer.writeBinary(out);
+  return out.str();
+}
 
 TEST(DependencyGraph, BasicLoad) {
   DependencyGraph<uintptr_t> graph;
@@ -790,3 +804,282 @@ TEST(DependencyGraph, ChainedExternalPreMarked) {
   EXPECT_TRUE(graph.isMarked(0));
   EXPECT_FALSE(graph.isMarked(1));
 }
+
+TEST(DependencyGraph, BinaryChained) {
+  DependencyGraph<uintptr_t> graph;
+
+  std::string deps0 = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addEntry(Section::ProvidesTopLevel, "a");
+  });
+  std::string deps1 = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addEntry(Section::ProvidesNominal, "b");
+    w.addEntry(Section::DependsTopLevel, "a");
+  });
+  EXPECT_EQ(graph.loadFromString(0, deps0), LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, deps1), LoadResult::UpToDate);
+  // Binary and YAML files can be mixed in one graph.
+  EXPECT_EQ(graph.loadFromString(2, "depends-nominal: [b]"),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(2u, marked.size());
+  EXPECT_TRUE(graph.isMarked(0));
+  EXPECT_TRUE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, BinaryMembersAndPrivate) {
+  DependencyGraph<uintptr_t> graph;
+
+  std::string deps0 = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addMemberEntry(Section::ProvidesMember, "a", "aa");
+    w.addEntry(Section::ProvidesTopLevel, "x");
+  });
+  std::string deps1 = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addMemberEntry(Section::DependsMember, "a", "aa",
+                     /*isCascading=*/false);
+    w.addEntry(Section::ProvidesTopLevel, "y");
+  });
+  std::string deps2 = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addMemberEntry(Section::DependsMember, "a", "bb");
+    w.addEntry(Section::DependsTopLevel, "y");
+  });
+  EXPECT_EQ(graph.loadFromString(0, deps0), LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, deps1), LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, deps2), LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(1u, marked.front());
+  EXPECT_TRUE(graph.isMarked(0));
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_FALSE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, BinaryInterfaceHash) {
+  DependencyGraph<uintptr_t> graph;
+
+  auto depsWithHash = [](StringRef hash) {
+    return makeBinaryDeps([hash](ReferenceDependencyFileWriter &w) {
+      w.addEntry(Section::ProvidesTopLevel, "a");
+      w.setInterfaceHash(hash);
+    });
+  };
+  EXPECT_EQ(graph.loadFromString(0, depsWithHash("abc")),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(0, depsWithHash("abc")),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(0, depsWithHash("def")),
+            LoadResult::AffectsDownstream);
+}
+
+TEST(DependencyGraph, BinaryMalformed) {
+  DependencyGraph<uintptr_t> graph;
+
+  std::string deps = makeBinaryDeps([](ReferenceDependencyFileWriter &w) {
+    w.addEntry(Section::ProvidesTopLevel, "a");
+  });
+  deps.pop_back();
+  EXPECT_EQ(graph.loadFromString(0, deps), LoadResult::HadError);
+}
+
+TEST(DependencyGraph, FingerprintsLimitMarking) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[a, a1], [b, b1]]\n"
+                                 "interface-hash: \"1\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[a, a1], [b, b2]]\n"
+                                 "interface-hash: \"2\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(2u, marked.front());
+  EXPECT_TRUE(graph.isMarked(0));
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsRemovedName) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[a, a1], [b, b1]]\n"
+                                 "interface-hash: \"1\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  // A name that is no longer provided counts as changed.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[b, b1]]\n"
+                                 "interface-hash: \"2\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(1u, marked.front());
+  EXPECT_FALSE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsMissing) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[a, a1], b]\n"
+                                 "interface-hash: \"1\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  // Names without fingerprints are always followed.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [[a, a1], b]\n"
+                                 "interface-hash: \"2\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(2u, marked.front());
+  EXPECT_FALSE(graph.isMarked(1));
+}
+
+TEST(DependencyGraph, FingerprintsIgnoredWhenDependenciesChanged) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0, "provides-top-level: [x]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1,
+                                 "depends-top-level: [x]\n"
+                                 "provides-top-level: [[a, a1]]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  marked.clear();
+
+  // Node 1 depends on a changed name, so what it provides may have changed
+  // even though its tokens didn't.
+  EXPECT_EQ(graph.loadFromString(1,
+                                 "depends-top-level: [x]\n"
+                                 "provides-top-level: [[a, a1]]"),
+            LoadResult::AffectsDownstream);
+  graph.markTransitiveFromChangedProvides(marked, 1);
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsIgnoredWhenChangedNameIsUsedLocally) {
+  DependencyGraph<uintptr_t> graph;
+
+  // Node 0 has "func foo() -> Int" and "let x = foo()".
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "depends-top-level: [foo]\n"
+                                 "provides-top-level: [[foo, f1], [x, x1]]\n"
+                                 "interface-hash: \"1\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [x]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [foo]"),
+            LoadResult::UpToDate);
+
+  // Changing foo's result type changes x's type too, even though x's tokens
+  // are the same.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "depends-top-level: [foo]\n"
+                                 "provides-top-level: [[foo, f2], [x, x1]]\n"
+                                 "interface-hash: \"2\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_TRUE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsUsedWhenUnchangedNameIsUsedLocally) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "depends-top-level: [a]\n"
+                                 "depends-member: [[V4main1S, m]]\n"
+                                 "provides-top-level: [[a, a1], [b, b1]]\n"
+                                 "provides-nominal: [[V4main1S, s1]]\n"
+                                 "interface-hash: \"1\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  // Only b changed, and this file doesn't use it.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "depends-top-level: [a]\n"
+                                 "depends-member: [[V4main1S, m]]\n"
+                                 "provides-top-level: [[a, a1], [b, b2]]\n"
+                                 "provides-nominal: [[V4main1S, s1]]\n"
+                                 "interface-hash: \"2\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+
+  // A member of a changed type that this file uses affects everything.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "depends-top-level: [a]\n"
+                                 "depends-member: [[V4main1S, m]]\n"
+                                 "provides-top-level: [[a, a1], [b, b2]]\n"
+                                 "provides-nominal: [[V4main1S, s2]]\n"
+                                 "interface-hash: \"3\""),
+            LoadResult::AffectsDownstream);
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_TRUE(graph.isMarked(1));
+}
+
+TEST(DependencyGraph, BinaryFingerprints) {
+  DependencyGraph<uintptr_t> graph;
+
+  auto depsWithFingerprints = [](StringRef a, StringRef b) {
+    return makeBinaryDeps([a, b](ReferenceDependencyFileWriter &w) {
+      w.addEntry(Section::ProvidesTopLevel, "a", /*isCascading=*/true, a);
+      w.addMemberEntry(Section::ProvidesMember, "b", "", /*isCascading=*/true,
+                       b);
+      w.setInterfaceHash(a.str() + b.str());
+    });
+  };
+  EXPECT_EQ(graph.loadFromString(0, depsWithFingerprints("1", "1")),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-member: [[b, \"\"]]"),
+            LoadResult::UpToDate);
+
+  EXPECT_EQ(graph.loadFromString(0, depsWithFingerprints("2", "1")),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitiveFromChangedProvides(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(1u, marked.front());
+  EXPECT_FALSE(graph.isMarked(2));
+}
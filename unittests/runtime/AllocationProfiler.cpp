@@ -0,0 +1,123 @@
+//===--- AllocationProfiler.cpp - Allocation profiler tests ---------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__linux__)
+
+using namespace swift;
+
+namespace swift {
+  extern std::atomic<bool> _swift_allocationProfileHasLiveSamples;
+}
+
+/// Profile the allocation of some boxes, sampling nearly every one of them,
+/// and exit with status 0 if the profile describes them.
+static void profileAllocations() {
+  char path[] = "/tmp/allocation-profile-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1)
+    _exit(2);
+  close(fd);
+
+  // Profiling is configured by the first allocation in the process.
+  setenv("SWIFT_ALLOCATION_PROFILE", path, 1);
+  setenv("SWIFT_ALLOCATION_PROFILE_SAMPLE_BYTES", "1", 1);
+
+  const unsigned NumObjects = 1000;
+  std::vector<HeapObject *> boxes;
+  for (unsigned i = 0; i != NumObjects; ++i) {
+    BoxPair box = swift_allocBox(&_TMBi64_.base);
+    boxes.push_back(box.first);
+  }
+  for (unsigned i = 0; i != NumObjects; i += 2)
+    swift_release(boxes[i]);
+
+  swift_dumpAllocationProfile(nullptr);
+
+  char metadata[32];
+  snprintf(metadata, sizeof(metadata), "%p",
+           static_cast<const void *>(boxes[1]->metadata));
+
+  bool found = false;
+  std::ifstream profile(path);
+  for (std::string line; std::getline(profile, line);) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    double objectCount, bytes, liveObjectCount, liveBytes;
+    unsigned long samples;
+    std::string address;
+    fields >> objectCount >> bytes >> liveObjectCount >> liveBytes
+           >> samples >> address;
+    if (address != metadata)
+      continue;
+    found = true;
+
+    // Every allocation but the first is sampled with a probability very
+    // close to 1, and each sample stands for about one object.
+    if (samples < NumObjects / 2 || objectCount < NumObjects / 2 ||
+        objectCount > NumObjects * 2) {
+      fprintf(stderr, "bad allocation estimate: %s\n", line.c_str());
+      _exit(1);
+    }
+    if (liveObjectCount < NumObjects / 4 || liveObjectCount > NumObjects) {
+      fprintf(stderr, "bad live object estimate: %s\n", line.c_str());
+      _exit(1);
+    }
+    if (line.find(" Box<") == std::string::npos) {
+      fprintf(stderr, "bad type name: %s\n", line.c_str());
+      _exit(1);
+    }
+  }
+  unlink(path);
+  if (!found) {
+    fprintf(stderr, "no profile for %s\n", metadata);
+    _exit(1);
+  }
+
+  // Allocate and free more sampled objects than the profiler has slots for.
+  // Their slots are reclaimed, and once no sampled object is live,
+  // deallocations stop checking for them.
+  for (unsigned i = 0; i != 100000; ++i) {
+    BoxPair box = swift_allocBox(&_TMBi64_.base);
+    swift_release(box.first);
+  }
+  for (unsigned i = 1; i < NumObjects; i += 2)
+    swift_release(boxes[i]);
+  if (_swift_allocationProfileHasLiveSamples.load()) {
+    fprintf(stderr, "live samples left after freeing every object\n");
+    _exit(1);
+  }
+
+  // Don't write the profile again at exit.
+  _exit(0);
+}
+
+// Profiling can only be turned on before the first allocation, so profile
+// in a fresh process.
+TEST(AllocationProfilerTest, dump_reports_sampled_objects) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(profileAllocations(), ::testing::ExitedWithCode(0), "");
+}
+
+#endif
@@ -0,0 +1,97 @@
+//===--- Heap.cpp - Heap allocation tests ---------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace swift;
+
+TEST(HeapTest, slowAlloc_alignment) {
+  for (size_t alignMask : {size_t(0), size_t(7), size_t(15), size_t(31),
+                           size_t(63), size_t(4095), ~size_t(0)}) {
+    for (size_t size : {1, 8, 16, 17, 100, 512, 513, 4096}) {
+      void *p = swift_slowAlloc(size, alignMask);
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+      if (alignMask != ~size_t(0))
+#else
+      // FIXME: Without the size-class allocator, alignMask isn't honored
+      // beyond what malloc guarantees.
+      if (alignMask < alignof(std::max_align_t))
+#endif
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) & alignMask);
+      memset(p, 0xAB, size);
+      swift_slowDealloc(p, size, alignMask);
+    }
+  }
+}
+
+// Some callers don't pass swift_slowDealloc the alignment mask the memory
+// was allocated with.
+TEST(HeapTest, slowDealloc_mismatched_alignMask) {
+  void *p = swift_slowAlloc(64, 63);
+  swift_slowDealloc(p, 64, ~size_t(0));
+
+  p = swift_slowAlloc(64, ~size_t(0));
+  swift_slowDealloc(p, 64, 63);
+
+  p = swift_slowAlloc(16, 7);
+  swift_slowDealloc(p, 16, 4095);
+}
+
+// Live blocks of every small size never overlap, and freed blocks can be
+// reused.
+TEST(HeapTest, slowAlloc_distinct_blocks) {
+  const size_t MaxSize = 600;
+  for (unsigned round = 0; round != 2; ++round) {
+    std::vector<unsigned char *> blocks;
+    for (size_t size = 1; size <= MaxSize; ++size) {
+      auto p = static_cast<unsigned char *>(swift_slowAlloc(size, 7));
+      memset(p, int(size & 0xFF), size);
+      blocks.push_back(p);
+    }
+
+    for (size_t size = 1; size <= MaxSize; ++size) {
+      auto p = blocks[size - 1];
+      for (size_t i = 0; i != size; ++i)
+        ASSERT_EQ(size & 0xFF, p[i]);
+      swift_slowDealloc(p, size, 7);
+    }
+  }
+}
+
+// Blocks allocated by one thread and freed by another go back to the
+// allocator, and can be allocated again by either thread.
+TEST(HeapTest, slowDealloc_on_other_thread) {
+  const unsigned NumBlocks = 1000;
+  for (unsigned round = 0; round != 4; ++round) {
+    std::vector<void *> blocks;
+    for (unsigned i = 0; i != NumBlocks; ++i)
+      blocks.push_back(swift_slowAlloc(48, 15));
+
+    std::thread([&] {
+      for (auto p : blocks)
+        swift_slowDealloc(p, 48, 15);
+    }).join();
+  }
+
+  std::thread([] {
+    for (unsigned i = 0; i != NumBlocks; ++i) {
+      void *p = swift_slowAlloc(48, 15);
+      memset(p, 0, 48);
+      swift_slowDealloc(p, 48, 15);
+    }
+  }).join();
+}
@@ -12,7 +12,10 @@
 
 #include "swift/Runtime/Metadata.h"
 #include "swift/Runtime/Concurrent.h"
+#include "llvm/ADT/Hashing.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <cstring>
 #include <iterator>
 #include <functional>
 #include <sys/mman.h>
@@ -215,6 +218,33 @@ TEST(Concurrent, ConcurrentList) {
   EXPECT_EQ(ListLen, results.size() * numElem);
 }
 
+TEST(Concurrent, ConcurrentListPushBack) {
+  const int numElem = 100;
+
+  ConcurrentList<int> List;
+  std::atomic<int> nextThread(0);
+  auto results = RaceTest<int*>(
+    [&]() -> int* {
+        int thread = nextThread++;
+        for (int i = 0; i < numElem; i++)
+          List.push_back(thread * numElem + i);
+        return nullptr;
+    }
+  );
+
+  // Every value is in the list, and each thread's values are in the order
+  // that thread added them.
+  std::vector<int> lastSeen(results.size(), -1);
+  size_t ListLen = 0;
+  for (auto A : List) {
+    int thread = A / numElem;
+    EXPECT_EQ(lastSeen[thread] + 1, A % numElem);
+    lastSeen[thread] = A % numElem;
+    ++ListLen;
+  }
+  EXPECT_EQ(ListLen, results.size() * numElem);
+}
+
 
 TEST(Concurrent, ConcurrentMap) {
   const int numElem = 100;
@@ -248,6 +278,189 @@ TEST(Concurrent, ConcurrentMap) {
   }
 }
 
+TEST(Concurrent, ConcurrentHashMap) {
+  const int numElem = 100;
+
+  struct Entry {
+    size_t Key;
+    Entry(size_t key) : Key(key) {}
+    int compareWithKey(size_t key) const {
+      return (key == Key ? 0 : (key < Key ? -1 : 1));
+    }
+    static size_t getKeyHash(size_t key) { return key; }
+    static size_t getExtraAllocationSize(size_t key) { return 0; }
+  };
+
+  ConcurrentHashMap<Entry> Map;
+
+  // Add a bunch of numbers to the map concurrently.
+  auto results = RaceTest<Entry*>(
+    [&]() -> Entry* {
+      for (int i = 0; i < numElem; i++) {
+        size_t hash = (i * 123512) % 0xFFFF ;
+        Map.getOrInsert(hash);
+      }
+      return Map.getOrInsert(size_t(0)).first;
+    }
+  );
+
+  // Every thread must have seen the same entry for the same key.
+  for (auto result : results) {
+    EXPECT_EQ(results[0], result);
+  }
+
+  // Check that all of the values that we inserted are in the map, and that
+  // nothing was inserted twice.
+  for (int i=0; i < numElem; i++) {
+    size_t hash = (i * 123512) % 0xFFFF ;
+    EXPECT_TRUE(Map.find(hash));
+  }
+  EXPECT_EQ(size_t(numElem), Map.size());
+  EXPECT_FALSE(Map.find(size_t(0xFFFF)));
+}
+
+// The throughput of the runtime's concurrent caches under this kind of load
+// is measured by the TupleMetadataLookups benchmarks.
+TEST(Concurrent, ConcurrentHashMapStress) {
+  const size_t numElem = 20000;
+  const size_t numLookups = 200000;
+
+  struct Entry {
+    size_t Key;
+    size_t Value;
+    Entry(size_t key, size_t value) : Key(key), Value(value) {}
+    int compareWithKey(size_t key) const {
+      return (key == Key ? 0 : (key < Key ? -1 : 1));
+    }
+    static size_t getKeyHash(size_t key) {
+      // Keys are sequential, like the hashes of pointers into a single
+      // allocation; spread them out the same way the runtime does.
+      return llvm::hash_value(key);
+    }
+    static size_t getExtraAllocationSize(size_t key, size_t value) {
+      return 0;
+    }
+  };
+
+  auto valueForKey = [](size_t key) { return key * 3 + 1; };
+
+  ConcurrentHashMap<Entry> Map;
+
+  // Each of the threads inserts every key, starting at a different offset,
+  // so that the table grows while other threads are inserting and probing.
+  std::atomic<size_t> nextThread(0);
+  std::atomic<size_t> numInserted(0);
+  RaceTest<void*, 32>(
+    [&]() -> void* {
+      size_t offset = nextThread.fetch_add(1) * 7919;
+      for (size_t i = 0; i < numElem; i++) {
+        size_t key = (i + offset) % numElem;
+        auto result = Map.getOrInsert(key, valueForKey(key));
+        EXPECT_EQ(key, result.first->Key);
+        EXPECT_EQ(valueForKey(key), result.first->Value);
+        if (result.second)
+          numInserted.fetch_add(1);
+
+        // The entry can be found right away, even while another thread is
+        // migrating the table.
+        EXPECT_EQ(result.first, Map.find(key));
+      }
+      for (size_t i = 0; i < numLookups; i++) {
+        auto entry = Map.find((i * 31 + offset) % numElem);
+        EXPECT_TRUE(entry != nullptr);
+      }
+      return nullptr;
+    }
+  );
+
+  // Every key was inserted exactly once, and is found with its value now
+  // that all the threads have finished.
+  EXPECT_EQ(numElem, numInserted.load());
+  EXPECT_EQ(numElem, Map.size());
+  for (size_t key = 0; key < numElem; key++) {
+    auto entry = Map.find(key);
+    ASSERT_TRUE(entry != nullptr);
+    EXPECT_EQ(key, entry->Key);
+    EXPECT_EQ(valueForKey(key), entry->Value);
+  }
+  EXPECT_FALSE(Map.find(numElem));
+
+  // The table never gets more than half full, so probe sequences stay short.
+  EXPECT_LT(Map.getMaxProbeDistance(), size_t(64));
+}
+
+
+/// Look up every key of \p map from several threads at once, and check that
+/// none of the lookups wrote to the map object.  Lookups that hit must not
+/// write to shared memory, or they would make its cache lines bounce between
+/// the cores of threads that only read the map.  The GenericMetadataHits
+/// benchmarks measure how hit throughput scales with the number of threads.
+template <class MapTy>
+static void expectHitsDontWrite(MapTy &map, size_t numKeys) {
+  char before[sizeof(MapTy)];
+  memcpy(before, &map, sizeof(MapTy));
+
+  std::atomic<size_t> nextThread(0);
+  RaceTest<void*, 8>(
+    [&]() -> void* {
+      size_t offset = nextThread.fetch_add(1);
+      for (size_t i = 0; i < numKeys * 4; i++) {
+        // Repeat each key a few times, the way a hot cast or conformance
+        // check does.
+        size_t key = ((i / 4) + offset) % numKeys;
+        auto entry = map.find(key);
+        EXPECT_TRUE(entry != nullptr && entry->Key == key);
+        EXPECT_FALSE(map.getOrInsert(key).second);
+      }
+      return nullptr;
+    }
+  );
+
+  EXPECT_EQ(0, memcmp(before, &map, sizeof(MapTy)));
+}
+
+TEST(Concurrent, ConcurrentMapHits) {
+  const size_t numKeys = 1000;
+
+  struct Entry {
+    size_t Key;
+    Entry(size_t key) : Key(key) {}
+    int compareWithKey(size_t key) const {
+      return (key == Key ? 0 : (key < Key ? -1 : 1));
+    }
+    static size_t getExtraAllocationSize(size_t key) { return 0; }
+  };
+
+  // Insert most keys in a scrambled order first, so that the tree is not a
+  // degenerate list.
+  ConcurrentMap<Entry> Map;
+  for (size_t i = 0; i < numKeys; i++)
+    Map.getOrInsert(size_t(llvm::hash_value(i)) % numKeys);
+  for (size_t i = 0; i < numKeys; i++)
+    Map.getOrInsert(i);
+
+  expectHitsDontWrite(Map, numKeys);
+}
+
+TEST(Concurrent, ConcurrentHashMapHits) {
+  const size_t numKeys = 1000;
+
+  struct Entry {
+    size_t Key;
+    Entry(size_t key) : Key(key) {}
+    int compareWithKey(size_t key) const {
+      return (key == Key ? 0 : (key < Key ? -1 : 1));
+    }
+    static size_t getKeyHash(size_t key) { return llvm::hash_value(key); }
+    static size_t getExtraAllocationSize(size_t key) { return 0; }
+  };
+
+  ConcurrentHashMap<Entry> Map;
+  for (size_t i = 0; i < numKeys; i++)
+    Map.getOrInsert(i);
+
+  expectHitsDontWrite(Map, numKeys);
+}
 
 TEST(MetadataTest, getGenericMetadata) {
   auto metadataTemplate = (GenericMetadata*) &MetadataTest1;
@@ -980,3 +1193,190 @@ TEST(WitnessTableTest, getGenericWitnessTable) {
       });
   }
 }
+
+// A "shadow" struct for ProtocolConformanceRecord, like the one above.
+struct ProtocolConformanceRecordStorage {
+  int32_t Protocol;
+  int32_t DirectType;
+  int32_t WitnessTable;
+  ProtocolConformanceFlags Flags;
+};
+
+// Concurrent conformance lookups.
+
+enum { NumScalingTypes = 64 };
+
+static ProtocolDescriptor ScalingProto = { "ScalingProto", nullptr,
+  ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+};
+
+// These have to be global to be relatively referenced by the records.
+// Only the first NumScalingTypes types conform to ScalingProto.
+static Metadata ScalingTypes[NumScalingTypes + 1];
+static const void *ScalingWitnessTables[NumScalingTypes];
+static ProtocolConformanceRecordStorage ScalingConformances[NumScalingTypes];
+
+static const WitnessTable *getScalingWitnessTable(size_t index) {
+  return reinterpret_cast<const WitnessTable *>(&ScalingWitnessTables[index]);
+}
+
+// The throughput of conformance lookups that hit in the cache is measured by
+// the ConformanceHits benchmarks.
+TEST(ProtocolConformanceTest, conformsToProtocolConcurrent) {
+  for (size_t i = 0; i <= NumScalingTypes; i++)
+    ScalingTypes[i].setKind(MetadataKind::Opaque);
+  for (size_t i = 0; i < NumScalingTypes; i++) {
+    auto &record = ScalingConformances[i];
+    initializeRelativePointer(&record.Protocol, &ScalingProto);
+    initializeRelativePointer(&record.DirectType, &ScalingTypes[i]);
+    initializeRelativePointer(&record.WitnessTable,
+                              getScalingWitnessTable(i));
+    record.Flags = ProtocolConformanceFlags()
+      .withTypeKind(TypeMetadataRecordKind::UniqueDirectType)
+      .withConformanceKind(ProtocolConformanceReferenceKind::WitnessTable);
+  }
+  auto records =
+    reinterpret_cast<const ProtocolConformanceRecord *>(ScalingConformances);
+  swift_registerProtocolConformances(records, records + NumScalingTypes);
+
+  // Every thread gets the right witness table for every type, both while the
+  // cache is being filled and once it is, with and without cache replicas.
+  for (unsigned numReplicas : {0u, 2u}) {
+    swift_setCacheReplicas(numReplicas);
+    std::atomic<size_t> nextThread(0);
+    RaceTest<void*, 16>(
+      [&]() -> void* {
+        size_t offset = nextThread.fetch_add(1);
+        for (size_t i = 0; i < 4 * NumScalingTypes; i++) {
+          size_t index = ((i / 4) + offset) % NumScalingTypes;
+          EXPECT_EQ(getScalingWitnessTable(index),
+                    swift_conformsToProtocol(&ScalingTypes[index],
+                                             &ScalingProto));
+          EXPECT_EQ(nullptr,
+                    swift_conformsToProtocol(&ScalingTypes[NumScalingTypes],
+                                             &ScalingProto));
+        }
+        return nullptr;
+      }
+    );
+  }
+  swift_setCacheReplicas(0);
+}
+
+// Conformance lookups through cache replicas.
+
+// More types than a replica has slots for conformances, so that their
+// results evict each other.
+enum { NumReplicaTypes = 4096 };
+
+static ProtocolDescriptor ReplicaProto = { "ReplicaProto", nullptr,
+  ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+};
+
+// Only the even-numbered types conform to ReplicaProto.
+static Metadata ReplicaTypes[NumReplicaTypes];
+static const void *ReplicaWitnessTables[NumReplicaTypes];
+static ProtocolConformanceRecordStorage ReplicaConformances[NumReplicaTypes / 2];
+
+static const WitnessTable *getReplicaWitnessTable(size_t index) {
+  return reinterpret_cast<const WitnessTable *>(&ReplicaWitnessTables[index]);
+}
+
+TEST(ProtocolConformanceTest, conformsToProtocolReplicas) {
+  for (size_t i = 0; i < NumReplicaTypes; i++) {
+    ReplicaTypes[i].setKind(MetadataKind::Opaque);
+    if (i % 2)
+      continue;
+    auto &record = ReplicaConformances[i / 2];
+    initializeRelativePointer(&record.Protocol, &ReplicaProto);
+    initializeRelativePointer(&record.DirectType, &ReplicaTypes[i]);
+    initializeRelativePointer(&record.WitnessTable,
+                              getReplicaWitnessTable(i));
+    record.Flags = ProtocolConformanceFlags()
+      .withTypeKind(TypeMetadataRecordKind::UniqueDirectType)
+      .withConformanceKind(ProtocolConformanceReferenceKind::WitnessTable);
+  }
+  auto records =
+    reinterpret_cast<const ProtocolConformanceRecord *>(ReplicaConformances);
+  swift_registerProtocolConformances(records, records + NumReplicaTypes / 2);
+
+  auto lookUp = [](size_t index) {
+    return swift_conformsToProtocol(&ReplicaTypes[index], &ReplicaProto);
+  };
+
+  // The results without replicas.
+  swift_setCacheReplicas(0);
+  std::vector<const WitnessTable *> expected;
+  for (size_t i = 0; i < NumReplicaTypes; i++) {
+    expected.push_back(lookUp(i));
+    EXPECT_EQ(i % 2 ? nullptr : getReplicaWitnessTable(i), expected[i]);
+  }
+
+  swift_setCacheReplicas(1);
+
+  // A few types, looked up repeatedly, miss in the replica once and then
+  // hit.
+  for (unsigned round = 0; round < 4; round++)
+    for (size_t i = 0; i < 16; i++)
+      EXPECT_EQ(expected[i], lookUp(i));
+
+  // All of them overwrite each other's slots.
+  for (unsigned round = 0; round < 4; round++)
+    for (size_t i = 0; i < NumReplicaTypes; i++)
+      EXPECT_EQ(expected[i], lookUp(i));
+
+  // Threads using several replicas at once see the same results.
+  swift_setCacheReplicas(4);
+  std::atomic<size_t> mismatches(0);
+  RaceTest<void*, 8>(
+    [&]() -> void* {
+      for (unsigned round = 0; round < 4; round++)
+        for (size_t i = 0; i < NumReplicaTypes; i++)
+          if (lookUp(i) != expected[i])
+            ++mismatches;
+      return nullptr;
+    }
+  );
+  EXPECT_EQ(0u, mismatches.load());
+
+  swift_setCacheReplicas(0);
+  for (size_t i = 0; i < NumReplicaTypes; i++)
+    EXPECT_EQ(expected[i], lookUp(i));
+
+  // A thread that has already looked up results keeps seeing the same ones
+  // as replication is turned on and off by another thread.
+  struct OtherThreadArgs {
+    decltype(lookUp) &LookUp;
+    std::vector<const WitnessTable *> &Expected;
+    pthread_barrier_t Step;
+    size_t Mismatches;
+  } args = { lookUp, expected, {}, 0 };
+  pthread_barrier_init(&args.Step, nullptr, 2);
+
+  pthread_t otherThread;
+  pthread_create(&otherThread, nullptr, [](void *context) -> void* {
+    auto &args = *static_cast<OtherThreadArgs *>(context);
+    for (unsigned phase = 0; phase < 3; phase++) {
+      pthread_barrier_wait(&args.Step);
+      for (unsigned round = 0; round < 2; round++)
+        for (size_t i = 0; i < NumReplicaTypes; i++)
+          if (args.LookUp(i) != args.Expected[i])
+            ++args.Mismatches;
+      pthread_barrier_wait(&args.Step);
+    }
+    return nullptr;
+  }, &args);
+
+  for (unsigned numReplicas : {0u, 2u, 0u}) {
+    swift_setCacheReplicas(numReplicas);
+    pthread_barrier_wait(&args.Step);
+    pthread_barrier_wait(&args.Step);
+  }
+  pthread_join(otherThread, nullptr);
+  pthread_barrier_destroy(&args.Step);
+  EXPECT_EQ(0u, args.Mismatches);
+}
@@ -0,0 +1,122 @@
+//===--- MetadataProfile.cpp - Metadata profile tests ---------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Metadata.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+#if defined(__ELF__)
+
+using namespace swift;
+
+static uint32_t ProfileDescription = 0;
+static uint32_t ProfileArgument = 0;
+
+static struct {
+  GenericMetadata Header;
+  StructMetadata Template;
+} ProfileGenericPattern = {
+  {
+    [](GenericMetadata *pattern, const void *args) -> Metadata * {
+      return swift_allocateGenericValueMetadata(pattern, args);
+    },
+    3 * sizeof(void*), // metadata size
+    1, // num arguments
+    0, // address point
+    {} // private data
+  },
+  {
+    MetadataKind::Struct,
+    reinterpret_cast<const NominalTypeDescriptor*>(&ProfileDescription),
+    nullptr
+  }
+};
+
+static ProtocolDescriptor ProfileProto1 = { "ProfileProto1", nullptr,
+  ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+};
+static ProtocolDescriptor ProfileProto2 = { "ProfileProto2", nullptr,
+  ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+};
+
+// Replaying a profile in the process that recorded it produces exactly the
+// metadata that was recorded, since all of it is uniqued.
+TEST(MetadataProfileTest, record_and_replay) {
+  char path[] = "/tmp/metadata-profile-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+
+  swift_recordMetadataProfile(path);
+
+  const void *args[] = { &ProfileArgument };
+  auto generic = swift_getGenericMetadata(
+    reinterpret_cast<GenericMetadata *>(&ProfileGenericPattern), args);
+
+  const ProtocolDescriptor *protocols[] = { &ProfileProto2, &ProfileProto1 };
+  auto existential = swift_getExistentialTypeMetadata(2, protocols);
+
+  auto tuple = swift_getTupleTypeMetadata2(existential, &_TMBi32_.base,
+                                           "profiled  ", nullptr);
+  auto emptyLabelsTuple = swift_getTupleTypeMetadata2(existential,
+                                                      &_TMBi32_.base, "",
+                                                      nullptr);
+  auto unlabeledTuple = swift_getTupleTypeMetadata2(existential,
+                                                    &_TMBi32_.base, nullptr,
+                                                    nullptr);
+  EXPECT_NE(emptyLabelsTuple, unlabeledTuple);
+
+  auto function = swift_getFunctionTypeMetadata2(
+    FunctionTypeFlags().withNumArguments(2),
+    FunctionTypeMetadata::Argument(generic, true).getOpaqueValue(),
+    tuple, emptyLabelsTuple);
+
+  swift_recordMetadataProfile(nullptr);
+
+  // Only images with a GNU build ID can be described in a profile.
+  std::set<std::string> kinds;
+  std::ifstream profile(path);
+  for (std::string kind, rest; profile >> kind && std::getline(profile, rest);)
+    kinds.insert(kind);
+  if (!kinds.count("image")) {
+    unlink(path);
+    return;
+  }
+  for (auto kind : {"generic", "existential", "tuple", "function", "type"})
+    EXPECT_TRUE(kinds.count(kind)) << kind;
+
+  std::set<const void *> replayed;
+  swift_replayMetadataProfile(path,
+    [](const void *metadata, void *context) {
+      static_cast<std::set<const void *> *>(context)->insert(metadata);
+    }, &replayed);
+  unlink(path);
+
+  EXPECT_TRUE(replayed.count(generic));
+  EXPECT_TRUE(replayed.count(existential));
+  EXPECT_TRUE(replayed.count(tuple));
+  EXPECT_TRUE(replayed.count(emptyLabelsTuple));
+  EXPECT_TRUE(replayed.count(unlabeledTuple));
+  EXPECT_TRUE(replayed.count(function));
+  EXPECT_TRUE(replayed.count(&_TMBi32_.base));
+}
+
+#endif
@@ -13,40 +13,13 @@
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
 #include "gtest/gtest.h"
+#include "TestObject.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace swift;
 
-struct TestObject : HeapObject {
-  size_t *Addr;
-  size_t Value;
-};
-
-static void destroyTestObject(HeapObject *_object) {
-  auto object = static_cast<TestObject*>(_object);
-  assert(object->Addr && "object already deallocated");
-  *object->Addr = object->Value;
-  object->Addr = nullptr;
-  swift_deallocObject(object, sizeof(TestObject), alignof(TestObject) - 1);
-}
-
-static const FullMetadata<ClassMetadata> TestClassObjectMetadata = {
-  { { &destroyTestObject }, { &_TWVBo } },
-  { { { MetadataKind::Class } }, 0, /*rodata*/ 1,
-  ClassFlags::UsesSwift1Refcounting, nullptr, 0, 0, 0, 0, 0 }
-};
-
-/// Create an object that, when deallocated, stores the given value to
-/// the given pointer.
-static TestObject *allocTestObject(size_t *addr, size_t value) {
-  auto result =
-    static_cast<TestObject *>(swift_allocObject(&TestClassObjectMetadata,
-                                                sizeof(TestObject),
-                                                alignof(TestObject) - 1));
-  result->Addr = addr;
-  result->Value = value;
-  return result;
-}
-
 TEST(RefcountingTest, release) {
   size_t value = 0;
   auto object = allocTestObject(&value, 1);
@@ -153,6 +126,328 @@ TEST(RefcountingTest, unowned_retain_release_n) {
   EXPECT_EQ(1u, value);
 }
 
+TEST(RefcountingTest, weak_load_release) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object);
+  EXPECT_TRUE(isNativeSwiftWeakReference(&ref));
+
+  auto loaded = swift_weakLoadStrong(&ref);
+  EXPECT_EQ(object, loaded);
+  EXPECT_EQ(2u, swift_retainCount(object));
+  swift_release(loaded);
+
+  // The weak reference doesn't keep the object alive.
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  swift_weakDestroy(&ref);
+}
+
+TEST(RefcountingTest, weak_copy_take_assign) {
+  size_t value1 = 0, value2 = 0;
+  auto object1 = allocTestObject(&value1, 1);
+  auto object2 = allocTestObject(&value2, 2);
+  WeakReference ref1, ref2, ref3;
+  swift_weakInit(&ref1, object1);
+  swift_weakCopyInit(&ref2, &ref1);
+  swift_weakTakeInit(&ref3, &ref2);
+
+  auto loaded = swift_weakTakeStrong(&ref3);
+  EXPECT_EQ(object1, loaded);
+  swift_release(loaded);
+
+  swift_weakInit(&ref2, object2);
+  swift_weakCopyAssign(&ref3, &ref1);
+  swift_weakAssign(&ref1, object2);
+  swift_release(object1);
+  EXPECT_EQ(1u, value1);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref3));
+
+  loaded = swift_weakLoadStrong(&ref1);
+  EXPECT_EQ(object2, loaded);
+  swift_release(loaded);
+
+  swift_weakTakeAssign(&ref3, &ref2);
+  swift_release(object2);
+  EXPECT_EQ(2u, value2);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref1));
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref3));
+  swift_weakDestroy(&ref1);
+  swift_weakDestroy(&ref3);
+}
+
+// Weak references to a stack-promoted object stop finding it at the end of
+// its lifetime, and don't find the next object in the same stack slot.
+TEST(RefcountingTest, weak_stack_object) {
+  TestObject storage;
+  WeakReference ref;
+  for (size_t i = 1; i != 3; ++i) {
+    size_t value = 0;
+    auto object = static_cast<TestObject *>(
+      swift_initStackObject(&TestClassObjectMetadata, &storage));
+    object->Addr = &value;
+    object->Value = i;
+    swift_weakInit(&ref, object);
+
+    auto loaded = swift_weakLoadStrong(&ref);
+    EXPECT_EQ(object, loaded);
+    swift_release(loaded);
+
+    swift_release(object);
+    EXPECT_EQ(i, value);
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+    swift_verifyEndOfLifetime(object);
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+    swift_weakDestroy(&ref);
+  }
+}
+
+// Weak references to many objects keep finding the right object while
+// others are deallocated.
+TEST(RefcountingTest, weak_many_objects) {
+  const size_t NumObjects = 1000;
+  std::vector<size_t> values(NumObjects);
+  std::vector<TestObject *> objects;
+  std::vector<WeakReference> refs(NumObjects);
+  for (size_t i = 0; i != NumObjects; ++i) {
+    objects.push_back(allocTestObject(&values[i], i + 1));
+    swift_weakInit(&refs[i], objects[i]);
+  }
+
+  for (size_t i = 0; i < NumObjects; i += 3) {
+    swift_release(objects[i]);
+    EXPECT_EQ(i + 1, values[i]);
+  }
+
+  for (size_t i = 0; i != NumObjects; ++i) {
+    WeakReference ref;
+    swift_weakInit(&ref, i % 3 ? objects[i] : nullptr);
+    for (auto *r : {&refs[i], &ref}) {
+      auto loaded = swift_weakLoadStrong(r);
+      EXPECT_EQ(i % 3 ? objects[i] : nullptr, loaded);
+      swift_release(loaded);
+    }
+    swift_weakDestroy(&ref);
+  }
+
+  for (size_t i = 0; i != NumObjects; ++i) {
+    if (i % 3)
+      swift_release(objects[i]);
+    swift_weakDestroy(&refs[i]);
+  }
+}
+
+// Many threads loading the same weak reference, as with a shared delegate.
+// The WeakLoadContention benchmarks measure how fast these loads are.
+TEST(RefcountingTest, weak_load_contention) {
+  const unsigned NumThreads = 8;
+  const size_t NumLoads = 10000;
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object);
+  size_t unownedCount = swift_unownedRetainCount(object);
+
+  std::atomic<bool> start(false), stop(false);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    threads.emplace_back([&] {
+      while (!start) std::this_thread::yield();
+      for (size_t j = 0; j != NumLoads; ++j) {
+        auto loaded = swift_weakLoadStrong(&ref);
+        ASSERT_EQ(object, loaded);
+        swift_release(loaded);
+      }
+    });
+  }
+
+  start = true;
+  for (auto &thread : threads)
+    thread.join();
+
+  // Every load's retain was balanced by its release.
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(1u, swift_retainCount(object));
+  EXPECT_EQ(unownedCount, swift_unownedRetainCount(object));
+
+  // Race the last release against loads that must now fail.
+  stop = false;
+  threads.clear();
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        if (auto loaded = swift_weakLoadStrong(&ref))
+          swift_release(loaded);
+      }
+    });
+  }
+  swift_release(object);
+  stop = true;
+  for (auto &thread : threads)
+    thread.join();
+
+  // A loader may have held the last reference.
+  EXPECT_EQ(1u, value);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  swift_weakDestroy(&ref);
+}
+
+// Deallocation finishes while other threads keep loading the weak
+// reference, instead of waiting for the loads to let up.
+TEST(RefcountingTest, weak_dealloc_during_loads) {
+  const unsigned NumThreads = 8;
+
+  for (unsigned iteration = 0; iteration != 20; ++iteration) {
+    size_t value = 0;
+    auto object = allocTestObject(&value, 1);
+    WeakReference ref;
+    swift_weakInit(&ref, object);
+
+    std::atomic<unsigned> running(0);
+    std::atomic<bool> deallocated(false);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < NumThreads; ++i) {
+      threads.emplace_back([&] {
+        ++running;
+        while (!deallocated) {
+          if (auto loaded = swift_weakLoadStrong(&ref)) {
+            EXPECT_EQ(object, loaded);
+            swift_release(loaded);
+          }
+        }
+      });
+    }
+
+    while (running != NumThreads)
+      std::this_thread::yield();
+    swift_release(object);
+    deallocated = true;
+    for (auto &thread : threads)
+      thread.join();
+
+    EXPECT_EQ(1u, value);
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+    swift_weakDestroy(&ref);
+  }
+}
+
+///////////////////////////////////////////
+// Cross-thread reference counting tests //
+///////////////////////////////////////////
+
+// An object whose last reference is released by another thread is
+// deallocated right away, without waiting for the thread that allocated it.
+TEST(RefcountingTest, release_on_other_thread) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  swift_retain(object);
+  std::thread([&] {
+    swift_release_n(object, 2);
+    EXPECT_EQ(1u, value);
+  }).join();
+  EXPECT_EQ(1u, value);
+}
+
+// An object whose last reference is released by the thread that allocated
+// it, after another thread released some of the others, is deallocated by
+// that release.
+TEST(RefcountingTest, release_after_other_thread_releases) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  swift_retain_n(object, 2);
+  std::thread([&] { swift_release_n(object, 2); }).join();
+  EXPECT_EQ(0u, value);
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+}
+
+TEST(RefcountingTest, release_after_allocating_thread_exits) {
+  size_t value = 0;
+  TestObject *object = nullptr;
+  std::thread([&] {
+    object = allocTestObject(&value, 1);
+    swift_retain_n(object, 2);
+    swift_release(object);
+  }).join();
+
+  EXPECT_EQ(2u, swift_retainCount(object));
+  swift_release(object);
+  EXPECT_EQ(0u, value);
+  EXPECT_TRUE(swift_isUniquelyReferenced_nonNull_native(object));
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+}
+
+TEST(RefcountingTest, weak_load_on_other_thread) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object);
+
+  std::thread([&] {
+    auto loaded = swift_weakLoadStrong(&ref);
+    EXPECT_EQ(object, loaded);
+    EXPECT_EQ(2u, swift_retainCount(object));
+    EXPECT_FALSE(swift_isUniquelyReferenced_nonNull_native(object));
+    swift_release(loaded);
+  }).join();
+
+  EXPECT_TRUE(swift_isUniquelyReferenced_nonNull_native(object));
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+  std::thread([&] {
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  }).join();
+  swift_weakDestroy(&ref);
+}
+
+// Threads retaining and releasing objects allocated by another thread,
+// while that thread does the same.
+TEST(RefcountingTest, retain_release_contention) {
+  const unsigned NumThreads = 4;
+  const unsigned NumObjects = 64;
+  const unsigned NumIterations = 1000;
+
+  std::vector<size_t> values(NumObjects);
+  std::vector<TestObject *> objects;
+  for (unsigned i = 0; i < NumObjects; ++i)
+    objects.push_back(allocTestObject(&values[i], 1));
+
+  auto retainAndRelease = [&] {
+    for (unsigned iteration = 0; iteration < NumIterations; ++iteration) {
+      for (auto object : objects)
+        swift_retain(object);
+      for (auto object : objects)
+        swift_release(object);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < NumThreads; ++i)
+    threads.emplace_back(retainAndRelease);
+  retainAndRelease();
+  for (auto &thread : threads)
+    thread.join();
+
+  for (auto object : objects) {
+    EXPECT_EQ(1u, swift_retainCount(object));
+    EXPECT_TRUE(swift_isUniquelyReferenced_nonNull_native(object));
+  }
+
+  // Hand every object's last reference to another thread.
+  for (auto object : objects)
+    swift_retain(object);
+  std::thread([&] {
+    for (auto object : objects)
+      swift_release_n(object, 2);
+  }).join();
+  for (auto value : values)
+    EXPECT_EQ(1u, value);
+}
+
 /////////////////////////////////////////
 // Non-atomic reference counting tests //
 /////////////////////////////////////////
@@ -0,0 +1,165 @@
+//===--- Statistics.cpp - Runtime call statistics -------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/Statistics.h"
+#include "gtest/gtest.h"
+#include "TestObject.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace swift;
+
+#if defined(__linux__)
+
+static RuntimeStatistics getStatistics() {
+  RuntimeStatistics statistics;
+  swift_getRuntimeStatistics(&statistics);
+  return statistics;
+}
+
+TEST(RuntimeStatisticsTest, counts_calls) {
+  swift_enableRuntimeStatistics(0);
+  swift_resetRuntimeStatistics();
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  swift_retain(object);
+  swift_retain_n(object, 2);
+  swift_release_n(object, 2);
+  swift_release(object);
+  swift_release(object);
+
+  auto statistics = getStatistics();
+  EXPECT_EQ(1u, statistics.ObjectAllocations);
+  EXPECT_EQ(1u, statistics.ObjectDeallocations);
+  EXPECT_EQ(2u, statistics.Retains);
+  EXPECT_EQ(3u, statistics.Releases);
+
+  swift_disableRuntimeStatistics();
+}
+
+TEST(RuntimeStatisticsTest, keeps_counts_of_exited_threads) {
+  swift_enableRuntimeStatistics(0);
+  swift_resetRuntimeStatistics();
+
+  std::thread([] {
+    size_t value = 0;
+    auto object = allocTestObject(&value, 1);
+    for (unsigned i = 0; i != 10; ++i)
+      swift_retain(object);
+    for (unsigned i = 0; i != 11; ++i)
+      swift_release(object);
+  }).join();
+
+  auto statistics = getStatistics();
+  EXPECT_EQ(1u, statistics.ObjectAllocations);
+  EXPECT_EQ(10u, statistics.Retains);
+  EXPECT_EQ(11u, statistics.Releases);
+
+  swift_disableRuntimeStatistics();
+}
+
+TEST(RuntimeStatisticsTest, disable_and_reset) {
+  size_t value = 0;
+  swift_enableRuntimeStatistics(0);
+  swift_resetRuntimeStatistics();
+  swift_release(allocTestObject(&value, 1));
+  swift_disableRuntimeStatistics();
+
+  // Calls made while disabled aren't counted.
+  swift_release(allocTestObject(&value, 2));
+  auto statistics = getStatistics();
+  EXPECT_EQ(1u, statistics.ObjectAllocations);
+  EXPECT_EQ(1u, statistics.Releases);
+
+  swift_resetRuntimeStatistics();
+  statistics = getStatistics();
+  EXPECT_EQ(0u, statistics.ObjectAllocations);
+  EXPECT_EQ(0u, statistics.ObjectDeallocations);
+  EXPECT_EQ(0u, statistics.Releases);
+}
+
+static unsigned NominalTypeDescriptorStorage = 0;
+
+struct SlowGenericMetadataPattern {
+  GenericMetadata Header;
+  StructMetadata Template;
+};
+
+static SlowGenericMetadataPattern SlowPattern = {
+  {
+    // Instantiate slowly enough that other threads have to wait.
+    [](GenericMetadata *pattern, const void *args) -> Metadata * {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      return swift_allocateGenericValueMetadata(pattern, args);
+    },
+    sizeof(StructMetadata), // metadata size
+    1, // num arguments
+    0, // address point
+    {} // private data
+  },
+  {
+    MetadataKind::Struct,
+    reinterpret_cast<const NominalTypeDescriptor *>(
+      &NominalTypeDescriptorStorage),
+    nullptr
+  }
+};
+
+static GenericMetadataStatistics
+getGenericMetadataStatistics(const GenericMetadata *pattern) {
+  struct Context {
+    const GenericMetadata *Pattern;
+    GenericMetadataStatistics Result;
+  } context = { pattern, {} };
+
+  swift_enumerateGenericMetadataStatistics(
+    [](const GenericMetadataStatistics *statistics, void *rawContext) {
+      auto context = static_cast<Context *>(rawContext);
+      if (statistics->Pattern == context->Pattern)
+        context->Result = *statistics;
+    }, &context);
+  return context.Result;
+}
+
+TEST(RuntimeStatisticsTest, generic_metadata_instantiations) {
+  swift_enableRuntimeStatistics(0);
+  swift_resetRuntimeStatistics();
+
+  auto pattern = &SlowPattern.Header;
+  static unsigned argument1, argument2;
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i != 8; ++i) {
+    threads.emplace_back([&, i] {
+      const void *args[] = { i % 2 ? &argument1 : &argument2 };
+      swift_getGenericMetadata(pattern, args);
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  auto statistics = getGenericMetadataStatistics(pattern);
+  EXPECT_EQ(pattern, statistics.Pattern);
+  EXPECT_EQ(2u, statistics.Instantiations);
+  EXPECT_LE(2u * 10000000, statistics.TotalNanoseconds);
+  EXPECT_LE(statistics.Waits, 6u);
+
+  swift_resetRuntimeStatistics();
+  EXPECT_EQ(nullptr, getGenericMetadataStatistics(pattern).Pattern);
+
+  swift_disableRuntimeStatistics();
+}
+
+#endif
@@ -0,0 +1,55 @@
+//===--- TestObject.h - A heap object class for runtime tests ---*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2016 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_UNITTESTS_RUNTIME_TESTOBJECT_H
+#define SWIFT_UNITTESTS_RUNTIME_TESTOBJECT_H
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include <cassert>
+
+namespace {
+
+struct TestObject : swift::HeapObject {
+  size_t *Addr;
+  size_t Value;
+};
+
+void destroyTestObject(swift::HeapObject *_object) {
+  auto object = static_cast<TestObject*>(_object);
+  assert(object->Addr && "object already deallocated");
+  *object->Addr = object->Value;
+  object->Addr = nullptr;
+  swift::swift_deallocObject(object, sizeof(TestObject),
+                             alignof(TestObject) - 1);
+}
+
+const swift::FullMetadata<swift::ClassMetadata> TestClassObjectMetadata = {
+  { { &destroyTestObject }, { &swift::_TWVBo } },
+  { { { swift::MetadataKind::Class } }, 0, /*rodata*/ 1,
+  swift::ClassFlags::UsesSwift1Refcounting, nullptr, 0, 0, 0, 0, 0 }
+};
+
+/// Create an object that, when deallocated, stores the given value to
+/// the given pointer.
+TestObject *allocTestObject(size_t *addr, size_t value) {
+  auto result = static_cast<TestObject *>(
+    swift::swift_allocObject(&TestClassObjectMetadata, sizeof(TestObject),
+                             alignof(TestObject) - 1));
+  result->Addr = addr;
+  result->Value = value;
+  return result;
+}
+
+} // end anonymous namespace
+
+#endif